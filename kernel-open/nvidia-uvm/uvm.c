@@ -22,6 +22,7 @@
 *******************************************************************************/
 
 #include "uvm_api.h"
+#include "uvm_fence.h"
 #include "uvm_global.h"
 #include "uvm_gpu_replayable_faults.h"
 #include "uvm_tools_init.h"
@@ -993,6 +994,38 @@ static NV_STATUS uvm_api_pageable_mem_access(UVM_PAGEABLE_MEM_ACCESS_PARAMS *par
     return NV_OK;
 }
 
+// Same as UVM_ROUTE_CMD_STACK_INIT_CHECK, except that the fence file descriptor
+// is installed only after the params are copied back to user-space. Once
+// installed, the descriptor could not be taken back if the copy failed.
+static long uvm_ioctl_migrate_fence(struct file *filp, unsigned long arg)
+{
+    UVM_MIGRATE_FENCE_PARAMS params;
+    struct file *fence_file = NULL;
+
+    if (copy_from_user(&params, (void __user*)arg, sizeof(params)))
+        return -EFAULT;
+
+    params.rmStatus = uvm_global_get_status();
+    if (params.rmStatus == NV_OK) {
+        if (!uvm_fd_va_space(filp))
+            params.rmStatus = NV_ERR_ILLEGAL_ACTION;
+        else
+            params.rmStatus = uvm_api_migrate_fence(&params, filp, &fence_file);
+    }
+
+    if (copy_to_user((void __user*)arg, &params, sizeof(params))) {
+        if (fence_file)
+            uvm_fence_discard_file(params.fenceFd, fence_file);
+
+        return -EFAULT;
+    }
+
+    if (fence_file)
+        uvm_fence_install_file(params.fenceFd, fence_file);
+
+    return 0;
+}
+
 static long uvm_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
     switch (cmd)
@@ -1046,6 +1079,13 @@ static long uvm_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TOOLS_GET_PROCESSOR_UUID_TABLE_V2,uvm_api_tools_get_processor_uuid_table_v2);
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_ALLOC_DEVICE_P2P,               uvm_api_alloc_device_p2p);
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_CLEAR_ALL_ACCESS_COUNTERS,      uvm_api_clear_all_access_counters);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_MIGRATE_BATCH,                  uvm_api_migrate_batch);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_SET_THRASHING_POLICY,           uvm_api_set_thrashing_policy);
+        case UVM_MIGRATE_FENCE:
+            return uvm_ioctl_migrate_fence(filp, arg);
+
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TOOLS_GET_NUMA_MIGRATION_COUNTERS,uvm_api_tools_get_numa_migration_counters);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_SET_READ_DUPLICATION_WRITE_TRACKING,uvm_api_set_read_duplication_write_tracking);
     }
 
     // Try the test ioctls if none of the above matched
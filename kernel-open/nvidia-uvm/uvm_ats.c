@@ -23,6 +23,7 @@
 
 #include "uvm_va_space.h"
 #include "uvm_ats.h"
+#include "uvm_ats_faults.h"
 #include "uvm_global.h"
 #include "uvm_gpu.h"
 
@@ -40,6 +41,8 @@ void uvm_ats_init(const UvmPlatformInfo *platform_info)
                                g_uvm_global.ats.supported       &&
                                UVM_ATS_SUPPORTED()              &&
                                uvm_va_space_mm_enabled_system();
+
+    uvm_ats_faults_init();
 }
 
 NV_STATUS uvm_ats_add_gpu(uvm_parent_gpu_t *parent_gpu)
@@ -111,6 +114,10 @@ NV_STATUS uvm_ats_register_gpu_va_space(uvm_gpu_va_space_t *gpu_va_space)
     if (uvm_processor_mask_test(&va_space->ats.registered_gpu_va_spaces, gpu_id))
         return NV_ERR_INVALID_DEVICE;
 
+    // No ATS faults are serviced in the GPU VA space until it is registered
+    memset(&gpu_va_space->ats.seq_prefetch, 0, sizeof(gpu_va_space->ats.seq_prefetch));
+    uvm_spin_lock_init(&gpu_va_space->ats.seq_prefetch.lock, UVM_LOCK_ORDER_LEAF);
+
     status = uvm_ats_sva_register_gpu_va_space(gpu_va_space);
 
     if (status == NV_OK)
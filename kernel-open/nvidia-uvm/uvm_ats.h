@@ -79,6 +79,35 @@ typedef struct
     atomic_t state;
 } uvm_ats_va_space_t;
 
+// State of the sequential ATS prefetcher of a GPU VA space. See
+// ats_seq_prefetch() in uvm_ats_faults.c.
+typedef struct
+{
+    // Protects all the fields below. Replayable faults in the same GPU VA space
+    // can be serviced concurrently by the fault service workers.
+    uvm_spinlock_t lock;
+
+    // Start of the last faults. A stream is continued by faults which start
+    // after this address.
+    NvU64 fault_start;
+
+    // End of the range covered by the stream, including the prefetched pages.
+    // Faults up to UVM_VA_BLOCK_SIZE after this address continue the stream. 0
+    // if there is no stream.
+    NvU64 stream_end;
+
+    // Number of consecutive fault groups which continued the stream
+    NvU32 confidence;
+
+    // Current prefetch window size in bytes. It doubles on every fault group
+    // which continues the stream, up to uvm_perf_ats_seq_prefetch_max_kb.
+    NvU64 window;
+
+    // Prefetched range which has not been accounted as hit or waste yet
+    NvU64 pending_start;
+    NvU64 pending_end;
+} uvm_ats_seq_prefetch_t;
+
 typedef struct
 {
     // Each GPU VA space can have ATS enabled or disabled in its hardware
@@ -90,6 +119,8 @@ typedef struct
     NvU32 pasid;
 
     uvm_sva_gpu_va_space_t sva;
+
+    uvm_ats_seq_prefetch_t seq_prefetch;
 } uvm_ats_gpu_va_space_t;
 
 // Initializes driver-wide ATS state
@@ -36,6 +36,64 @@
 #include <linux/hmm.h>
 #endif
 
+#define UVM_ATS_SEQ_PREFETCH_CONFIDENCE_MIN     1
+#define UVM_ATS_SEQ_PREFETCH_CONFIDENCE_DEFAULT 2
+#define UVM_ATS_SEQ_PREFETCH_CONFIDENCE_MAX     16
+
+#define UVM_ATS_SEQ_PREFETCH_MAX_KB_MIN     (UVM_VA_BLOCK_SIZE / 1024)
+#define UVM_ATS_SEQ_PREFETCH_MAX_KB_DEFAULT (8 * 1024)
+#define UVM_ATS_SEQ_PREFETCH_MAX_KB_MAX     (64 * 1024)
+
+// Enable the sequential ATS prefetcher. The faulting region prefetcher only
+// considers the UVM_VA_BLOCK_SIZE region of the faults, so a sequential scan
+// otherwise takes a fault round trip for every new piece of the region. Once
+// uvm_perf_ats_seq_prefetch_confidence consecutive groups of replayable faults
+// in a GPU VA space continue the same ascending stream, the pages following
+// the stream are populated and mapped ahead of the faults with a single
+// uvm_migrate_pageable() call. The window ahead of the faults starts at
+// UVM_VA_BLOCK_SIZE and doubles while the stream continues, up to
+// uvm_perf_ats_seq_prefetch_max_kb.
+static unsigned uvm_perf_ats_seq_prefetch = 0;
+static unsigned uvm_perf_ats_seq_prefetch_confidence = UVM_ATS_SEQ_PREFETCH_CONFIDENCE_DEFAULT;
+static unsigned uvm_perf_ats_seq_prefetch_max_kb = UVM_ATS_SEQ_PREFETCH_MAX_KB_DEFAULT;
+
+module_param(uvm_perf_ats_seq_prefetch, uint, S_IRUGO);
+module_param(uvm_perf_ats_seq_prefetch_confidence, uint, S_IRUGO);
+module_param(uvm_perf_ats_seq_prefetch_max_kb, uint, S_IRUGO);
+
+static bool g_uvm_perf_ats_seq_prefetch;
+static unsigned g_uvm_perf_ats_seq_prefetch_confidence;
+static NvU64 g_uvm_perf_ats_seq_prefetch_max_size;
+
+void uvm_ats_faults_init(void)
+{
+    g_uvm_perf_ats_seq_prefetch = uvm_perf_ats_seq_prefetch != 0;
+
+    if (uvm_perf_ats_seq_prefetch_confidence >= UVM_ATS_SEQ_PREFETCH_CONFIDENCE_MIN &&
+        uvm_perf_ats_seq_prefetch_confidence <= UVM_ATS_SEQ_PREFETCH_CONFIDENCE_MAX) {
+        g_uvm_perf_ats_seq_prefetch_confidence = uvm_perf_ats_seq_prefetch_confidence;
+    }
+    else {
+        UVM_INFO_PRINT("Invalid value %u for uvm_perf_ats_seq_prefetch_confidence. Using %u instead\n",
+                       uvm_perf_ats_seq_prefetch_confidence,
+                       UVM_ATS_SEQ_PREFETCH_CONFIDENCE_DEFAULT);
+
+        g_uvm_perf_ats_seq_prefetch_confidence = UVM_ATS_SEQ_PREFETCH_CONFIDENCE_DEFAULT;
+    }
+
+    if (uvm_perf_ats_seq_prefetch_max_kb >= UVM_ATS_SEQ_PREFETCH_MAX_KB_MIN &&
+        uvm_perf_ats_seq_prefetch_max_kb <= UVM_ATS_SEQ_PREFETCH_MAX_KB_MAX) {
+        g_uvm_perf_ats_seq_prefetch_max_size = (NvU64)uvm_perf_ats_seq_prefetch_max_kb * 1024;
+    }
+    else {
+        UVM_INFO_PRINT("Invalid value %u for uvm_perf_ats_seq_prefetch_max_kb. Using %u instead\n",
+                       uvm_perf_ats_seq_prefetch_max_kb,
+                       UVM_ATS_SEQ_PREFETCH_MAX_KB_DEFAULT);
+
+        g_uvm_perf_ats_seq_prefetch_max_size = (NvU64)UVM_ATS_SEQ_PREFETCH_MAX_KB_DEFAULT * 1024;
+    }
+}
+
 typedef enum
 {
     UVM_ATS_SERVICE_TYPE_FAULTS = 0,
@@ -120,14 +178,11 @@ static NV_STATUS service_ats_requests(uvm_gpu_va_space_t *gpu_va_space,
 static void flush_tlb_va_region(uvm_gpu_va_space_t *gpu_va_space,
                                 NvU64 addr,
                                 size_t size,
-                                uvm_fault_client_type_t client_type)
+                                uvm_ats_fault_context_t *ats_context)
 {
-    uvm_ats_fault_invalidate_t *ats_invalidate;
+    uvm_ats_fault_invalidate_t *ats_invalidate = ats_context->ats_invalidate;
 
-    if (client_type == UVM_FAULT_CLIENT_TYPE_GPC)
-        ats_invalidate = &gpu_va_space->gpu->parent->fault_buffer.replayable.ats_invalidate;
-    else
-        ats_invalidate = &gpu_va_space->gpu->parent->fault_buffer.non_replayable.ats_invalidate;
+    UVM_ASSERT(ats_invalidate);
 
     if (!ats_invalidate->tlb_batch_pending) {
         uvm_tlb_batch_begin(&gpu_va_space->page_tables, &ats_invalidate->tlb_batch);
@@ -503,6 +558,44 @@ static NV_STATUS ats_compute_prefetch(uvm_gpu_va_space_t *gpu_va_space,
     return status;
 }
 
+// Invalidate the translations which might be stale after servicing the range
+// [start, start + length) with the given access type.
+static void ats_invalidate_serviced_range(uvm_gpu_va_space_t *gpu_va_space,
+                                          NvU64 start,
+                                          size_t length,
+                                          uvm_fault_access_type_t access_type,
+                                          uvm_ats_fault_context_t *ats_context)
+{
+    // WAR for older kernel versions missing an SMMU invalidate on RO -> RW
+    // transition. The SMMU and GPU could have the stale RO copy cached in their
+    // TLBs, which could have caused this write fault. This operation
+    // invalidates the SMMU TLBs but not the GPU TLBs. That will happen below as
+    // necessary.
+    if (access_type == UVM_FAULT_ACCESS_TYPE_WRITE)
+        uvm_ats_smmu_invalidate_tlbs(gpu_va_space, start, length);
+
+    // The Linux kernel does not invalidate TLB entries on an invalid to valid
+    // PTE transition. The GPU might have the invalid PTE cached in its TLB.
+    // The GPU will re-fetch an entry on access if the PTE is invalid and the
+    // page size is not 4K, but if the page size is 4K no re-fetch will happen
+    // and the GPU will fault despite the CPU PTE being valid. We don't know
+    // whether these faults happened due to stale entries after a transition,
+    // so use the hammer of always invalidating the GPU's TLB on each fault.
+    //
+    // The second case is similar and handles missing ATS invalidations on RO ->
+    // RW transitions for all page sizes. See the uvm_ats_smmu_invalidate_tlbs()
+    // call above.
+    if (PAGE_SIZE == UVM_PAGE_SIZE_4K || (UVM_ATS_SMMU_WAR_REQUIRED() && access_type == UVM_FAULT_ACCESS_TYPE_WRITE)) {
+        flush_tlb_va_region(gpu_va_space, start, length, ats_context);
+    }
+    else {
+        // ARM requires TLB invalidations on RO -> RW, but not all architectures
+        // do. If we implement ATS support on other architectures, we might need
+        // to issue GPU invalidates.
+        UVM_ASSERT(NVCPU_IS_AARCH64);
+    }
+}
+
 static NV_STATUS uvm_ats_service_faults_region(uvm_gpu_va_space_t *gpu_va_space,
                                                struct vm_area_struct *vma,
                                                NvU64 base,
@@ -542,36 +635,161 @@ static NV_STATUS uvm_ats_service_faults_region(uvm_gpu_va_space_t *gpu_va_space,
 
     uvm_page_mask_region_fill(faults_serviced_mask, region);
 
-    // WAR for older kernel versions missing an SMMU invalidate on RO -> RW
-    // transition. The SMMU and GPU could have the stale RO copy cached in their
-    // TLBs, which could have caused this write fault. This operation
-    // invalidates the SMMU TLBs but not the GPU TLBs. That will happen below as
-    // necessary.
-    if (access_type == UVM_FAULT_ACCESS_TYPE_WRITE)
-        uvm_ats_smmu_invalidate_tlbs(gpu_va_space, start, length);
+    ats_invalidate_serviced_range(gpu_va_space, start, length, access_type, ats_context);
 
-    // The Linux kernel does not invalidate TLB entries on an invalid to valid
-    // PTE transition. The GPU might have the invalid PTE cached in its TLB.
-    // The GPU will re-fetch an entry on access if the PTE is invalid and the
-    // page size is not 4K, but if the page size is 4K no re-fetch will happen
-    // and the GPU will fault despite the CPU PTE being valid. We don't know
-    // whether these faults happened due to stale entries after a transition,
-    // so use the hammer of always invalidating the GPU's TLB on each fault.
-    //
-    // The second case is similar and handles missing ATS invalidations on RO ->
-    // RW transitions for all page sizes. See the uvm_ats_smmu_invalidate_tlbs()
-    // call above.
-    if (PAGE_SIZE == UVM_PAGE_SIZE_4K || (UVM_ATS_SMMU_WAR_REQUIRED() && access_type == UVM_FAULT_ACCESS_TYPE_WRITE)) {
-        flush_tlb_va_region(gpu_va_space, start, length, ats_context->client_type);
+    return NV_OK;
+}
+
+// Account the pending prefetched pages of the stream. Pages the faults moved
+// past are hits. If the faults left the stream, the pages it did not reach are
+// waste. This is a heuristic, since ATS accesses to prefetched pages don't
+// fault and are not observed.
+static void seq_prefetch_account(uvm_ats_seq_prefetch_t *seq,
+                                 NvU64 fault_start,
+                                 bool continues,
+                                 NvU64 *hit_pages,
+                                 NvU64 *waste_pages)
+{
+    NvU64 hit_end;
+
+    if (seq->pending_start == seq->pending_end)
+        return;
+
+    if (!continues) {
+        *waste_pages += (seq->pending_end - seq->pending_start) / PAGE_SIZE;
+        seq->pending_start = seq->pending_end;
+        return;
+    }
+
+    hit_end = min(fault_start, seq->pending_end);
+    if (hit_end > seq->pending_start) {
+        *hit_pages += (hit_end - seq->pending_start) / PAGE_SIZE;
+        seq->pending_start = hit_end;
+    }
+}
+
+// Update the sequential stream of the GPU VA space with the faults just
+// serviced in the UVM_VA_BLOCK_SIZE region at base, and populate the pages
+// following the stream if it is confident enough.
+//
+// The stream is continued by faults which start after the start of the
+// previous faults, and no further than UVM_VA_BLOCK_SIZE past the end of the
+// range covered by the stream. Streams are tracked per GPU VA space, so
+// interleaved scans of distinct buffers keep resetting each other and don't
+// trigger prefetches.
+static void ats_seq_prefetch(uvm_gpu_va_space_t *gpu_va_space,
+                             struct vm_area_struct *vma,
+                             NvU64 base,
+                             uvm_ats_fault_context_t *ats_context)
+{
+    uvm_ats_seq_prefetch_t *seq = &gpu_va_space->ats.seq_prefetch;
+    uvm_va_block_region_t fault_region;
+    uvm_va_block_region_t serviced_region;
+    uvm_fault_access_type_t access_type;
+    NvU64 fault_start;
+    NvU64 fault_end;
+    NvU64 prefetch_start = 0;
+    NvU64 prefetch_end = 0;
+    NvU64 hit_pages = 0;
+    NvU64 waste_pages = 0;
+    bool continues;
+    NV_STATUS status;
+
+    if (uvm_page_mask_empty(&ats_context->faults.accessed_mask) ||
+        uvm_page_mask_empty(&ats_context->faults.faults_serviced_mask))
+        return;
+
+    fault_region = uvm_va_block_region_from_mask(NULL, &ats_context->faults.accessed_mask);
+    serviced_region = uvm_va_block_region_from_mask(NULL, &ats_context->faults.faults_serviced_mask);
+
+    fault_start = base + fault_region.first * PAGE_SIZE;
+
+    // The serviced pages include those prefetched within the region by
+    // ats_compute_prefetch().
+    fault_end = base + max(fault_region.outer, serviced_region.outer) * PAGE_SIZE;
+
+    uvm_spin_lock(&seq->lock);
+
+    continues = (seq->stream_end != 0) &&
+                (fault_start > seq->fault_start) &&
+                (fault_start <= seq->stream_end + UVM_VA_BLOCK_SIZE);
+
+    seq_prefetch_account(seq, fault_start, continues, &hit_pages, &waste_pages);
+
+    if (continues) {
+        if (seq->confidence < g_uvm_perf_ats_seq_prefetch_confidence)
+            ++seq->confidence;
+
+        seq->stream_end = max(seq->stream_end, fault_end);
     }
     else {
-        // ARM requires TLB invalidations on RO -> RW, but not all architectures
-        // do. If we implement ATS support on other architectures, we might need
-        // to issue GPU invalidates.
-        UVM_ASSERT(NVCPU_IS_AARCH64);
+        seq->confidence = 0;
+        seq->window = 0;
+        seq->stream_end = fault_end;
     }
 
-    return NV_OK;
+    seq->fault_start = fault_start;
+
+    if (seq->confidence >= g_uvm_perf_ats_seq_prefetch_confidence) {
+        // The faulting region is known not to overlap GMMU mappings, but the
+        // following UVM_GMMU_ATS_GRANULARITY region might.
+        NvU64 gmmu_region_end = UVM_ALIGN_DOWN(fault_start, UVM_GMMU_ATS_GRANULARITY) + UVM_GMMU_ATS_GRANULARITY;
+
+        if (seq->window == 0)
+            seq->window = min((NvU64)UVM_VA_BLOCK_SIZE, g_uvm_perf_ats_seq_prefetch_max_size);
+        else
+            seq->window = min(seq->window * 2, g_uvm_perf_ats_seq_prefetch_max_size);
+
+        // Only the part of the window not covered by previous prefetches is
+        // populated.
+        prefetch_start = seq->stream_end;
+        prefetch_end = min3(fault_end + seq->window, (NvU64)vma->vm_end, gmmu_region_end);
+
+        if (prefetch_start < prefetch_end) {
+            if (seq->pending_start == seq->pending_end)
+                seq->pending_start = prefetch_start;
+
+            seq->pending_end = prefetch_end;
+            seq->stream_end = prefetch_end;
+        }
+    }
+
+    uvm_spin_unlock(&seq->lock);
+
+    if (hit_pages || waste_pages)
+        uvm_tools_record_ats_prefetch(gpu_va_space->va_space, gpu_va_space->gpu, hit_pages, waste_pages);
+
+    if (prefetch_start >= prefetch_end)
+        return;
+
+    // Populate with the same permissions as the pages prefetched within the
+    // faulting region. See ats_compute_prefetch().
+    access_type = (vma->vm_flags & VM_WRITE) ? UVM_FAULT_ACCESS_TYPE_WRITE : UVM_FAULT_ACCESS_TYPE_READ;
+
+    status = service_ats_requests(gpu_va_space,
+                                  vma,
+                                  prefetch_start,
+                                  prefetch_end - prefetch_start,
+                                  access_type,
+                                  UVM_ATS_SERVICE_TYPE_FAULTS,
+                                  ats_context);
+    if (status != NV_OK) {
+        // Prefetch failures are not fatal, the pages will be faulted on and
+        // serviced individually. Drop them from the pending pages so they are
+        // not accounted, and restart the window growth.
+        uvm_spin_lock(&seq->lock);
+
+        if (seq->pending_end == prefetch_end)
+            seq->pending_end = max(seq->pending_start, prefetch_start);
+
+        seq->window = 0;
+
+        uvm_spin_unlock(&seq->lock);
+
+        return;
+    }
+
+    ats_invalidate_serviced_range(gpu_va_space, prefetch_start, prefetch_end - prefetch_start, access_type, ats_context);
 }
 
 NV_STATUS uvm_ats_service_faults(uvm_gpu_va_space_t *gpu_va_space,
@@ -679,6 +897,10 @@ NV_STATUS uvm_ats_service_faults(uvm_gpu_va_space_t *gpu_va_space,
             return status;
     }
 
+    // Non-replayable faults are not part of the SM access streams
+    if (g_uvm_perf_ats_seq_prefetch && (ats_context->client_type == UVM_FAULT_CLIENT_TYPE_GPC))
+        ats_seq_prefetch(gpu_va_space, vma, base, ats_context);
+
     return status;
 }
 
@@ -27,6 +27,11 @@
 #include "uvm_va_space.h"
 #include "uvm_gpu.h"
 
+// Validates the ATS fault servicing module parameters
+//
+// LOCKING: None
+void uvm_ats_faults_init(void);
+
 // Service ATS faults in the range (base, base + UVM_VA_BLOCK_SIZE) with service
 // type for individual pages in the range requested by page masks set in
 // ats_context->fault.read_fault_mask/write_fault_mask/prefetch_only_mask.
@@ -37,6 +42,11 @@
 // responsible for handling any errors returned by this function (fault
 // cancellations etc.).
 //
+// If uvm_perf_ats_seq_prefetch is enabled and the replayable faults continue a
+// sequential stream in the GPU VA space, the pages following the stream are
+// also populated ahead of the faults, possibly beyond base + UVM_VA_BLOCK_SIZE.
+// Those pages are not reported in the returned masks.
+//
 // Returns the fault service status in ats_context->fault.faults_serviced_mask.
 // In addition, ats_context->fault.reads_serviced_mask returns whether read
 // servicing worked on write faults iff the read service was also requested in
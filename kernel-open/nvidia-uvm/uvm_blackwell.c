@@ -36,6 +36,8 @@ void uvm_hal_blackwell_arch_init_properties(uvm_parent_gpu_t *parent_gpu)
     // TODO: Bug 1767241: Run benchmarks to figure out a good number
     parent_gpu->tlb_batch.max_ranges = 8;
 
+    parent_gpu->tlb_batch.max_merged_range_size = UVM_PAGE_SIZE_2M;
+
     parent_gpu->utlb_per_gpc_count = uvm_blackwell_get_utlbs_per_gpc(parent_gpu);
 
     parent_gpu->fault_buffer.replayable.utlb_count = parent_gpu->rm_info.maxGpcCount * parent_gpu->utlb_per_gpc_count;
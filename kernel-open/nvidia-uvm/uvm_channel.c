@@ -646,6 +646,50 @@ NV_STATUS uvm_channel_reserve_type(uvm_channel_manager_t *manager, uvm_channel_t
     return channel_reserve_in_pool(pool, reserve_type, channel_out);
 }
 
+unsigned uvm_channel_manager_num_stripe_channels(uvm_channel_manager_t *manager, uvm_channel_type_t type)
+{
+    unsigned i;
+    unsigned num_channels = 0;
+
+    UVM_ASSERT(type < UVM_CHANNEL_TYPE_CE_COUNT);
+
+    for (i = 0; i < manager->pool_to_use.num_stripe_pools[type]; i++)
+        num_channels += manager->pool_to_use.stripe_for_type[type][i]->num_channels;
+
+    return num_channels;
+}
+
+uvm_channel_t *uvm_channel_manager_stripe_channel(uvm_channel_manager_t *manager,
+                                                  uvm_channel_type_t type,
+                                                  unsigned stripe_index)
+{
+    unsigned num_pools;
+    unsigned channel_index;
+
+    UVM_ASSERT(type < UVM_CHANNEL_TYPE_CE_COUNT);
+
+    num_pools = manager->pool_to_use.num_stripe_pools[type];
+    UVM_ASSERT(num_pools > 0);
+
+    stripe_index %= uvm_channel_manager_num_stripe_channels(manager, type);
+
+    // Pools can have different numbers of channels, so pools running out of
+    // channels are skipped in the later rounds.
+    for (channel_index = 0; ; channel_index++) {
+        unsigned i;
+
+        for (i = 0; i < num_pools; i++) {
+            uvm_channel_pool_t *pool = manager->pool_to_use.stripe_for_type[type][i];
+
+            if (channel_index >= pool->num_channels)
+                continue;
+
+            if (stripe_index-- == 0)
+                return pool->channels + channel_index;
+        }
+    }
+}
+
 NV_STATUS uvm_channel_reserve_gpu_to_gpu(uvm_channel_manager_t *manager,
                                          uvm_gpu_t *dst_gpu,
                                          uvm_channel_t **channel_out)
@@ -3109,7 +3153,57 @@ static void pick_ces_for_channel_types(uvm_channel_manager_t *manager,
     }
 }
 
-static void pick_ces(uvm_channel_manager_t *manager, const UvmGpuCopyEngineCaps *ce_caps, unsigned *preferred_ce)
+// Returns true if transfers of the given type can be striped over the CE
+// described by cap, in addition to the preferred CE described by best_cap.
+// Only CEs as fast as the preferred one for the transfer type are used, and CEs
+// dedicated to NvLink P2P are left alone unless the preferred one is also one.
+static bool ce_can_stripe_channel_type(const UvmGpuCopyEngineCaps *cap,
+                                       const UvmGpuCopyEngineCaps *best_cap,
+                                       uvm_channel_type_t type)
+{
+    if (cap->nvlinkP2p && !best_cap->nvlinkP2p)
+        return false;
+
+    switch (type) {
+        case UVM_CHANNEL_TYPE_CPU_TO_GPU:
+            return cap->sysmemRead == best_cap->sysmemRead;
+
+        case UVM_CHANNEL_TYPE_GPU_TO_CPU:
+            return cap->sysmemWrite == best_cap->sysmemWrite;
+
+        default:
+            return false;
+    }
+}
+
+// Select the CEs across which large transfers of each type can be striped.
+// The preferred CE of the type is always the first one.
+static void pick_stripe_ces(const UvmGpuCopyEngineCaps *ce_caps, const unsigned *preferred_ce, NvU64 *stripe_ces)
+{
+    uvm_channel_type_t type;
+
+    BUILD_BUG_ON(UVM_COPY_ENGINE_COUNT_MAX > 64);
+
+    for (type = 0; type < UVM_CHANNEL_TYPE_CE_COUNT; type++) {
+        unsigned ce;
+        const unsigned best_ce = preferred_ce[type];
+
+        stripe_ces[type] = 1ULL << best_ce;
+
+        for (ce = 0; ce < UVM_COPY_ENGINE_COUNT_MAX; ++ce) {
+            if (ce == best_ce || !ce_is_usable(ce_caps + ce))
+                continue;
+
+            if (ce_can_stripe_channel_type(ce_caps + ce, ce_caps + best_ce, type))
+                stripe_ces[type] |= 1ULL << ce;
+        }
+    }
+}
+
+static void pick_ces(uvm_channel_manager_t *manager,
+                     const UvmGpuCopyEngineCaps *ce_caps,
+                     unsigned *preferred_ce,
+                     NvU64 *stripe_ces)
 {
     // The order of picking CEs for each type matters as it's affected by
     // the usage count of each CE and it increases every time a CE
@@ -3124,6 +3218,8 @@ static void pick_ces(uvm_channel_manager_t *manager, const UvmGpuCopyEngineCaps
     UVM_ASSERT(!g_uvm_global.conf_computing_enabled);
 
     pick_ces_for_channel_types(manager, ce_caps, types, ARRAY_SIZE(types), preferred_ce);
+
+    pick_stripe_ces(ce_caps, preferred_ce, stripe_ces);
 }
 
 static void pick_ces_conf_computing(uvm_channel_manager_t *manager,
@@ -3156,7 +3252,7 @@ static void pick_ces_conf_computing(uvm_channel_manager_t *manager,
         UVM_ASSERT(ce_usage_count(best_wlc_ce, preferred_ce) == 0);
 }
 
-static NV_STATUS channel_manager_pick_ces(uvm_channel_manager_t *manager, unsigned *preferred_ce)
+static NV_STATUS channel_manager_pick_ces(uvm_channel_manager_t *manager, unsigned *preferred_ce, NvU64 *stripe_ces)
 {
     NV_STATUS status;
     UvmGpuCopyEnginesCaps *ces_caps;
@@ -3165,6 +3261,9 @@ static NV_STATUS channel_manager_pick_ces(uvm_channel_manager_t *manager, unsign
     for (type = 0; type < UVM_CHANNEL_TYPE_COUNT; type++)
         preferred_ce[type] = UVM_COPY_ENGINE_COUNT_MAX;
 
+    for (type = 0; type < UVM_CHANNEL_TYPE_CE_COUNT; type++)
+        stripe_ces[type] = 0;
+
     ces_caps = uvm_kvmalloc_zero(sizeof(*ces_caps));
     if (!ces_caps)
         return NV_ERR_NO_MEMORY;
@@ -3180,7 +3279,7 @@ static NV_STATUS channel_manager_pick_ces(uvm_channel_manager_t *manager, unsign
     if (g_uvm_global.conf_computing_enabled)
         pick_ces_conf_computing(manager, ces_caps->copyEngineCaps, preferred_ce);
     else
-        pick_ces(manager, ces_caps->copyEngineCaps, preferred_ce);
+        pick_ces(manager, ces_caps->copyEngineCaps, preferred_ce, stripe_ces);
 
 out:
     uvm_kvfree(ces_caps);
@@ -3419,7 +3518,9 @@ static unsigned channel_manager_get_max_pools(uvm_channel_manager_t *manager)
     return num_channel_pools;
 }
 
-static NV_STATUS channel_manager_create_ce_pools(uvm_channel_manager_t *manager, unsigned *preferred_ce)
+static NV_STATUS channel_manager_create_ce_pools(uvm_channel_manager_t *manager,
+                                                 unsigned *preferred_ce,
+                                                 const NvU64 *stripe_ces)
 {
     unsigned ce;
     unsigned type;
@@ -3448,6 +3549,28 @@ static NV_STATUS channel_manager_create_ce_pools(uvm_channel_manager_t *manager,
         manager->pool_to_use.default_for_type[type] = channel_manager_ce_pool(manager, ce);
     }
 
+    for (type = 0; type < UVM_CHANNEL_TYPE_CE_COUNT; type++) {
+        uvm_channel_pool_t *default_pool = manager->pool_to_use.default_for_type[type];
+        unsigned num_pools = 0;
+
+        manager->pool_to_use.stripe_for_type[type][num_pools++] = default_pool;
+
+        // Striping is only supported across pools of CE channels owned by UVM
+        if (default_pool->pool_type != UVM_CHANNEL_POOL_TYPE_CE) {
+            manager->pool_to_use.num_stripe_pools[type] = num_pools;
+            continue;
+        }
+
+        for_each_set_bit(ce, manager->ce_mask, UVM_COPY_ENGINE_COUNT_MAX) {
+            if (ce == default_pool->engine_index || !(stripe_ces[type] & (1ULL << ce)))
+                continue;
+
+            manager->pool_to_use.stripe_for_type[type][num_pools++] = channel_manager_ce_pool(manager, ce);
+        }
+
+        manager->pool_to_use.num_stripe_pools[type] = num_pools;
+    }
+
     return NV_OK;
 }
 
@@ -3835,8 +3958,9 @@ static NV_STATUS channel_manager_create_pools(uvm_channel_manager_t *manager)
     NV_STATUS status;
     unsigned max_channel_pools;
     unsigned preferred_ce[UVM_CHANNEL_TYPE_COUNT];
+    NvU64 stripe_ces[UVM_CHANNEL_TYPE_CE_COUNT];
 
-    status = channel_manager_pick_ces(manager, preferred_ce);
+    status = channel_manager_pick_ces(manager, preferred_ce, stripe_ces);
     if (status != NV_OK)
         return status;
 
@@ -3850,7 +3974,7 @@ static NV_STATUS channel_manager_create_pools(uvm_channel_manager_t *manager)
     if (status != NV_OK)
         return status;
 
-    status = channel_manager_create_ce_pools(manager, preferred_ce);
+    status = channel_manager_create_ce_pools(manager, preferred_ce, stripe_ces);
     if (status != NV_OK)
         return status;
 
@@ -3865,6 +3989,8 @@ static NV_STATUS channel_manager_create_pools(uvm_channel_manager_t *manager)
             return status;
 
         manager->pool_to_use.default_for_type[channel_type] = proxy_pool;
+        manager->pool_to_use.stripe_for_type[channel_type][0] = proxy_pool;
+        manager->pool_to_use.num_stripe_pools[channel_type] = 1;
     }
 
     return NV_OK;
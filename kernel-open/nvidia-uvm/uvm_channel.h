@@ -223,6 +223,10 @@ typedef struct
     // Pool type: Refer to the uvm_channel_pool_type_t enum.
     uvm_channel_pool_type_t pool_type;
 
+    // Index of the pushbuffer chunk last used by a push in this pool. Only a
+    // hint, read and written without synchronization.
+    NvU32 pushbuffer_chunk_hint;
+
     // Lock protecting the state of channels in the pool.
     //
     // There are two pool lock types available: spinlock and mutex. The mutex
@@ -454,6 +458,15 @@ struct uvm_channel_manager_struct
         // If there is no optimal pool (the entry is NULL), use default pool
         // default_for_type[UVM_CHANNEL_GPU_TO_GPU] instead.
         uvm_channel_pool_t *gpu_to_gpu[UVM_ID_MAX_GPUS];
+
+        // Pools across which large transfers of a given type can be striped,
+        // starting with default_for_type[type]. Only CPU_TO_GPU and GPU_TO_CPU
+        // transfers are striped, and only if Confidential Computing is
+        // disabled. Otherwise the only stripe pool is the default one.
+        uvm_channel_pool_t *stripe_for_type[UVM_CHANNEL_TYPE_CE_COUNT][UVM_COPY_ENGINE_COUNT_MAX];
+
+        // Number of valid entries in stripe_for_type[type]
+        unsigned num_stripe_pools[UVM_CHANNEL_TYPE_CE_COUNT];
     } pool_to_use;
 
     struct
@@ -684,6 +697,23 @@ NV_STATUS uvm_channel_reserve_type(uvm_channel_manager_t *manager,
                                    uvm_channel_type_t type,
                                    uvm_channel_t **channel_out);
 
+// Number of distinct channels across which transfers of the given type can be
+// striped. See uvm_channel_manager_stripe_channel().
+unsigned uvm_channel_manager_num_stripe_channels(uvm_channel_manager_t *manager, uvm_channel_type_t type);
+
+// Return the channel to use for the stripe_index-th part of a transfer of the
+// given type split across several channels. Consecutive stripes rotate across
+// the pools of CEs suitable for the type first, and then across the channels
+// within each pool, so that the first stripes land on different CEs. Every
+// stripe channel is used once before any is used again, even if the pools have
+// different numbers of channels.
+//
+// The channel is not reserved: pushes are expected to be started with
+// uvm_push_begin_acquire_on_channel().
+uvm_channel_t *uvm_channel_manager_stripe_channel(uvm_channel_manager_t *manager,
+                                                  uvm_channel_type_t type,
+                                                  unsigned stripe_index);
+
 // Select and reserve a channel for a transfer from channel_manager->gpu to
 // dst_gpu.
 NV_STATUS uvm_channel_reserve_gpu_to_gpu(uvm_channel_manager_t *channel_manager,
@@ -963,6 +963,62 @@ error:
     return status;
 }
 
+static NV_STATUS test_stripe_channels(uvm_va_space_t *va_space)
+{
+    uvm_gpu_t *gpu;
+
+    for_each_va_space_gpu(gpu, va_space) {
+        uvm_channel_manager_t *manager = gpu->channel_manager;
+        uvm_channel_type_t channel_type;
+
+        for (channel_type = 0; channel_type < UVM_CHANNEL_TYPE_CE_COUNT; channel_type++) {
+            unsigned num_pools = manager->pool_to_use.num_stripe_pools[channel_type];
+            unsigned num_channels = uvm_channel_manager_num_stripe_channels(manager, channel_type);
+            unsigned i;
+
+            TEST_CHECK_RET(num_pools >= 1);
+            TEST_CHECK_RET(manager->pool_to_use.stripe_for_type[channel_type][0] ==
+                           manager->pool_to_use.default_for_type[channel_type]);
+            TEST_CHECK_RET(num_channels >= manager->pool_to_use.default_for_type[channel_type]->num_channels);
+
+            if (g_uvm_global.conf_computing_enabled ||
+                (channel_type != UVM_CHANNEL_TYPE_CPU_TO_GPU && channel_type != UVM_CHANNEL_TYPE_GPU_TO_CPU))
+                TEST_CHECK_RET(num_pools == 1);
+
+            // The first stripes land on distinct CEs
+            for (i = 0; i < num_pools; i++) {
+                uvm_channel_t *channel = uvm_channel_manager_stripe_channel(manager, channel_type, i);
+                unsigned j;
+
+                TEST_CHECK_RET(channel->pool == manager->pool_to_use.stripe_for_type[channel_type][i]);
+
+                for (j = 0; j < i; j++)
+                    TEST_CHECK_RET(channel->pool->engine_index !=
+                                   manager->pool_to_use.stripe_for_type[channel_type][j]->engine_index);
+            }
+
+            // Every channel is used once before any is used again, whatever the
+            // number of channels in each pool
+            for (i = 0; i < num_channels; i++) {
+                uvm_channel_t *channel = uvm_channel_manager_stripe_channel(manager, channel_type, i);
+                unsigned j;
+
+                TEST_CHECK_RET(channel >= channel->pool->channels);
+                TEST_CHECK_RET(channel < channel->pool->channels + channel->pool->num_channels);
+
+                for (j = 0; j < i; j++)
+                    TEST_CHECK_RET(uvm_channel_manager_stripe_channel(manager, channel_type, j) != channel);
+            }
+
+            // And the rotation starts over afterwards
+            TEST_CHECK_RET(uvm_channel_manager_stripe_channel(manager, channel_type, num_channels) ==
+                           uvm_channel_manager_stripe_channel(manager, channel_type, 0));
+        }
+    }
+
+    return NV_OK;
+}
+
 static NV_STATUS test_channel_iv_rotation(uvm_va_space_t *va_space)
 {
     uvm_gpu_t *gpu;
@@ -1624,6 +1680,10 @@ NV_STATUS uvm_test_channel_sanity(UVM_TEST_CHANNEL_SANITY_PARAMS *params, struct
     if (status != NV_OK)
         goto done;
 
+    status = test_stripe_channels(va_space);
+    if (status != NV_OK)
+        goto done;
+
     status = test_channel_iv_rotation(va_space);
     if (status != NV_OK)
         goto done;
@@ -1904,3 +1964,225 @@ NV_STATUS uvm_test_channel_stress(UVM_TEST_CHANNEL_STRESS_PARAMS *params, struct
             return NV_ERR_INVALID_PARAMETER;
     }
 }
+
+// Copy size bytes from src to dst split in num_stripes parts, each pushed to
+// the channel returned by uvm_channel_manager_stripe_channel(), and wait for
+// all of them.
+static NV_STATUS striped_memcopy(uvm_gpu_t *gpu,
+                                 uvm_channel_type_t channel_type,
+                                 unsigned num_stripes,
+                                 uvm_gpu_address_t dst,
+                                 uvm_gpu_address_t src,
+                                 NvU64 size)
+{
+    NV_STATUS status = NV_OK;
+    NV_STATUS tracker_status;
+    uvm_tracker_t tracker = UVM_TRACKER_INIT();
+    NvU64 stripe_size = UVM_ALIGN_UP(DIV_ROUND_UP(size, num_stripes), PAGE_SIZE);
+    NvU64 offset;
+    unsigned stripe;
+
+    for (stripe = 0, offset = 0; offset < size; stripe++, offset += stripe_size) {
+        uvm_channel_t *channel = uvm_channel_manager_stripe_channel(gpu->channel_manager, channel_type, stripe);
+        uvm_gpu_address_t stripe_dst = dst;
+        uvm_gpu_address_t stripe_src = src;
+        uvm_push_t push;
+
+        status = uvm_push_begin_on_channel(channel, &push, "Stripe %u of %u", stripe, num_stripes);
+        if (status != NV_OK)
+            break;
+
+        stripe_dst.address += offset;
+        stripe_src.address += offset;
+        gpu->parent->ce_hal->memcopy(&push, stripe_dst, stripe_src, min(stripe_size, size - offset));
+
+        uvm_push_end(&push);
+
+        status = uvm_tracker_add_push_safe(&tracker, &push);
+        if (status != NV_OK) {
+            uvm_push_wait(&push);
+            break;
+        }
+    }
+
+    tracker_status = uvm_tracker_wait_deinit(&tracker);
+
+    return status == NV_OK ? tracker_status : status;
+}
+
+static NV_STATUS time_striped_memcopy(uvm_gpu_t *gpu,
+                                      uvm_channel_type_t channel_type,
+                                      unsigned num_stripes,
+                                      uvm_gpu_address_t dst,
+                                      uvm_gpu_address_t src,
+                                      NvU64 size,
+                                      NvU32 iterations,
+                                      NvU64 *elapsed_ns)
+{
+    NvU64 start = NV_GETTIME();
+    NvU32 i;
+
+    for (i = 0; i < iterations; i++)
+        TEST_NV_CHECK_RET(striped_memcopy(gpu, channel_type, num_stripes, dst, src, size));
+
+    *elapsed_ns = max(NV_GETTIME() - start, 1ULL);
+
+    return NV_OK;
+}
+
+static NV_STATUS alloc_sysmem_for_gpu(uvm_gpu_t *gpu, NvU64 size, uvm_mem_t **mem)
+{
+    NV_STATUS status;
+
+    *mem = NULL;
+
+    TEST_NV_CHECK_RET(uvm_mem_alloc_sysmem_dma(size, gpu, NULL, mem));
+    TEST_NV_CHECK_GOTO(uvm_mem_map_cpu_kernel(*mem), error);
+    TEST_NV_CHECK_GOTO(uvm_mem_map_gpu_kernel(*mem, gpu), error);
+
+    return NV_OK;
+
+error:
+    uvm_mem_free(*mem);
+    *mem = NULL;
+    return status;
+}
+
+static NV_STATUS channel_stripe_bandwidth(uvm_gpu_t *gpu, UVM_TEST_CHANNEL_STRIPE_BANDWIDTH_PARAMS *params)
+{
+    NV_STATUS status;
+    uvm_mem_t *sysmem_src = NULL;
+    uvm_mem_t *sysmem_dst = NULL;
+    uvm_mem_t *vidmem = NULL;
+    uvm_gpu_address_t sysmem_src_address, sysmem_dst_address, vidmem_address;
+    uvm_channel_type_t channel_type;
+    NvU64 size = params->size ? params->size : 64 * 1024 * 1024;
+    NvU32 iterations = params->iterations ? params->iterations : 4;
+    unsigned num_stripes;
+    NvU64 *cpu_va;
+    NvU64 i;
+
+    if (params->direction == UVM_TEST_CHANNEL_STRIPE_DIRECTION_CPU_TO_GPU)
+        channel_type = UVM_CHANNEL_TYPE_CPU_TO_GPU;
+    else if (params->direction == UVM_TEST_CHANNEL_STRIPE_DIRECTION_GPU_TO_CPU)
+        channel_type = UVM_CHANNEL_TYPE_GPU_TO_CPU;
+    else
+        return NV_ERR_INVALID_ARGUMENT;
+
+    if (!PAGE_ALIGNED(size) || size > 1024ull * 1024 * 1024)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    // Copies are encrypted in Confidential Computing, and not striped
+    if (g_uvm_global.conf_computing_enabled)
+        return NV_ERR_NOT_SUPPORTED;
+
+    num_stripes = uvm_channel_manager_num_stripe_channels(gpu->channel_manager, channel_type);
+    if (params->stripes)
+        num_stripes = min(num_stripes, (unsigned)params->stripes);
+    num_stripes = min(num_stripes, (unsigned)(size / PAGE_SIZE));
+
+    TEST_NV_CHECK_GOTO(alloc_sysmem_for_gpu(gpu, size, &sysmem_src), done);
+    TEST_NV_CHECK_GOTO(alloc_sysmem_for_gpu(gpu, size, &sysmem_dst), done);
+    TEST_NV_CHECK_GOTO(uvm_mem_alloc_vidmem(size, gpu, &vidmem), done);
+    TEST_NV_CHECK_GOTO(uvm_mem_map_gpu_kernel(vidmem, gpu), done);
+
+    sysmem_src_address = uvm_mem_gpu_address_virtual_kernel(sysmem_src, gpu);
+    sysmem_dst_address = uvm_mem_gpu_address_virtual_kernel(sysmem_dst, gpu);
+    vidmem_address = uvm_mem_gpu_address_virtual_kernel(vidmem, gpu);
+
+    cpu_va = uvm_mem_get_cpu_addr_kernel(sysmem_src);
+    for (i = 0; i < size / sizeof(*cpu_va); i++)
+        cpu_va[i] = i;
+
+    memset(uvm_mem_get_cpu_addr_kernel(sysmem_dst), 0, size);
+
+    // Round trip through vidmem with striped copies in both directions
+    TEST_NV_CHECK_GOTO(striped_memcopy(gpu,
+                                       UVM_CHANNEL_TYPE_CPU_TO_GPU,
+                                       num_stripes,
+                                       vidmem_address,
+                                       sysmem_src_address,
+                                       size),
+                       done);
+    TEST_NV_CHECK_GOTO(striped_memcopy(gpu,
+                                       UVM_CHANNEL_TYPE_GPU_TO_CPU,
+                                       num_stripes,
+                                       sysmem_dst_address,
+                                       vidmem_address,
+                                       size),
+                       done);
+    TEST_CHECK_GOTO(memcmp(uvm_mem_get_cpu_addr_kernel(sysmem_src), uvm_mem_get_cpu_addr_kernel(sysmem_dst), size) == 0,
+                    done);
+
+    if (channel_type == UVM_CHANNEL_TYPE_CPU_TO_GPU) {
+        TEST_NV_CHECK_GOTO(time_striped_memcopy(gpu,
+                                                channel_type,
+                                                1,
+                                                vidmem_address,
+                                                sysmem_src_address,
+                                                size,
+                                                iterations,
+                                                &params->single_ns),
+                           done);
+        TEST_NV_CHECK_GOTO(time_striped_memcopy(gpu,
+                                                channel_type,
+                                                num_stripes,
+                                                vidmem_address,
+                                                sysmem_src_address,
+                                                size,
+                                                iterations,
+                                                &params->striped_ns),
+                           done);
+    }
+    else {
+        TEST_NV_CHECK_GOTO(time_striped_memcopy(gpu,
+                                                channel_type,
+                                                1,
+                                                sysmem_dst_address,
+                                                vidmem_address,
+                                                size,
+                                                iterations,
+                                                &params->single_ns),
+                           done);
+        TEST_NV_CHECK_GOTO(time_striped_memcopy(gpu,
+                                                channel_type,
+                                                num_stripes,
+                                                sysmem_dst_address,
+                                                vidmem_address,
+                                                size,
+                                                iterations,
+                                                &params->striped_ns),
+                           done);
+    }
+
+    // Bytes per nanosecond is GB/s, report MB/s
+    params->stripes_used = num_stripes;
+    params->single_mbps = (size * iterations * 1000) / params->single_ns;
+    params->striped_mbps = (size * iterations * 1000) / params->striped_ns;
+
+done:
+    uvm_mem_free(vidmem);
+    uvm_mem_free(sysmem_dst);
+    uvm_mem_free(sysmem_src);
+
+    return status;
+}
+
+NV_STATUS uvm_test_channel_stripe_bandwidth(UVM_TEST_CHANNEL_STRIPE_BANDWIDTH_PARAMS *params, struct file *filp)
+{
+    NV_STATUS status;
+    uvm_gpu_t *gpu;
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+
+    uvm_va_space_down_read_rm(va_space);
+
+    gpu = uvm_va_space_get_gpu_by_uuid(va_space, &params->gpu_uuid);
+    if (gpu)
+        status = channel_stripe_bandwidth(gpu, params);
+    else
+        status = NV_ERR_INVALID_DEVICE;
+
+    uvm_va_space_up_read_rm(va_space);
+
+    return status;
+}
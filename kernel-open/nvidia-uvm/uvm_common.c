@@ -117,6 +117,10 @@ NV_STATUS errno_to_nv_status(int errnoCode)
         case ENOMEM:
             return NV_ERR_NO_MEMORY;
 
+        case EMFILE:
+        case ENFILE:
+            return NV_ERR_INSUFFICIENT_RESOURCES;
+
         case EPERM:
             return NV_ERR_INSUFFICIENT_PERMISSIONS;
 
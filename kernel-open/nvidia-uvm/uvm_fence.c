@@ -0,0 +1,331 @@
+/*******************************************************************************
+    Copyright (c) 2025 NVIDIA Corporation
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+*******************************************************************************/
+
+#include "uvm_common.h"
+#include "uvm_api.h"
+#include "uvm_fence.h"
+#include "uvm_global.h"
+#include "uvm_gpu.h"
+#include "uvm_kvmalloc.h"
+#include "uvm_test.h"
+#include "uvm_tracker.h"
+#include "uvm_va_block.h"
+#include "uvm_va_space.h"
+
+typedef struct
+{
+    // One reference is held by the file and one by the pending q_item
+    struct kref kref;
+
+    // Copy of the tracker of the fenced work. Only accessed by the signaling
+    // q_item.
+    uvm_tracker_t tracker;
+
+    // GPUs referenced by the tracker or checked for NVLINK errors. They are
+    // retained until the fence is signaled.
+    uvm_processor_mask_t retained_gpus;
+
+    // GPUs checked for NVLINK errors once the tracker completes
+    uvm_processor_mask_t nvlink_gpus;
+
+    nv_kthread_q_item_t q_item;
+
+    // Woken up when the fence is signaled
+    wait_queue_head_t wait_queue;
+
+    // Status of the fenced work. Written once, before signaled is set.
+    NV_STATUS status;
+
+    bool signaled;
+} uvm_fence_t;
+
+// Queue waiting on the trackers of the pending fences
+static nv_kthread_q_t g_uvm_fence_q;
+
+static bool fence_is_signaled(uvm_fence_t *fence)
+{
+    // Pairs with the smp_store_release() in fence_signal()
+    return smp_load_acquire(&fence->signaled);
+}
+
+static void fence_destroy(struct kref *kref)
+{
+    uvm_fence_t *fence = container_of(kref, uvm_fence_t, kref);
+
+    uvm_tracker_deinit(&fence->tracker);
+    uvm_kvfree(fence);
+}
+
+static void fence_signal(uvm_fence_t *fence)
+{
+    NV_STATUS status = uvm_tracker_wait(&fence->tracker);
+
+    // Check for STO errors in case there was no other error until now, same as
+    // the synchronous version of the fenced operation.
+    if (status == NV_OK && !uvm_processor_mask_empty(&fence->nvlink_gpus))
+        status = uvm_global_gpu_check_nvlink_error(&fence->nvlink_gpus);
+
+    uvm_global_gpu_release(&fence->retained_gpus);
+
+    fence->status = status;
+    smp_store_release(&fence->signaled, true);
+    wake_up_all(&fence->wait_queue);
+
+    kref_put(&fence->kref, fence_destroy);
+}
+
+static void fence_signal_entry(void *args)
+{
+    UVM_ENTRY_VOID(fence_signal(args));
+}
+
+static unsigned uvm_fence_poll(struct file *filp, poll_table *wait)
+{
+    uvm_fence_t *fence = filp->private_data;
+    unsigned flags = 0;
+
+    poll_wait(filp, &fence->wait_queue, wait);
+
+    if (fence_is_signaled(fence)) {
+        flags = POLLIN | POLLRDNORM;
+        if (fence->status != NV_OK)
+            flags |= POLLERR;
+    }
+
+    return flags;
+}
+
+static unsigned uvm_fence_poll_entry(struct file *filp, poll_table *wait)
+{
+    UVM_ENTRY_RET(uvm_fence_poll(filp, wait));
+}
+
+static ssize_t uvm_fence_read(struct file *filp, char __user *buf, size_t count, loff_t *ppos)
+{
+    uvm_fence_t *fence = filp->private_data;
+
+    if (count < sizeof(fence->status))
+        return -EINVAL;
+
+    if (!fence_is_signaled(fence)) {
+        if (filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+
+        if (wait_event_interruptible(fence->wait_queue, fence_is_signaled(fence)))
+            return -ERESTARTSYS;
+    }
+
+    if (copy_to_user(buf, &fence->status, sizeof(fence->status)))
+        return -EFAULT;
+
+    return sizeof(fence->status);
+}
+
+static ssize_t uvm_fence_read_entry(struct file *filp, char __user *buf, size_t count, loff_t *ppos)
+{
+    UVM_ENTRY_RET(uvm_fence_read(filp, buf, count, ppos));
+}
+
+static int uvm_fence_release(struct inode *inode, struct file *filp)
+{
+    uvm_fence_t *fence = filp->private_data;
+
+    // The fence outlives the file if it is still pending
+    kref_put(&fence->kref, fence_destroy);
+
+    return 0;
+}
+
+static int uvm_fence_release_entry(struct inode *inode, struct file *filp)
+{
+    UVM_ENTRY_RET(uvm_fence_release(inode, filp));
+}
+
+static const struct file_operations uvm_fence_fops =
+{
+    .release = uvm_fence_release_entry,
+    .read    = uvm_fence_read_entry,
+    .poll    = uvm_fence_poll_entry,
+    .llseek  = noop_llseek,
+    .owner   = THIS_MODULE,
+};
+
+NV_STATUS uvm_fence_create_file(uvm_tracker_t *tracker,
+                                const uvm_processor_mask_t *gpus_to_check_for_nvlink_errors,
+                                int *fd_out,
+                                struct file **file_out)
+{
+    uvm_fence_t *fence;
+    uvm_tracker_entry_t *entry;
+    struct file *file;
+    NV_STATUS status;
+    int fd;
+    int ret;
+
+    fence = uvm_kvmalloc_zero(sizeof(*fence));
+    if (!fence)
+        return NV_ERR_NO_MEMORY;
+
+    status = uvm_tracker_init_from(&fence->tracker, tracker);
+    if (status != NV_OK)
+        goto error;
+
+    for_each_tracker_entry(entry, &fence->tracker)
+        uvm_processor_mask_set(&fence->retained_gpus, uvm_tracker_entry_gpu(entry)->id);
+
+    if (gpus_to_check_for_nvlink_errors) {
+        uvm_processor_mask_copy(&fence->nvlink_gpus, gpus_to_check_for_nvlink_errors);
+        uvm_processor_mask_or(&fence->retained_gpus, &fence->retained_gpus, gpus_to_check_for_nvlink_errors);
+    }
+
+    init_waitqueue_head(&fence->wait_queue);
+    nv_kthread_q_item_init(&fence->q_item, fence_signal_entry, fence);
+
+    fd = get_unused_fd_flags(O_CLOEXEC);
+    if (fd < 0) {
+        status = errno_to_nv_status(fd);
+        goto error;
+    }
+
+    file = anon_inode_getfile("[nvidia-uvm-fence]", &uvm_fence_fops, fence, O_RDONLY);
+    if (IS_ERR(file)) {
+        put_unused_fd(fd);
+        status = errno_to_nv_status(PTR_ERR(file));
+        goto error;
+    }
+
+    // The file owns the initial reference, and the q_item takes a second one
+    kref_init(&fence->kref);
+    kref_get(&fence->kref);
+
+    // The VA space lock held by the caller keeps the GPUs registered
+    uvm_global_gpu_retain(&fence->retained_gpus);
+
+    ret = nv_kthread_q_schedule_q_item(&g_uvm_fence_q, &fence->q_item);
+    UVM_ASSERT(ret != 0);
+
+    *fd_out = fd;
+    *file_out = file;
+
+    return NV_OK;
+
+error:
+    uvm_tracker_deinit(&fence->tracker);
+    uvm_kvfree(fence);
+
+    return status;
+}
+
+void uvm_fence_install_file(int fd, struct file *file)
+{
+    fd_install(fd, file);
+}
+
+void uvm_fence_discard_file(int fd, struct file *file)
+{
+    // Releasing the file drops its fence reference. The fence is still
+    // signaled by the q_item, which holds the other reference.
+    fput(file);
+    put_unused_fd(fd);
+}
+
+NV_STATUS uvm_fence_init(void)
+{
+    return errno_to_nv_status(nv_kthread_q_init(&g_uvm_fence_q, "UVM fence queue"));
+}
+
+void uvm_fence_exit(void)
+{
+    // Flushes the pending fences, which releases the GPUs they retain
+    nv_kthread_q_stop(&g_uvm_fence_q);
+}
+
+static NV_STATUS test_fence_blocks_completed(uvm_va_space_t *va_space, NvU64 base, NvU64 length)
+{
+    NvU64 addr = base;
+    NV_STATUS status = NV_OK;
+
+    uvm_va_space_down_read(va_space);
+
+    while (addr < base + length) {
+        uvm_va_block_t *va_block;
+        bool completed;
+
+        // Only managed ranges have VA blocks
+        if (uvm_va_block_find(va_space, addr, &va_block) != NV_OK) {
+            addr = UVM_ALIGN_DOWN(addr, UVM_VA_BLOCK_SIZE) + UVM_VA_BLOCK_SIZE;
+            continue;
+        }
+
+        uvm_mutex_lock(&va_block->lock);
+        completed = uvm_tracker_is_completed(&va_block->tracker);
+        uvm_mutex_unlock(&va_block->lock);
+
+        TEST_CHECK_GOTO(completed, done);
+
+        addr = va_block->end + 1;
+    }
+
+done:
+    uvm_va_space_up_read(va_space);
+
+    return status;
+}
+
+NV_STATUS uvm_test_migrate_fence(UVM_TEST_MIGRATE_FENCE_PARAMS *params, struct file *filp)
+{
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+    UVM_MIGRATE_FENCE_PARAMS migrate_params = {0};
+    struct file *fence_file;
+    uvm_fence_t *fence;
+    unsigned poll_flags;
+    NV_STATUS status;
+
+    migrate_params.base = params->base;
+    migrate_params.length = params->length;
+    migrate_params.destinationUuid = params->destination_uuid;
+    migrate_params.cpuNumaNode = params->cpu_numa_node;
+
+    status = uvm_api_migrate_fence(&migrate_params, filp, &fence_file);
+    if (status != NV_OK)
+        return status;
+
+    fence = fence_file->private_data;
+
+    wait_event(fence->wait_queue, fence_is_signaled(fence));
+
+    // Return the migration status as-is, it is checked by the caller
+    status = fence->status;
+
+    poll_flags = uvm_fence_poll(fence_file, NULL);
+    TEST_CHECK_GOTO(poll_flags & POLLIN, done);
+    TEST_CHECK_GOTO(!!(poll_flags & POLLERR) == (status != NV_OK), done);
+
+    if (status == NV_OK)
+        status = test_fence_blocks_completed(va_space, params->base, params->length);
+
+done:
+    uvm_fence_discard_file(migrate_params.fenceFd, fence_file);
+
+    return status;
+}
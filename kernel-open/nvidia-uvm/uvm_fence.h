@@ -0,0 +1,77 @@
+/*******************************************************************************
+    Copyright (c) 2025 NVIDIA Corporation
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+*******************************************************************************/
+
+#ifndef __UVM_FENCE_H__
+#define __UVM_FENCE_H__
+
+#include "uvm_forward_decl.h"
+#include "uvm_processors.h"
+#include "uvm_tracker.h"
+
+// User-visible fences
+//
+// A fence is an anonymous file which signals the completion of the work in a
+// tracker. It lets user-space wait for an asynchronous operation, such as
+// UVM_MIGRATE_FENCE, from poll/select/epoll instead of blocking a thread in the
+// ioctl:
+//
+// - poll() reports POLLIN | POLLRDNORM once the fence is signaled, and
+//   additionally POLLERR if the tracked work failed.
+// - read() returns the NV_STATUS of the tracked work (sizeof(NV_STATUS) bytes).
+//   It blocks until the fence is signaled, unless the file is in non-blocking
+//   mode, in which case it fails with -EAGAIN.
+//
+// Fences are signaled from a dedicated kthread queue which waits on the
+// trackers in creation order.
+
+NV_STATUS uvm_fence_init(void);
+void uvm_fence_exit(void);
+
+// Create a fence signaled when all the entries in tracker complete. The fence
+// file is returned in file_out, along with a reserved file descriptor in
+// fd_out. The tracker is copied, so the caller retains ownership of it.
+//
+// The file descriptor is not visible to user-space until the caller passes
+// both to uvm_fence_install_file(). Callers which fail after the fence is
+// created, for example when copying the descriptor back to user-space, must
+// pass them to uvm_fence_discard_file() instead. The fenced work is waited on
+// either way.
+//
+// The GPUs in gpus_to_check_for_nvlink_errors are checked for NVLINK errors
+// once the tracker completes, and any error is reported as the fence status.
+// The mask can be NULL.
+//
+// All the GPUs referenced by the tracker and by the mask are retained until
+// the fence is signaled.
+//
+// LOCKING: The caller must hold the VA space lock, which prevents the GPUs in
+//          the tracker from being unregistered.
+NV_STATUS uvm_fence_create_file(uvm_tracker_t *tracker,
+                                const uvm_processor_mask_t *gpus_to_check_for_nvlink_errors,
+                                int *fd_out,
+                                struct file **file_out);
+
+void uvm_fence_install_file(int fd, struct file *file);
+void uvm_fence_discard_file(int fd, struct file *file);
+
+#endif // __UVM_FENCE_H__
@@ -37,6 +37,7 @@
 #include "uvm_pmm_sysmem.h"
 #include "uvm_pmm_gpu.h"
 #include "uvm_migrate.h"
+#include "uvm_fence.h"
 #include "uvm_gpu_access_counters.h"
 #include "uvm_va_space_mm.h"
 #include "nv_uvm_interface.h"
@@ -176,6 +177,12 @@ NV_STATUS uvm_global_init(void)
         goto error;
     }
 
+    status = uvm_fence_init();
+    if (status != NV_OK) {
+        UVM_ERR_PRINT("uvm_fence_init() failed: %s\n", nvstatusToString(status));
+        goto error;
+    }
+
     status = uvm_perf_events_init();
     if (status != NV_OK) {
         UVM_ERR_PRINT("uvm_perf_events_init() failed: %s\n", nvstatusToString(status));
@@ -234,6 +241,7 @@ void uvm_global_exit(void)
     uvm_service_block_context_exit();
     uvm_perf_heuristics_exit();
     uvm_perf_events_exit();
+    uvm_fence_exit();
     uvm_migrate_exit();
     uvm_range_group_exit();
     uvm_va_range_exit();
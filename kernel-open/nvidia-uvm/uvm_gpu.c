@@ -633,7 +633,7 @@ static void gpu_info_print_common(uvm_gpu_t *gpu, struct seq_file *s)
         UVM_SEQ_OR_DBG_PRINT(s, "replayable_faults_replay_policy        %s\n",
                              uvm_perf_fault_replay_policy_string(gpu->parent->fault_buffer.replayable.replay_policy));
         UVM_SEQ_OR_DBG_PRINT(s, "replayable_faults_num_faults           %llu\n",
-                             gpu->parent->stats.num_replayable_faults);
+                             (NvU64)atomic64_read(&gpu->parent->stats.num_replayable_faults));
     }
     if (gpu->parent->isr.non_replayable_faults.handling) {
         UVM_SEQ_OR_DBG_PRINT(s, "non_replayable_faults_bh               %llu\n",
@@ -689,6 +689,24 @@ static void gpu_info_print_common(uvm_gpu_t *gpu, struct seq_file *s)
     UVM_SEQ_OR_DBG_PRINT(s, "mapped_cpu_pages_dma                   %llu (%llu MB)\n",
                          mapped_cpu_pages_size / PAGE_SIZE,
                          mapped_cpu_pages_size / (1024u * 1024u));
+    UVM_SEQ_OR_DBG_PRINT(s, "pmm_evict_watermark                    %u\n",
+                         gpu->pmm.background_eviction.watermark);
+    UVM_SEQ_OR_DBG_PRINT(s, "pmm_background_evictions               %llu\n",
+                         (NvU64)atomic64_read(&gpu->pmm.background_eviction.num_evicted));
+    UVM_SEQ_OR_DBG_PRINT(s, "pmm_sync_evictions                     %llu\n",
+                         (NvU64)atomic64_read(&gpu->pmm.background_eviction.num_sync_evictions));
+    UVM_SEQ_OR_DBG_PRINT(s, "tlb_batch_targeted                     %llu\n",
+                         (NvU64)atomic64_read(&gpu->parent->stats.tlb_batch.num_targeted));
+    UVM_SEQ_OR_DBG_PRINT(s, "tlb_batch_invalidate_all               %llu\n",
+                         (NvU64)atomic64_read(&gpu->parent->stats.tlb_batch.num_invalidate_all));
+    UVM_SEQ_OR_DBG_PRINT(s, "tlb_batch_merged_ranges                %llu\n",
+                         (NvU64)atomic64_read(&gpu->parent->stats.tlb_batch.num_merged_ranges));
+    UVM_SEQ_OR_DBG_PRINT(s, "tracker_wait_latency                   %llu us\n",
+                         (NvU64)atomic64_read(&gpu->parent->tracker_wait.latency_ns) / 1000);
+    UVM_SEQ_OR_DBG_PRINT(s, "tracker_wait_sleeps                    %llu\n",
+                         (NvU64)atomic64_read(&gpu->parent->tracker_wait.num_sleeps));
+    UVM_SEQ_OR_DBG_PRINT(s, "tracker_wait_cpu_time_saved            %llu us\n",
+                         (NvU64)atomic64_read(&gpu->parent->tracker_wait.sleep_ns) / 1000);
 
     gpu_info_print_ce_caps(gpu, s);
 
@@ -706,18 +724,19 @@ gpu_fault_stats_print_common(uvm_parent_gpu_t *parent_gpu, struct seq_file *s)
 
     UVM_ASSERT(uvm_procfs_is_debug_enabled());
 
-    UVM_SEQ_OR_DBG_PRINT(s, "replayable_faults      %llu\n", parent_gpu->stats.num_replayable_faults);
+    UVM_SEQ_OR_DBG_PRINT(s, "replayable_faults      %llu\n",
+                         (NvU64)atomic64_read(&parent_gpu->stats.num_replayable_faults));
     UVM_SEQ_OR_DBG_PRINT(s, "duplicates             %llu\n",
-                         parent_gpu->fault_buffer.replayable.stats.num_duplicate_faults);
+                         (NvU64)atomic64_read(&parent_gpu->fault_buffer.replayable.stats.num_duplicate_faults));
     UVM_SEQ_OR_DBG_PRINT(s, "faults_by_access_type:\n");
     UVM_SEQ_OR_DBG_PRINT(s, "  prefetch             %llu\n",
-                         parent_gpu->fault_buffer.replayable.stats.num_prefetch_faults);
+                         (NvU64)atomic64_read(&parent_gpu->fault_buffer.replayable.stats.num_prefetch_faults));
     UVM_SEQ_OR_DBG_PRINT(s, "  read                 %llu\n",
-                         parent_gpu->fault_buffer.replayable.stats.num_read_faults);
+                         (NvU64)atomic64_read(&parent_gpu->fault_buffer.replayable.stats.num_read_faults));
     UVM_SEQ_OR_DBG_PRINT(s, "  write                %llu\n",
-                         parent_gpu->fault_buffer.replayable.stats.num_write_faults);
+                         (NvU64)atomic64_read(&parent_gpu->fault_buffer.replayable.stats.num_write_faults));
     UVM_SEQ_OR_DBG_PRINT(s, "  atomic               %llu\n",
-                         parent_gpu->fault_buffer.replayable.stats.num_atomic_faults);
+                         (NvU64)atomic64_read(&parent_gpu->fault_buffer.replayable.stats.num_atomic_faults));
     num_pages_out = atomic64_read(&parent_gpu->fault_buffer.replayable.stats.num_pages_out);
     num_pages_in = atomic64_read(&parent_gpu->fault_buffer.replayable.stats.num_pages_in);
     UVM_SEQ_OR_DBG_PRINT(s, "migrations:\n");
@@ -730,6 +749,8 @@ gpu_fault_stats_print_common(uvm_parent_gpu_t *parent_gpu, struct seq_file *s)
                          parent_gpu->fault_buffer.replayable.stats.num_replays);
     UVM_SEQ_OR_DBG_PRINT(s, "  start_ack_all        %llu\n",
                          parent_gpu->fault_buffer.replayable.stats.num_replays_ack_all);
+    UVM_SEQ_OR_DBG_PRINT(s, "sharded_batches        %llu\n",
+                         parent_gpu->fault_buffer.replayable.stats.num_sharded_batches);
     UVM_SEQ_OR_DBG_PRINT(s, "non_replayable_faults  %llu\n", parent_gpu->stats.num_non_replayable_faults);
     UVM_SEQ_OR_DBG_PRINT(s, "faults_by_access_type:\n");
     UVM_SEQ_OR_DBG_PRINT(s, "  read                 %llu\n",
@@ -1864,25 +1885,25 @@ static void update_stats_parent_gpu_fault_instance(uvm_parent_gpu_t *parent_gpu,
     switch (fault_entry->fault_access_type)
     {
         case UVM_FAULT_ACCESS_TYPE_PREFETCH:
-            ++parent_gpu->fault_buffer.replayable.stats.num_prefetch_faults;
+            atomic64_inc(&parent_gpu->fault_buffer.replayable.stats.num_prefetch_faults);
             break;
         case UVM_FAULT_ACCESS_TYPE_READ:
-            ++parent_gpu->fault_buffer.replayable.stats.num_read_faults;
+            atomic64_inc(&parent_gpu->fault_buffer.replayable.stats.num_read_faults);
             break;
         case UVM_FAULT_ACCESS_TYPE_WRITE:
-            ++parent_gpu->fault_buffer.replayable.stats.num_write_faults;
+            atomic64_inc(&parent_gpu->fault_buffer.replayable.stats.num_write_faults);
             break;
         case UVM_FAULT_ACCESS_TYPE_ATOMIC_WEAK:
         case UVM_FAULT_ACCESS_TYPE_ATOMIC_STRONG:
-            ++parent_gpu->fault_buffer.replayable.stats.num_atomic_faults;
+            atomic64_inc(&parent_gpu->fault_buffer.replayable.stats.num_atomic_faults);
             break;
         default:
             break;
     }
     if (is_duplicate || fault_entry->filtered)
-        ++parent_gpu->fault_buffer.replayable.stats.num_duplicate_faults;
+        atomic64_inc(&parent_gpu->fault_buffer.replayable.stats.num_duplicate_faults);
 
-    ++parent_gpu->stats.num_replayable_faults;
+    atomic64_inc(&parent_gpu->stats.num_replayable_faults);
 }
 
 static void update_stats_fault_cb(uvm_va_space_t *va_space,
@@ -2742,6 +2763,10 @@ static void remove_gpu(uvm_gpu_t *gpu)
     else
         uvm_parent_gpu_flush_bottom_halves(parent_gpu);
 
+    // The GPU is no longer in retained_gpus, so the CPU chunk pool refill won't
+    // create new mappings on it.
+    uvm_cpu_chunk_pool_unmap_gpu(gpu);
+
     deinit_gpu(gpu);
 
     UVM_ASSERT(parent_gpu->gpus[sub_processor_index] == gpu);
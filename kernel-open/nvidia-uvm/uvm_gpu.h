@@ -246,6 +246,10 @@ typedef struct
     // Client type of the service requestor.
     uvm_fault_client_type_t client_type;
 
+    // State used to batch the GPU TLB invalidations of stale ATS PTEs found
+    // while servicing faults with this context.
+    uvm_ats_fault_invalidate_t *ats_invalidate;
+
     // New residency ID of the faulting region.
     uvm_processor_id_t residency_id;
 
@@ -286,6 +290,49 @@ typedef struct
     } prefetch_state;
 } uvm_ats_fault_context_t;
 
+// Maximum number of distinct instance pointers or {VA space, GPU} pairs in a
+// fault batch that can be ordered with radix bucketing. Batches with more fall
+// back to a comparison sort.
+#define UVM_FAULT_SORT_MAX_GROUPS 64
+
+#define UVM_FAULT_SORT_RADIX_BITS 8
+
+typedef struct
+{
+    // Sort key computed from the VA space, GPU, fault address and access type
+    // of fault_entry
+    NvU64 key;
+
+    uvm_fault_buffer_entry_t *fault_entry;
+} uvm_fault_sort_item_t;
+
+// Scratch state used to order a fault batch in linear time
+typedef struct
+{
+    // Ping-pong buffers used by the radix passes. Each of them has max_items
+    // elements.
+    uvm_fault_sort_item_t *items[2];
+
+    NvU32 max_items;
+
+    NvU32 counts[1 << UVM_FAULT_SORT_RADIX_BITS];
+
+    // First fault entry of each distinct {instance_ptr, ve_id} pair found in
+    // the batch
+    uvm_fault_buffer_entry_t *instance_ptr_groups[UVM_FAULT_SORT_MAX_GROUPS];
+
+    // Distinct {VA space, GPU} pairs found in the batch and their rank in
+    // service order
+    struct
+    {
+        uvm_va_space_t *va_space;
+
+        uvm_gpu_t *gpu;
+
+        NvU32 rank;
+    } groups[UVM_FAULT_SORT_MAX_GROUPS];
+} uvm_fault_sort_context_t;
+
 struct uvm_fault_service_batch_context_struct
 {
     // Array of elements fetched from the GPU fault buffer. The number of
@@ -297,6 +344,9 @@ struct uvm_fault_service_batch_context_struct
     // max_batch_size
     uvm_fault_buffer_entry_t **ordered_fault_cache;
 
+    // Scratch state used to generate ordered_fault_cache
+    uvm_fault_sort_context_t *sort_context;
+
     // Per uTLB fault information. Used for replay policies and fault
     // cancellation on Pascal
     uvm_fault_utlb_info_t *utlbs;
@@ -339,6 +389,11 @@ struct uvm_fault_service_batch_context_struct
 
     // Last fetched fault. Used for fault filtering.
     uvm_fault_buffer_entry_t *last_fault;
+
+    // Structure used to coalesce fault servicing in a VA block. It points to
+    // the GPU's block_service_context, except for the shards of a batch
+    // serviced by fault service workers, which use their own.
+    uvm_service_block_context_t *block_service_context;
 };
 
 struct uvm_ats_fault_invalidate_struct
@@ -347,6 +402,37 @@ struct uvm_ats_fault_invalidate_struct
     uvm_tlb_batch_t tlb_batch;
 };
 
+// State of a worker servicing one shard of a replayable fault batch. See
+// uvm_perf_fault_service_workers in uvm_gpu_replayable_faults.c.
+typedef struct
+{
+    uvm_parent_gpu_t *parent_gpu;
+
+    // Batch context describing the shard. ordered_fault_cache points into the
+    // ordered_fault_cache array of the GPU's batch_service_context, and
+    // fault_cache and utlbs are shared with it. The rest of the fields are
+    // private to the worker.
+    uvm_fault_service_batch_context_t batch_context;
+
+    // Structure used to coalesce fault servicing in a VA block
+    uvm_service_block_context_t block_service_context;
+
+    // Information required to invalidate stale ATS PTEs from the GPU TLBs
+    uvm_ats_fault_invalidate_t ats_invalidate;
+
+    // Queue on which the shard is serviced. The shard of the first worker is
+    // serviced by the bottom half itself, so its queue is not initialized.
+    nv_kthread_q_t q;
+
+    nv_kthread_q_item_t q_item;
+
+    // Signaled by the worker when it is done servicing its shard
+    struct completion done;
+
+    // Status returned by the servicing of the shard
+    NV_STATUS status;
+} uvm_fault_service_worker_t;
+
 typedef struct
 {
     // Fault buffer information and structures provided by RM
@@ -384,19 +470,20 @@ typedef struct
 
         // Fault statistics. These fields are per-GPU and most of them are only
         // updated during fault servicing, and can be safely incremented.
-        // Migrations may be triggered by different GPUs and need to be
-        // incremented using atomics
+        // Migrations may be triggered by different GPUs, and per-fault
+        // counters may be updated by several fault service workers, so they
+        // need to be incremented using atomics.
         struct
         {
-            NvU64 num_prefetch_faults;
+            atomic64_t num_prefetch_faults;
 
-            NvU64 num_read_faults;
+            atomic64_t num_read_faults;
 
-            NvU64 num_write_faults;
+            atomic64_t num_write_faults;
 
-            NvU64 num_atomic_faults;
+            atomic64_t num_atomic_faults;
 
-            NvU64 num_duplicate_faults;
+            atomic64_t num_duplicate_faults;
 
             atomic64_t num_pages_out;
 
@@ -405,6 +492,8 @@ typedef struct
             NvU64 num_replays;
 
             NvU64 num_replays_ack_all;
+
+            NvU64 num_sharded_batches;
         } stats;
 
         // Number of uTLBs in the chip
@@ -418,6 +507,32 @@ typedef struct
 
         // Information required to invalidate stale ATS PTEs from the GPU TLBs
         uvm_ats_fault_invalidate_t ats_invalidate;
+
+        // Workers used to service the shards of a fault batch in parallel.
+        // Only allocated if more than one worker is configured.
+        struct
+        {
+            uvm_fault_service_worker_t *workers;
+
+            NvU32 num_workers;
+        } service_workers;
+
+        // Trace of the fetched fault batches, captured for offline analysis.
+        // See UVM_TEST_FAULT_TRACE_CAPTURE. records is a ring buffer, only
+        // allocated while a capture is in progress. Protected by the
+        // replayable faults ISR lock.
+        struct
+        {
+            UVM_TEST_FAULT_TRACE_RECORD *records;
+
+            NvU32 max_records;
+
+            NvU32 first_record;
+
+            NvU32 num_records;
+
+            NvU64 num_dropped;
+        } trace;
     } replayable;
 
     struct uvm_non_replayable_fault_buffer_struct
@@ -437,6 +552,11 @@ typedef struct
         // elements in this array is exactly max_batch_size
         uvm_fault_buffer_entry_t *fault_cache;
 
+        // Array of pointers to elements in fault_cache, sorted by channel and
+        // fault address so faults on the same channel and VA block can be
+        // serviced together. Same size as fault_cache.
+        uvm_fault_buffer_entry_t **ordered_fault_cache;
+
         // Fault statistics. See replayable fault stats for more details.
         struct
         {
@@ -504,6 +624,90 @@ struct uvm_access_counter_service_batch_context_struct
     NvU32 batch_id;
 };
 
+typedef enum
+{
+    UVM_ACCESS_COUNTER_PLAN_CANDIDATE_PENDING = 0,
+    UVM_ACCESS_COUNTER_PLAN_CANDIDATE_SELECTED,
+    UVM_ACCESS_COUNTER_PLAN_CANDIDATE_RETIRED,
+} uvm_access_counter_plan_candidate_state_t;
+
+// VA block region accumulated by the access counter migration planner. See the
+// comments on the planner in uvm_gpu_access_counters.c.
+typedef struct
+{
+    uvm_va_space_t *va_space;
+
+    // GPU whose notifications were recorded and which the pages would be
+    // migrated to
+    uvm_gpu_t *gpu;
+
+    // Start address of the VA block in which the notifications were recorded.
+    // The candidate is dropped if there is no VA block starting at this
+    // address anymore when the migration is issued.
+    NvU64 block_start;
+
+    // Pages accessed by gpu and not resident on it, relative to block_start
+    uvm_page_mask_t pages;
+
+    // Hotness score: number of notifications recorded for the region, halved
+    // at the end of every planning interval without new notifications.
+    NvU32 score;
+
+    // Planning interval in which the last notification was recorded
+    NvU64 interval;
+
+    // Scratch fields used while selecting the regions to migrate
+    NvU64 benefit;
+    uvm_access_counter_plan_candidate_state_t state;
+} uvm_access_counter_plan_candidate_t;
+
+typedef struct
+{
+    // Table of candidate regions, allocated only if the planner is enabled
+    uvm_access_counter_plan_candidate_t *candidates;
+    NvU32 num_candidates;
+    NvU32 max_candidates;
+
+    // Scratch array of candidate pointers used to rank the candidates
+    uvm_access_counter_plan_candidate_t **order;
+
+    // Number of planning intervals elapsed
+    NvU64 interval;
+
+    // Time at which the next plan is due, in NV_GETTIME() units
+    NvU64 next_plan_time;
+
+    struct
+    {
+        // Planning intervals with at least one candidate
+        atomic64_t num_plans;
+
+        // Groups of notifications recorded in the candidate table
+        atomic64_t num_recorded;
+
+        // Candidates replaced because the table was full
+        atomic64_t num_evicted;
+
+        // Candidates dropped because their score decayed to zero
+        atomic64_t num_expired;
+
+        // Candidates not migrated because another GPU accesses the same
+        // region with a comparable score
+        atomic64_t num_contested;
+
+        // Candidates dropped because another GPU's candidate for the same
+        // region was a clear winner
+        atomic64_t num_outvoted;
+
+        // Candidates postponed to a later interval by the bandwidth budget
+        atomic64_t num_deferred;
+
+        // Candidates migrated, and the total size of the pages requested
+        atomic64_t num_migrated;
+        atomic64_t bytes_migrated;
+    } stats;
+} uvm_access_counter_planner_t;
+
 struct uvm_access_counter_buffer_struct
 {
     uvm_parent_gpu_t *parent_gpu;
@@ -565,6 +769,12 @@ struct uvm_access_counter_buffer_struct
     // Context structure used to service a GPU access counter batch
     uvm_access_counter_service_batch_context_t batch_service_context;
 
+    // Migration planner for the notifications in VA blocks, if enabled with
+    // uvm_perf_access_counter_planner.
+    //
+    // Locking: the access counters ISR lock must be held.
+    uvm_access_counter_planner_t planner;
+
     struct
     {
         // VA space that reconfigured the access counters configuration, if any.
@@ -1114,6 +1324,13 @@ struct uvm_parent_gpu_struct
             // back to invalidate all
             NvU32 max_ranges;
         };
+
+        // VA range invalidates apply to the naturally aligned power-of-two
+        // block covering the range. Ranges are only merged if the block of the
+        // result is at most this big, or no bigger than the block of one of
+        // the merged ranges, which bounds how much unrelated VA gets
+        // invalidated. Only used if va_range_invalidate_supported is set.
+        NvU64 max_merged_range_size;
     } tlb_batch;
 
     // Largest VA (exclusive) which can be used for channel buffer mappings
@@ -1274,18 +1491,45 @@ struct uvm_parent_gpu_struct
     } smc;
 
     // Global statistics. These fields are per-GPU and most of them are only
-    // updated during fault servicing, and can be safely incremented.
+    // updated during fault servicing, and can be safely incremented. Replayable
+    // faults may be serviced by several fault service workers, so their
+    // counter is atomic.
     struct
     {
-        NvU64          num_replayable_faults;
+        atomic64_t     num_replayable_faults;
 
         NvU64      num_non_replayable_faults;
 
         atomic64_t             num_pages_out;
 
         atomic64_t              num_pages_in;
+
+        // TLB batches, see uvm_tlb_batch_end()
+        struct
+        {
+            // Batches flushed with targeted invalidates
+            atomic64_t num_targeted;
+
+            // Batches flushed with an invalidate of the whole PDB
+            atomic64_t num_invalidate_all;
+
+            // Ranges merged into other ranges
+            atomic64_t num_merged_ranges;
+        } tlb_batch;
     } stats;
 
+    // Adaptive tracker waits, see tracker_waiter_t in uvm_tracker.c
+    struct
+    {
+        // Moving average of the duration of tracker waits on the GPU
+        atomic64_t latency_ns;
+
+        // Number of sleeps and total time slept by tracker waits instead of
+        // spinning, which is the CPU time saved
+        atomic64_t num_sleeps;
+        atomic64_t sleep_ns;
+    } tracker_wait;
+
     // Structure to hold nvswitch specific information. In an nvswitch
     // environment, rather than using the peer-id field of the PTE (which can
     // only address 8 gpus), all gpus are assigned a 47-bit physical address
@@ -35,6 +35,7 @@
 #include "uvm_perf_module.h"
 #include "uvm_ats.h"
 #include "uvm_ats_faults.h"
+#include "uvm_test.h"
 
 #define UVM_PERF_ACCESS_COUNTER_BATCH_COUNT_MIN     1
 #define UVM_PERF_ACCESS_COUNTER_BATCH_COUNT_DEFAULT 256
@@ -43,6 +44,11 @@
 #define UVM_PERF_ACCESS_COUNTER_THRESHOLD_MAX       ((1 << 16) - 1)
 #define UVM_PERF_ACCESS_COUNTER_THRESHOLD_DEFAULT   256
 
+#define UVM_PERF_ACCESS_COUNTER_PLANNER_CANDIDATES          512
+#define UVM_PERF_ACCESS_COUNTER_PLANNER_INTERVAL_MS_DEFAULT  10
+#define UVM_PERF_ACCESS_COUNTER_PLANNER_BUDGET_MB_DEFAULT    64
+#define UVM_PERF_ACCESS_COUNTER_PLANNER_MIN_SCORE_DEFAULT    2
+
 #define UVM_ACCESS_COUNTER_ACTION_BATCH_CLEAR       0x1
 #define UVM_ACCESS_COUNTER_ACTION_TARGETED_CLEAR    0x2
 
@@ -86,6 +92,30 @@ MODULE_PARM_DESC(uvm_perf_access_counter_threshold,
                  "Number of remote accesses on a region required to trigger a notification."
                  "Valid values: [1, 65535]");
 
+// Access counter migration planner tunables. See the comments on the planner
+// below.
+static unsigned uvm_perf_access_counter_planner = 0;
+static unsigned uvm_perf_access_counter_planner_interval_ms = UVM_PERF_ACCESS_COUNTER_PLANNER_INTERVAL_MS_DEFAULT;
+static unsigned uvm_perf_access_counter_planner_budget_mb = UVM_PERF_ACCESS_COUNTER_PLANNER_BUDGET_MB_DEFAULT;
+static unsigned uvm_perf_access_counter_planner_min_score = UVM_PERF_ACCESS_COUNTER_PLANNER_MIN_SCORE_DEFAULT;
+
+module_param(uvm_perf_access_counter_planner, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_perf_access_counter_planner,
+                 "Accumulate access counter notifications in VA blocks across batches and migrate the hottest "
+                 "regions once per planning interval, instead of migrating on every notification. "
+                 "Valid values: 0 (off, default), 1 (on)");
+module_param(uvm_perf_access_counter_planner_interval_ms, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_perf_access_counter_planner_interval_ms,
+                 "Planning interval of the access counter migration planner, in milliseconds.");
+module_param(uvm_perf_access_counter_planner_budget_mb, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_perf_access_counter_planner_budget_mb,
+                 "Maximum amount of memory the access counter migration planner migrates to each GPU per "
+                 "planning interval, in megabytes.");
+module_param(uvm_perf_access_counter_planner_min_score, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_perf_access_counter_planner_min_score,
+                 "Number of notifications a region needs to accumulate before the access counter migration "
+                 "planner migrates it.");
+
 static void access_counter_buffer_flush_locked(uvm_access_counter_buffer_t *access_counters,
                                                uvm_gpu_buffer_flush_mode_t flush_mode);
 
@@ -217,6 +247,360 @@ static NV_STATUS config_granularity_to_bytes(UVM_ACCESS_COUNTER_GRANULARITY gran
     return NV_OK;
 }
 
+// Access counter migration planner
+//
+// By default, every batch of notifications in a VA block migrates the notified
+// pages right away. A region that crosses the notification threshold once, for
+// example a small buffer read a few times, costs a migration just as much as a
+// region the GPU keeps hammering. Two GPUs alternately crossing the threshold
+// on the same sysmem region would also bounce it between them.
+//
+// When uvm_perf_access_counter_planner is set, notifications in VA blocks are
+// recorded as candidates instead, keyed by VA space, GPU and VA block. Their
+// notifications are cleared so the GPU keeps counting and notifies again while
+// the region stays hot. Each notification adds one to the candidate's score, so
+// the score accumulates across batches and across all the VA spaces served by
+// the notification buffer. Once per planning interval, the planner:
+// - Halves the score of the candidates without new notifications, and drops
+//   the ones that reach zero.
+// - Looks at candidates for the same region from different GPUs. If the top
+//   score is not at least twice the next one, the region is contested and none
+//   of them is migrated, leaving the pages where all GPUs can reach them.
+//   Otherwise the losing candidates are dropped.
+// - Ranks the remaining candidates with at least min_score notifications by
+//   score per migrated page.
+// - Picks candidates in rank order until each GPU's budget of bytes for the
+//   interval is used up. The first candidate of a GPU is always picked so that
+//   regions larger than the budget still make progress.
+// - Migrates the picked candidates sorted by VA space, GPU and address, so the
+//   VA space locks are taken once per VA space.
+//
+// Candidates left over by the budget keep their score for the next interval.
+// The planner only handles notifications serviced through VA blocks: ATS
+// notifications are still serviced right away.
+
+static NV_STATUS planner_init(uvm_access_counter_planner_t *planner, NvU32 max_candidates)
+{
+    memset(planner, 0, sizeof(*planner));
+
+    planner->candidates = uvm_kvmalloc_zero(max_candidates * sizeof(*planner->candidates));
+    planner->order = uvm_kvmalloc_zero(max_candidates * sizeof(*planner->order));
+    if (!planner->candidates || !planner->order) {
+        uvm_kvfree(planner->candidates);
+        uvm_kvfree(planner->order);
+        planner->candidates = NULL;
+        planner->order = NULL;
+        return NV_ERR_NO_MEMORY;
+    }
+
+    planner->max_candidates = max_candidates;
+
+    return NV_OK;
+}
+
+static void planner_deinit(uvm_access_counter_planner_t *planner)
+{
+    uvm_kvfree(planner->candidates);
+    uvm_kvfree(planner->order);
+    planner->candidates = NULL;
+    planner->order = NULL;
+    planner->num_candidates = 0;
+}
+
+static bool planner_is_enabled(const uvm_access_counter_planner_t *planner)
+{
+    return planner->candidates != NULL;
+}
+
+// Add score notifications on the given pages of the VA block starting at
+// block_start to the matching candidate, creating it if needed. If the table is
+// full, the candidate with the lowest score is replaced, unless it scores
+// higher than the new one.
+static void planner_record(uvm_access_counter_planner_t *planner,
+                           uvm_va_space_t *va_space,
+                           uvm_gpu_t *gpu,
+                           NvU64 block_start,
+                           const uvm_page_mask_t *pages,
+                           NvU32 score)
+{
+    uvm_access_counter_plan_candidate_t *candidate = NULL;
+    uvm_access_counter_plan_candidate_t *coldest = NULL;
+    NvU32 i;
+
+    UVM_ASSERT(!uvm_page_mask_empty(pages));
+
+    for (i = 0; i < planner->num_candidates; i++) {
+        uvm_access_counter_plan_candidate_t *current = &planner->candidates[i];
+
+        if (current->va_space == va_space && current->gpu == gpu && current->block_start == block_start) {
+            candidate = current;
+            break;
+        }
+
+        if (!coldest || current->score < coldest->score)
+            coldest = current;
+    }
+
+    if (candidate) {
+        uvm_page_mask_or(&candidate->pages, &candidate->pages, pages);
+        candidate->score = min(candidate->score + score, (NvU32)U32_MAX / 2);
+    }
+    else {
+        if (planner->num_candidates < planner->max_candidates) {
+            candidate = &planner->candidates[planner->num_candidates++];
+        }
+        else {
+            UVM_ASSERT(coldest);
+            if (coldest->score > score)
+                return;
+
+            candidate = coldest;
+            atomic64_inc(&planner->stats.num_evicted);
+        }
+
+        candidate->va_space = va_space;
+        candidate->gpu = gpu;
+        candidate->block_start = block_start;
+        uvm_page_mask_copy(&candidate->pages, pages);
+        candidate->score = score;
+    }
+
+    candidate->interval = planner->interval;
+    candidate->state = UVM_ACCESS_COUNTER_PLAN_CANDIDATE_PENDING;
+    atomic64_inc(&planner->stats.num_recorded);
+}
+
+// Record notifications in the planner like planner_record(), unless access
+// counters have been disabled for the VA space and GPU. The counters can stay
+// active for other VA spaces, so notifications can still be translated to the
+// VA space. But uvm_gpu_access_counters_disable() clears the VA space's
+// access_counters_enabled_processors bit before it purges the planner under the
+// ISR lock, so recording after that would leave candidates pointing at a VA
+// space which may be freed. Returns whether the notifications were recorded.
+//
+// The ISR lock of the notification buffer must be held.
+static bool planner_record_notifications(uvm_access_counter_planner_t *planner,
+                                         uvm_va_space_t *va_space,
+                                         uvm_gpu_t *gpu,
+                                         NvU64 block_start,
+                                         const uvm_page_mask_t *pages,
+                                         NvU32 score)
+{
+    if (!uvm_parent_processor_mask_test(&va_space->access_counters_enabled_processors, gpu->parent->id))
+        return false;
+
+    planner_record(planner, va_space, gpu, block_start, pages, score);
+
+    return true;
+}
+
+// Sort by VA space and block start, and by decreasing score within a region
+static int cmp_sort_plan_candidates_by_region(const void *_a, const void *_b)
+{
+    const uvm_access_counter_plan_candidate_t *a = *(const uvm_access_counter_plan_candidate_t **)_a;
+    const uvm_access_counter_plan_candidate_t *b = *(const uvm_access_counter_plan_candidate_t **)_b;
+    int result;
+
+    result = UVM_CMP_DEFAULT(a->va_space, b->va_space);
+    if (result != 0)
+        return result;
+
+    result = UVM_CMP_DEFAULT(a->block_start, b->block_start);
+    if (result != 0)
+        return result;
+
+    return UVM_CMP_DEFAULT(b->score, a->score);
+}
+
+// Sort by decreasing benefit, then by decreasing score
+static int cmp_sort_plan_candidates_by_benefit(const void *_a, const void *_b)
+{
+    const uvm_access_counter_plan_candidate_t *a = *(const uvm_access_counter_plan_candidate_t **)_a;
+    const uvm_access_counter_plan_candidate_t *b = *(const uvm_access_counter_plan_candidate_t **)_b;
+    int result;
+
+    result = UVM_CMP_DEFAULT(b->benefit, a->benefit);
+    if (result != 0)
+        return result;
+
+    result = UVM_CMP_DEFAULT(b->score, a->score);
+    if (result != 0)
+        return result;
+
+    return cmp_sort_plan_candidates_by_region(_a, _b);
+}
+
+// Sort by VA space, GPU and block start, which is the order in which the
+// migrations are issued
+static int cmp_sort_plan_candidates_by_va_space_gpu_address(const void *_a, const void *_b)
+{
+    const uvm_access_counter_plan_candidate_t *a = *(const uvm_access_counter_plan_candidate_t **)_a;
+    const uvm_access_counter_plan_candidate_t *b = *(const uvm_access_counter_plan_candidate_t **)_b;
+    int result;
+
+    result = UVM_CMP_DEFAULT(a->va_space, b->va_space);
+    if (result != 0)
+        return result;
+
+    result = UVM_CMP_DEFAULT(a->gpu, b->gpu);
+    if (result != 0)
+        return result;
+
+    return UVM_CMP_DEFAULT(a->block_start, b->block_start);
+}
+
+// Close the current planning interval and select the candidates to migrate.
+// The selected candidates are returned sorted by VA space, GPU and address in
+// planner->order, and their count is returned. Candidates dropped by the
+// selection are marked as retired. The caller must retire the selected
+// candidates and call planner_retire() before recording new notifications.
+static NvU32 planner_select(uvm_access_counter_planner_t *planner, NvU64 budget_bytes, NvU32 min_score)
+{
+    struct
+    {
+        uvm_gpu_t *gpu;
+        NvU64 bytes;
+    } budget[UVM_PARENT_ID_MAX_SUB_PROCESSORS] = {};
+    NvU32 num_order = 0;
+    NvU32 num_eligible = 0;
+    NvU32 num_selected = 0;
+    NvU32 i;
+
+    // Decay the candidates without notifications in the interval
+    for (i = 0; i < planner->num_candidates; i++) {
+        uvm_access_counter_plan_candidate_t *candidate = &planner->candidates[i];
+
+        UVM_ASSERT(candidate->state == UVM_ACCESS_COUNTER_PLAN_CANDIDATE_PENDING);
+
+        if (candidate->interval != planner->interval)
+            candidate->score /= 2;
+
+        if (candidate->score == 0) {
+            candidate->state = UVM_ACCESS_COUNTER_PLAN_CANDIDATE_RETIRED;
+            atomic64_inc(&planner->stats.num_expired);
+            continue;
+        }
+
+        planner->order[num_order++] = candidate;
+    }
+
+    ++planner->interval;
+
+    if (num_order == 0)
+        return 0;
+
+    atomic64_inc(&planner->stats.num_plans);
+
+    // Resolve candidates for the same region from different GPUs. The winner
+    // is first in each region.
+    sort(planner->order, num_order, sizeof(*planner->order), cmp_sort_plan_candidates_by_region, NULL);
+
+    for (i = 0; i < num_order;) {
+        uvm_access_counter_plan_candidate_t *winner = planner->order[i];
+        NvU32 region_end = i + 1;
+        NvU32 j;
+
+        while (region_end < num_order &&
+               planner->order[region_end]->va_space == winner->va_space &&
+               planner->order[region_end]->block_start == winner->block_start)
+            region_end++;
+
+        if (region_end - i > 1 && planner->order[i + 1]->score * 2 > winner->score) {
+            atomic64_add(region_end - i, &planner->stats.num_contested);
+        }
+        else if (winner->score >= min_score) {
+            for (j = i + 1; j < region_end; j++) {
+                planner->order[j]->state = UVM_ACCESS_COUNTER_PLAN_CANDIDATE_RETIRED;
+                atomic64_inc(&planner->stats.num_outvoted);
+            }
+
+            // Fixed point score per page. num_pages is at most
+            // PAGES_PER_UVM_VA_BLOCK, which keeps the fraction meaningful.
+            winner->benefit = ((NvU64)winner->score << 32) / uvm_page_mask_weight(&winner->pages);
+            planner->order[num_eligible++] = winner;
+        }
+
+        i = region_end;
+    }
+
+    sort(planner->order, num_eligible, sizeof(*planner->order), cmp_sort_plan_candidates_by_benefit, NULL);
+
+    // Apply the per-GPU budget in benefit order. The selected candidates are
+    // compacted at the front of the array.
+    for (i = 0; i < num_eligible; i++) {
+        uvm_access_counter_plan_candidate_t *candidate = planner->order[i];
+        NvU64 bytes = (NvU64)uvm_page_mask_weight(&candidate->pages) * PAGE_SIZE;
+        NvU32 slot;
+
+        for (slot = 0; slot < ARRAY_SIZE(budget); slot++) {
+            if (!budget[slot].gpu || budget[slot].gpu == candidate->gpu)
+                break;
+        }
+
+        // All the GPUs served by a notification buffer share a parent GPU
+        UVM_ASSERT(slot < ARRAY_SIZE(budget));
+
+        if (budget[slot].gpu && budget[slot].bytes + bytes > budget_bytes) {
+            atomic64_inc(&planner->stats.num_deferred);
+            continue;
+        }
+
+        budget[slot].gpu = candidate->gpu;
+        budget[slot].bytes += bytes;
+
+        candidate->state = UVM_ACCESS_COUNTER_PLAN_CANDIDATE_SELECTED;
+        planner->order[num_selected++] = candidate;
+    }
+
+    sort(planner->order,
+         num_selected,
+         sizeof(*planner->order),
+         cmp_sort_plan_candidates_by_va_space_gpu_address,
+         NULL);
+
+    return num_selected;
+}
+
+// Remove the retired candidates from the table
+static void planner_retire(uvm_access_counter_planner_t *planner)
+{
+    NvU32 i;
+    NvU32 num_candidates = 0;
+
+    for (i = 0; i < planner->num_candidates; i++) {
+        uvm_access_counter_plan_candidate_t *candidate = &planner->candidates[i];
+
+        UVM_ASSERT(candidate->state != UVM_ACCESS_COUNTER_PLAN_CANDIDATE_SELECTED);
+
+        if (candidate->state == UVM_ACCESS_COUNTER_PLAN_CANDIDATE_RETIRED)
+            continue;
+
+        if (num_candidates != i)
+            planner->candidates[num_candidates] = *candidate;
+
+        num_candidates++;
+    }
+
+    planner->num_candidates = num_candidates;
+}
+
+// Drop the candidates of the given VA space and GPU. Called when access
+// counters are disabled for them, after which the pointers in the candidates
+// are no longer valid.
+static void planner_purge(uvm_access_counter_planner_t *planner, uvm_va_space_t *va_space, uvm_gpu_t *gpu)
+{
+    NvU32 i;
+
+    for (i = 0; i < planner->num_candidates; i++) {
+        uvm_access_counter_plan_candidate_t *candidate = &planner->candidates[i];
+
+        if (candidate->va_space == va_space && candidate->gpu == gpu)
+            candidate->state = UVM_ACCESS_COUNTER_PLAN_CANDIDATE_RETIRED;
+    }
+
+    planner_retire(planner);
+}
+
 static NV_STATUS parent_gpu_clear_tracker_wait(uvm_parent_gpu_t *parent_gpu)
 {
     NV_STATUS status;
@@ -437,6 +821,12 @@ NV_STATUS uvm_parent_gpu_init_access_counters(uvm_parent_gpu_t *parent_gpu, NvU3
         goto fail;
     }
 
+    if (uvm_perf_access_counter_planner) {
+        status = planner_init(&access_counters->planner, UVM_PERF_ACCESS_COUNTER_PLANNER_CANDIDATES);
+        if (status != NV_OK)
+            goto fail;
+    }
+
     return NV_OK;
 
 fail:
@@ -470,6 +860,7 @@ void uvm_parent_gpu_deinit_access_counters(uvm_parent_gpu_t *parent_gpu, NvU32 n
         uvm_kvfree(batch_context->notifications);
         batch_context->notification_cache = NULL;
         batch_context->notifications = NULL;
+        planner_deinit(&access_counters->planner);
     }
 }
 
@@ -661,6 +1052,9 @@ static void access_counters_disable_notif_buffer(uvm_access_counter_buffer_t *ac
 
     access_counters_disable(access_counters);
 
+    if (planner_is_enabled(&access_counters->planner))
+        planner_purge(&access_counters->planner, va_space, gpu);
+
     // If this VA space reconfigured access counters, clear the ownership to
     // allow for other processes to invoke the reconfiguration.
     if (access_counters->test.reconfiguration_owner == va_space) {
@@ -1364,6 +1758,7 @@ static NV_STATUS service_notifications_in_block(uvm_gpu_va_space_t *gpu_va_space
     NvU32 flags = 0;
     NV_STATUS status = NV_OK;
     NV_STATUS flags_status;
+    uvm_gpu_id_t resident_id;
     uvm_gpu_t *gpu = gpu_va_space->gpu;
     uvm_va_space_t *va_space = gpu_va_space->va_space;
     uvm_access_counter_service_batch_context_t *batch_context = &access_counters->batch_service_context;
@@ -1404,7 +1799,26 @@ static NV_STATUS service_notifications_in_block(uvm_gpu_va_space_t *gpu_va_space
 
     batch_context->block_service_context.access_counters_buffer_index = access_counters->index;
 
-    status = service_notification_va_block_helper(mm, va_block, gpu->id, batch_context);
+    // The notified pages were accessed where they currently reside. Record the
+    // access before servicing potentially migrates them away.
+    for_each_gpu_id_in_mask(resident_id, &va_block->resident)
+        uvm_va_block_mark_memory_accessed(va_block, resident_id);
+
+    // With the planner, the migration is deferred to the end of the planning
+    // interval. The notifications are still cleared below.
+    if (planner_is_enabled(&access_counters->planner)) {
+        if (!uvm_page_mask_empty(accessed_pages)) {
+            planner_record_notifications(&access_counters->planner,
+                                         va_space,
+                                         gpu,
+                                         va_block->start,
+                                         accessed_pages,
+                                         *out_index - index);
+        }
+    }
+    else {
+        status = service_notification_va_block_helper(mm, va_block, gpu->id, batch_context);
+    }
 
     uvm_mutex_unlock(&va_block->lock);
 
@@ -1716,6 +2130,104 @@ static NV_STATUS service_notifications(uvm_access_counter_buffer_t *access_count
     return status;
 }
 
+static NV_STATUS planner_service_candidate(uvm_access_counter_buffer_t *access_counters,
+                                           uvm_gpu_va_space_t *gpu_va_space,
+                                           struct mm_struct *mm,
+                                           uvm_access_counter_plan_candidate_t *candidate)
+{
+    NV_STATUS status;
+    uvm_va_block_t *va_block;
+    uvm_va_range_managed_t *managed_range;
+    uvm_access_counter_service_batch_context_t *batch_context = &access_counters->batch_service_context;
+    uvm_service_block_context_t *service_context = &batch_context->block_service_context;
+
+    managed_range = uvm_va_range_managed_find(gpu_va_space->va_space, candidate->block_start);
+    if (!managed_range)
+        return NV_OK;
+
+    // The page indices in the candidate are only valid if the VA block still
+    // starts at the same address. The block may have been shortened by a
+    // split, so pages past its end are dropped.
+    va_block = uvm_va_range_block(managed_range, uvm_va_range_block_index(managed_range, candidate->block_start));
+    if (!va_block || va_block->start != candidate->block_start)
+        return NV_OK;
+
+    uvm_page_mask_copy(&batch_context->accessed_pages, &candidate->pages);
+    uvm_page_mask_region_clear_outside(&batch_context->accessed_pages, uvm_va_block_region_from_block(va_block));
+
+    uvm_va_block_context_init(service_context->block_context, mm);
+    service_context->access_counters_buffer_index = access_counters->index;
+
+    uvm_mutex_lock(&va_block->lock);
+    status = service_notification_va_block_helper(mm, va_block, gpu_va_space->gpu->id, batch_context);
+    uvm_mutex_unlock(&va_block->lock);
+
+    return status;
+}
+
+// Migrate the candidates selected by the planner if the planning interval has
+// elapsed. Must be called with no VA space lock held.
+static NV_STATUS planner_run(uvm_access_counter_buffer_t *access_counters)
+{
+    NV_STATUS status = NV_OK;
+    struct mm_struct *mm = NULL;
+    uvm_va_space_t *va_space = NULL;
+    uvm_access_counter_planner_t *planner = &access_counters->planner;
+    NvU64 now = NV_GETTIME();
+    NvU32 num_selected;
+    NvU32 i;
+
+    if (planner->num_candidates == 0 || now < planner->next_plan_time)
+        return NV_OK;
+
+    planner->next_plan_time = now + (NvU64)uvm_perf_access_counter_planner_interval_ms * NSEC_PER_MSEC;
+
+    num_selected = planner_select(planner,
+                                  (NvU64)uvm_perf_access_counter_planner_budget_mb * UVM_SIZE_1MB,
+                                  uvm_perf_access_counter_planner_min_score);
+
+    for (i = 0; i < num_selected; i++) {
+        uvm_access_counter_plan_candidate_t *candidate = planner->order[i];
+        uvm_gpu_va_space_t *gpu_va_space;
+
+        if (candidate->va_space != va_space) {
+            if (va_space) {
+                uvm_va_space_up_read(va_space);
+                uvm_va_space_mm_release_unlock(va_space, mm);
+            }
+
+            va_space = candidate->va_space;
+            mm = uvm_va_space_mm_retain_lock(va_space);
+            uvm_va_space_down_read(va_space);
+        }
+
+        candidate->state = UVM_ACCESS_COUNTER_PLAN_CANDIDATE_RETIRED;
+
+        // Keep retiring the remaining candidates after an error
+        if (status != NV_OK)
+            continue;
+
+        gpu_va_space = uvm_gpu_va_space_get(va_space, candidate->gpu);
+        if (!gpu_va_space || !uvm_va_space_has_access_counter_migrations(va_space))
+            continue;
+
+        status = planner_service_candidate(access_counters, gpu_va_space, mm, candidate);
+        if (status == NV_OK) {
+            atomic64_inc(&planner->stats.num_migrated);
+            atomic64_add((NvU64)uvm_page_mask_weight(&candidate->pages) * PAGE_SIZE, &planner->stats.bytes_migrated);
+        }
+    }
+
+    if (va_space) {
+        uvm_va_space_up_read(va_space);
+        uvm_va_space_mm_release_unlock(va_space, mm);
+    }
+
+    planner_retire(planner);
+
+    return status;
+}
+
 void uvm_service_access_counters(uvm_access_counter_buffer_t *access_counters)
 {
     NV_STATUS status = NV_OK;
@@ -1751,6 +2263,9 @@ void uvm_service_access_counters(uvm_access_counter_buffer_t *access_counters)
         }
     }
 
+    if (status == NV_OK && planner_is_enabled(&access_counters->planner))
+        status = planner_run(access_counters);
+
     if (status != NV_OK) {
         UVM_DBG_PRINT("Error %s servicing access counter notifications on GPU: %s notif buf index: %u\n",
                       nvstatusToString(status),
@@ -2241,8 +2756,258 @@ NV_STATUS uvm_test_query_access_counters(UVM_TEST_QUERY_ACCESS_COUNTERS_PARAMS *
     params->num_notification_buffers = gpu->parent->rm_info.accessCntrBufferCount;
     params->num_notification_entries = buffer_size / gpu->parent->access_counter_buffer_hal->entry_size(gpu->parent);
 
+    for (index = 0; index < gpu->parent->rm_info.accessCntrBufferCount; index++) {
+        uvm_access_counter_planner_t *planner = &gpu->parent->access_counter_buffer[index].planner;
+
+        if (!planner_is_enabled(planner))
+            continue;
+
+        params->planner_enabled = NV_TRUE;
+        params->planner_plans += atomic64_read(&planner->stats.num_plans);
+        params->planner_recorded += atomic64_read(&planner->stats.num_recorded);
+        params->planner_evicted += atomic64_read(&planner->stats.num_evicted);
+        params->planner_expired += atomic64_read(&planner->stats.num_expired);
+        params->planner_contested += atomic64_read(&planner->stats.num_contested);
+        params->planner_outvoted += atomic64_read(&planner->stats.num_outvoted);
+        params->planner_deferred += atomic64_read(&planner->stats.num_deferred);
+        params->planner_migrated += atomic64_read(&planner->stats.num_migrated);
+        params->planner_bytes_migrated += atomic64_read(&planner->stats.bytes_migrated);
+    }
+
 exit_release_gpu:
     uvm_gpu_release(gpu);
 
     return status;
 }
+
+// Select a plan, check that the selected candidates are exactly the expected
+// ones, and retire them as if they were migrated.
+static NV_STATUS test_planner_check_plan(uvm_access_counter_planner_t *planner,
+                                         NvU64 budget_bytes,
+                                         NvU32 min_score,
+                                         const NvU64 *expected_block_starts,
+                                         NvU32 num_expected)
+{
+    NvU32 num_selected = planner_select(planner, budget_bytes, min_score);
+    NvU32 i;
+
+    TEST_CHECK_RET(num_selected == num_expected);
+
+    for (i = 0; i < num_selected; i++) {
+        TEST_CHECK_RET(planner->order[i]->block_start == expected_block_starts[i]);
+        TEST_CHECK_RET(planner->order[i]->state == UVM_ACCESS_COUNTER_PLAN_CANDIDATE_SELECTED);
+        planner->order[i]->state = UVM_ACCESS_COUNTER_PLAN_CANDIDATE_RETIRED;
+    }
+
+    planner_retire(planner);
+
+    return NV_OK;
+}
+
+static NV_STATUS test_planner(uvm_access_counter_planner_t *planner, uvm_page_mask_t *pages)
+{
+    // The planner never dereferences the VA space and GPU pointers
+    uvm_va_space_t *va_space0 = (uvm_va_space_t *)0x1000;
+    uvm_va_space_t *va_space1 = (uvm_va_space_t *)0x2000;
+    uvm_gpu_t *gpu0 = (uvm_gpu_t *)0x3000;
+    uvm_gpu_t *gpu1 = (uvm_gpu_t *)0x4000;
+    const NvU64 block0 = 0;
+    const NvU64 block1 = UVM_VA_BLOCK_SIZE;
+    const NvU64 block2 = 2 * UVM_VA_BLOCK_SIZE;
+    const NvU64 no_budget = ULLONG_MAX;
+
+    // Scores accumulate across batches. A region below min_score stays pending
+    // and decays by half every interval without notifications.
+    uvm_page_mask_zero(pages);
+    uvm_page_mask_set(pages, 0);
+    planner_record(planner, va_space0, gpu0, block0, pages, 2);
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 3, NULL, 0));
+    TEST_CHECK_RET(planner->num_candidates == 1);
+    TEST_CHECK_RET(planner->candidates[0].score == 2);
+
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 3, NULL, 0));
+    TEST_CHECK_RET(planner->candidates[0].score == 1);
+
+    planner_record(planner, va_space0, gpu0, block0, pages, 2);
+    TEST_CHECK_RET(planner->num_candidates == 1);
+    TEST_CHECK_RET(planner->candidates[0].score == 3);
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 3, &block0, 1));
+    TEST_CHECK_RET(planner->num_candidates == 0);
+
+    // Without notifications a candidate eventually expires
+    planner_record(planner, va_space0, gpu0, block0, pages, 3);
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 4, NULL, 0));
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 4, NULL, 0));
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 4, NULL, 0));
+    TEST_CHECK_RET(planner->num_candidates == 0);
+
+    // Ranking by score per page: a single hot page beats a larger region with
+    // the same score. The first candidate of each GPU ignores the budget.
+    planner_record(planner, va_space0, gpu0, block1, pages, 8);
+    uvm_page_mask_region_fill(pages, uvm_va_block_region(0, 4));
+    planner_record(planner, va_space0, gpu0, block0, pages, 8);
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, PAGE_SIZE, 1, &block1, 1));
+    TEST_CHECK_RET(planner->num_candidates == 1);
+    TEST_CHECK_RET(planner->candidates[0].block_start == block0);
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, PAGE_SIZE, 1, &block0, 1));
+
+    // The budget is per GPU and shared by all VA spaces. A candidate with a
+    // much lower score than another GPU's candidate for the same region is
+    // outvoted. Plans are issued sorted by VA space, GPU and address.
+    uvm_page_mask_zero(pages);
+    uvm_page_mask_set(pages, 0);
+    planner_record(planner, va_space1, gpu0, block0, pages, 4);
+    planner_record(planner, va_space0, gpu1, block0, pages, 4);
+    planner_record(planner, va_space0, gpu0, block1, pages, 4);
+    planner_record(planner, va_space0, gpu0, block0, pages, 1);
+    {
+        const NvU64 expected[] = {block1, block0};
+
+        TEST_NV_CHECK_RET(test_planner_check_plan(planner, PAGE_SIZE, 1, expected, ARRAY_SIZE(expected)));
+    }
+
+    TEST_CHECK_RET(planner->num_candidates == 1);
+    TEST_CHECK_RET(planner->candidates[0].va_space == va_space1);
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, PAGE_SIZE, 1, &block0, 1));
+    TEST_CHECK_RET(planner->num_candidates == 0);
+
+    // Two GPUs with comparable scores on the same region: neither migrates it
+    planner_record(planner, va_space0, gpu0, block0, pages, 6);
+    planner_record(planner, va_space0, gpu1, block0, pages, 4);
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 1, NULL, 0));
+    TEST_CHECK_RET(planner->num_candidates == 2);
+
+    // A clear winner migrates it, and the loser is dropped
+    planner_record(planner, va_space0, gpu0, block0, pages, 8);
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 1, &block0, 1));
+    TEST_CHECK_RET(planner->num_candidates == 0);
+
+    // A full table replaces its coldest candidate, unless it is hotter than
+    // the new one
+    planner->max_candidates = 2;
+    planner_record(planner, va_space0, gpu0, block0, pages, 5);
+    planner_record(planner, va_space0, gpu0, block1, pages, 3);
+    planner_record(planner, va_space0, gpu0, block2, pages, 2);
+    TEST_CHECK_RET(planner->num_candidates == 2);
+    planner_record(planner, va_space0, gpu0, block2, pages, 4);
+    TEST_CHECK_RET(planner->num_candidates == 2);
+    {
+        const NvU64 expected[] = {block0, block2};
+
+        TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 1, expected, ARRAY_SIZE(expected)));
+    }
+
+    // Purging a VA space and GPU pair only drops its candidates
+    planner_record(planner, va_space0, gpu0, block0, pages, 5);
+    planner_record(planner, va_space0, gpu1, block1, pages, 5);
+    planner_purge(planner, va_space0, gpu0);
+    TEST_CHECK_RET(planner->num_candidates == 1);
+    TEST_CHECK_RET(planner->candidates[0].gpu == gpu1);
+    TEST_NV_CHECK_RET(test_planner_check_plan(planner, no_budget, 1, &block1, 1));
+
+    return NV_OK;
+}
+
+// Notifications for a VA space are not recorded once access counters have been
+// disabled for it, since the planner has already been purged of its candidates.
+static NV_STATUS test_planner_disabled_counters_gpu(uvm_va_space_t *va_space,
+                                                    uvm_gpu_t *gpu,
+                                                    uvm_access_counter_planner_t *planner,
+                                                    uvm_page_mask_t *pages)
+{
+    NV_STATUS status = NV_OK;
+    NV_STATUS enable_status = NV_OK;
+    bool was_enabled;
+
+    // Access counters are enabled and disabled without holding the VA space
+    // lock, like in GPU registration.
+    was_enabled = uvm_parent_processor_mask_test(&va_space->access_counters_enabled_processors, gpu->parent->id);
+    if (!was_enabled)
+        TEST_NV_CHECK_RET(uvm_gpu_access_counters_enable(gpu, va_space));
+
+    uvm_page_mask_zero(pages);
+    uvm_page_mask_set(pages, 0);
+
+    TEST_CHECK_GOTO(planner_record_notifications(planner, va_space, gpu, 0, pages, 1), done);
+    TEST_CHECK_GOTO(planner->num_candidates == 1, done);
+
+    uvm_gpu_access_counters_disable(gpu, va_space);
+    planner_purge(planner, va_space, gpu);
+
+    TEST_CHECK_GOTO(!planner_record_notifications(planner, va_space, gpu, 0, pages, 1), done);
+    TEST_CHECK_GOTO(planner->num_candidates == 0, done);
+
+done:
+    planner_purge(planner, va_space, gpu);
+
+    if (was_enabled)
+        enable_status = uvm_gpu_access_counters_enable(gpu, va_space);
+    else
+        uvm_gpu_access_counters_disable(gpu, va_space);
+
+    return status == NV_OK ? enable_status : status;
+}
+
+static NV_STATUS test_planner_disabled_counters(uvm_va_space_t *va_space,
+                                                uvm_access_counter_planner_t *planner,
+                                                uvm_page_mask_t *pages)
+{
+    uvm_processor_mask_t *retained_gpus;
+    uvm_gpu_t *gpu;
+    NV_STATUS status = NV_OK;
+
+    retained_gpus = uvm_processor_mask_cache_alloc();
+    if (!retained_gpus)
+        return NV_ERR_NO_MEMORY;
+
+    uvm_va_space_down_read(va_space);
+
+    uvm_processor_mask_copy(retained_gpus, &va_space->registered_gpus);
+    uvm_global_gpu_retain(retained_gpus);
+
+    uvm_va_space_up_read(va_space);
+
+    for_each_gpu_in_mask(gpu, retained_gpus) {
+        if (!gpu->parent->access_counters_supported)
+            continue;
+
+        status = test_planner_disabled_counters_gpu(va_space, gpu, planner, pages);
+        if (status != NV_OK)
+            break;
+    }
+
+    uvm_global_gpu_release(retained_gpus);
+    uvm_processor_mask_cache_free(retained_gpus);
+
+    return status;
+}
+
+NV_STATUS uvm_test_access_counter_planner(UVM_TEST_ACCESS_COUNTER_PLANNER_PARAMS *params, struct file *filp)
+{
+    uvm_access_counter_planner_t *planner;
+    uvm_page_mask_t *pages;
+    NV_STATUS status;
+
+    planner = uvm_kvmalloc(sizeof(*planner));
+    pages = uvm_kvmalloc(sizeof(*pages));
+    if (!planner || !pages) {
+        status = NV_ERR_NO_MEMORY;
+        goto out;
+    }
+
+    status = planner_init(planner, UVM_PERF_ACCESS_COUNTER_PLANNER_CANDIDATES);
+    if (status != NV_OK)
+        goto out;
+
+    status = test_planner(planner, pages);
+    if (status == NV_OK)
+        status = test_planner_disabled_counters(uvm_va_space_get(filp), planner, pages);
+
+    planner_deinit(planner);
+
+out:
+    uvm_kvfree(planner);
+    uvm_kvfree(pages);
+
+    return status;
+}
@@ -20,6 +20,7 @@
     DEALINGS IN THE SOFTWARE.
 *******************************************************************************/
 
+#include "linux/sort.h"
 #include "nv_uvm_interface.h"
 #include "uvm_common.h"
 #include "uvm_api.h"
@@ -113,6 +114,18 @@
 // for that block is identical to that of a replayable fault, see
 // uvm_va_block_service_locked. Another similarity between the two types of
 // faults is that they use the same entry format, uvm_fault_buffer_entry_t.
+//
+// The faults fetched from the shadow buffer are sorted by channel and address,
+// and all the faults of a channel are serviced under a single VA space lookup
+// and lock acquisition. Faults that fall within the same VA block are serviced
+// together, and the faulted bit of the channel is cleared once all of its
+// faults have been serviced. Fatal faults are still reported individually.
+
+// Group non-replayable faults by channel and VA block before servicing them.
+// When disabled, faults are serviced one at a time in the order in which they
+// were fetched.
+static unsigned uvm_perf_non_replayable_fault_batching = 1;
+module_param(uvm_perf_non_replayable_fault_batching, uint, S_IRUGO);
 
 
 // There is no error handling in this function. The caller is in charge of
@@ -123,8 +136,9 @@ NV_STATUS uvm_parent_gpu_fault_buffer_init_non_replayable_faults(uvm_parent_gpu_
 
     UVM_ASSERT(parent_gpu->non_replayable_faults_supported);
 
-    non_replayable_faults->shadow_buffer_copy = NULL;
-    non_replayable_faults->fault_cache        = NULL;
+    non_replayable_faults->shadow_buffer_copy  = NULL;
+    non_replayable_faults->fault_cache         = NULL;
+    non_replayable_faults->ordered_fault_cache = NULL;
 
     non_replayable_faults->max_faults = parent_gpu->fault_buffer.rm_info.nonReplayable.bufferSize /
                                         parent_gpu->fault_buffer_hal->entry_size(parent_gpu);
@@ -139,9 +153,16 @@ NV_STATUS uvm_parent_gpu_fault_buffer_init_non_replayable_faults(uvm_parent_gpu_
     if (!non_replayable_faults->fault_cache)
         return NV_ERR_NO_MEMORY;
 
+    non_replayable_faults->ordered_fault_cache =
+        uvm_kvmalloc_zero(non_replayable_faults->max_faults * sizeof(*non_replayable_faults->ordered_fault_cache));
+    if (!non_replayable_faults->ordered_fault_cache)
+        return NV_ERR_NO_MEMORY;
+
     uvm_tracker_init(&non_replayable_faults->clear_faulted_tracker);
     uvm_tracker_init(&non_replayable_faults->fault_service_tracker);
 
+    non_replayable_faults->ats_context.ats_invalidate = &non_replayable_faults->ats_invalidate;
+
     return NV_OK;
 }
 
@@ -159,8 +180,10 @@ void uvm_parent_gpu_fault_buffer_deinit_non_replayable_faults(uvm_parent_gpu_t *
 
     uvm_kvfree(non_replayable_faults->shadow_buffer_copy);
     uvm_kvfree(non_replayable_faults->fault_cache);
-    non_replayable_faults->shadow_buffer_copy = NULL;
-    non_replayable_faults->fault_cache        = NULL;
+    uvm_kvfree(non_replayable_faults->ordered_fault_cache);
+    non_replayable_faults->shadow_buffer_copy  = NULL;
+    non_replayable_faults->fault_cache         = NULL;
+    non_replayable_faults->ordered_fault_cache = NULL;
 }
 
 bool uvm_parent_gpu_non_replayable_faults_pending(uvm_parent_gpu_t *parent_gpu)
@@ -318,7 +341,7 @@ static NV_STATUS clear_faulted_register_on_gpu(uvm_user_channel_t *user_channel,
 
     // We need to wait for all pending work before writing to the channel
     // register
-    status = uvm_tracker_wait(tracker);
+    status = uvm_tracker_wait_spin(tracker);
     if (status != NV_OK)
         return status;
 
@@ -342,114 +365,169 @@ static NV_STATUS clear_faulted_on_gpu(uvm_user_channel_t *user_channel,
     return clear_faulted_register_on_gpu(user_channel, fault_entry, batch_id, tracker);
 }
 
-static NV_STATUS service_managed_fault_in_block_locked(uvm_va_block_t *va_block,
-                                                       uvm_va_block_retry_t *va_block_retry,
-                                                       uvm_fault_buffer_entry_t *fault_entry,
-                                                       uvm_service_block_context_t *service_context,
-                                                       const bool hmm_migratable)
+// Service the faults in ordered_fault_cache that fall within the VA block (or
+// within the policy range of the first fault, for HMM), starting at
+// first_fault_index and up to end_fault_index. The number of entries covered
+// is returned in block_faults.
+//
+// Faults that fail the logical permission checks are flagged as fatal, and the
+// rest are serviced with a single call to uvm_va_block_service_locked.
+static NV_STATUS service_fault_batch_block_locked(uvm_gpu_t *gpu,
+                                                  uvm_va_block_t *va_block,
+                                                  uvm_va_block_retry_t *va_block_retry,
+                                                  NvU32 first_fault_index,
+                                                  NvU32 end_fault_index,
+                                                  const bool hmm_migratable,
+                                                  NvU32 *block_faults)
 {
-    uvm_gpu_t *gpu = fault_entry->gpu;
     NV_STATUS status = NV_OK;
-    uvm_page_index_t page_index;
-    uvm_perf_thrashing_hint_t thrashing_hint;
-    uvm_processor_id_t new_residency;
-    bool read_duplicate;
+    NvU32 i;
+    uvm_page_index_t first_page_index = PAGES_PER_UVM_VA_BLOCK;
+    uvm_page_index_t last_page_index = 0;
+    NvU32 page_fault_count = 0;
     uvm_va_space_t *va_space = uvm_va_block_get_va_space(va_block);
     uvm_non_replayable_fault_buffer_t *non_replayable_faults = &gpu->parent->fault_buffer.non_replayable;
+    uvm_fault_buffer_entry_t **ordered_fault_cache = non_replayable_faults->ordered_fault_cache;
+    uvm_fault_buffer_entry_t *first_fault_entry = ordered_fault_cache[first_fault_index];
+    uvm_service_block_context_t *service_context = &non_replayable_faults->block_service_context;
     const uvm_va_policy_t *policy;
-
-    UVM_ASSERT(!fault_entry->is_fatal);
+    NvU64 end;
 
     uvm_assert_rwsem_locked(&va_space->lock);
-
-    UVM_ASSERT(fault_entry->va_space == va_space);
-    UVM_ASSERT(fault_entry->fault_address >= va_block->start);
-    UVM_ASSERT(fault_entry->fault_address <= va_block->end);
-
-    policy = uvm_va_policy_get(va_block, fault_entry->fault_address);
-
-    if (service_context->num_retries == 0) {
-        // notify event to tools/performance heuristics. For now we use a
-        // unique batch id per fault, since we clear the faulted channel for
-        // each fault.
-        uvm_perf_event_notify_gpu_fault(&va_space->perf_events,
-                                        va_block,
-                                        gpu->id,
-                                        policy->preferred_location,
-                                        fault_entry,
-                                        ++non_replayable_faults->batch_id,
-                                        false);
+    uvm_assert_mutex_locked(&va_block->lock);
+
+    UVM_ASSERT(!first_fault_entry->is_fatal);
+    UVM_ASSERT(first_fault_entry->va_space == va_space);
+    UVM_ASSERT(first_fault_entry->fault_address >= va_block->start);
+    UVM_ASSERT(first_fault_entry->fault_address <= va_block->end);
+
+    if (uvm_va_block_is_hmm(va_block)) {
+        policy = uvm_hmm_find_policy_end(va_block,
+                                         service_context->block_context->hmm.vma,
+                                         first_fault_entry->fault_address,
+                                         &end);
     }
-
-    // Check logical permissions
-    status = uvm_va_block_check_logical_permissions(va_block,
-                                                    service_context->block_context,
-                                                    gpu->id,
-                                                    uvm_va_block_cpu_page_index(va_block,
-                                                                                fault_entry->fault_address),
-                                                    fault_entry->fault_access_type,
-                                                    uvm_range_group_address_migratable(va_space,
-                                                                                       fault_entry->fault_address));
-    if (status != NV_OK) {
-        fault_entry->is_fatal = true;
-        fault_entry->fatal_reason = uvm_tools_status_to_fatal_fault_reason(status);
-        return NV_OK;
+    else {
+        policy = &va_block->managed_range->policy;
+        end = va_block->end;
     }
 
-    // TODO: Bug 1880194: Revisit thrashing detection
-    thrashing_hint.type = UVM_PERF_THRASHING_HINT_TYPE_NONE;
-
+    // Initialize the minimum necessary state in the fault service context
+    uvm_processor_mask_zero(&service_context->resident_processors);
     service_context->read_duplicate_count = 0;
     service_context->thrashing_pin_count = 0;
 
-    page_index = uvm_va_block_cpu_page_index(va_block, fault_entry->fault_address);
+    for (i = first_fault_index;
+         i < end_fault_index && ordered_fault_cache[i]->fault_address <= end;
+         ++i) {
+        uvm_fault_buffer_entry_t *current_entry = ordered_fault_cache[i];
+        uvm_page_index_t page_index = uvm_va_block_cpu_page_index(va_block, current_entry->fault_address);
+        uvm_perf_thrashing_hint_t thrashing_hint;
+        uvm_processor_id_t new_residency;
+        bool read_duplicate;
+
+        // Faults with a fatal type, or which already failed the permission
+        // checks in a previous try, are not serviced
+        if (current_entry->is_fatal)
+            continue;
+
+        if (service_context->num_retries == 0) {
+            // Notify event to tools/performance heuristics. All the faults
+            // serviced before clearing the faulted channel share a batch id.
+            uvm_perf_event_notify_gpu_fault(&va_space->perf_events,
+                                            va_block,
+                                            gpu->id,
+                                            policy->preferred_location,
+                                            current_entry,
+                                            non_replayable_faults->batch_id,
+                                            false);
+        }
 
-    // Compute new residency and update the masks
-    new_residency = uvm_va_block_select_residency(va_block,
-                                                  service_context->block_context,
-                                                  page_index,
-                                                  gpu->id,
-                                                  fault_entry->access_type_mask,
-                                                  policy,
-                                                  &thrashing_hint,
-                                                  UVM_SERVICE_OPERATION_NON_REPLAYABLE_FAULTS,
-                                                  hmm_migratable,
-                                                  &read_duplicate);
+        // Faults on the same page are sorted by decreasing access type, so the
+        // page has already been serviced for this access if the previous
+        // fault was not fatal.
+        if (i > first_fault_index) {
+            uvm_fault_buffer_entry_t *previous_entry = ordered_fault_cache[i - 1];
 
-    // Initialize the minimum necessary state in the fault service context
-    uvm_processor_mask_zero(&service_context->resident_processors);
+            if (previous_entry->fault_address == current_entry->fault_address && !previous_entry->is_fatal)
+                continue;
+        }
 
-    // Set new residency and update the masks
-    uvm_processor_mask_set(&service_context->resident_processors, new_residency);
+        // Check logical permissions
+        status = uvm_va_block_check_logical_permissions(va_block,
+                                                        service_context->block_context,
+                                                        gpu->id,
+                                                        page_index,
+                                                        current_entry->fault_access_type,
+                                                        uvm_range_group_address_migratable(va_space,
+                                                                                           current_entry->fault_address));
+        if (status != NV_OK) {
+            current_entry->is_fatal = true;
+            current_entry->fatal_reason = uvm_tools_status_to_fatal_fault_reason(status);
+            status = NV_OK;
+            continue;
+        }
 
-    // The masks need to be fully zeroed as the fault region may grow due to prefetching
-    uvm_page_mask_zero(&service_context->per_processor_masks[uvm_id_value(new_residency)].new_residency);
-    uvm_page_mask_set(&service_context->per_processor_masks[uvm_id_value(new_residency)].new_residency, page_index);
+        // TODO: Bug 1880194: Revisit thrashing detection
+        thrashing_hint.type = UVM_PERF_THRASHING_HINT_TYPE_NONE;
+
+        // Compute new residency and update the masks
+        new_residency = uvm_va_block_select_residency(va_block,
+                                                      service_context->block_context,
+                                                      page_index,
+                                                      gpu->id,
+                                                      current_entry->access_type_mask,
+                                                      policy,
+                                                      &thrashing_hint,
+                                                      UVM_SERVICE_OPERATION_NON_REPLAYABLE_FAULTS,
+                                                      hmm_migratable,
+                                                      &read_duplicate);
+
+        // The masks need to be fully zeroed as the fault region may grow due
+        // to prefetching
+        if (!uvm_processor_mask_test_and_set(&service_context->resident_processors, new_residency))
+            uvm_page_mask_zero(&service_context->per_processor_masks[uvm_id_value(new_residency)].new_residency);
+
+        uvm_page_mask_set(&service_context->per_processor_masks[uvm_id_value(new_residency)].new_residency, page_index);
+
+        if (read_duplicate) {
+            if (service_context->read_duplicate_count++ == 0)
+                uvm_page_mask_zero(&service_context->read_duplicate_mask);
+
+            uvm_page_mask_set(&service_context->read_duplicate_mask, page_index);
+        }
 
-    if (read_duplicate) {
-        uvm_page_mask_zero(&service_context->read_duplicate_mask);
-        uvm_page_mask_set(&service_context->read_duplicate_mask, page_index);
-        service_context->read_duplicate_count = 1;
-    }
+        service_context->access_type[page_index] = current_entry->fault_access_type;
 
-    service_context->access_type[page_index] = fault_entry->fault_access_type;
+        ++page_fault_count;
 
-    service_context->region = uvm_va_block_region_for_page(page_index);
+        if (page_index < first_page_index)
+            first_page_index = page_index;
+        if (page_index > last_page_index)
+            last_page_index = page_index;
+    }
+
+    if (page_fault_count > 0) {
+        service_context->region = uvm_va_block_region(first_page_index, last_page_index + 1);
+        status = uvm_va_block_service_locked(gpu->id, va_block, va_block_retry, service_context);
+    }
 
-    status = uvm_va_block_service_locked(gpu->id, va_block, va_block_retry, service_context);
+    *block_faults = i - first_fault_index;
 
     ++service_context->num_retries;
 
     return status;
 }
 
-static NV_STATUS service_managed_fault_in_block(uvm_va_block_t *va_block,
-                                                uvm_fault_buffer_entry_t *fault_entry,
-                                                const bool hmm_migratable)
+static NV_STATUS service_fault_batch_block(uvm_gpu_t *gpu,
+                                           uvm_va_block_t *va_block,
+                                           NvU32 first_fault_index,
+                                           NvU32 end_fault_index,
+                                           const bool hmm_migratable,
+                                           NvU32 *block_faults)
 {
     NV_STATUS status, tracker_status;
     uvm_va_block_retry_t va_block_retry;
-    uvm_gpu_t *gpu = fault_entry->gpu;
     uvm_service_block_context_t *service_context = &gpu->parent->fault_buffer.non_replayable.block_service_context;
 
     service_context->operation = UVM_SERVICE_OPERATION_NON_REPLAYABLE_FAULTS;
@@ -461,11 +539,13 @@ static NV_STATUS service_managed_fault_in_block(uvm_va_block_t *va_block,
     uvm_mutex_lock(&va_block->lock);
 
     status = UVM_VA_BLOCK_RETRY_LOCKED(va_block, &va_block_retry,
-                                       service_managed_fault_in_block_locked(va_block,
-                                                                             &va_block_retry,
-                                                                             fault_entry,
-                                                                             service_context,
-                                                                             hmm_migratable));
+                                       service_fault_batch_block_locked(gpu,
+                                                                        va_block,
+                                                                        &va_block_retry,
+                                                                        first_fault_index,
+                                                                        end_fault_index,
+                                                                        hmm_migratable,
+                                                                        block_faults));
 
     tracker_status = uvm_tracker_add_tracker_safe(&gpu->parent->fault_buffer.non_replayable.fault_service_tracker,
                                                   &va_block->tracker);
@@ -566,7 +646,7 @@ static NV_STATUS service_non_managed_fault(uvm_gpu_va_space_t *gpu_va_space,
                                     gpu->id,
                                     UVM_ID_INVALID,
                                     fault_entry,
-                                    ++non_replayable_faults->batch_id,
+                                    non_replayable_faults->batch_id,
                                     false);
 
     if (status != NV_ERR_INVALID_ADDRESS)
@@ -638,11 +718,65 @@ static NV_STATUS service_non_managed_fault(uvm_gpu_va_space_t *gpu_va_space,
     return status;
 }
 
-static NV_STATUS service_fault_once(uvm_parent_gpu_t *parent_gpu,
-                                    uvm_fault_buffer_entry_t *fault_entry,
-                                    const bool hmm_migratable)
+static int cmp_fault_channel(const uvm_fault_buffer_entry_t *a, const uvm_fault_buffer_entry_t *b)
+{
+    int result = uvm_gpu_phys_addr_cmp(a->instance_ptr, b->instance_ptr);
+    if (result != 0)
+        return result;
+
+    // The VEID and the client type determine the VA space of the fault, and
+    // the engine type determines the faulted bit to be cleared
+    result = UVM_CMP_DEFAULT(a->fault_source.ve_id, b->fault_source.ve_id);
+    if (result != 0)
+        return result;
+
+    result = UVM_CMP_DEFAULT(a->fault_source.client_type, b->fault_source.client_type);
+    if (result != 0)
+        return result;
+
+    return UVM_CMP_DEFAULT(a->fault_source.mmu_engine_type, b->fault_source.mmu_engine_type);
+}
+
+// Sort comparator for pointers to fault buffer entries that sorts by channel,
+// fault address, decreasing fault access type, and fetch order.
+static int cmp_sort_fault_entry_by_channel_address_access_type(const void *_a, const void *_b)
+{
+    const uvm_fault_buffer_entry_t **a = (const uvm_fault_buffer_entry_t **)_a;
+    const uvm_fault_buffer_entry_t **b = (const uvm_fault_buffer_entry_t **)_b;
+    int result;
+
+    result = cmp_fault_channel(*a, *b);
+    if (result != 0)
+        return result;
+
+    result = UVM_CMP_DEFAULT((*a)->fault_address, (*b)->fault_address);
+    if (result != 0)
+        return result;
+
+    result = UVM_CMP_DEFAULT((*b)->fault_access_type, (*a)->fault_access_type);
+    if (result != 0)
+        return result;
+
+    return UVM_CMP_DEFAULT((*a)->non_replayable.buffer_index, (*b)->non_replayable.buffer_index);
+}
+
+// Service the faults in ordered_fault_cache[first_fault_index, end_fault_index),
+// which belong to the same channel, starting at *next_fault_index. On return,
+// *next_fault_index is the first fault that still needs to be serviced, which
+// is end_fault_index unless servicing needs to be retried with the locks
+// dropped.
+//
+// The faulted bit of the channel is cleared once all the faults have been
+// serviced, if any of them was not fatal.
+static NV_STATUS service_fault_batch_channel_once(uvm_parent_gpu_t *parent_gpu,
+                                                  NvU32 first_fault_index,
+                                                  NvU32 end_fault_index,
+                                                  NvU32 *next_fault_index,
+                                                  const bool hmm_migratable)
 {
     NV_STATUS status;
+    NvU32 i;
+    NvU32 start_fault_index = *next_fault_index;
     uvm_user_channel_t *user_channel;
     uvm_va_block_t *va_block;
     uvm_va_space_t *va_space;
@@ -650,10 +784,13 @@ static NV_STATUS service_fault_once(uvm_parent_gpu_t *parent_gpu,
     uvm_gpu_va_space_t *gpu_va_space;
     uvm_gpu_t *gpu;
     uvm_non_replayable_fault_buffer_t *non_replayable_faults = &parent_gpu->fault_buffer.non_replayable;
+    uvm_fault_buffer_entry_t **ordered_fault_cache = non_replayable_faults->ordered_fault_cache;
+    uvm_fault_buffer_entry_t *first_fault_entry = ordered_fault_cache[first_fault_index];
+    uvm_fault_buffer_entry_t *clear_fault_entry = NULL;
     uvm_va_block_context_t *va_block_context = non_replayable_faults->block_service_context.block_context;
 
     status = uvm_parent_gpu_fault_entry_to_va_space(parent_gpu,
-                                                    fault_entry,
+                                                    first_fault_entry,
                                                     &va_space,
                                                     &gpu);
     if (status != NV_OK) {
@@ -662,7 +799,7 @@ static NV_STATUS service_fault_once(uvm_parent_gpu_t *parent_gpu,
         // space unregister, VA space destroy, etc). The other thread will stop
         // the channel and remove the channel from the table, so the faulting
         // condition will be gone. In the case of replayable faults we need to
-        // flush the buffer, but here we can just ignore the entry and proceed
+        // flush the buffer, but here we can just ignore the entries and proceed
         // on.
         //
         // Note that we can't have any subcontext issues here, since non-
@@ -670,6 +807,7 @@ static NV_STATUS service_fault_once(uvm_parent_gpu_t *parent_gpu,
         UVM_ASSERT(status == NV_ERR_INVALID_CHANNEL);
         UVM_ASSERT(!va_space);
         UVM_ASSERT(!gpu);
+        *next_fault_index = end_fault_index;
         return NV_OK;
     }
 
@@ -689,57 +827,94 @@ static NV_STATUS service_fault_once(uvm_parent_gpu_t *parent_gpu,
     if (!gpu_va_space) {
         // The va_space might have gone away. See the comment above.
         status = NV_OK;
+        *next_fault_index = end_fault_index;
         goto exit_no_channel;
     }
 
-    fault_entry->va_space = va_space;
-    fault_entry->gpu = gpu;
-
-    user_channel = uvm_gpu_va_space_get_user_channel(gpu_va_space, fault_entry->instance_ptr);
+    user_channel = uvm_gpu_va_space_get_user_channel(gpu_va_space, first_fault_entry->instance_ptr);
     if (!user_channel) {
         // The channel might have gone away. See the comment above.
         status = NV_OK;
+        *next_fault_index = end_fault_index;
         goto exit_no_channel;
     }
 
-    fault_entry->fault_source.channel_id = user_channel->hw_channel_id;
+    for (i = start_fault_index; i < end_fault_index; ++i) {
+        ordered_fault_cache[i]->va_space = va_space;
+        ordered_fault_cache[i]->gpu = gpu;
+        ordered_fault_cache[i]->fault_source.channel_id = user_channel->hw_channel_id;
+    }
+
+    for (i = start_fault_index; i < end_fault_index;) {
+        uvm_fault_buffer_entry_t *current_entry = ordered_fault_cache[i];
+        NvU32 block_faults = 1;
+
+        if (!current_entry->is_fatal) {
+            if (mm) {
+                status = uvm_va_block_find_create(va_space,
+                                                  current_entry->fault_address,
+                                                  &va_block_context->hmm.vma,
+                                                  &va_block);
+            }
+            else {
+                status = uvm_va_block_find_create_managed(va_space,
+                                                          current_entry->fault_address,
+                                                          &va_block);
+            }
+            if (status == NV_OK)
+                status = service_fault_batch_block(gpu, va_block, i, end_fault_index, hmm_migratable, &block_faults);
+            else
+                status = service_non_managed_fault(gpu_va_space, mm, current_entry, status);
 
-    if (!fault_entry->is_fatal) {
-        if (mm) {
-            status = uvm_va_block_find_create(va_space,
-                                              fault_entry->fault_address,
-                                              &va_block_context->hmm.vma,
-                                              &va_block);
+            if (status != NV_OK)
+                break;
         }
-        else {
-            status = uvm_va_block_find_create_managed(va_space,
-                                                      fault_entry->fault_address,
-                                                      &va_block);
+
+        i += block_faults;
+    }
+
+    *next_fault_index = i;
+
+    // We are done, we clear the faulted bit on the channel, so it can be
+    // re-scheduled again
+    if (status == NV_OK) {
+        for (i = first_fault_index; i < end_fault_index; ++i) {
+            if (!ordered_fault_cache[i]->is_fatal) {
+                clear_fault_entry = ordered_fault_cache[i];
+                break;
+            }
         }
-        if (status == NV_OK)
-            status = service_managed_fault_in_block(va_block, fault_entry, hmm_migratable);
-        else
-            status = service_non_managed_fault(gpu_va_space, mm, fault_entry, status);
 
-        // We are done, we clear the faulted bit on the channel, so it can be
-        // re-scheduled again
-        if (status == NV_OK && !fault_entry->is_fatal) {
+        if (clear_fault_entry) {
             status = clear_faulted_on_gpu(user_channel,
-                                          fault_entry,
+                                          clear_fault_entry,
                                           non_replayable_faults->batch_id,
                                           &non_replayable_faults->fault_service_tracker);
-            uvm_tracker_clear(&non_replayable_faults->fault_service_tracker);
         }
+
+        uvm_tracker_clear(&non_replayable_faults->fault_service_tracker);
     }
 
-    if (fault_entry->is_fatal)
-        uvm_tools_record_gpu_fatal_fault(gpu->id, va_space, fault_entry, fault_entry->fatal_reason);
+    // Faults after *next_fault_index are reported in the next try
+    for (i = start_fault_index; i < *next_fault_index; ++i) {
+        uvm_fault_buffer_entry_t *current_entry = ordered_fault_cache[i];
 
-    if (fault_entry->is_fatal ||
-        (status != NV_OK &&
-         status != NV_WARN_MORE_PROCESSING_REQUIRED &&
-         status != NV_WARN_MISMATCHED_TARGET))
-        schedule_kill_channel(fault_entry, user_channel);
+        if (current_entry->is_fatal) {
+            uvm_tools_record_gpu_fatal_fault(gpu->id, va_space, current_entry, current_entry->fatal_reason);
+            schedule_kill_channel(current_entry, user_channel);
+        }
+    }
+
+    if (status != NV_OK &&
+        status != NV_WARN_MORE_PROCESSING_REQUIRED &&
+        status != NV_WARN_MISMATCHED_TARGET) {
+        // Either servicing the fault at *next_fault_index or clearing the
+        // faulted bit failed
+        if (*next_fault_index < end_fault_index)
+            schedule_kill_channel(ordered_fault_cache[*next_fault_index], user_channel);
+        else
+            schedule_kill_channel(clear_fault_entry, user_channel);
+    }
 
 exit_no_channel:
     uvm_va_space_up_read(va_space);
@@ -754,17 +929,24 @@ exit_no_channel:
     return status;
 }
 
-static NV_STATUS service_fault(uvm_parent_gpu_t *parent_gpu, uvm_fault_buffer_entry_t *fault_entry)
+static NV_STATUS service_fault_batch_channel(uvm_parent_gpu_t *parent_gpu,
+                                             NvU32 first_fault_index,
+                                             NvU32 end_fault_index)
 {
-    uvm_service_block_context_t *service_context =
-        &parent_gpu->fault_buffer.non_replayable.block_service_context;
     NV_STATUS status;
+    NvU32 next_fault_index = first_fault_index;
     bool hmm_migratable = true;
 
-    service_context->num_retries = 0;
+    // All the faults of the channel are reported with the same batch id, since
+    // the faulted channel is cleared once for all of them
+    ++parent_gpu->fault_buffer.non_replayable.batch_id;
 
     do {
-        status = service_fault_once(parent_gpu, fault_entry, hmm_migratable);
+        status = service_fault_batch_channel_once(parent_gpu,
+                                                  first_fault_index,
+                                                  end_fault_index,
+                                                  &next_fault_index,
+                                                  hmm_migratable);
         if (status == NV_WARN_MISMATCHED_TARGET) {
             hmm_migratable = false;
             status = NV_WARN_MORE_PROCESSING_REQUIRED;
@@ -774,6 +956,45 @@ static NV_STATUS service_fault(uvm_parent_gpu_t *parent_gpu, uvm_fault_buffer_en
     return status;
 }
 
+static NV_STATUS service_fault_batch(uvm_parent_gpu_t *parent_gpu, NvU32 cached_faults)
+{
+    uvm_non_replayable_fault_buffer_t *non_replayable_faults = &parent_gpu->fault_buffer.non_replayable;
+    uvm_fault_buffer_entry_t **ordered_fault_cache = non_replayable_faults->ordered_fault_cache;
+    NvU32 first_fault_index;
+    NvU32 end_fault_index;
+    NvU32 i;
+
+    for (i = 0; i < cached_faults; ++i)
+        ordered_fault_cache[i] = &non_replayable_faults->fault_cache[i];
+
+    if (uvm_perf_non_replayable_fault_batching) {
+        sort(ordered_fault_cache,
+             cached_faults,
+             sizeof(*ordered_fault_cache),
+             cmp_sort_fault_entry_by_channel_address_access_type,
+             NULL);
+    }
+
+    for (first_fault_index = 0; first_fault_index < cached_faults; first_fault_index = end_fault_index) {
+        NV_STATUS status;
+
+        end_fault_index = first_fault_index + 1;
+
+        if (uvm_perf_non_replayable_fault_batching) {
+            while (end_fault_index < cached_faults &&
+                   cmp_fault_channel(ordered_fault_cache[first_fault_index],
+                                     ordered_fault_cache[end_fault_index]) == 0)
+                ++end_fault_index;
+        }
+
+        status = service_fault_batch_channel(parent_gpu, first_fault_index, end_fault_index);
+        if (status != NV_OK)
+            return status;
+    }
+
+    return NV_OK;
+}
+
 void uvm_parent_gpu_service_non_replayable_fault_buffer(uvm_parent_gpu_t *parent_gpu)
 {
     NvU32 cached_faults;
@@ -784,19 +1005,13 @@ void uvm_parent_gpu_service_non_replayable_fault_buffer(uvm_parent_gpu_t *parent
     // returned to the RM.
     do {
         NV_STATUS status;
-        NvU32 i;
 
         status = fetch_non_replayable_fault_buffer_entries(parent_gpu, &cached_faults);
         if (status != NV_OK)
             return;
 
-        // Differently to replayable faults, we do not batch up and preprocess
-        // non-replayable faults since getting multiple faults on the same
-        // memory region is not very likely
-        for (i = 0; i < cached_faults; ++i) {
-            status = service_fault(parent_gpu, &parent_gpu->fault_buffer.non_replayable.fault_cache[i]);
-            if (status != NV_OK)
-                return;
-        }
+        status = service_fault_batch(parent_gpu, cached_faults);
+        if (status != NV_OK)
+            return;
     } while (cached_faults > 0);
 }
@@ -39,6 +39,7 @@
 #include "uvm_gpu_non_replayable_faults.h"
 #include "uvm_ats_faults.h"
 #include "uvm_test.h"
+#include "uvm_test_rng.h"
 
 // The documentation at the beginning of uvm_gpu_non_replayable_faults.c
 // provides some background for understanding replayable faults, non-replayable
@@ -115,6 +116,30 @@ module_param(uvm_perf_fault_max_throttle_per_service, uint, S_IRUGO);
 static unsigned uvm_perf_fault_coalesce = 1;
 module_param(uvm_perf_fault_coalesce, uint, S_IRUGO);
 
+#define UVM_PERF_FAULT_SERVICE_WORKERS_DEFAULT 1
+#define UVM_PERF_FAULT_SERVICE_WORKERS_MAX     32
+
+// Number of workers that service a replayable fault batch. When greater than
+// 1, the ordered view of each batch is split into shards at VA space and VA
+// block boundaries, and the shards are serviced in parallel by the bottom half
+// and uvm_perf_fault_service_workers - 1 additional kthreads. A single replay
+// is issued once all the shards have been serviced.
+//
+// Sharding is not used with UVM_PERF_FAULT_REPLAY_POLICY_BLOCK, since it
+// issues replays while the batch is being serviced.
+static unsigned uvm_perf_fault_service_workers = UVM_PERF_FAULT_SERVICE_WORKERS_DEFAULT;
+module_param(uvm_perf_fault_service_workers, uint, S_IRUGO);
+
+// Minimum number of coalesced faults per shard. Smaller batches are serviced by
+// the bottom half alone, since the cost of waking up the workers would not pay
+// off.
+#define UVM_PERF_FAULT_SERVICE_MIN_FAULTS_PER_SHARD 32
+
+static void service_fault_batch_shard_entry(void *args);
+
+static uvm_fault_sort_context_t *fault_sort_context_alloc(NvU32 max_items);
+static void fault_sort_context_free(uvm_fault_sort_context_t *sort_context);
+
 // This function is used for both the initial fault buffer initialization and
 // the power management resume path.
 static void fault_buffer_reinit_replayable_faults(uvm_parent_gpu_t *parent_gpu)
@@ -135,6 +160,92 @@ static void fault_buffer_reinit_replayable_faults(uvm_parent_gpu_t *parent_gpu)
         parent_gpu->arch_hal->disable_prefetch_faults(parent_gpu);
 }
 
+// There is no error handling in this function. The caller is in charge of
+// calling fault_service_workers_deinit on failure.
+static NV_STATUS fault_service_workers_init(uvm_parent_gpu_t *parent_gpu)
+{
+    uvm_replayable_fault_buffer_t *replayable_faults = &parent_gpu->fault_buffer.replayable;
+    uvm_fault_service_worker_t *workers;
+    NvU32 num_workers;
+    NvU32 i;
+
+    num_workers = max(uvm_perf_fault_service_workers, 1u);
+    num_workers = min(num_workers, (NvU32)UVM_PERF_FAULT_SERVICE_WORKERS_MAX);
+
+    if (num_workers != uvm_perf_fault_service_workers) {
+        UVM_INFO_PRINT("Invalid uvm_perf_fault_service_workers value on GPU %s: %u. Valid range [1:%u] Using %u instead\n",
+                       uvm_parent_gpu_name(parent_gpu),
+                       uvm_perf_fault_service_workers,
+                       UVM_PERF_FAULT_SERVICE_WORKERS_MAX,
+                       num_workers);
+    }
+
+    if (num_workers == 1)
+        return NV_OK;
+
+    workers = uvm_kvmalloc_zero(num_workers * sizeof(*workers));
+    if (!workers)
+        return NV_ERR_NO_MEMORY;
+
+    replayable_faults->service_workers.workers = workers;
+    replayable_faults->service_workers.num_workers = num_workers;
+
+    for (i = 0; i < num_workers; ++i) {
+        uvm_fault_service_worker_t *worker = &workers[i];
+        char kthread_name[TASK_COMM_LEN + 1];
+        NV_STATUS status;
+
+        worker->parent_gpu = parent_gpu;
+        worker->batch_context.block_service_context = &worker->block_service_context;
+        worker->batch_context.ats_context.ats_invalidate = &worker->ats_invalidate;
+
+        worker->block_service_context.block_context = uvm_va_block_context_alloc(NULL);
+        if (!worker->block_service_context.block_context)
+            return NV_ERR_NO_MEMORY;
+
+        // The shard of the first worker is serviced by the bottom half
+        if (i == 0)
+            continue;
+
+        nv_kthread_q_item_init(&worker->q_item, service_fault_batch_shard_entry, worker);
+
+        snprintf(kthread_name, sizeof(kthread_name), "UVM GPU%u FW%u", uvm_parent_id_value(parent_gpu->id), i);
+        status = errno_to_nv_status(nv_kthread_q_init_on_node(&worker->q,
+                                                              kthread_name,
+                                                              parent_gpu->closest_cpu_numa_node));
+        if (status != NV_OK) {
+            UVM_ERR_PRINT("Failed in nv_kthread_q_init for fault service worker %u: %s, GPU %s\n",
+                          i,
+                          nvstatusToString(status),
+                          uvm_parent_gpu_name(parent_gpu));
+            return status;
+        }
+    }
+
+    return NV_OK;
+}
+
+static void fault_service_workers_deinit(uvm_parent_gpu_t *parent_gpu)
+{
+    uvm_replayable_fault_buffer_t *replayable_faults = &parent_gpu->fault_buffer.replayable;
+    uvm_fault_service_worker_t *workers = replayable_faults->service_workers.workers;
+    NvU32 i;
+
+    if (!workers)
+        return;
+
+    for (i = 0; i < replayable_faults->service_workers.num_workers; ++i) {
+        // It is safe to call nv_kthread_q_stop() on a queue that was never
+        // initialized or whose initialization failed.
+        nv_kthread_q_stop(&workers[i].q);
+        uvm_va_block_context_free(workers[i].block_service_context.block_context);
+    }
+
+    uvm_kvfree(workers);
+    replayable_faults->service_workers.workers = NULL;
+    replayable_faults->service_workers.num_workers = 0;
+}
+
 // There is no error handling in this function. The caller is in charge of
 // calling fault_buffer_deinit_replayable_faults on failure.
 static NV_STATUS fault_buffer_init_replayable_faults(uvm_parent_gpu_t *parent_gpu)
@@ -176,6 +287,10 @@ static NV_STATUS fault_buffer_init_replayable_faults(uvm_parent_gpu_t *parent_gp
     if (!batch_context->ordered_fault_cache)
         return NV_ERR_NO_MEMORY;
 
+    batch_context->sort_context = fault_sort_context_alloc(replayable_faults->max_faults);
+    if (!batch_context->sort_context)
+        return NV_ERR_NO_MEMORY;
+
     // This value must be initialized by HAL
     UVM_ASSERT(replayable_faults->utlb_count > 0);
 
@@ -185,6 +300,9 @@ static NV_STATUS fault_buffer_init_replayable_faults(uvm_parent_gpu_t *parent_gp
 
     batch_context->max_utlb_id = 0;
 
+    batch_context->block_service_context = &replayable_faults->block_service_context;
+    batch_context->ats_context.ats_invalidate = &replayable_faults->ats_invalidate;
+
     status = uvm_rm_locked_call(nvUvmInterfaceOwnPageFaultIntr(parent_gpu->rm_device, NV_TRUE));
     if (status != NV_OK) {
         UVM_ERR_PRINT("Failed to take page fault ownership from RM: %s, GPU %s\n",
@@ -212,6 +330,10 @@ static NV_STATUS fault_buffer_init_replayable_faults(uvm_parent_gpu_t *parent_gp
                        replayable_faults->replay_update_put_ratio);
     }
 
+    status = fault_service_workers_init(parent_gpu);
+    if (status != NV_OK)
+        return status;
+
     // Re-enable fault prefetching just in case it was disabled in a previous run
     parent_gpu->fault_buffer.prefetch_faults_enabled = parent_gpu->prefetch_fault_supported;
 
@@ -225,6 +347,8 @@ static void fault_buffer_deinit_replayable_faults(uvm_parent_gpu_t *parent_gpu)
     uvm_replayable_fault_buffer_t *replayable_faults = &parent_gpu->fault_buffer.replayable;
     uvm_fault_service_batch_context_t *batch_context = &replayable_faults->batch_service_context;
 
+    fault_service_workers_deinit(parent_gpu);
+
     if (batch_context->fault_cache) {
         UVM_ASSERT(uvm_tracker_is_empty(&replayable_faults->replay_tracker));
         uvm_tracker_deinit(&replayable_faults->replay_tracker);
@@ -236,12 +360,17 @@ static void fault_buffer_deinit_replayable_faults(uvm_parent_gpu_t *parent_gpu)
             parent_gpu->arch_hal->enable_prefetch_faults(parent_gpu);
     }
 
+    fault_sort_context_free(batch_context->sort_context);
     uvm_kvfree(batch_context->fault_cache);
     uvm_kvfree(batch_context->ordered_fault_cache);
     uvm_kvfree(batch_context->utlbs);
     batch_context->fault_cache         = NULL;
     batch_context->ordered_fault_cache = NULL;
+    batch_context->sort_context        = NULL;
     batch_context->utlbs               = NULL;
+
+    uvm_kvfree(replayable_faults->trace.records);
+    replayable_faults->trace.records = NULL;
 }
 
 NV_STATUS uvm_parent_gpu_fault_buffer_init(uvm_parent_gpu_t *parent_gpu)
@@ -627,7 +756,7 @@ static NV_STATUS fault_buffer_flush_locked(uvm_parent_gpu_t *parent_gpu,
 
     // Wait for the prior replay to flush out old fault messages
     if (flush_mode == UVM_GPU_BUFFER_FLUSH_MODE_WAIT_UPDATE_PUT) {
-        status = uvm_tracker_wait(&replayable_faults->replay_tracker);
+        status = uvm_tracker_wait_spin(&replayable_faults->replay_tracker);
         if (status != NV_OK)
             return status;
     }
@@ -819,6 +948,47 @@ static bool fetch_fault_buffer_try_merge_entry(uvm_fault_buffer_entry_t *current
     return false;
 }
 
+// Track current_entry, the fault_index-th entry fetched in the batch, in the
+// uTLB and batch state, merging it into a previous entry for the same page when
+// may_filter is set. Returns true if the entry was merged, false if it is the
+// representative of a new coalesced fault.
+static bool fetch_fault_buffer_coalesce_entry(uvm_fault_buffer_entry_t *current_entry,
+                                              uvm_fault_service_batch_context_t *batch_context,
+                                              NvU32 fault_index,
+                                              bool may_filter)
+{
+    bool is_same_instance_ptr = true;
+    uvm_fault_utlb_info_t *current_tlb = &batch_context->utlbs[current_entry->fault_source.utlb_id];
+
+    if (fault_index > 0) {
+        UVM_ASSERT(batch_context->last_fault);
+        is_same_instance_ptr = cmp_fault_instance_ptr(current_entry, batch_context->last_fault) == 0;
+
+        // Coalesce duplicate faults when possible
+        if (may_filter && !current_entry->is_fatal) {
+            bool merged = fetch_fault_buffer_try_merge_entry(current_entry,
+                                                             batch_context,
+                                                             current_tlb,
+                                                             is_same_instance_ptr);
+            if (merged)
+                return true;
+        }
+    }
+
+    if (batch_context->is_single_instance_ptr && !is_same_instance_ptr)
+        batch_context->is_single_instance_ptr = false;
+
+    current_entry->num_instances = 1;
+    current_entry->access_type_mask = uvm_fault_access_type_mask_bit(current_entry->fault_access_type);
+    INIT_LIST_HEAD(&current_entry->merged_instances_list);
+
+    ++current_tlb->num_pending_faults;
+    current_tlb->last_fault = current_entry;
+    batch_context->last_fault = current_entry;
+
+    return false;
+}
+
 // Fetch entries from the fault buffer, decode them and store them in the batch
 // context. We implement the fetch modes described above.
 //
@@ -889,9 +1059,7 @@ static NV_STATUS fetch_fault_buffer_entries(uvm_parent_gpu_t *parent_gpu,
     // Parse until get != put and have enough space to cache.
     while ((get != put) &&
            (fetch_mode == FAULT_FETCH_MODE_ALL || fault_index < parent_gpu->fault_buffer.max_batch_size)) {
-        bool is_same_instance_ptr = true;
         uvm_fault_buffer_entry_t *current_entry = &fault_cache[fault_index];
-        uvm_fault_utlb_info_t *current_tlb;
 
         // We cannot just wait for the last entry (the one pointed by put) to
         // become valid, we have to do it individually since entries can be
@@ -939,37 +1107,9 @@ static NV_STATUS fetch_fault_buffer_entries(uvm_parent_gpu_t *parent_gpu,
             batch_context->max_utlb_id = current_entry->fault_source.utlb_id;
         }
 
-        current_tlb = &batch_context->utlbs[current_entry->fault_source.utlb_id];
-
-        if (fault_index > 0) {
-            UVM_ASSERT(batch_context->last_fault);
-            is_same_instance_ptr = cmp_fault_instance_ptr(current_entry, batch_context->last_fault) == 0;
-
-            // Coalesce duplicate faults when possible
-            if (may_filter && !current_entry->is_fatal) {
-                bool merged = fetch_fault_buffer_try_merge_entry(current_entry,
-                                                                 batch_context,
-                                                                 current_tlb,
-                                                                 is_same_instance_ptr);
-                if (merged)
-                    goto next_fault;
-            }
-        }
-
-        if (batch_context->is_single_instance_ptr && !is_same_instance_ptr)
-            batch_context->is_single_instance_ptr = false;
+        if (!fetch_fault_buffer_coalesce_entry(current_entry, batch_context, fault_index, may_filter))
+            ++num_coalesced_faults;
 
-        current_entry->num_instances = 1;
-        current_entry->access_type_mask = uvm_fault_access_type_mask_bit(current_entry->fault_access_type);
-        INIT_LIST_HEAD(&current_entry->merged_instances_list);
-
-        ++current_tlb->num_pending_faults;
-        current_tlb->last_fault = current_entry;
-        batch_context->last_fault = current_entry;
-
-        ++num_coalesced_faults;
-
-    next_fault:
         ++fault_index;
         ++get;
         if (get == replayable_faults->max_faults)
@@ -1019,8 +1159,253 @@ static int cmp_sort_fault_entry_by_va_space_gpu_address_access_type(const void *
     return cmp_access_type((*a)->fault_access_type, (*b)->fault_access_type);
 }
 
+// Fault batches are ordered with radix bucketing on a 64-bit key per fault.
+// From the least to the most significant bits, the key contains:
+// - the inverse of the access type, so more intrusive accesses come first
+// - the page number of the fault address
+// - the rank of the {VA space, GPU} pair of the fault, in the order defined by
+//   cmp_va_space() and cmp_gpu()
+//
+// This produces the same order as
+// cmp_sort_fault_entry_by_va_space_gpu_address_access_type, which is still
+// used for batches whose faults do not fit in the key.
+#define UVM_FAULT_SORT_ACCESS_TYPE_BITS 3
+#define UVM_FAULT_SORT_PAGE_BITS        45
+#define UVM_FAULT_SORT_GROUP_SHIFT      (UVM_FAULT_SORT_PAGE_BITS + UVM_FAULT_SORT_ACCESS_TYPE_BITS)
+
+static uvm_fault_sort_context_t *fault_sort_context_alloc(NvU32 max_items)
+{
+    uvm_fault_sort_context_t *sort_context = uvm_kvmalloc_zero(sizeof(*sort_context));
+
+    if (!sort_context)
+        return NULL;
+
+    sort_context->max_items = max_items;
+    sort_context->items[0] = uvm_kvmalloc(max_items * sizeof(*sort_context->items[0]));
+    sort_context->items[1] = uvm_kvmalloc(max_items * sizeof(*sort_context->items[1]));
+    if (!sort_context->items[0] || !sort_context->items[1]) {
+        fault_sort_context_free(sort_context);
+        return NULL;
+    }
+
+    return sort_context;
+}
+
+static void fault_sort_context_free(uvm_fault_sort_context_t *sort_context)
+{
+    if (!sort_context)
+        return;
+
+    uvm_kvfree(sort_context->items[0]);
+    uvm_kvfree(sort_context->items[1]);
+    uvm_kvfree(sort_context);
+}
+
+// Stable LSD radix sort of the first num_entries items of
+// sort_context->items[0]. The resulting order is written to fault_entries.
+static void fault_sort_radix(uvm_fault_sort_context_t *sort_context,
+                             uvm_fault_buffer_entry_t **fault_entries,
+                             NvU32 num_entries)
+{
+    const NvU64 digit_mask = (1 << UVM_FAULT_SORT_RADIX_BITS) - 1;
+    uvm_fault_sort_item_t *src = sort_context->items[0];
+    uvm_fault_sort_item_t *dst = sort_context->items[1];
+    NvU64 diff = 0;
+    unsigned shift;
+    NvU32 i;
+
+    // Skip the digits that are the same in all the keys. Faults in a batch are
+    // usually clustered in the VA space, so only a few low digits need a pass.
+    for (i = 1; i < num_entries; ++i)
+        diff |= src[i].key ^ src[0].key;
+
+    for (shift = 0; shift < 64; shift += UVM_FAULT_SORT_RADIX_BITS) {
+        uvm_fault_sort_item_t *tmp;
+        NvU32 sum = 0;
+
+        if (((diff >> shift) & digit_mask) == 0)
+            continue;
+
+        memset(sort_context->counts, 0, sizeof(sort_context->counts));
+
+        for (i = 0; i < num_entries; ++i)
+            ++sort_context->counts[(src[i].key >> shift) & digit_mask];
+
+        for (i = 0; i < ARRAY_SIZE(sort_context->counts); ++i) {
+            NvU32 count = sort_context->counts[i];
+
+            sort_context->counts[i] = sum;
+            sum += count;
+        }
+
+        for (i = 0; i < num_entries; ++i)
+            dst[sort_context->counts[(src[i].key >> shift) & digit_mask]++] = src[i];
+
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    for (i = 0; i < num_entries; ++i)
+        fault_entries[i] = src[i].fault_entry;
+}
+
+// Place the fault entries with the same {instance_ptr, ve_id} pair next to each
+// other, in order of first appearance. Unlike
+// cmp_sort_fault_entry_by_instance_ptr, the pairs are not sorted, which is
+// enough to minimize the number of instance_ptr translations.
+static void group_faults_by_instance_ptr(uvm_fault_sort_context_t *sort_context,
+                                         uvm_fault_buffer_entry_t **fault_entries,
+                                         NvU32 num_entries)
+{
+    uvm_fault_sort_item_t *items = sort_context->items[0];
+    NvU32 num_groups = 0;
+    NvU32 group = 0;
+    NvU32 i;
+
+    UVM_ASSERT(num_entries <= sort_context->max_items);
+
+    for (i = 0; i < num_entries; ++i) {
+        uvm_fault_buffer_entry_t *fault_entry = fault_entries[i];
+
+        if (num_groups == 0 || cmp_fault_instance_ptr(sort_context->instance_ptr_groups[group], fault_entry) != 0) {
+            for (group = 0; group < num_groups; ++group) {
+                if (cmp_fault_instance_ptr(sort_context->instance_ptr_groups[group], fault_entry) == 0)
+                    break;
+            }
+
+            if (group == num_groups) {
+                if (num_groups == UVM_FAULT_SORT_MAX_GROUPS) {
+                    sort(fault_entries,
+                         num_entries,
+                         sizeof(*fault_entries),
+                         cmp_sort_fault_entry_by_instance_ptr,
+                         NULL);
+                    return;
+                }
+
+                sort_context->instance_ptr_groups[num_groups++] = fault_entry;
+            }
+        }
+
+        items[i].key = group;
+        items[i].fault_entry = fault_entry;
+    }
+
+    fault_sort_radix(sort_context, fault_entries, num_entries);
+}
+
+static int cmp_fault_sort_group(uvm_va_space_t *va_space_a,
+                                uvm_gpu_t *gpu_a,
+                                uvm_va_space_t *va_space_b,
+                                uvm_gpu_t *gpu_b)
+{
+    int result = cmp_va_space(va_space_a, va_space_b);
+
+    if (result != 0)
+        return result;
+
+    return cmp_gpu(gpu_a, gpu_b);
+}
+
+// Compute the sort key of all the fault entries. Returns false if the batch
+// contains too many {VA space, GPU} pairs or addresses that do not fit in the
+// key.
+static bool fault_sort_compute_keys(uvm_fault_sort_context_t *sort_context,
+                                    uvm_fault_buffer_entry_t **fault_entries,
+                                    NvU32 num_entries)
+{
+    uvm_fault_sort_item_t *items = sort_context->items[0];
+    const NvU64 low_mask = (1ULL << UVM_FAULT_SORT_GROUP_SHIFT) - 1;
+    NvU32 num_groups = 0;
+    NvU32 group = 0;
+    NvU32 i, j;
+
+    BUILD_BUG_ON(UVM_FAULT_ACCESS_TYPE_COUNT > (1 << UVM_FAULT_SORT_ACCESS_TYPE_BITS));
+    BUILD_BUG_ON(UVM_FAULT_SORT_MAX_GROUPS > (1 << (64 - UVM_FAULT_SORT_GROUP_SHIFT)));
+
+    for (i = 0; i < num_entries; ++i) {
+        uvm_fault_buffer_entry_t *fault_entry = fault_entries[i];
+        NvU64 page_number = fault_entry->fault_address >> PAGE_SHIFT;
+
+        if (page_number >= (1ULL << UVM_FAULT_SORT_PAGE_BITS))
+            return false;
+
+        // Faults are grouped by instance_ptr at this point, so consecutive
+        // entries usually belong to the same {VA space, GPU} pair.
+        if (num_groups == 0 ||
+            sort_context->groups[group].va_space != fault_entry->va_space ||
+            sort_context->groups[group].gpu != fault_entry->gpu) {
+            for (group = 0; group < num_groups; ++group) {
+                if (sort_context->groups[group].va_space == fault_entry->va_space &&
+                    sort_context->groups[group].gpu == fault_entry->gpu)
+                    break;
+            }
+
+            if (group == num_groups) {
+                if (num_groups == UVM_FAULT_SORT_MAX_GROUPS)
+                    return false;
+
+                sort_context->groups[group].va_space = fault_entry->va_space;
+                sort_context->groups[group].gpu = fault_entry->gpu;
+                ++num_groups;
+            }
+        }
+
+        UVM_ASSERT(fault_entry->fault_access_type < UVM_FAULT_ACCESS_TYPE_COUNT);
+
+        items[i].key = ((NvU64)group << UVM_FAULT_SORT_GROUP_SHIFT) |
+                       (page_number << UVM_FAULT_SORT_ACCESS_TYPE_BITS) |
+                       (UVM_FAULT_ACCESS_TYPE_COUNT - 1 - fault_entry->fault_access_type);
+        items[i].fault_entry = fault_entry;
+    }
+
+    if (num_groups == 1)
+        return true;
+
+    // The number of groups is small, so rank them by brute force
+    for (i = 0; i < num_groups; ++i) {
+        sort_context->groups[i].rank = 0;
+        for (j = 0; j < num_groups; ++j) {
+            if (cmp_fault_sort_group(sort_context->groups[j].va_space,
+                                     sort_context->groups[j].gpu,
+                                     sort_context->groups[i].va_space,
+                                     sort_context->groups[i].gpu) < 0)
+                ++sort_context->groups[i].rank;
+        }
+    }
+
+    for (i = 0; i < num_entries; ++i) {
+        group = items[i].key >> UVM_FAULT_SORT_GROUP_SHIFT;
+        items[i].key = (items[i].key & low_mask) | ((NvU64)sort_context->groups[group].rank << UVM_FAULT_SORT_GROUP_SHIFT);
+    }
+
+    return true;
+}
+
+// Sort the fault entries by VA space, GPU ID, fault address and access type.
+// Produces the same order as sorting with
+// cmp_sort_fault_entry_by_va_space_gpu_address_access_type, in linear time.
+static void sort_faults_by_va_space_gpu_address_access_type(uvm_fault_sort_context_t *sort_context,
+                                                           uvm_fault_buffer_entry_t **fault_entries,
+                                                           NvU32 num_entries)
+{
+    UVM_ASSERT(num_entries <= sort_context->max_items);
+
+    if (fault_sort_compute_keys(sort_context, fault_entries, num_entries)) {
+        fault_sort_radix(sort_context, fault_entries, num_entries);
+        return;
+    }
+
+    sort(fault_entries,
+         num_entries,
+         sizeof(*fault_entries),
+         cmp_sort_fault_entry_by_va_space_gpu_address_access_type,
+         NULL);
+}
+
 // Translate all instance pointers to a VA space and GPU instance. Since the
-// buffer is ordered by instance_ptr, we minimize the number of translations.
+// buffer is grouped by instance_ptr, we minimize the number of translations.
 //
 // This function returns NV_WARN_MORE_PROCESSING_REQUIRED if a fault buffer
 // flush occurred and executed successfully, or the error code if it failed.
@@ -1120,17 +1505,20 @@ static NV_STATUS translate_instance_ptrs(uvm_parent_gpu_t *parent_gpu,
 // This function generates an ordered view of the given fault_cache in which
 // faults are sorted by VA space, fault address (aligned to 4K) and access type
 // "intrusiveness". In order to minimize the number of instance_ptr to VA space
-// translations we perform a first sort by instance_ptr.
+// translations we first group the faults by instance_ptr.
 //
 // This function returns NV_WARN_MORE_PROCESSING_REQUIRED if a fault buffer
 // flush occurred during instance_ptr translation and executed successfully, or
 // the error code if it failed. NV_OK otherwise.
 //
 // Current scheme:
-// 1) sort by instance_ptr
+// 1) group by instance_ptr
 // 2) translate all instance_ptrs to VA spaces
 // 3) sort by va_space, GPU ID, fault address (fault_address is page-aligned at
 //    this point) and access type.
+//
+// Both 1) and 3) use radix bucketing, so the cost is linear in the number of
+// faults.
 static NV_STATUS preprocess_fault_batch(uvm_parent_gpu_t *parent_gpu,
                                         uvm_fault_service_batch_context_t *batch_context)
 {
@@ -1152,13 +1540,11 @@ static NV_STATUS preprocess_fault_batch(uvm_parent_gpu_t *parent_gpu,
     }
     UVM_ASSERT(j == batch_context->num_coalesced_faults);
 
-    // 1) if the fault batch contains more than one, sort by instance_ptr
+    // 1) if the fault batch contains more than one, group by instance_ptr
     if (!batch_context->is_single_instance_ptr) {
-        sort(ordered_fault_cache,
-             batch_context->num_coalesced_faults,
-             sizeof(*ordered_fault_cache),
-             cmp_sort_fault_entry_by_instance_ptr,
-             NULL);
+        group_faults_by_instance_ptr(batch_context->sort_context,
+                                     ordered_fault_cache,
+                                     batch_context->num_coalesced_faults);
     }
 
     // 2) translate all instance_ptrs to VA spaces
@@ -1168,11 +1554,9 @@ static NV_STATUS preprocess_fault_batch(uvm_parent_gpu_t *parent_gpu,
 
     // 3) sort by va_space, GPU ID, fault address (GPU already reports
     // 4K-aligned address), and access type.
-    sort(ordered_fault_cache,
-         batch_context->num_coalesced_faults,
-         sizeof(*ordered_fault_cache),
-         cmp_sort_fault_entry_by_va_space_gpu_address_access_type,
-         NULL);
+    sort_faults_by_va_space_gpu_address_access_type(batch_context->sort_context,
+                                                    ordered_fault_cache,
+                                                    batch_context->num_coalesced_faults);
 
     return NV_OK;
 }
@@ -1386,10 +1770,9 @@ static NV_STATUS service_fault_batch_block_locked(uvm_gpu_t *gpu,
     uvm_page_index_t last_page_index;
     NvU32 page_fault_count = 0;
     uvm_range_group_range_iter_t iter;
-    uvm_replayable_fault_buffer_t *replayable_faults = &gpu->parent->fault_buffer.replayable;
     uvm_fault_buffer_entry_t **ordered_fault_cache = batch_context->ordered_fault_cache;
     uvm_fault_buffer_entry_t *first_fault_entry = ordered_fault_cache[first_fault_index];
-    uvm_service_block_context_t *block_context = &replayable_faults->block_service_context;
+    uvm_service_block_context_t *block_context = batch_context->block_service_context;
     uvm_va_space_t *va_space = uvm_va_block_get_va_space(va_block);
     const uvm_va_policy_t *policy;
     NvU64 end;
@@ -1613,8 +1996,7 @@ static NV_STATUS service_fault_batch_block(uvm_gpu_t *gpu,
     NV_STATUS status;
     uvm_va_block_retry_t va_block_retry;
     NV_STATUS tracker_status;
-    uvm_replayable_fault_buffer_t *replayable_faults = &gpu->parent->fault_buffer.replayable;
-    uvm_service_block_context_t *fault_block_context = &replayable_faults->block_service_context;
+    uvm_service_block_context_t *fault_block_context = batch_context->block_service_context;
 
     fault_block_context->operation = UVM_SERVICE_OPERATION_REPLAYABLE_FAULTS;
     fault_block_context->num_retries = 0;
@@ -1956,8 +2338,7 @@ static NV_STATUS service_fault_batch_dispatch(uvm_va_space_t *va_space,
     uvm_va_range_t *va_range_next = NULL;
     uvm_va_block_t *va_block;
     uvm_gpu_t *gpu = gpu_va_space->gpu;
-    uvm_va_block_context_t *va_block_context =
-        gpu->parent->fault_buffer.replayable.block_service_context.block_context;
+    uvm_va_block_context_t *va_block_context = batch_context->block_service_context->block_context;
     uvm_fault_buffer_entry_t *current_entry = batch_context->ordered_fault_cache[fault_index];
     struct mm_struct *mm = va_block_context->mm;
     NvU64 fault_address = current_entry->fault_address;
@@ -2048,8 +2429,7 @@ static NV_STATUS service_fault_batch_for_cancel(uvm_fault_service_batch_context_
     uvm_gpu_va_space_t *gpu_va_space = NULL;
     struct mm_struct *mm;
     uvm_replayable_fault_buffer_t *replayable_faults = &gpu->parent->fault_buffer.replayable;
-    uvm_service_block_context_t *service_context = &gpu->parent->fault_buffer.replayable.block_service_context;
-    uvm_va_block_context_t *va_block_context = service_context->block_context;
+    uvm_va_block_context_t *va_block_context = batch_context->block_service_context->block_context;
 
     UVM_ASSERT(va_space);
     UVM_ASSERT(gpu);
@@ -2078,7 +2458,7 @@ static NV_STATUS service_fault_batch_for_cancel(uvm_fault_service_batch_context_
 
     // Wait for the flush's replay to finish to give the legitimate faults a
     // chance to show up in the buffer again.
-    status = uvm_tracker_wait(&replayable_faults->replay_tracker);
+    status = uvm_tracker_wait_spin(&replayable_faults->replay_tracker);
     if (status != NV_OK)
         goto done;
 
@@ -2156,7 +2536,7 @@ static NV_STATUS service_fault_batch_for_cancel(uvm_fault_service_batch_context_
             ++i;
         }
         else {
-            uvm_ats_fault_invalidate_t *ats_invalidate = &gpu->parent->fault_buffer.replayable.ats_invalidate;
+            uvm_ats_fault_invalidate_t *ats_invalidate = batch_context->ats_context.ats_invalidate;
             NvU32 block_faults;
             const bool hmm_migratable = true;
 
@@ -2237,13 +2617,11 @@ static NV_STATUS service_fault_batch(uvm_parent_gpu_t *parent_gpu,
     NvU32 i;
     uvm_va_space_t *va_space = NULL;
     uvm_gpu_va_space_t *prev_gpu_va_space = NULL;
-    uvm_ats_fault_invalidate_t *ats_invalidate = &parent_gpu->fault_buffer.replayable.ats_invalidate;
+    uvm_ats_fault_invalidate_t *ats_invalidate = batch_context->ats_context.ats_invalidate;
     struct mm_struct *mm = NULL;
     const bool replay_per_va_block = service_mode != FAULT_SERVICE_MODE_CANCEL &&
                                      parent_gpu->fault_buffer.replayable.replay_policy == UVM_PERF_FAULT_REPLAY_POLICY_BLOCK;
-    uvm_service_block_context_t *service_context =
-        &parent_gpu->fault_buffer.replayable.block_service_context;
-    uvm_va_block_context_t *va_block_context = service_context->block_context;
+    uvm_va_block_context_t *va_block_context = batch_context->block_service_context->block_context;
     bool hmm_migratable = true;
 
     UVM_ASSERT(parent_gpu->replayable_faults_supported);
@@ -2376,6 +2754,164 @@ fail:
     return status;
 }
 
+static void service_fault_batch_shard(uvm_fault_service_worker_t *worker)
+{
+    worker->status = service_fault_batch(worker->parent_gpu, FAULT_SERVICE_MODE_REGULAR, &worker->batch_context);
+}
+
+static void service_fault_batch_shard_entry(void *args)
+{
+    uvm_fault_service_worker_t *worker = (uvm_fault_service_worker_t *)args;
+
+    UVM_ENTRY_VOID(service_fault_batch_shard(worker));
+
+    complete(&worker->done);
+}
+
+// Tells if the given consecutive entries of the ordered fault cache can be
+// serviced by different workers. Shards must not split VA blocks, nor the
+// UVM_VA_BLOCK_SIZE-aligned regions in which ATS faults are serviced.
+static bool is_shard_boundary(const uvm_fault_buffer_entry_t *previous_entry,
+                              const uvm_fault_buffer_entry_t *current_entry)
+{
+    return current_entry->va_space != previous_entry->va_space ||
+           current_entry->gpu != previous_entry->gpu ||
+           UVM_VA_BLOCK_ALIGN_DOWN(current_entry->fault_address) !=
+           UVM_VA_BLOCK_ALIGN_DOWN(previous_entry->fault_address);
+}
+
+static void init_shard_batch_context(uvm_fault_service_batch_context_t *shard_context,
+                                     uvm_fault_service_batch_context_t *batch_context,
+                                     NvU32 first_fault_index,
+                                     NvU32 num_faults)
+{
+    shard_context->fault_cache                 = batch_context->fault_cache;
+    shard_context->ordered_fault_cache         = batch_context->ordered_fault_cache + first_fault_index;
+    shard_context->utlbs                       = batch_context->utlbs;
+    shard_context->max_utlb_id                 = batch_context->max_utlb_id;
+    shard_context->num_cached_faults           = num_faults;
+    shard_context->num_coalesced_faults        = num_faults;
+    shard_context->fatal_va_space              = NULL;
+    shard_context->fatal_gpu                   = NULL;
+    shard_context->has_throttled_faults        = false;
+    shard_context->num_invalid_prefetch_faults = 0;
+    shard_context->num_duplicate_faults        = 0;
+    shard_context->num_replays                 = 0;
+    shard_context->batch_id                    = batch_context->batch_id;
+    shard_context->is_single_instance_ptr      = batch_context->is_single_instance_ptr;
+    shard_context->last_fault                  = NULL;
+
+    uvm_tracker_init(&shard_context->tracker);
+}
+
+// Split the ordered view of the fault batch in up to num_workers shards of
+// similar size, and initialize the batch context of the corresponding workers.
+// Returns the number of shards.
+static NvU32 split_fault_batch(uvm_fault_service_batch_context_t *batch_context,
+                               uvm_fault_service_worker_t *workers,
+                               NvU32 num_workers)
+{
+    NvU32 num_faults = batch_context->num_coalesced_faults;
+    NvU32 shard_size = max(DIV_ROUND_UP(num_faults, num_workers), (NvU32)UVM_PERF_FAULT_SERVICE_MIN_FAULTS_PER_SHARD);
+    NvU32 shard_start = 0;
+    NvU32 num_shards = 0;
+    NvU32 i;
+
+    for (i = 1; i <= num_faults; ++i) {
+        if (i < num_faults) {
+            // The last worker takes the rest of the batch
+            if (i - shard_start < shard_size || num_shards == num_workers - 1)
+                continue;
+
+            if (!is_shard_boundary(batch_context->ordered_fault_cache[i - 1], batch_context->ordered_fault_cache[i]))
+                continue;
+        }
+
+        init_shard_batch_context(&workers[num_shards].batch_context, batch_context, shard_start, i - shard_start);
+        ++num_shards;
+        shard_start = i;
+    }
+
+    return num_shards;
+}
+
+// Service the fault batch using the fault service workers, if the batch is
+// large enough to be split in several shards. Each shard is serviced as an
+// independent batch by service_fault_batch(), with its own VA space locking,
+// service block context and tracker. The results of all the shards are then
+// merged back into batch_context, so the caller can handle fatal faults and
+// replays as if the batch had been serviced by a single thread.
+//
+// Shards never share VA blocks, so concurrent shards only contend on the VA
+// space lock in read mode and on the locks protecting VA space-wide state,
+// which must already cope with concurrent CPU faults and with the servicing of
+// faults from different GPUs.
+static NV_STATUS service_fault_batch_sharded(uvm_parent_gpu_t *parent_gpu,
+                                             uvm_fault_service_batch_context_t *batch_context)
+{
+    NV_STATUS status = NV_OK;
+    uvm_replayable_fault_buffer_t *replayable_faults = &parent_gpu->fault_buffer.replayable;
+    uvm_fault_service_worker_t *workers = replayable_faults->service_workers.workers;
+    NvU32 num_shards = 0;
+    NvU32 i;
+
+    // Fault cancellation on GPUs without VA cancel support requires 4k PTEs to
+    // be forced on all VA blocks serviced after the first fatal fault, so it
+    // relies on the batch being serviced in order.
+    if (replayable_faults->service_workers.num_workers > 1 &&
+        replayable_faults->replay_policy != UVM_PERF_FAULT_REPLAY_POLICY_BLOCK &&
+        parent_gpu->fault_cancel_va_supported &&
+        batch_context->num_coalesced_faults >= 2 * UVM_PERF_FAULT_SERVICE_MIN_FAULTS_PER_SHARD) {
+        num_shards = split_fault_batch(batch_context, workers, replayable_faults->service_workers.num_workers);
+    }
+
+    if (num_shards <= 1) {
+        if (num_shards == 1)
+            uvm_tracker_deinit(&workers[0].batch_context.tracker);
+
+        return service_fault_batch(parent_gpu, FAULT_SERVICE_MODE_REGULAR, batch_context);
+    }
+
+    for (i = 1; i < num_shards; ++i) {
+        init_completion(&workers[i].done);
+        nv_kthread_q_schedule_q_item(&workers[i].q, &workers[i].q_item);
+    }
+
+    service_fault_batch_shard(&workers[0]);
+
+    for (i = 1; i < num_shards; ++i)
+        wait_for_completion(&workers[i].done);
+
+    // Merge the results of the shards in batch order, so the VA space targeted
+    // by fault cancellation is the same as with non-sharded servicing.
+    for (i = 0; i < num_shards; ++i) {
+        uvm_fault_service_batch_context_t *shard_context = &workers[i].batch_context;
+        NV_STATUS tracker_status;
+
+        batch_context->num_invalid_prefetch_faults += shard_context->num_invalid_prefetch_faults;
+        batch_context->num_duplicate_faults += shard_context->num_duplicate_faults;
+        batch_context->has_throttled_faults |= shard_context->has_throttled_faults;
+
+        if (!batch_context->fatal_va_space && shard_context->fatal_va_space) {
+            batch_context->fatal_va_space = shard_context->fatal_va_space;
+            batch_context->fatal_gpu = shard_context->fatal_gpu;
+        }
+
+        tracker_status = uvm_tracker_add_tracker_safe(&batch_context->tracker, &shard_context->tracker);
+        uvm_tracker_deinit(&shard_context->tracker);
+
+        if (status == NV_OK)
+            status = workers[i].status;
+
+        if (status == NV_OK)
+            status = tracker_status;
+    }
+
+    ++replayable_faults->stats.num_sharded_batches;
+
+    return status;
+}
+
 // Tells if the given fault entry is the first one in its uTLB
 static bool is_first_fault_in_utlb(uvm_fault_service_batch_context_t *batch_context, NvU32 fault_index)
 {
@@ -2779,7 +3315,7 @@ static NV_STATUS cancel_faults_precise_tlb(uvm_gpu_t *gpu, uvm_fault_service_bat
             break;
 
         // 4) Wait for replay to finish
-        status = uvm_tracker_wait(&replayable_faults->replay_tracker);
+        status = uvm_tracker_wait_spin(&replayable_faults->replay_tracker);
         if (status != NV_OK)
             break;
 
@@ -2855,7 +3391,7 @@ static NV_STATUS cancel_faults_precise_tlb(uvm_gpu_t *gpu, uvm_fault_service_bat
     if (status == NV_OK)
         status = push_replay_on_gpu(gpu, UVM_FAULT_REPLAY_TYPE_START, batch_context);
 
-    tracker_status = uvm_tracker_wait(&batch_context->tracker);
+    tracker_status = uvm_tracker_wait_spin(&batch_context->tracker);
 
     return status == NV_OK? tracker_status: status;
 }
@@ -2903,6 +3439,81 @@ static void enable_disable_prefetch_faults(uvm_parent_gpu_t *parent_gpu,
     }
 }
 
+static bool fault_trace_enabled(uvm_replayable_fault_buffer_t *replayable_faults)
+{
+    return replayable_faults->trace.records != NULL;
+}
+
+static UVM_TEST_FAULT_TRACE_RECORD *fault_trace_add_record(uvm_replayable_fault_buffer_t *replayable_faults,
+                                                           NvU32 type,
+                                                           NvU32 batch_id)
+{
+    UVM_TEST_FAULT_TRACE_RECORD *record;
+
+    if (replayable_faults->trace.num_records == replayable_faults->trace.max_records) {
+        ++replayable_faults->trace.num_dropped;
+        return NULL;
+    }
+
+    record = &replayable_faults->trace.records[(replayable_faults->trace.first_record +
+                                                replayable_faults->trace.num_records) %
+                                               replayable_faults->trace.max_records];
+    ++replayable_faults->trace.num_records;
+    memset(record, 0, sizeof(*record));
+    record->type = type;
+    record->batch_id = batch_id;
+
+    return record;
+}
+
+// Add the batch that has just been fetched to the trace. The returned batch
+// record, if any, is updated as the batch is serviced. It remains valid until
+// the ISR lock is dropped.
+static UVM_TEST_FAULT_TRACE_RECORD *fault_trace_capture_batch(uvm_parent_gpu_t *parent_gpu,
+                                                              uvm_fault_service_batch_context_t *batch_context,
+                                                              NvU64 fetch_start)
+{
+    uvm_replayable_fault_buffer_t *replayable_faults = &parent_gpu->fault_buffer.replayable;
+    UVM_TEST_FAULT_TRACE_RECORD *batch_record;
+    NvU32 i;
+
+    UVM_ASSERT(uvm_sem_is_locked(&parent_gpu->isr.replayable_faults.service_lock));
+
+    batch_record = fault_trace_add_record(replayable_faults,
+                                          UVM_TEST_FAULT_TRACE_RECORD_TYPE_BATCH,
+                                          batch_context->batch_id);
+    if (batch_record) {
+        batch_record->num_cached_faults = batch_context->num_cached_faults;
+        batch_record->num_coalesced_faults = batch_context->num_coalesced_faults;
+        batch_record->fetch_start_ns = fetch_start;
+        batch_record->fetch_ns = NV_GETTIME() - fetch_start;
+    }
+
+    for (i = 0; i < batch_context->num_cached_faults; ++i) {
+        const uvm_fault_buffer_entry_t *fault_entry = &batch_context->fault_cache[i];
+        UVM_TEST_FAULT_TRACE_RECORD *record = fault_trace_add_record(replayable_faults,
+                                                                     UVM_TEST_FAULT_TRACE_RECORD_TYPE_FAULT,
+                                                                     batch_context->batch_id);
+        if (!record)
+            break;
+
+        record->fault_address = fault_entry->fault_address;
+        record->timestamp = fault_entry->timestamp;
+        record->instance_ptr = fault_entry->instance_ptr.address;
+        record->instance_ptr_aperture = fault_entry->instance_ptr.aperture;
+        record->fault_type = fault_entry->fault_type;
+        record->access_type = fault_entry->fault_access_type;
+        record->client_type = fault_entry->fault_source.client_type;
+        record->client_id = fault_entry->fault_source.client_id;
+        record->gpc_id = fault_entry->fault_source.gpc_id;
+        record->utlb_id = fault_entry->fault_source.utlb_id;
+        record->ve_id = fault_entry->fault_source.ve_id;
+        record->mmu_engine_type = fault_entry->fault_source.mmu_engine_type;
+    }
+
+    return batch_record;
+}
+
 void uvm_parent_gpu_service_replayable_faults(uvm_parent_gpu_t *parent_gpu)
 {
     NvU32 num_replays = 0;
@@ -2918,6 +3529,9 @@ void uvm_parent_gpu_service_replayable_faults(uvm_parent_gpu_t *parent_gpu)
 
     // Process all faults in the buffer
     while (1) {
+        UVM_TEST_FAULT_TRACE_RECORD *trace_record = NULL;
+        NvU64 timestamp = 0;
+
         if (num_throttled >= uvm_perf_fault_max_throttle_per_service ||
             num_batches >= uvm_perf_fault_max_batches_per_service) {
             break;
@@ -2930,6 +3544,9 @@ void uvm_parent_gpu_service_replayable_faults(uvm_parent_gpu_t *parent_gpu)
         batch_context->fatal_gpu                   = NULL;
         batch_context->has_throttled_faults        = false;
 
+        if (fault_trace_enabled(replayable_faults))
+            timestamp = NV_GETTIME();
+
         status = fetch_fault_buffer_entries(parent_gpu, batch_context, FAULT_FETCH_MODE_BATCH_READY);
         if (status != NV_OK)
             break;
@@ -2939,6 +3556,11 @@ void uvm_parent_gpu_service_replayable_faults(uvm_parent_gpu_t *parent_gpu)
 
         ++batch_context->batch_id;
 
+        if (fault_trace_enabled(replayable_faults)) {
+            trace_record = fault_trace_capture_batch(parent_gpu, batch_context, timestamp);
+            timestamp = NV_GETTIME();
+        }
+
         status = preprocess_fault_batch(parent_gpu, batch_context);
 
         num_replays += batch_context->num_replays;
@@ -2948,7 +3570,19 @@ void uvm_parent_gpu_service_replayable_faults(uvm_parent_gpu_t *parent_gpu)
         else if (status != NV_OK)
             break;
 
-        status = service_fault_batch(parent_gpu, FAULT_SERVICE_MODE_REGULAR, batch_context);
+        if (trace_record) {
+            NvU64 now = NV_GETTIME();
+
+            trace_record->preprocess_ns = now - timestamp;
+            timestamp = now;
+        }
+
+        status = service_fault_batch_sharded(parent_gpu, batch_context);
+
+        if (trace_record) {
+            trace_record->service_ns = NV_GETTIME() - timestamp;
+            trace_record->num_duplicate_faults = batch_context->num_duplicate_faults;
+        }
 
         // We may have issued replays even if status != NV_OK if
         // UVM_PERF_FAULT_REPLAY_POLICY_BLOCK is being used or the fault buffer
@@ -2969,7 +3603,7 @@ void uvm_parent_gpu_service_replayable_faults(uvm_parent_gpu_t *parent_gpu)
         }
 
         if (batch_context->fatal_va_space) {
-            status = uvm_tracker_wait(&batch_context->tracker);
+            status = uvm_tracker_wait_spin(&batch_context->tracker);
             if (status == NV_OK) {
                 status = cancel_faults_precise(batch_context);
                 if (status == NV_OK) {
@@ -3001,7 +3635,7 @@ void uvm_parent_gpu_service_replayable_faults(uvm_parent_gpu_t *parent_gpu)
             if (status != NV_OK)
                 break;
             ++num_replays;
-            status = uvm_tracker_wait(&replayable_faults->replay_tracker);
+            status = uvm_tracker_wait_spin(&replayable_faults->replay_tracker);
             if (status != NV_OK)
                 break;
         }
@@ -3116,3 +3750,514 @@ NV_STATUS uvm_test_drain_replayable_faults(UVM_TEST_DRAIN_REPLAYABLE_FAULTS_PARA
 
     return status;
 }
+
+#define FAULT_BATCH_SORT_TEST_VA_SPACES 24
+#define FAULT_BATCH_SORT_TEST_GPUS      4
+#define FAULT_BATCH_SORT_TEST_MAX_FAULTS (1 << 16)
+
+static void fault_batch_sort_test_fill(uvm_test_rng_t *rng,
+                                       uvm_fault_buffer_entry_t *fault_entries,
+                                       NvU32 num_entries,
+                                       char *va_spaces,
+                                       uvm_gpu_t *gpus)
+{
+    // Small batches of VA spaces and GPUs keep the number of {VA space, GPU}
+    // pairs under UVM_FAULT_SORT_MAX_GROUPS, larger ones exercise the fallback
+    // paths.
+    NvU32 num_va_spaces = uvm_test_rng_range_32(rng, 1, FAULT_BATCH_SORT_TEST_VA_SPACES);
+    NvU32 num_gpus = uvm_test_rng_range_32(rng, 1, FAULT_BATCH_SORT_TEST_GPUS);
+    NvU64 base = uvm_test_rng_range_64(rng, 0, 1ULL << 47) & ~(UVM_VA_BLOCK_SIZE - 1);
+    bool high_addresses = uvm_test_rng_range_32(rng, 0, 15) == 0;
+    NvU32 i;
+
+    for (i = 0; i < num_entries; ++i) {
+        uvm_fault_buffer_entry_t *fault_entry = &fault_entries[i];
+        NvU32 va_space_index = uvm_test_rng_range_32(rng, 0, num_va_spaces - 1);
+        NvU32 gpu_index = uvm_test_rng_range_32(rng, 0, num_gpus);
+
+        memset(fault_entry, 0, sizeof(*fault_entry));
+
+        // Use the same instance_ptr for all faults from the same {VA space,
+        // GPU} pair, as real fault batches do
+        fault_entry->instance_ptr.address = (va_space_index * (FAULT_BATCH_SORT_TEST_GPUS + 1) + gpu_index) * PAGE_SIZE;
+        fault_entry->instance_ptr.aperture = UVM_APERTURE_VID;
+        fault_entry->fault_source.ve_id = va_space_index % 2;
+        fault_entry->va_space = (uvm_va_space_t *)&va_spaces[va_space_index];
+
+        // Index num_gpus stands for a fault not yet attributed to a GPU
+        fault_entry->gpu = gpu_index < num_gpus ? &gpus[gpu_index] : NULL;
+
+        if (high_addresses)
+            fault_entry->fault_address = uvm_test_rng_64(rng);
+        else
+            fault_entry->fault_address = base + uvm_test_rng_range_64(rng, 0, 4 * UVM_VA_BLOCK_SIZE - 1);
+
+        fault_entry->fault_address &= PAGE_MASK;
+        fault_entry->fault_access_type = uvm_test_rng_range_32(rng, 0, UVM_FAULT_ACCESS_TYPE_COUNT - 1);
+    }
+}
+
+static NV_STATUS fault_batch_sort_test_check(uvm_fault_sort_context_t *sort_context,
+                                             uvm_fault_buffer_entry_t *fault_entries,
+                                             uvm_fault_buffer_entry_t **ordered,
+                                             uvm_fault_buffer_entry_t **reference,
+                                             NvU32 num_entries)
+{
+    NvU32 i, j;
+
+    for (i = 0; i < num_entries; ++i)
+        ordered[i] = &fault_entries[i];
+
+    // The faults with the same instance_ptr must be contiguous after grouping
+    group_faults_by_instance_ptr(sort_context, ordered, num_entries);
+    for (i = 1; i < num_entries; ++i) {
+        if (cmp_fault_instance_ptr(ordered[i - 1], ordered[i]) == 0)
+            continue;
+
+        for (j = i + 1; j < num_entries; ++j)
+            TEST_CHECK_RET(cmp_fault_instance_ptr(ordered[i - 1], ordered[j]) != 0);
+    }
+
+    memcpy(reference, ordered, num_entries * sizeof(*reference));
+
+    sort_faults_by_va_space_gpu_address_access_type(sort_context, ordered, num_entries);
+    sort(reference,
+         num_entries,
+         sizeof(*reference),
+         cmp_sort_fault_entry_by_va_space_gpu_address_access_type,
+         NULL);
+
+    // The order of equal entries is not defined, so compare keys rather than
+    // entries. Checking that all entries are present is enough to make the
+    // output a permutation of the input.
+    for (i = 0; i < num_entries; ++i) {
+        TEST_CHECK_RET(cmp_sort_fault_entry_by_va_space_gpu_address_access_type(&ordered[i], &reference[i]) == 0);
+        TEST_CHECK_RET(ordered[i]->filtered == false);
+        ordered[i]->filtered = true;
+    }
+
+    for (i = 0; i < num_entries; ++i)
+        TEST_CHECK_RET(fault_entries[i].filtered);
+
+    return NV_OK;
+}
+
+NV_STATUS uvm_test_fault_batch_sort(UVM_TEST_FAULT_BATCH_SORT_PARAMS *params, struct file *filp)
+{
+    uvm_fault_sort_context_t *sort_context = NULL;
+    uvm_fault_buffer_entry_t *fault_entries = NULL;
+    uvm_fault_buffer_entry_t **ordered = NULL;
+    uvm_fault_buffer_entry_t **reference = NULL;
+    uvm_gpu_t *gpus = NULL;
+    char va_spaces[FAULT_BATCH_SORT_TEST_VA_SPACES];
+    uvm_test_rng_t rng;
+    NV_STATUS status = NV_OK;
+    NvU32 max_faults = params->max_faults;
+    NvU32 i;
+
+    if (max_faults == 0 || max_faults > FAULT_BATCH_SORT_TEST_MAX_FAULTS)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    uvm_test_rng_init(&rng, params->seed);
+
+    sort_context = fault_sort_context_alloc(max_faults);
+    fault_entries = uvm_kvmalloc(max_faults * sizeof(*fault_entries));
+    ordered = uvm_kvmalloc(max_faults * sizeof(*ordered));
+    reference = uvm_kvmalloc(max_faults * sizeof(*reference));
+    gpus = uvm_kvmalloc_zero(FAULT_BATCH_SORT_TEST_GPUS * sizeof(*gpus));
+    if (!sort_context || !fault_entries || !ordered || !reference || !gpus) {
+        status = NV_ERR_NO_MEMORY;
+        goto done;
+    }
+
+    // Assign the GPU IDs in reverse order, so the GPU order does not match the
+    // order of the pointers
+    for (i = 0; i < FAULT_BATCH_SORT_TEST_GPUS; ++i)
+        gpus[i].id = uvm_gpu_id_from_index(FAULT_BATCH_SORT_TEST_GPUS - 1 - i);
+
+    for (i = 0; i < params->iterations; ++i) {
+        NvU32 num_entries = uvm_test_rng_range_32(&rng, 1, max_faults);
+
+        fault_batch_sort_test_fill(&rng, fault_entries, num_entries, va_spaces, gpus);
+
+        status = fault_batch_sort_test_check(sort_context, fault_entries, ordered, reference, num_entries);
+        if (status != NV_OK)
+            goto done;
+
+        if (fatal_signal_pending(current)) {
+            status = NV_ERR_SIGNAL_PENDING;
+            goto done;
+        }
+    }
+
+done:
+    uvm_kvfree(gpus);
+    uvm_kvfree(reference);
+    uvm_kvfree(ordered);
+    uvm_kvfree(fault_entries);
+    fault_sort_context_free(sort_context);
+
+    return status;
+}
+
+NV_STATUS uvm_test_fault_trace_capture(UVM_TEST_FAULT_TRACE_CAPTURE_PARAMS *params, struct file *filp)
+{
+    uvm_gpu_t *gpu;
+    uvm_replayable_fault_buffer_t *replayable_faults;
+    UVM_TEST_FAULT_TRACE_RECORD *records = NULL;
+    UVM_TEST_FAULT_TRACE_RECORD *old_records;
+    NV_STATUS status = NV_OK;
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+
+    if (params->max_records > UVM_TEST_FAULT_TRACE_MAX_RECORDS)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    gpu = uvm_va_space_retain_gpu_by_uuid(va_space, &params->gpu_uuid);
+    if (!gpu)
+        return NV_ERR_INVALID_DEVICE;
+
+    if (!gpu->parent->replayable_faults_supported) {
+        status = NV_ERR_NOT_SUPPORTED;
+        goto done;
+    }
+
+    if (params->max_records > 0) {
+        records = uvm_kvmalloc(params->max_records * sizeof(*records));
+        if (!records) {
+            status = NV_ERR_NO_MEMORY;
+            goto done;
+        }
+    }
+
+    replayable_faults = &gpu->parent->fault_buffer.replayable;
+
+    uvm_parent_gpu_replayable_faults_isr_lock(gpu->parent);
+
+    old_records = replayable_faults->trace.records;
+    replayable_faults->trace.records = records;
+    replayable_faults->trace.max_records = params->max_records;
+    replayable_faults->trace.first_record = 0;
+    replayable_faults->trace.num_records = 0;
+    replayable_faults->trace.num_dropped = 0;
+
+    uvm_parent_gpu_replayable_faults_isr_unlock(gpu->parent);
+
+    uvm_kvfree(old_records);
+
+done:
+    uvm_gpu_release(gpu);
+
+    return status;
+}
+
+// Number of records moved out of the trace per ISR lock acquisition
+#define FAULT_TRACE_READ_CHUNK 1024
+
+NV_STATUS uvm_test_fault_trace_read(UVM_TEST_FAULT_TRACE_READ_PARAMS *params, struct file *filp)
+{
+    uvm_gpu_t *gpu;
+    uvm_replayable_fault_buffer_t *replayable_faults;
+    UVM_TEST_FAULT_TRACE_RECORD __user *user_records = (UVM_TEST_FAULT_TRACE_RECORD __user *)params->records;
+    UVM_TEST_FAULT_TRACE_RECORD *chunk = NULL;
+    NV_STATUS status = NV_OK;
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+
+    params->num_records = 0;
+    params->num_dropped = 0;
+
+    gpu = uvm_va_space_retain_gpu_by_uuid(va_space, &params->gpu_uuid);
+    if (!gpu)
+        return NV_ERR_INVALID_DEVICE;
+
+    if (!gpu->parent->replayable_faults_supported) {
+        status = NV_ERR_NOT_SUPPORTED;
+        goto done;
+    }
+
+    chunk = uvm_kvmalloc(FAULT_TRACE_READ_CHUNK * sizeof(*chunk));
+    if (!chunk) {
+        status = NV_ERR_NO_MEMORY;
+        goto done;
+    }
+
+    replayable_faults = &gpu->parent->fault_buffer.replayable;
+
+    // The records are copied out of the trace with the ISR lock held, and to
+    // the user buffer with the lock dropped, so that fault servicing is not
+    // blocked on user page faults.
+    while (params->num_records < params->max_records) {
+        NvU32 num_records;
+        NvU32 i;
+
+        uvm_parent_gpu_replayable_faults_isr_lock(gpu->parent);
+
+        if (!fault_trace_enabled(replayable_faults)) {
+            uvm_parent_gpu_replayable_faults_isr_unlock(gpu->parent);
+            status = NV_ERR_INVALID_STATE;
+            break;
+        }
+
+        num_records = min3((NvU32)FAULT_TRACE_READ_CHUNK,
+                           params->max_records - params->num_records,
+                           replayable_faults->trace.num_records);
+
+        for (i = 0; i < num_records; ++i) {
+            chunk[i] = replayable_faults->trace.records[replayable_faults->trace.first_record];
+            replayable_faults->trace.first_record = (replayable_faults->trace.first_record + 1) %
+                                                    replayable_faults->trace.max_records;
+        }
+
+        replayable_faults->trace.num_records -= num_records;
+
+        params->num_dropped += replayable_faults->trace.num_dropped;
+        replayable_faults->trace.num_dropped = 0;
+
+        uvm_parent_gpu_replayable_faults_isr_unlock(gpu->parent);
+
+        if (num_records == 0)
+            break;
+
+        if (copy_to_user(user_records + params->num_records, chunk, num_records * sizeof(*chunk))) {
+            status = NV_ERR_INVALID_ADDRESS;
+            break;
+        }
+
+        params->num_records += num_records;
+    }
+
+done:
+    uvm_kvfree(chunk);
+    uvm_gpu_release(gpu);
+
+    return status;
+}
+
+// uTLB IDs are 16-bit
+#define FAULT_TRACE_REPLAY_MAX_UTLBS (1 << 16)
+
+static NV_STATUS fault_trace_replay_fill_entry(const UVM_TEST_FAULT_TRACE_RECORD *record,
+                                               uvm_fault_buffer_entry_t *fault_entry)
+{
+    if (record->instance_ptr_aperture >= UVM_APERTURE_MAX ||
+        record->fault_type >= UVM_FAULT_TYPE_COUNT ||
+        record->access_type >= UVM_FAULT_ACCESS_TYPE_COUNT ||
+        record->client_type >= UVM_FAULT_CLIENT_TYPE_COUNT ||
+        record->mmu_engine_type >= UVM_MMU_ENGINE_TYPE_COUNT ||
+        record->client_id > NV_U16_MAX ||
+        record->gpc_id > NV_U8_MAX ||
+        record->utlb_id >= FAULT_TRACE_REPLAY_MAX_UTLBS ||
+        record->ve_id > NV_U8_MAX)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    memset(fault_entry, 0, sizeof(*fault_entry));
+
+    fault_entry->fault_address = UVM_PAGE_ALIGN_DOWN(record->fault_address);
+    fault_entry->timestamp = record->timestamp;
+    fault_entry->instance_ptr.address = record->instance_ptr;
+    fault_entry->instance_ptr.aperture = record->instance_ptr_aperture;
+    fault_entry->fault_type = record->fault_type;
+    fault_entry->fault_access_type = record->access_type;
+    fault_entry->fault_source.client_type = record->client_type;
+    fault_entry->fault_source.client_id = record->client_id;
+    fault_entry->fault_source.gpc_id = record->gpc_id;
+    fault_entry->fault_source.utlb_id = record->utlb_id;
+    fault_entry->fault_source.ve_id = record->ve_id;
+    fault_entry->fault_source.mmu_engine_type = record->mmu_engine_type;
+    fault_entry->is_replayable = true;
+    fault_entry->is_fatal = (fault_entry->fault_type >= UVM_FAULT_TYPE_FATAL);
+
+    return NV_OK;
+}
+
+// Run the cached faults of batch_context through the same coalescing and
+// ordering as fetch_fault_buffer_entries() and preprocess_fault_batch(), with
+// instance pointers translated to mock VA spaces taken from va_spaces.
+static NV_STATUS fault_trace_replay_batch(uvm_fault_service_batch_context_t *batch_context,
+                                          char *va_spaces,
+                                          UVM_TEST_FAULT_TRACE_REPLAY_PARAMS *params)
+{
+    uvm_fault_buffer_entry_t *fault_cache = batch_context->fault_cache;
+    uvm_fault_buffer_entry_t **ordered_fault_cache = batch_context->ordered_fault_cache;
+    NvU32 num_coalesced_faults = 0;
+    NvU32 num_va_spaces = 0;
+    NvU32 utlb_id;
+    NvU32 i, j;
+    NvU64 start = NV_GETTIME();
+
+    batch_context->is_single_instance_ptr = true;
+    batch_context->last_fault = NULL;
+
+    for (utlb_id = 0; utlb_id <= batch_context->max_utlb_id; ++utlb_id) {
+        batch_context->utlbs[utlb_id].num_pending_faults = 0;
+        batch_context->utlbs[utlb_id].has_fatal_faults = false;
+    }
+    batch_context->max_utlb_id = 0;
+
+    for (i = 0; i < batch_context->num_cached_faults; ++i) {
+        uvm_fault_buffer_entry_t *current_entry = &fault_cache[i];
+
+        batch_context->max_utlb_id = max(batch_context->max_utlb_id, (NvU32)current_entry->fault_source.utlb_id);
+
+        if (!fetch_fault_buffer_coalesce_entry(current_entry, batch_context, i, uvm_perf_fault_coalesce))
+            ++num_coalesced_faults;
+    }
+
+    batch_context->num_coalesced_faults = num_coalesced_faults;
+
+    for (i = 0, j = 0; i < batch_context->num_cached_faults; ++i) {
+        if (!fault_cache[i].filtered)
+            ordered_fault_cache[j++] = &fault_cache[i];
+    }
+    TEST_CHECK_RET(j == num_coalesced_faults);
+
+    if (!batch_context->is_single_instance_ptr)
+        group_faults_by_instance_ptr(batch_context->sort_context, ordered_fault_cache, num_coalesced_faults);
+
+    // Mock translate_instance_ptrs(): each run of faults with the same
+    // {instance_ptr, ve_id} pair gets its own VA space
+    for (i = 0; i < num_coalesced_faults; ++i) {
+        uvm_fault_buffer_entry_t *current_entry = ordered_fault_cache[i];
+
+        if (i != 0 && cmp_fault_instance_ptr(current_entry, ordered_fault_cache[i - 1]) == 0) {
+            current_entry->va_space = ordered_fault_cache[i - 1]->va_space;
+        }
+        else {
+            // The same pair can't show up in two runs after grouping
+            current_entry->va_space = (uvm_va_space_t *)&va_spaces[num_va_spaces++];
+        }
+
+        current_entry->gpu = NULL;
+    }
+
+    sort_faults_by_va_space_gpu_address_access_type(batch_context->sort_context,
+                                                    ordered_fault_cache,
+                                                    num_coalesced_faults);
+
+    params->preprocess_ns += NV_GETTIME() - start;
+
+    for (i = 0; i < num_coalesced_faults; ++i) {
+        uvm_fault_buffer_entry_t *current_entry = ordered_fault_cache[i];
+        uvm_fault_buffer_entry_t *previous_entry = i > 0 ? ordered_fault_cache[i - 1] : NULL;
+
+        if (previous_entry) {
+            TEST_CHECK_RET(cmp_sort_fault_entry_by_va_space_gpu_address_access_type(&previous_entry,
+                                                                                    &current_entry) <= 0);
+        }
+
+        // Same accounting as update_batch_and_notify_fault()
+        if (check_fault_entry_duplicate(current_entry, previous_entry))
+            params->num_duplicate_faults += current_entry->num_instances;
+        else
+            params->num_duplicate_faults += current_entry->num_instances - 1;
+
+        if (!previous_entry ||
+            previous_entry->va_space != current_entry->va_space ||
+            UVM_VA_BLOCK_ALIGN_DOWN(previous_entry->fault_address) !=
+            UVM_VA_BLOCK_ALIGN_DOWN(current_entry->fault_address))
+            ++params->num_block_groups;
+    }
+
+    ++params->num_batches;
+    params->num_faults += batch_context->num_cached_faults;
+    params->num_coalesced_faults += num_coalesced_faults;
+    params->num_instance_ptr_groups += num_va_spaces;
+
+    return NV_OK;
+}
+
+NV_STATUS uvm_test_fault_trace_replay(UVM_TEST_FAULT_TRACE_REPLAY_PARAMS *params, struct file *filp)
+{
+    const UVM_TEST_FAULT_TRACE_RECORD __user *user_records =
+        (const UVM_TEST_FAULT_TRACE_RECORD __user *)params->records;
+    uvm_fault_service_batch_context_t *batch_context;
+    char *va_spaces = NULL;
+    bool in_batch = false;
+    NV_STATUS status = NV_OK;
+    NvU32 i;
+
+    params->num_batches = 0;
+    params->num_faults = 0;
+    params->num_coalesced_faults = 0;
+    params->num_duplicate_faults = 0;
+    params->num_instance_ptr_groups = 0;
+    params->num_block_groups = 0;
+    params->preprocess_ns = 0;
+
+    batch_context = uvm_kvmalloc_zero(sizeof(*batch_context));
+    if (!batch_context)
+        return NV_ERR_NO_MEMORY;
+
+    batch_context->fault_cache = uvm_kvmalloc(UVM_TEST_FAULT_TRACE_MAX_BATCH_FAULTS *
+                                              sizeof(*batch_context->fault_cache));
+    batch_context->ordered_fault_cache = uvm_kvmalloc(UVM_TEST_FAULT_TRACE_MAX_BATCH_FAULTS *
+                                                      sizeof(*batch_context->ordered_fault_cache));
+    batch_context->utlbs = uvm_kvmalloc_zero(FAULT_TRACE_REPLAY_MAX_UTLBS * sizeof(*batch_context->utlbs));
+    batch_context->sort_context = fault_sort_context_alloc(UVM_TEST_FAULT_TRACE_MAX_BATCH_FAULTS);
+    va_spaces = uvm_kvmalloc(UVM_TEST_FAULT_TRACE_MAX_BATCH_FAULTS);
+    if (!batch_context->fault_cache ||
+        !batch_context->ordered_fault_cache ||
+        !batch_context->utlbs ||
+        !batch_context->sort_context ||
+        !va_spaces) {
+        status = NV_ERR_NO_MEMORY;
+        goto done;
+    }
+
+    for (i = 0; i < params->num_records; ++i) {
+        UVM_TEST_FAULT_TRACE_RECORD record;
+
+        if (copy_from_user(&record, &user_records[i], sizeof(record))) {
+            status = NV_ERR_INVALID_ADDRESS;
+            goto done;
+        }
+
+        if (record.type == UVM_TEST_FAULT_TRACE_RECORD_TYPE_BATCH) {
+            if (batch_context->num_cached_faults > 0) {
+                status = fault_trace_replay_batch(batch_context, va_spaces, params);
+                if (status != NV_OK)
+                    goto done;
+            }
+
+            batch_context->num_cached_faults = 0;
+            in_batch = true;
+        }
+        else if (record.type == UVM_TEST_FAULT_TRACE_RECORD_TYPE_FAULT) {
+            if (!in_batch)
+                continue;
+
+            if (batch_context->num_cached_faults == UVM_TEST_FAULT_TRACE_MAX_BATCH_FAULTS) {
+                status = NV_ERR_INVALID_ARGUMENT;
+                goto done;
+            }
+
+            status = fault_trace_replay_fill_entry(&record,
+                                                   &batch_context->fault_cache[batch_context->num_cached_faults]);
+            if (status != NV_OK)
+                goto done;
+
+            ++batch_context->num_cached_faults;
+        }
+        else {
+            status = NV_ERR_INVALID_ARGUMENT;
+            goto done;
+        }
+
+        if (fatal_signal_pending(current)) {
+            status = NV_ERR_SIGNAL_PENDING;
+            goto done;
+        }
+    }
+
+    if (batch_context->num_cached_faults > 0)
+        status = fault_trace_replay_batch(batch_context, va_spaces, params);
+
+done:
+    uvm_kvfree(va_spaces);
+    fault_sort_context_free(batch_context->sort_context);
+    uvm_kvfree(batch_context->utlbs);
+    uvm_kvfree(batch_context->ordered_fault_cache);
+    uvm_kvfree(batch_context->fault_cache);
+    uvm_kvfree(batch_context);
+
+    return status;
+}
@@ -74,6 +74,15 @@ module_param(uvm_disable_hmm, bool, 0444);
 #include "uvm_va_policy.h"
 #include "uvm_tools.h"
 
+#include <linux/mempolicy.h>
+
+static unsigned uvm_hmm_mempolicy = 1;
+module_param(uvm_hmm_mempolicy, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(uvm_hmm_mempolicy,
+                 "Place CPU pages of HMM migrations and faults according to the "
+                 "memory policy of the VMA or thread (mbind/set_mempolicy), and "
+                 "on the NUMA node of the faulting CPU otherwise. Default: 1.");
+
 // The function nv_PageSwapCache() wraps the check for page swap cache flag in
 // order to support a wide variety of kernel versions.
 // The function PageSwapCache() is removed after 32f51ead3d77 ("mm: remove
@@ -764,8 +773,8 @@ static NV_STATUS hmm_migrate_range(uvm_va_block_t *va_block,
     uvm_for_each_va_policy_in(policy, va_block, start, end, node, region) {
         // Even though UVM_VA_BLOCK_RETRY_LOCKED() may unlock and relock the
         // va_block lock, the policy remains valid because we hold the mmap
-        // lock so munmap can't remove the policy, and the va_space lock so the
-        // policy APIs can't change the policy.
+        // lock so munmap can't remove the policy, and the va_block migrate
+        // lock so the policy APIs can't change the policy.
         status = UVM_VA_BLOCK_RETRY_LOCKED(va_block,
                                            va_block_retry,
                                            uvm_va_block_migrate_locked(va_block,
@@ -1091,7 +1100,10 @@ NV_STATUS uvm_hmm_split_as_needed(uvm_va_space_t *va_space,
     uvm_va_policy_node_t *node;
     NV_STATUS status;
 
-    uvm_assert_rwsem_locked_write(&va_space->lock);
+    // The policy node spanning addr extends past the range locked by the
+    // caller, but splitting it doesn't change the policy of any address and
+    // splits are serialized by the va_block locks.
+    uvm_assert_rwsem_locked(&va_space->lock);
 
     // If there is no HMM va_block or the va_block doesn't span the policy
     // addr, there is no need to split.
@@ -1099,6 +1111,9 @@ NV_STATUS uvm_hmm_split_as_needed(uvm_va_space_t *va_space,
     if (status != NV_OK || va_block->start == addr)
         return NV_OK;
 
+    // Readers which drop the va_block lock while using a policy node hold the
+    // migrate lock, so take it before splitting the node.
+    uvm_hmm_migrate_begin_wait(va_block);
     uvm_mutex_lock(&va_block->lock);
 
     node = uvm_va_policy_node_find(va_block, addr);
@@ -1114,6 +1129,7 @@ NV_STATUS uvm_hmm_split_as_needed(uvm_va_space_t *va_space,
 
 done:
     uvm_mutex_unlock(&va_block->lock);
+    uvm_hmm_migrate_finish(va_block);
     return status;
 }
 
@@ -1173,8 +1189,8 @@ static NV_STATUS hmm_set_preferred_location_locked(uvm_va_block_t *va_block,
 
         // Even though the UVM_VA_BLOCK_RETRY_LOCKED() may unlock and relock
         // the va_block lock, the policy remains valid because we hold the mmap
-        // lock so munmap can't remove the policy, and the va_space lock so the
-        // policy APIs can't change the policy.
+        // lock so munmap can't remove the policy, and the va_block migrate
+        // lock so other policy API calls can't change the policy.
         status = UVM_VA_BLOCK_RETRY_LOCKED(va_block,
                                            NULL,
                                            uvm_va_block_set_preferred_location_locked(va_block,
@@ -1209,14 +1225,18 @@ NV_STATUS uvm_hmm_set_preferred_location(uvm_va_space_t *va_space,
         return NV_ERR_INVALID_ADDRESS;
 
     uvm_assert_mmap_lock_locked(va_space->va_space_mm.mm);
-    uvm_assert_rwsem_locked_write(&va_space->lock);
+    uvm_va_space_assert_policy_locked(va_space, base, last_address);
     UVM_ASSERT(PAGE_ALIGNED(base));
     UVM_ASSERT(PAGE_ALIGNED(last_address + 1));
     UVM_ASSERT(base < last_address);
 
     // Update HMM preferred location policy.
 
-    va_block_context = uvm_va_space_block_context(va_space, va_space->va_space_mm.mm);
+    // The VA space lock may be held in read mode, so the shared VA space block
+    // context can't be used.
+    va_block_context = uvm_va_block_context_alloc(va_space->va_space_mm.mm);
+    if (!va_block_context)
+        return NV_ERR_NO_MEMORY;
 
     for (addr = base; addr < last_address; addr = va_block->end + 1) {
         NvU64 end;
@@ -1227,6 +1247,7 @@ NV_STATUS uvm_hmm_set_preferred_location(uvm_va_space_t *va_space,
 
         end = min(last_address, va_block->end);
 
+        uvm_hmm_migrate_begin_wait(va_block);
         uvm_mutex_lock(&va_block->lock);
 
         status = hmm_set_preferred_location_locked(va_block,
@@ -1238,11 +1259,14 @@ NV_STATUS uvm_hmm_set_preferred_location(uvm_va_space_t *va_space,
                                                    out_tracker);
 
         uvm_mutex_unlock(&va_block->lock);
+        uvm_hmm_migrate_finish(va_block);
 
         if (status != NV_OK)
             break;
     }
 
+    uvm_va_block_context_free(va_block_context);
+
     return status;
 }
 
@@ -1296,14 +1320,18 @@ NV_STATUS uvm_hmm_set_accessed_by(uvm_va_space_t *va_space,
         return NV_ERR_INVALID_ADDRESS;
 
     uvm_assert_mmap_lock_locked(va_space->va_space_mm.mm);
-    uvm_assert_rwsem_locked_write(&va_space->lock);
+    uvm_va_space_assert_policy_locked(va_space, base, last_address);
     UVM_ASSERT(PAGE_ALIGNED(base));
     UVM_ASSERT(PAGE_ALIGNED(last_address + 1));
     UVM_ASSERT(base < last_address);
 
     // Update HMM accessed by policy.
 
-    va_block_context = uvm_va_space_block_context(va_space, va_space->va_space_mm.mm);
+    // The VA space lock may be held in read mode, so the shared VA space block
+    // context can't be used.
+    va_block_context = uvm_va_block_context_alloc(va_space->va_space_mm.mm);
+    if (!va_block_context)
+        return NV_ERR_NO_MEMORY;
 
     for (addr = base; addr < last_address; addr = va_block->end + 1) {
         NvU64 end;
@@ -1314,6 +1342,7 @@ NV_STATUS uvm_hmm_set_accessed_by(uvm_va_space_t *va_space,
 
         end = min(last_address, va_block->end);
 
+        uvm_hmm_migrate_begin_wait(va_block);
         uvm_mutex_lock(&va_block->lock);
 
         status = uvm_va_policy_set_range(va_block,
@@ -1335,11 +1364,14 @@ NV_STATUS uvm_hmm_set_accessed_by(uvm_va_space_t *va_space,
         }
 
         uvm_mutex_unlock(&va_block->lock);
+        uvm_hmm_migrate_finish(va_block);
 
         if (status != NV_OK)
             break;
     }
 
+    uvm_va_block_context_free(va_block_context);
+
     return status;
 }
 
@@ -1898,6 +1930,42 @@ static NV_STATUS gpu_chunk_add(uvm_va_block_t *va_block,
     return NV_OK;
 }
 
+// Accumulates runs of system memory pages migrated into or out of the same
+// NUMA node, so the per-node tools counters are updated once per run.
+typedef struct
+{
+    int nid;
+    NvU64 pages_in;
+    NvU64 pages_out;
+} hmm_numa_migration_count_t;
+
+static void hmm_numa_migration_count_flush(uvm_va_block_t *va_block, hmm_numa_migration_count_t *count)
+{
+    uvm_tools_record_numa_migration(va_block->hmm.va_space, count->nid, count->pages_in, count->pages_out);
+
+    count->nid = NUMA_NO_NODE;
+    count->pages_in = 0;
+    count->pages_out = 0;
+}
+
+static void hmm_numa_migration_count_page(uvm_va_block_t *va_block,
+                                          hmm_numa_migration_count_t *count,
+                                          struct page *page,
+                                          bool in)
+{
+    int nid = page_to_nid(page);
+
+    if (nid != count->nid) {
+        hmm_numa_migration_count_flush(va_block, count);
+        count->nid = nid;
+    }
+
+    if (in)
+        count->pages_in++;
+    else
+        count->pages_out++;
+}
+
 // This is called just before calling migrate_vma_finalize() in order to wait
 // for GPU operations to complete and update the va_block state to match which
 // pages migrated (or not) and therefore which pages will be released by
@@ -1914,6 +1982,7 @@ static NV_STATUS sync_page_and_chunk_state(uvm_va_block_t *va_block,
                                            const uvm_page_mask_t *migrated_pages,
                                            const uvm_page_mask_t *same_devmem_page_mask)
 {
+    hmm_numa_migration_count_t numa_count = { NUMA_NO_NODE, 0, 0 };
     uvm_page_index_t page_index;
     NV_STATUS status;
 
@@ -1935,10 +2004,13 @@ static NV_STATUS sync_page_and_chunk_state(uvm_va_block_t *va_block,
         // TODO: Bug 3660922: Need to handle read duplication at some point.
         src_page = migrate_pfn_to_page(src_pfns[page_index]);
         if (src_page && uvm_page_mask_test(migrated_pages, page_index)) {
-            if (is_device_private_page(src_page))
+            if (is_device_private_page(src_page)) {
                 gpu_chunk_remove(va_block, page_index, src_page);
-            else
+            }
+            else {
+                hmm_numa_migration_count_page(va_block, &numa_count, src_page, false);
                 hmm_va_block_cpu_page_unpopulate(va_block, page_index, src_page);
+            }
         }
 
         dst_page = migrate_pfn_to_page(dst_pfns[page_index]);
@@ -1963,9 +2035,14 @@ static NV_STATUS sync_page_and_chunk_state(uvm_va_block_t *va_block,
                 // Clear pointer to sysmem page that will be released.
                 hmm_va_block_cpu_page_unpopulate(va_block, page_index, dst_page);
             }
+            else {
+                hmm_numa_migration_count_page(va_block, &numa_count, dst_page, true);
+            }
         }
     }
 
+    hmm_numa_migration_count_flush(va_block, &numa_count);
+
     return status;
 }
 
@@ -2013,6 +2090,123 @@ static void clean_up_non_migrating_pages(uvm_va_block_t *va_block,
 
 // CPU page fault handling.
 
+#if defined(NV_MEMPOLICY_HAS_UNIFIED_NODES)
+// Return the node of nodes closest to nid, or the first node of nodes if nid is
+// NUMA_NO_NODE.
+static int hmm_closest_node_in_mask(int nid, const nodemask_t *nodes)
+{
+    int closest_nid = NUMA_NO_NODE;
+    int min_distance = INT_MAX;
+    int candidate;
+
+    if (nid == NUMA_NO_NODE)
+        return first_node(*nodes);
+
+    if (node_isset(nid, *nodes))
+        return nid;
+
+    for_each_node_mask(candidate, *nodes) {
+        int distance = node_distance(nid, candidate);
+
+        if (distance < min_distance) {
+            min_distance = distance;
+            closest_nid = candidate;
+        }
+    }
+
+    return closest_nid;
+}
+#endif
+
+// Return the NUMA node selected for the page at addr by the memory policy of
+// vma or, if the VMA has none, by the memory policy of the current thread.
+// local_nid is the node used by local allocation policies, and it is preferred
+// among the allowed nodes of MPOL_BIND and MPOL_PREFERRED_MANY. MPOL_INTERLEAVE
+// spreads the pages by their offset in the mapping, like the kernel does for
+// VMA policies. NUMA_NO_NODE is returned if no node with memory is selected.
+//
+// The mmap_lock must be held.
+static int hmm_mempolicy_node(struct vm_area_struct *vma, NvU64 addr, int local_nid)
+{
+#if defined(NV_MEMPOLICY_HAS_UNIFIED_NODES)
+    struct mempolicy *policy = vma_policy(vma);
+    nodemask_t nodes;
+
+    uvm_assert_mmap_lock_locked(vma->vm_mm);
+
+    // The thread policy only applies if the migration is done on behalf of a
+    // thread of the process, like CPU faults or UvmMigrate.
+    if (!policy && current->mm == vma->vm_mm)
+        policy = current->mempolicy;
+
+    if (!policy)
+        return local_nid;
+
+    nodes_and(nodes, policy->nodes, node_states[N_MEMORY]);
+    if (nodes_empty(nodes))
+        return local_nid;
+
+    switch (policy->mode) {
+        case MPOL_INTERLEAVE:
+        {
+            NvU64 offset = vma->vm_pgoff + ((addr - vma->vm_start) >> PAGE_SHIFT);
+            unsigned target = do_div(offset, nodes_weight(nodes));
+            int nid = first_node(nodes);
+
+            while (target--)
+                nid = next_node(nid, nodes);
+
+            return nid;
+        }
+
+        case MPOL_PREFERRED:
+            return first_node(nodes);
+
+        case MPOL_BIND:
+#if defined(NV_MPOL_PREFERRED_MANY_PRESENT)
+        case MPOL_PREFERRED_MANY:
+#endif
+#if defined(NV_MEMPOLICY_HAS_HOME_NODE)
+            if (policy->home_node != NUMA_NO_NODE && node_isset(policy->home_node, nodes))
+                return policy->home_node;
+#endif
+            return hmm_closest_node_in_mask(local_nid, &nodes);
+
+        default:
+            return local_nid;
+    }
+#else
+    return local_nid;
+#endif
+}
+
+// Return the NUMA node on which a CPU page should be allocated for the page at
+// page_index, if block_context doesn't specify one, or NUMA_NO_NODE to let
+// the allocation use the defaults. A preferred CPU NUMA node set with the UVM
+// policy API takes precedence over the kernel memory policy.
+static int hmm_cpu_page_nid(uvm_va_block_t *va_block,
+                            uvm_va_block_context_t *block_context,
+                            uvm_page_index_t page_index)
+{
+    struct vm_area_struct *vma = block_context->hmm.vma;
+    NvU64 addr = uvm_va_block_cpu_page_address(va_block, page_index);
+    int local_nid = NUMA_NO_NODE;
+
+    if (!uvm_hmm_mempolicy || !vma || block_context->make_resident.dest_nid != NUMA_NO_NODE)
+        return NUMA_NO_NODE;
+
+    if (uvm_va_policy_get(va_block, addr)->preferred_nid != NUMA_NO_NODE)
+        return NUMA_NO_NODE;
+
+    // CPU faults and explicit migrations run on the thread which needs the
+    // pages. GPU faults are serviced by a kernel thread, which has no useful
+    // locality of its own.
+    if (current->mm == vma->vm_mm)
+        local_nid = numa_mem_id();
+
+    return hmm_mempolicy_node(vma, addr, local_nid);
+}
+
 // Fill in the dst_pfns[page_index] entry with a CPU page.
 // The src_pfns[page_index] page, if present, is page locked.
 static NV_STATUS alloc_page_on_cpu(uvm_va_block_t *va_block,
@@ -2027,14 +2221,25 @@ static NV_STATUS alloc_page_on_cpu(uvm_va_block_t *va_block,
     struct page *dst_page;
     uvm_cpu_chunk_t *chunk;
     uvm_va_block_region_t chunk_region;
+    int requested_nid = NUMA_NO_NODE;
 
     if (!uvm_page_mask_test(&va_block->cpu.allocated, page_index)) {
+        int dest_nid = block_context->make_resident.dest_nid;
+        int policy_nid = hmm_cpu_page_nid(va_block, block_context, page_index);
         NV_STATUS status;
 
         UVM_ASSERT(!uvm_processor_mask_test(&va_block->resident, UVM_ID_CPU) ||
                    !uvm_va_block_cpu_is_page_resident_on(va_block, NUMA_NO_NODE, page_index));
 
+        if (policy_nid != NUMA_NO_NODE)
+            block_context->make_resident.dest_nid = policy_nid;
+
+        requested_nid = block_context->make_resident.dest_nid;
         status = uvm_va_block_populate_page_cpu(va_block, page_index, block_context);
+
+        // The populate clears dest_nid when it falls back to other nodes, and
+        // the policy node only applies to this page.
+        block_context->make_resident.dest_nid = dest_nid;
         if (status != NV_OK)
             return status;
     }
@@ -2059,6 +2264,9 @@ static NV_STATUS alloc_page_on_cpu(uvm_va_block_t *va_block,
     UVM_ASSERT(dst_page != ZERO_PAGE(uvm_va_block_cpu_page_address(va_block, page_index)));
     UVM_ASSERT(!is_device_private_page(dst_page));
 
+    if (requested_nid != NUMA_NO_NODE && page_to_nid(dst_page) != requested_nid)
+        uvm_tools_record_numa_misplaced(va_block->hmm.va_space, requested_nid, 1);
+
     // The source page is usually a device private page but it could be a GPU
     // remote mapped system memory page. It could also be a driver allocated
     // page for GPU-to-GPU staged copies (i.e., not a resident copy and owned
@@ -3852,6 +4060,7 @@ NV_STATUS uvm_hmm_va_range_info(uvm_va_space_t *va_space,
     params->va_range_start = 0;
     params->va_range_end = ULONG_MAX;
     params->read_duplication = UVM_TEST_READ_DUPLICATION_UNSET;
+    params->read_duplication_write_tracking = NV_FALSE;
     memset(&params->preferred_location, 0, sizeof(params->preferred_location));
     params->preferred_cpu_nid = NUMA_NO_NODE;
     params->accessed_by_count = 0;
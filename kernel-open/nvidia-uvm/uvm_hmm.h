@@ -167,7 +167,9 @@ typedef struct
     // Before: [----------- existing ------------]
     // After:  [---- existing ----][---- new ----]
     //                             ^addr
-    // Locking: the va_space must be write locked.
+    // Locking: the va_space must be write locked, or read locked along with
+    // the va_space range lock. The va_block migrate and va_block locks must
+    // not be held.
     NV_STATUS uvm_hmm_split_as_needed(uvm_va_space_t *va_space,
                                       NvU64 addr,
                                       uvm_va_policy_is_split_needed_t split_needed_cb,
@@ -176,7 +178,8 @@ typedef struct
     // Set the preferred location policy for the given range.
     // Note that 'last_address' is inclusive.
     // Locking: the va_space->va_space_mm.mm mmap_lock must be locked
-    // and the va_space lock must be held in write mode.
+    // and the va_space lock must be held in write mode, or in read mode along
+    // with the va_space range lock covering the range.
     NV_STATUS uvm_hmm_set_preferred_location(uvm_va_space_t *va_space,
                                              uvm_processor_id_t preferred_location,
                                              int preferred_cpu_nid,
@@ -187,7 +190,8 @@ typedef struct
     // Set the accessed by policy for the given range. This also tries to
     // map the range. Note that 'last_address' is inclusive.
     // Locking: the va_space->va_space_mm.mm mmap_lock must be locked
-    // and the va_space lock must be held in write mode.
+    // and the va_space lock must be held in write mode, or in read mode along
+    // with the va_space range lock covering the range.
     NV_STATUS uvm_hmm_set_accessed_by(uvm_va_space_t *va_space,
                                       uvm_processor_id_t processor_id,
                                       bool set_bit,
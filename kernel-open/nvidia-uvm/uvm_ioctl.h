@@ -1133,6 +1133,204 @@ typedef struct
     NV_STATUS       rmStatus;                                                  // OUT
 } UVM_DISCARD_PARAMS;
 
+//
+// UvmMigrateBatch
+//
+// Migrate an array of ranges of UvmMigrateBatchRange, each with its own
+// destination, under a single acquisition of the VA space lock. Adjacent
+// ranges with the same destination are migrated as one. The copies of all the
+// ranges are tracked together and, unless UVM_MIGRATE_FLAG_ASYNC is set,
+// waited on once before returning. Semaphore release is not supported.
+//
+// The ranges are migrated in order. On error, numRangesMigrated is the index
+// of the first range which might not have been fully migrated, and the
+// handling of NV_WARN_NOTHING_TO_DO and NV_ERR_MORE_PROCESSING_REQUIRED for
+// pageable memory is the same as for UVM_MIGRATE, with userSpaceStart and
+// userSpaceLength describing the part of that range left to user-space.
+// Nothing is migrated if any of the ranges or destinations is invalid, or if
+// the padding of any range is not 0.
+//
+#define UVM_MIGRATE_BATCH_MAX_RANGES                                  4096
+
+#define UVM_MIGRATE_BATCH                                             UVM_IOCTL_BASE(81)
+typedef struct
+{
+    NvU64           rangesAddress                           NV_ALIGN_BYTES(8); // IN
+    NvU32           numRanges;                                                 // IN
+    NvU32           flags;                                                     // IN
+    NvU32           numRangesMigrated;                                         // OUT
+    NvU64           userSpaceStart                          NV_ALIGN_BYTES(8); // OUT
+    NvU64           userSpaceLength                         NV_ALIGN_BYTES(8); // OUT
+    NV_STATUS       rmStatus;                                                  // OUT
+} UVM_MIGRATE_BATCH_PARAMS;
+
+//
+// UvmSetThrashingPolicy
+//
+// Set the thrashing mitigation policy of the VA space.
+//
+// UVM_THRASHING_POLICY_MODE_DEFAULT restores the parameters from the module
+// configuration, adapted at runtime if the uvm_perf_thrashing_adaptive module
+// parameter is set. UVM_THRASHING_POLICY_MODE_FIXED pins the given parameters
+// and disables the runtime adaptation. In that mode, parameters set to 0 keep
+// the module configuration value, and pinUsec is ignored if the speculative
+// unpinning of pages is disabled in the module configuration. napUsec must be
+// between 1 and 100 times the lapse, like the uvm_perf_thrashing_nap module
+// parameter. All the parameters must be 0 with
+// UVM_THRASHING_POLICY_MODE_DEFAULT.
+//
+// The thrashing tracking state of the VA space is reset and pinned pages are
+// unpinned.
+//
+// Error codes:
+//     NV_ERR_INVALID_ARGUMENT:
+//         mode is not valid, or a parameter is out of range.
+//
+//     NV_ERR_NOT_SUPPORTED:
+//         Thrashing mitigation is disabled in the module configuration.
+//
+#define UVM_THRASHING_POLICY_MODE_DEFAULT                             0
+#define UVM_THRASHING_POLICY_MODE_FIXED                               1
+
+#define UVM_SET_THRASHING_POLICY                                      UVM_IOCTL_BASE(82)
+typedef struct
+{
+    NvU32           mode;                                                      // IN
+    NvU32           threshold;                                                 // IN
+    NvU32           pinThreshold;                                              // IN
+    NvU32           padding;
+    NvU64           lapseUsec                               NV_ALIGN_BYTES(8); // IN
+    NvU64           napUsec                                 NV_ALIGN_BYTES(8); // IN
+    NvU64           pinUsec                                 NV_ALIGN_BYTES(8); // IN
+    NV_STATUS       rmStatus;                                                  // OUT
+} UVM_SET_THRASHING_POLICY_PARAMS;
+
+//
+// UvmMigrateAsyncFence
+//
+// Start migrating [base, base + length) to the destination like UVM_MIGRATE
+// with UVM_MIGRATE_FLAG_ASYNC, and return a fence file descriptor in fenceFd
+// which signals the completion of the migration. This lets user-space overlap
+// other work with the migration, and wait for any number of migrations from a
+// single thread with poll, select or epoll.
+//
+// The fence becomes readable (POLLIN) once the migration is complete and all
+// mappings are updated, and additionally reports POLLERR if the migration
+// failed. Reading sizeof(NV_STATUS) bytes from it returns the status of the
+// migration, blocking until completion unless the file descriptor is in
+// non-blocking mode, in which case the read fails with EAGAIN. The fence must
+// be closed with close() once it is no longer needed. Closing it before
+// completion doesn't cancel the migration.
+//
+// flags accepts the same values as UVM_MIGRATE. UVM_MIGRATE_FLAG_ASYNC is
+// implied. Semaphore release is not supported.
+//
+// If any status other than NV_OK is returned, including NV_WARN_NOTHING_TO_DO
+// and NV_ERR_MORE_PROCESSING_REQUIRED for pageable memory, no fence is created
+// and fenceFd is -1. In that case, the part of the range migrated by the driver
+// is complete when the ioctl returns, and userSpaceStart and userSpaceLength
+// have the same meaning as for UVM_MIGRATE.
+//
+// Error codes:
+//     Same as UVM_MIGRATE, and:
+//
+//     NV_ERR_INSUFFICIENT_RESOURCES:
+//         A new file descriptor could not be allocated.
+//
+#define UVM_MIGRATE_FENCE                                             UVM_IOCTL_BASE(83)
+typedef struct
+{
+    NvU64           base                                    NV_ALIGN_BYTES(8); // IN
+    NvU64           length                                  NV_ALIGN_BYTES(8); // IN
+    NvProcessorUuid destinationUuid;                                           // IN
+    NvU32           flags;                                                     // IN
+    NvS32           cpuNumaNode;                                               // IN
+    NvS32           fenceFd;                                                   // OUT
+    NvU64           userSpaceStart                          NV_ALIGN_BYTES(8); // OUT
+    NvU64           userSpaceLength                         NV_ALIGN_BYTES(8); // OUT
+    NV_STATUS       rmStatus;                                                  // OUT
+} UVM_MIGRATE_FENCE_PARAMS;
+
+//
+// UvmToolsGetNumaMigrationCounters
+//
+// Read the per-NUMA node migration counters of the VA space. Entry i of the
+// table describes NUMA node i:
+//
+// - pagesMigratedIn: pages migrated to the node by HMM or pageable
+//   migrations.
+// - pagesMigratedOut: pages migrated away from the node by the same
+//   migrations.
+// - pagesMisplaced: pages which the requested destination node or the memory
+//   policy of the VMA or thread placed on the node, but which had to be
+//   allocated on another node.
+//
+// On input, count is the number of entries in the table at tablePtr. On
+// output, it is the number of NUMA node IDs in the system. Entries beyond the
+// smaller of the two are not written.
+//
+// Error codes:
+//     NV_ERR_INVALID_ADDRESS:
+//         The table could not be written.
+//
+typedef struct
+{
+    NvU64           pagesMigratedIn                         NV_ALIGN_BYTES(8);
+    NvU64           pagesMigratedOut                        NV_ALIGN_BYTES(8);
+    NvU64           pagesMisplaced                          NV_ALIGN_BYTES(8);
+} UvmToolsNumaMigrationCounters;
+
+#define UVM_TOOLS_GET_NUMA_MIGRATION_COUNTERS                         UVM_IOCTL_BASE(84)
+typedef struct
+{
+    NvU64           tablePtr                                NV_ALIGN_BYTES(8); // IN
+    NvU32           count;                                                     // IN/OUT
+    NV_STATUS       rmStatus;                                                  // OUT
+} UVM_TOOLS_GET_NUMA_MIGRATION_COUNTERS_PARAMS;
+
+//
+// UvmSetReadDuplicationWriteTracking
+//
+// Enable (enable != 0) or disable the write-tracking mode of read duplication
+// for the managed allocations covering [requestedBase, requestedBase + length).
+//
+// By default, a write to a read-duplicated page invalidates all the duplicates
+// and the other processors fault them back one page at a time. With write
+// tracking, the writer still gets exclusive ownership of the page, but each
+// GPU whose duplicate was invalidated re-duplicates all such pages of the
+// same VA block in a single batch on its next read fault to that block. This
+// suits read-mostly data with rare, small updates.
+//
+// The mode only has an effect on ranges with read duplication enabled, see
+// UvmEnableReadDuplication. It is ignored for pageable memory, on which the
+// call succeeds without doing anything.
+//
+// Error codes:
+//     NV_ERR_INVALID_ADDRESS:
+//         The range is not fully covered by managed allocations or pageable
+//         memory, or base and length are not page-aligned.
+//
+//     NV_ERR_NO_MEMORY:
+//         Internal memory allocation failed.
+//
+#define UVM_SET_READ_DUPLICATION_WRITE_TRACKING                       UVM_IOCTL_BASE(85)
+typedef struct
+{
+    NvU64           requestedBase                           NV_ALIGN_BYTES(8); // IN
+    NvU64           length                                  NV_ALIGN_BYTES(8); // IN
+    NvU32           enable;                                                    // IN
+    NV_STATUS       rmStatus;                                                  // OUT
+} UVM_SET_READ_DUPLICATION_WRITE_TRACKING_PARAMS;
+
+//
+// Same as UVM_TOOLS_INIT_EVENT_TRACKER_V2, except that the controlBuffer of a
+// counter tracker holds UVM_TOTAL_COUNTERS_V3 counters instead of
+// UVM_TOTAL_COUNTERS, so that the counters which follow UVM_TOTAL_COUNTERS in
+// UvmCounterName can be enabled.
+//
+#define UVM_TOOLS_INIT_EVENT_TRACKER_V3                               UVM_IOCTL_BASE(86)
+typedef UVM_TOOLS_INIT_EVENT_TRACKER_PARAMS UVM_TOOLS_INIT_EVENT_TRACKER_V3_PARAMS;
+
 //
 // Temporary ioctls which should be removed before UVM 8 release
 // Number backwards from 2047 - highest custom ioctl function number
@@ -46,6 +46,7 @@
 
 #include <linux/jhash.h>
 #include <linux/rwsem.h>
+#include <linux/seqlock.h>
 #include <linux/rbtree.h>
 #include <linux/mm.h>
 #include <asm/barrier.h>
@@ -57,6 +58,8 @@
 #include <linux/radix-tree.h>       /* Linux kernel radix tree          */
 
 #include <linux/file.h>             /* fget()                           */
+#include <linux/anon_inodes.h>      /* anon_inode_getfile()             */
+#include <linux/timex.h>            /* get_cycles()                     */
 
 #include <linux/percpu.h>
 #include <linux/printk.h>
@@ -27,7 +27,7 @@
 
 const char *uvm_lock_order_to_string(uvm_lock_order_t lock_order)
 {
-    BUILD_BUG_ON(UVM_LOCK_ORDER_COUNT != 38);
+    BUILD_BUG_ON(UVM_LOCK_ORDER_COUNT != 40);
 
     switch (lock_order) {
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_INVALID);
@@ -40,12 +40,14 @@ const char *uvm_lock_order_to_string(uvm_lock_order_t lock_order)
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_VA_SPACE_SERIALIZE_WRITERS);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_VA_SPACE_READ_ACQUIRE_WRITE_RELEASE_LOCK);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_VA_SPACE);
+        UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_VA_SPACE_RANGE);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_EXT_RANGE_TREE);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_GPU_SEMAPHORE_POOL);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_RM_API);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_RM_GPUS);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_VA_BLOCK_MIGRATE);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_VA_BLOCK);
+        UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_CPU_CHUNK_POOL);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_CONF_COMPUTING_DMA_BUFFER_POOL);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_CHUNK_MAPPING);
         UVM_ENUM_STRING_CASE(UVM_LOCK_ORDER_PAGE_TREE);
@@ -116,6 +118,14 @@ bool __uvm_record_lock(void *lock, uvm_lock_order_t lock_order, uvm_lock_flags_t
         }
     }
 
+    // The VA space range lock only serializes threads holding the VA space
+    // lock, so it can't be taken on its own.
+    if (lock_order == UVM_LOCK_ORDER_VA_SPACE_RANGE &&
+        !test_bit(UVM_LOCK_ORDER_VA_SPACE, uvm_context->acquired_lock_orders)) {
+        UVM_ERR_PRINT("Acquiring VA space range lock without the VA space lock held\n");
+        correct = false;
+    }
+
     conflicting_order = find_next_bit(uvm_context->acquired_lock_orders, UVM_LOCK_ORDER_COUNT, lock_order);
     if (conflicting_order != UVM_LOCK_ORDER_COUNT) {
         if (trylock) {
@@ -243,7 +243,22 @@
 //      allowed only if the VA space serialize_writers_lock is also taken.
 //
 //      Write mode: Modification of the range state such as mmap and changes to
-//      logical permissions or location preferences. RM calls are never allowed.
+//      logical permissions or location preferences of managed VA ranges. RM
+//      calls are never allowed.
+//
+// - VA space range lock (va_space->range_lock)
+//      Order: UVM_LOCK_ORDER_VA_SPACE_RANGE
+//      Range lock (uvm_range_lock_t) per uvm_va_space
+//
+//      Serializes policy changes on overlapping HMM address ranges, which are
+//      done with the VA space lock held in read mode instead of write mode so
+//      they don't block fault servicing on unrelated ranges. Fault servicing
+//      doesn't take this lock: readers which drop the VA block lock while
+//      depending on the policy hold the VA block migrate lock instead, which
+//      the policy writers take per VA block.
+//
+//      Must be acquired with the VA space lock held, which the lock tracking
+//      enforces.
 //
 // - External Allocation Tree lock
 //      Order: UVM_LOCK_ORDER_EXT_RANGE_TREE
@@ -291,6 +306,17 @@
 //      - GPU memory allocation which can evict memory (would require nesting
 //        block locks)
 //
+// - CPU chunk pool lock (g_cpu_chunk_pool.lock in uvm_pmm_sysmem.c)
+//      Order: UVM_LOCK_ORDER_CPU_CHUNK_POOL
+//      Exclusive lock (mutex)
+//
+//      Protects:
+//      - The lists of preallocated CPU chunks
+//      - The DMA mappings of the chunks in the pool
+//
+//      Taken under the va_block lock when an allocation is satisfied from the
+//      pool, and under the global lock by the pool refill and GPU removal.
+//
 // - GPU DMA Allocation pool lock (gpu->conf_computing.dma_buffer_pool.lock)
 //      Order: UVM_LOCK_ORDER_CONF_COMPUTING_DMA_BUFFER_POOL
 //      Condition: The Confidential Computing feature is enabled
@@ -510,12 +536,14 @@ typedef enum
     UVM_LOCK_ORDER_VA_SPACE_SERIALIZE_WRITERS,
     UVM_LOCK_ORDER_VA_SPACE_READ_ACQUIRE_WRITE_RELEASE_LOCK,
     UVM_LOCK_ORDER_VA_SPACE,
+    UVM_LOCK_ORDER_VA_SPACE_RANGE,
     UVM_LOCK_ORDER_EXT_RANGE_TREE,
     UVM_LOCK_ORDER_GPU_SEMAPHORE_POOL,
     UVM_LOCK_ORDER_RM_API,
     UVM_LOCK_ORDER_RM_GPUS,
     UVM_LOCK_ORDER_VA_BLOCK_MIGRATE,
     UVM_LOCK_ORDER_VA_BLOCK,
+    UVM_LOCK_ORDER_CPU_CHUNK_POOL,
     UVM_LOCK_ORDER_CONF_COMPUTING_DMA_BUFFER_POOL,
     UVM_LOCK_ORDER_CHUNK_MAPPING,
     UVM_LOCK_ORDER_PAGE_TREE,
@@ -1011,6 +1039,17 @@ typedef struct
         down(&_sem->sem);                                  \
     })
 
+// trylock for a semaphore: returns 1 if successful, 0 if not.
+#define uvm_down_trylock(uvm_sem) ({                                                \
+        typeof(uvm_sem) _sem = (uvm_sem);                                           \
+        int locked;                                                                 \
+        uvm_record_lock(_sem, UVM_LOCK_FLAGS_MODE_SHARED | UVM_LOCK_FLAGS_TRYLOCK); \
+        locked = (down_trylock(&_sem->sem) == 0);                                   \
+        if (locked == 0)                                                            \
+            uvm_record_unlock(_sem, UVM_LOCK_FLAGS_MODE_SHARED);                    \
+        locked;                                                                     \
+    })
+
 #define uvm_up(uvm_sem) ({                                   \
         typeof(uvm_sem) _sem = (uvm_sem);                    \
         UVM_ASSERT(uvm_sem_is_locked(_sem));                 \
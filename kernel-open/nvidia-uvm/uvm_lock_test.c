@@ -25,6 +25,9 @@
 #include "uvm_lock.h"
 #include "uvm_global.h"
 #include "uvm_thread_context.h"
+#include "uvm_test_rng.h"
+#include "uvm_kvmalloc.h"
+#include "uvm_va_space.h"
 
 #define UVM_LOCK_ORDER_FIRST  (UVM_LOCK_ORDER_INVALID + 1)
 #define UVM_LOCK_ORDER_SECOND (UVM_LOCK_ORDER_INVALID + 2)
@@ -410,6 +413,22 @@ static NV_STATUS test_try_locking_out_of_order(void)
     return NV_OK;
 }
 
+static NV_STATUS test_locking_va_space_range_without_va_space(void)
+{
+    // The VA space range lock can only be taken with the VA space lock held
+    TEST_CHECK_RET(!fake_lock(UVM_LOCK_ORDER_VA_SPACE_RANGE, UVM_LOCK_FLAGS_MODE_EXCLUSIVE));
+    TEST_CHECK_RET(fake_unlock(UVM_LOCK_ORDER_VA_SPACE_RANGE, UVM_LOCK_FLAGS_MODE_EXCLUSIVE));
+
+    TEST_CHECK_RET(fake_lock(UVM_LOCK_ORDER_VA_SPACE, UVM_LOCK_FLAGS_MODE_SHARED));
+    TEST_CHECK_RET(fake_lock(UVM_LOCK_ORDER_VA_SPACE_RANGE, UVM_LOCK_FLAGS_MODE_EXCLUSIVE));
+    TEST_CHECK_RET(fake_unlock(UVM_LOCK_ORDER_VA_SPACE_RANGE, UVM_LOCK_FLAGS_MODE_EXCLUSIVE));
+    TEST_CHECK_RET(fake_unlock(UVM_LOCK_ORDER_VA_SPACE, UVM_LOCK_FLAGS_MODE_SHARED));
+
+    TEST_CHECK_RET(__uvm_thread_check_all_unlocked());
+
+    return NV_OK;
+}
+
 static NV_STATUS run_all_lock_tests(void)
 {
     // The test needs all locks to be released initially
@@ -435,6 +454,7 @@ static NV_STATUS run_all_lock_tests(void)
     TEST_CHECK_RET(test_downgrading_when_different_instance_held() == NV_OK);
     TEST_CHECK_RET(test_downgrading_when_locked_as_shared() == NV_OK);
     TEST_CHECK_RET(test_try_locking_out_of_order() == NV_OK);
+    TEST_CHECK_RET(test_locking_va_space_range_without_va_space() == NV_OK);
 
     return NV_OK;
 }
@@ -458,3 +478,161 @@ NV_STATUS uvm_test_lock_sanity(UVM_TEST_LOCK_SANITY_PARAMS *params, struct file
 
     return status;
 }
+
+#define RANGE_LOCK_STRESS_PAGES       1024
+#define RANGE_LOCK_STRESS_SPAN_PAGES  128
+#define RANGE_LOCK_STRESS_MAX_THREADS 16
+
+typedef struct
+{
+    uvm_va_space_t *va_space;
+
+    // Per-page value written and checked by the threads while holding the
+    // range lock on the page
+    NvU64 *pages;
+
+    NvU32 iterations;
+} range_lock_stress_t;
+
+typedef struct
+{
+    range_lock_stress_t *stress;
+
+    nv_kthread_q_t q;
+    nv_kthread_q_item_t q_item;
+
+    uvm_test_rng_t rng;
+
+    NvU32 index;
+
+    NV_STATUS status;
+} range_lock_stress_thread_t;
+
+static NvU64 range_lock_stress_addr(NvU32 page_index)
+{
+    return (NvU64)page_index * PAGE_SIZE;
+}
+
+// Lock a random span of pages and stamp it, like a policy update
+static NV_STATUS range_lock_stress_update(range_lock_stress_thread_t *thread, NvU64 stamp)
+{
+    range_lock_stress_t *stress = thread->stress;
+    uvm_range_lock_t *range_lock = &stress->va_space->range_lock;
+    uvm_range_lock_range_t range;
+    NvU32 first = uvm_test_rng_range_32(&thread->rng, 0, RANGE_LOCK_STRESS_PAGES - 1);
+    NvU32 last = min(first + uvm_test_rng_range_32(&thread->rng, 0, RANGE_LOCK_STRESS_SPAN_PAGES),
+                     (NvU32)RANGE_LOCK_STRESS_PAGES - 1);
+    NvU64 start = range_lock_stress_addr(first);
+    NvU64 end = range_lock_stress_addr(last + 1) - 1;
+    NV_STATUS status = NV_OK;
+    NvU32 i;
+
+    uvm_range_lock(range_lock, &range, start, end);
+
+    // No other locked range can overlap the span, so none can cover it along
+    // with the next page either.
+    if (!uvm_range_lock_is_locked(range_lock, start, end) ||
+        !uvm_range_lock_is_locked(range_lock, end, end) ||
+        uvm_range_lock_is_locked(range_lock, start, end + 1)) {
+        status = NV_ERR_INVALID_STATE;
+        goto done;
+    }
+
+    for (i = first; i <= last; i++)
+        WRITE_ONCE(stress->pages[i], stamp);
+
+    schedule();
+
+    for (i = first; i <= last; i++) {
+        if (READ_ONCE(stress->pages[i]) != stamp) {
+            status = NV_ERR_INVALID_STATE;
+            goto done;
+        }
+    }
+
+done:
+    uvm_range_unlock(range_lock, &range);
+
+    return status;
+}
+
+static void range_lock_stress_thread(range_lock_stress_thread_t *thread)
+{
+    range_lock_stress_t *stress = thread->stress;
+    NvU32 i;
+
+    for (i = 0; i < stress->iterations && thread->status == NV_OK; i++) {
+        // Stamps are unique across threads and iterations
+        NvU64 stamp = ((NvU64)(thread->index + 1) << 32) | i;
+
+        uvm_va_space_down_read(stress->va_space);
+        thread->status = range_lock_stress_update(thread, stamp);
+        uvm_va_space_up_read(stress->va_space);
+    }
+}
+
+static void range_lock_stress_thread_entry(void *args)
+{
+    UVM_ENTRY_VOID(range_lock_stress_thread(args));
+}
+
+NV_STATUS uvm_test_range_lock_stress(UVM_TEST_RANGE_LOCK_STRESS_PARAMS *params, struct file *filp)
+{
+    range_lock_stress_t stress;
+    range_lock_stress_thread_t *threads;
+    NvU32 num_threads = params->num_threads;
+    NV_STATUS status = NV_OK;
+    NvU32 started = 0;
+    NvU32 i;
+
+    if (num_threads == 0 || num_threads > RANGE_LOCK_STRESS_MAX_THREADS)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    stress.va_space = uvm_va_space_get(filp);
+    stress.iterations = params->iterations;
+    stress.pages = uvm_kvmalloc_zero(RANGE_LOCK_STRESS_PAGES * sizeof(*stress.pages));
+    if (!stress.pages)
+        return NV_ERR_NO_MEMORY;
+
+    threads = uvm_kvmalloc_zero(num_threads * sizeof(*threads));
+    if (!threads) {
+        status = NV_ERR_NO_MEMORY;
+        goto out;
+    }
+
+    for (i = 0; i < num_threads; i++) {
+        range_lock_stress_thread_t *thread = &threads[i];
+
+        thread->stress = &stress;
+        thread->index = i;
+        uvm_test_rng_init(&thread->rng, params->seed + i);
+        nv_kthread_q_item_init(&thread->q_item, range_lock_stress_thread_entry, thread);
+
+        status = errno_to_nv_status(nv_kthread_q_init(&thread->q, "UVM range lock stress"));
+        if (status != NV_OK)
+            break;
+
+        started++;
+    }
+
+    // Start the threads together so they contend from the first iteration
+    if (status == NV_OK) {
+        for (i = 0; i < num_threads; i++)
+            nv_kthread_q_schedule_q_item(&threads[i].q, &threads[i].q_item);
+    }
+
+    // Stopping the queues flushes the scheduled items
+    for (i = 0; i < started; i++) {
+        nv_kthread_q_stop(&threads[i].q);
+
+        if (status == NV_OK)
+            status = threads[i].status;
+    }
+
+    uvm_kvfree(threads);
+
+out:
+    uvm_kvfree(stress.pages);
+
+    return status;
+}
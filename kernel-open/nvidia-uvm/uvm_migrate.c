@@ -39,6 +39,7 @@
 #include "uvm_hal.h"
 #include "uvm_tools.h"
 #include "uvm_migrate.h"
+#include "uvm_fence.h"
 #include "uvm_migrate_pageable.h"
 #include "uvm_va_space_mm.h"
 #include "nv_speculation_barrier.h"
@@ -875,6 +876,136 @@ void uvm_migrate_exit(void)
     uvm_migrate_pageable_exit();
 }
 
+// Look up and check the destination of a migration of [base, base + length).
+// length may be 0, in which case only the destination itself is checked.
+//
+// LOCKING: The caller must hold the VA space lock.
+static NV_STATUS migrate_get_destination(uvm_va_space_t *va_space,
+                                         const NvProcessorUuid *dest_uuid,
+                                         int cpu_numa_node,
+                                         NvU32 flags,
+                                         NvU64 base,
+                                         NvU64 length,
+                                         uvm_gpu_t **out_dest_gpu)
+{
+    uvm_gpu_t *dest_gpu = NULL;
+
+    uvm_assert_rwsem_locked(&va_space->lock);
+
+    if (!uvm_uuid_is_cpu(dest_uuid)) {
+        if (flags & UVM_MIGRATE_FLAG_NO_GPU_VA_SPACE)
+            dest_gpu = uvm_va_space_get_gpu_by_uuid(va_space, dest_uuid);
+        else
+            dest_gpu = uvm_va_space_get_gpu_by_uuid_with_gpu_va_space(va_space, dest_uuid);
+
+        if (!dest_gpu)
+            return NV_ERR_INVALID_DEVICE;
+
+        if (length > 0 && !uvm_gpu_can_address(dest_gpu, base, length))
+            return NV_ERR_OUT_OF_RANGE;
+    }
+    else {
+        // If cpu_numa_node is not -1, we only check that it is a valid node in
+        // the system, it has memory, and it doesn't correspond to a GPU node.
+        //
+        // For pageable memory, this is fine because alloc_pages_node will clamp
+        // the allocation to cpuset_current_mems_allowed when uvm_migrate
+        //_pageable is called from process context (uvm_migrate) when dst_id is
+        // CPU. UVM bottom half calls uvm_migrate_pageable with CPU dst_id only
+        // when the VMA memory policy is set to dst_node_id and dst_node_id is
+        // not NUMA_NO_NODE.
+        if (cpu_numa_node != -1 &&
+            (!nv_numa_node_has_memory(cpu_numa_node) ||
+             !node_isset(cpu_numa_node, node_possible_map) ||
+             uvm_va_space_find_gpu_with_memory_node_id(va_space, cpu_numa_node)))
+            return NV_ERR_INVALID_ARGUMENT;
+    }
+
+    *out_dest_gpu = dest_gpu;
+
+    return NV_OK;
+}
+
+// Migrate the non-empty range [base, base + length) to dest_gpu, or to the CPU
+// if dest_gpu is NULL, on behalf of the migrate ioctls. See UVM_MIGRATE for
+// the meaning of the user_space_start and user_space_length outputs.
+//
+// LOCKING: The caller must hold the VA space lock, and mmap_lock if mm is not
+// NULL.
+static NV_STATUS migrate_api_range(uvm_va_space_t *va_space,
+                                   struct mm_struct *mm,
+                                   NvU64 base,
+                                   NvU64 length,
+                                   uvm_gpu_t *dest_gpu,
+                                   int cpu_numa_node,
+                                   NvU32 flags,
+                                   uvm_tracker_t *tracker_ptr,
+                                   NvU64 *user_space_start,
+                                   NvU64 *user_space_length,
+                                   uvm_processor_mask_t *gpus_to_check_for_nvlink_errors)
+{
+    uvm_api_range_type_t type;
+    uvm_processor_id_t dest_id = dest_gpu ? dest_gpu->id : UVM_ID_CPU;
+    NV_STATUS status;
+
+    UVM_ASSERT(length > 0);
+
+    // Migration to an integrated GPU is equivalent to migration to that
+    // GPUs nearest NUMA node.
+    if (dest_gpu && dest_gpu->parent->is_integrated_gpu) {
+        dest_id = UVM_ID_CPU;
+        cpu_numa_node = dest_gpu->parent->closest_cpu_numa_node;
+    }
+
+    type = uvm_api_range_type_check(va_space, mm, base, length);
+    if (type == UVM_API_RANGE_TYPE_INVALID)
+        return NV_ERR_INVALID_ADDRESS;
+
+    if (type == UVM_API_RANGE_TYPE_ATS) {
+        uvm_migrate_args_t uvm_migrate_args =
+        {
+            .va_space                           = va_space,
+            .mm                                 = mm,
+            .start                              = base,
+            .length                             = length,
+            .dst_id                             = dest_id,
+            .dst_node_id                        = cpu_numa_node,
+            .populate_permissions               = UVM_POPULATE_PERMISSIONS_INHERIT,
+            .populate_flags                     = UVM_POPULATE_PAGEABLE_FLAG_SKIP_PROT_CHECK,
+            .cause                              = UVM_MAKE_RESIDENT_CAUSE_API_MIGRATE,
+            .skip_mapped                        = false,
+            .populate_on_cpu_alloc_failures     = false,
+            .populate_on_migrate_vma_failures   = true,
+            .user_space_start                   = user_space_start,
+            .user_space_length                  = user_space_length,
+            .gpus_to_check_for_nvlink_errors    = gpus_to_check_for_nvlink_errors,
+            .fail_on_unresolved_sto_errors      = false,
+        };
+
+        if (dest_gpu && dest_gpu->parent->cdmm_enabled) {
+            uvm_migrate_args.dst_id = UVM_ID_CPU;
+            uvm_migrate_args.dst_node_id = dest_gpu->parent->closest_cpu_numa_node;
+            uvm_migrate_args.populate_on_cpu_alloc_failures = true;
+        }
+
+        status = uvm_migrate_pageable(&uvm_migrate_args);
+    }
+    else {
+        status = uvm_migrate(va_space,
+                             mm,
+                             base,
+                             length,
+                             dest_id,
+                             (UVM_ID_IS_CPU(dest_id) ? cpu_numa_node : NUMA_NO_NODE),
+                             flags,
+                             uvm_va_space_iter_managed_first(va_space, base, base),
+                             tracker_ptr,
+                             gpus_to_check_for_nvlink_errors);
+    }
+
+    return status;
+}
+
 NV_STATUS uvm_api_migrate(UVM_MIGRATE_PARAMS *params, struct file *filp)
 {
     uvm_va_space_t *va_space = uvm_va_space_get(filp);
@@ -941,105 +1072,32 @@ NV_STATUS uvm_api_migrate(UVM_MIGRATE_PARAMS *params, struct file *filp)
         }
     }
 
-    if (!uvm_uuid_is_cpu(&params->destinationUuid)) {
-        if (params->flags & UVM_MIGRATE_FLAG_NO_GPU_VA_SPACE)
-            dest_gpu = uvm_va_space_get_gpu_by_uuid(va_space, &params->destinationUuid);
-        else
-            dest_gpu = uvm_va_space_get_gpu_by_uuid_with_gpu_va_space(va_space, &params->destinationUuid);
-
-        if (!dest_gpu) {
-            status = NV_ERR_INVALID_DEVICE;
-            goto done;
-        }
-
-        if (params->length > 0 && !uvm_gpu_can_address(dest_gpu, params->base, params->length)) {
-            status = NV_ERR_OUT_OF_RANGE;
-            goto done;
-        }
-    }
-    else {
-        // If cpu_numa_node is not -1, we only check that it is a valid node in
-        // the system, it has memory, and it doesn't correspond to a GPU node.
-        //
-        // For pageable memory, this is fine because alloc_pages_node will clamp
-        // the allocation to cpuset_current_mems_allowed when uvm_migrate
-        //_pageable is called from process context (uvm_migrate) when dst_id is
-        // CPU. UVM bottom half calls uvm_migrate_pageable with CPU dst_id only
-        // when the VMA memory policy is set to dst_node_id and dst_node_id is
-        // not NUMA_NO_NODE.
-        if (cpu_numa_node != -1 &&
-            (!nv_numa_node_has_memory(cpu_numa_node) ||
-             !node_isset(cpu_numa_node, node_possible_map) ||
-             uvm_va_space_find_gpu_with_memory_node_id(va_space, cpu_numa_node))) {
-            status = NV_ERR_INVALID_ARGUMENT;
-            goto done;
-        }
-    }
-
-    UVM_ASSERT(status == NV_OK);
+    status = migrate_get_destination(va_space,
+                                     &params->destinationUuid,
+                                     cpu_numa_node,
+                                     params->flags,
+                                     params->base,
+                                     params->length,
+                                     &dest_gpu);
+    if (status != NV_OK)
+        goto done;
 
     // If we're synchronous or if we need to release a semaphore, use a tracker.
     if (synchronous || params->semaphoreAddress)
         tracker_ptr = &tracker;
 
     if (params->length > 0) {
-        uvm_api_range_type_t type;
-        uvm_processor_id_t dest_id = dest_gpu ? dest_gpu->id : UVM_ID_CPU;
-
-        // Migration to an integrated GPU is equivalent to migration to that
-        // GPUs nearest NUMA node.
-        if (dest_gpu && dest_gpu->parent->is_integrated_gpu) {
-            dest_id = UVM_ID_CPU;
-            cpu_numa_node = dest_gpu->parent->closest_cpu_numa_node;
-        }
-
-        type = uvm_api_range_type_check(va_space, mm, params->base, params->length);
-        if (type == UVM_API_RANGE_TYPE_INVALID) {
-            status = NV_ERR_INVALID_ADDRESS;
-            goto done;
-        }
-
-        if (type == UVM_API_RANGE_TYPE_ATS) {
-            uvm_migrate_args_t uvm_migrate_args =
-            {
-                .va_space                           = va_space,
-                .mm                                 = mm,
-                .start                              = params->base,
-                .length                             = params->length,
-                .dst_id                             = dest_id,
-                .dst_node_id                        = cpu_numa_node,
-                .populate_permissions               = UVM_POPULATE_PERMISSIONS_INHERIT,
-                .populate_flags                     = UVM_POPULATE_PAGEABLE_FLAG_SKIP_PROT_CHECK,
-                .cause                              = UVM_MAKE_RESIDENT_CAUSE_API_MIGRATE,
-                .skip_mapped                        = false,
-                .populate_on_cpu_alloc_failures     = false,
-                .populate_on_migrate_vma_failures   = true,
-                .user_space_start                   = &params->userSpaceStart,
-                .user_space_length                  = &params->userSpaceLength,
-                .gpus_to_check_for_nvlink_errors    = gpus_to_check_for_nvlink_errors,
-                .fail_on_unresolved_sto_errors      = false,
-            };
-
-            if (dest_gpu && dest_gpu->parent->cdmm_enabled) {
-                uvm_migrate_args.dst_id = UVM_ID_CPU;
-                uvm_migrate_args.dst_node_id = dest_gpu->parent->closest_cpu_numa_node;
-                uvm_migrate_args.populate_on_cpu_alloc_failures = true;
-            }
-
-            status = uvm_migrate_pageable(&uvm_migrate_args);
-        }
-        else {
-            status = uvm_migrate(va_space,
-                                 mm,
-                                 params->base,
-                                 params->length,
-                                 dest_id,
-                                 (UVM_ID_IS_CPU(dest_id) ? cpu_numa_node : NUMA_NO_NODE),
-                                 params->flags,
-                                 uvm_va_space_iter_managed_first(va_space, params->base, params->base),
-                                 tracker_ptr,
-                                 gpus_to_check_for_nvlink_errors);
-        }
+        status = migrate_api_range(va_space,
+                                   mm,
+                                   params->base,
+                                   params->length,
+                                   dest_gpu,
+                                   cpu_numa_node,
+                                   params->flags,
+                                   tracker_ptr,
+                                   &params->userSpaceStart,
+                                   &params->userSpaceLength,
+                                   gpus_to_check_for_nvlink_errors);
     }
 
 done:
@@ -1100,6 +1158,289 @@ done:
     return status;
 }
 
+NV_STATUS uvm_api_migrate_fence(UVM_MIGRATE_FENCE_PARAMS *params, struct file *filp, struct file **fence_file_out)
+{
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+    uvm_tracker_t tracker = UVM_TRACKER_INIT();
+    uvm_gpu_t *dest_gpu = NULL;
+    struct mm_struct *mm;
+    NV_STATUS status;
+    int cpu_numa_node = (int)params->cpuNumaNode;
+    uvm_processor_mask_t *gpus_to_check_for_nvlink_errors = NULL;
+
+    params->fenceFd = -1;
+    *fence_file_out = NULL;
+
+    if (uvm_api_range_invalid(params->base, params->length))
+        return NV_ERR_INVALID_ADDRESS;
+
+    if (params->flags & ~UVM_MIGRATE_FLAGS_ALL)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    if ((params->flags & UVM_MIGRATE_FLAGS_TEST_ALL) && !uvm_enable_builtin_tests) {
+        UVM_INFO_PRINT("Test flag set for UVM_MIGRATE_FENCE. Did you mean to insmod with uvm_enable_builtin_tests=1?\n");
+        return NV_ERR_INVALID_ARGUMENT;
+    }
+
+    gpus_to_check_for_nvlink_errors = uvm_processor_mask_cache_alloc();
+    if (!gpus_to_check_for_nvlink_errors)
+        return NV_ERR_NO_MEMORY;
+
+    uvm_processor_mask_zero(gpus_to_check_for_nvlink_errors);
+
+    // mmap_lock will be needed if we have to create CPU mappings
+    mm = uvm_va_space_mm_or_current_retain_lock(va_space);
+    uvm_va_space_down_read(va_space);
+
+    status = migrate_get_destination(va_space,
+                                     &params->destinationUuid,
+                                     cpu_numa_node,
+                                     params->flags,
+                                     params->base,
+                                     params->length,
+                                     &dest_gpu);
+    if (status == NV_OK) {
+        status = migrate_api_range(va_space,
+                                   mm,
+                                   params->base,
+                                   params->length,
+                                   dest_gpu,
+                                   cpu_numa_node,
+                                   params->flags | UVM_MIGRATE_FLAG_ASYNC,
+                                   &tracker,
+                                   &params->userSpaceStart,
+                                   &params->userSpaceLength,
+                                   gpus_to_check_for_nvlink_errors);
+    }
+
+    if (mm)
+        uvm_up_read_mmap_lock_out_of_order(mm);
+
+    // The fence takes its own references on the GPUs, and performs the NVLINK
+    // error check on completion. The VA space lock must still be held for it
+    // to retain the GPUs in the tracker.
+    if (status == NV_OK) {
+        int fd;
+
+        status = uvm_fence_create_file(&tracker, gpus_to_check_for_nvlink_errors, &fd, fence_file_out);
+        if (status == NV_OK)
+            params->fenceFd = fd;
+    }
+
+    // Without a fence, wait for the partial migration before returning the
+    // error, same as UVM_MIGRATE.
+    if (status != NV_OK)
+        uvm_tracker_wait(&tracker);
+
+    uvm_tracker_deinit(&tracker);
+
+    uvm_va_space_up_read(va_space);
+    uvm_va_space_mm_or_current_release(va_space, mm);
+
+    if (status != NV_OK)
+        uvm_tools_flush_events();
+
+    uvm_processor_mask_cache_free(gpus_to_check_for_nvlink_errors);
+
+    return status;
+}
+
+// Run of adjacent ranges of a UVM_MIGRATE_BATCH call with the same
+// destination, migrated as a single range
+typedef struct
+{
+    NvU64 base;
+    NvU64 length;
+    uvm_gpu_t *dest_gpu;
+    int cpu_numa_node;
+
+    // Index of the first range of the run in the ioctl's array
+    NvU32 first_range;
+} migrate_batch_run_t;
+
+static bool migrate_batch_range_extends_run(const UvmMigrateBatchRange *range,
+                                            const migrate_batch_run_t *run,
+                                            const UvmMigrateBatchRange *run_first_range)
+{
+    return run->base + run->length == range->base &&
+           run_first_range->cpuNumaNode == range->cpuNumaNode &&
+           uvm_uuid_eq(&run_first_range->destinationUuid, &range->destinationUuid);
+}
+
+NV_STATUS uvm_api_migrate_batch(UVM_MIGRATE_BATCH_PARAMS *params, struct file *filp)
+{
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+    uvm_tracker_t tracker = UVM_TRACKER_INIT();
+    uvm_tracker_t *tracker_ptr = NULL;
+    UvmMigrateBatchRange *ranges = NULL;
+    migrate_batch_run_t *runs = NULL;
+    NvU32 num_runs = 0;
+    struct mm_struct *mm;
+    NV_STATUS status = NV_OK;
+    const bool synchronous = !(params->flags & UVM_MIGRATE_FLAG_ASYNC);
+    uvm_processor_mask_t *gpus_to_check_for_nvlink_errors = NULL;
+    uvm_processor_mask_t *run_gpus_to_check_for_nvlink_errors = NULL;
+    NvU32 i;
+
+    params->numRangesMigrated = 0;
+    params->userSpaceStart = 0;
+    params->userSpaceLength = 0;
+
+    if (params->numRanges == 0 || params->numRanges > UVM_MIGRATE_BATCH_MAX_RANGES)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    if (params->flags & ~UVM_MIGRATE_FLAGS_ALL)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    if ((params->flags & UVM_MIGRATE_FLAGS_TEST_ALL) && !uvm_enable_builtin_tests) {
+        UVM_INFO_PRINT("Test flag set for UVM_MIGRATE_BATCH. Did you mean to insmod with uvm_enable_builtin_tests=1?\n");
+        return NV_ERR_INVALID_ARGUMENT;
+    }
+
+    ranges = uvm_kvmalloc(sizeof(*ranges) * params->numRanges);
+    runs = uvm_kvmalloc(sizeof(*runs) * params->numRanges);
+    gpus_to_check_for_nvlink_errors = uvm_processor_mask_cache_alloc();
+    run_gpus_to_check_for_nvlink_errors = uvm_processor_mask_cache_alloc();
+    if (!ranges || !runs || !gpus_to_check_for_nvlink_errors || !run_gpus_to_check_for_nvlink_errors) {
+        status = NV_ERR_NO_MEMORY;
+        goto out_free;
+    }
+
+    if (copy_from_user(ranges,
+                       (const void __user *)(uintptr_t)params->rangesAddress,
+                       sizeof(*ranges) * params->numRanges)) {
+        status = NV_ERR_INVALID_ADDRESS;
+        goto out_free;
+    }
+
+    // Coalesce adjacent ranges going to the same destination, so that VA
+    // blocks shared by consecutive ranges are only locked and copied once.
+    for (i = 0; i < params->numRanges; i++) {
+        const UvmMigrateBatchRange *range = &ranges[i];
+        migrate_batch_run_t *run = num_runs > 0 ? &runs[num_runs - 1] : NULL;
+
+        if (uvm_api_range_invalid(range->base, range->length)) {
+            status = NV_ERR_INVALID_ADDRESS;
+            goto out_free;
+        }
+
+        if (range->padding != 0) {
+            status = NV_ERR_INVALID_ARGUMENT;
+            goto out_free;
+        }
+
+        if (run && migrate_batch_range_extends_run(range, run, &ranges[run->first_range])) {
+            run->length += range->length;
+            continue;
+        }
+
+        run = &runs[num_runs++];
+        run->base = range->base;
+        run->length = range->length;
+        run->dest_gpu = NULL;
+        run->cpu_numa_node = (int)range->cpuNumaNode;
+        run->first_range = i;
+    }
+
+    uvm_processor_mask_zero(gpus_to_check_for_nvlink_errors);
+
+    // mmap_lock will be needed if we have to create CPU mappings
+    mm = uvm_va_space_mm_or_current_retain_lock(va_space);
+    uvm_va_space_down_read(va_space);
+
+    // Check all the ranges and destinations before migrating anything.
+    // Migrations don't change the VA ranges or VMAs, so the ranges stay valid
+    // while the earlier runs are migrated.
+    for (i = 0; i < num_runs; i++) {
+        migrate_batch_run_t *run = &runs[i];
+
+        if (uvm_api_range_type_check(va_space, mm, run->base, run->length) == UVM_API_RANGE_TYPE_INVALID) {
+            status = NV_ERR_INVALID_ADDRESS;
+            goto done;
+        }
+
+        status = migrate_get_destination(va_space,
+                                         &ranges[run->first_range].destinationUuid,
+                                         run->cpu_numa_node,
+                                         params->flags,
+                                         run->base,
+                                         run->length,
+                                         &run->dest_gpu);
+        if (status != NV_OK)
+            goto done;
+    }
+
+    // All the runs share a single tracker, so copies to different
+    // destinations overlap and are waited on once at the end.
+    if (synchronous)
+        tracker_ptr = &tracker;
+
+    for (i = 0; i < num_runs; i++) {
+        migrate_batch_run_t *run = &runs[i];
+
+        uvm_processor_mask_zero(run_gpus_to_check_for_nvlink_errors);
+
+        status = migrate_api_range(va_space,
+                                   mm,
+                                   run->base,
+                                   run->length,
+                                   run->dest_gpu,
+                                   run->cpu_numa_node,
+                                   params->flags,
+                                   tracker_ptr,
+                                   &params->userSpaceStart,
+                                   &params->userSpaceLength,
+                                   run_gpus_to_check_for_nvlink_errors);
+
+        uvm_processor_mask_or(gpus_to_check_for_nvlink_errors,
+                              gpus_to_check_for_nvlink_errors,
+                              run_gpus_to_check_for_nvlink_errors);
+
+        // Stop at the first run which couldn't be fully migrated. User-space
+        // can resume the batch from the first range of the run.
+        if (status != NV_OK)
+            break;
+
+        params->numRangesMigrated = (i + 1 < num_runs) ? runs[i + 1].first_range : params->numRanges;
+    }
+
+done:
+    uvm_global_gpu_retain(gpus_to_check_for_nvlink_errors);
+
+    // We only need to hold mmap_lock to create new CPU mappings, so drop it if
+    // we need to wait for the tracker to finish.
+    if (mm)
+        uvm_up_read_mmap_lock_out_of_order(mm);
+
+    if (tracker_ptr) {
+        NV_STATUS tracker_status = uvm_tracker_wait_deinit(tracker_ptr);
+
+        // Only clobber status if we didn't hit an earlier error
+        if (status == NV_OK)
+            status = tracker_status;
+    }
+
+    uvm_va_space_up_read(va_space);
+    uvm_va_space_mm_or_current_release(va_space, mm);
+
+    // Check for STO errors in case there was no other error until now.
+    if (status == NV_OK && !uvm_processor_mask_empty(gpus_to_check_for_nvlink_errors))
+        status = uvm_global_gpu_check_nvlink_error(gpus_to_check_for_nvlink_errors);
+
+    uvm_global_gpu_release(gpus_to_check_for_nvlink_errors);
+
+    if (synchronous)
+        uvm_tools_flush_events();
+
+out_free:
+    uvm_processor_mask_cache_free(run_gpus_to_check_for_nvlink_errors);
+    uvm_processor_mask_cache_free(gpus_to_check_for_nvlink_errors);
+    uvm_kvfree(runs);
+    uvm_kvfree(ranges);
+
+    return status;
+}
+
 NV_STATUS uvm_api_migrate_range_group(UVM_MIGRATE_RANGE_GROUP_PARAMS *params, struct file *filp)
 {
     NV_STATUS status = NV_OK;
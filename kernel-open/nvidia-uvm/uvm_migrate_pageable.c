@@ -1080,9 +1080,32 @@ static void uvm_migrate_vma_alloc_and_copy_helper(struct vm_area_struct *vma,
 
 static void uvm_migrate_vma_finalize_and_map(struct migrate_vma *args, migrate_vma_state_t *state)
 {
+    uvm_migrate_args_t *uvm_migrate_args = state->uvm_migrate_args;
+    uvm_va_space_t *va_space = uvm_migrate_args->va_space;
+    NvU64 pages_in = 0;
+    NvU64 pages_out = 0;
+    int src_nid = NUMA_NO_NODE;
     unsigned long i;
 
     for (i = 0; i < state->num_pages; i++) {
+        // Account the migrated pages in the per-node counters. Runs of source
+        // pages from the same node are recorded at once.
+        if (args->src[i] & MIGRATE_PFN_MIGRATE) {
+            struct page *src_page = migrate_pfn_to_page(args->src[i]);
+
+            pages_in++;
+
+            if (src_page) {
+                if (page_to_nid(src_page) != src_nid) {
+                    uvm_tools_record_numa_migration(va_space, src_nid, 0, pages_out);
+                    src_nid = page_to_nid(src_page);
+                    pages_out = 0;
+                }
+
+                pages_out++;
+            }
+        }
+
         // There are two reasons a page might not have been migrated.
         //
         // 1. Page is already resident at the destination.
@@ -1109,6 +1132,9 @@ static void uvm_migrate_vma_finalize_and_map(struct migrate_vma *args, migrate_v
             __set_bit(i, state->populate_pages_mask.page_mask);
     }
 
+    uvm_tools_record_numa_migration(va_space, src_nid, 0, pages_out);
+    uvm_tools_record_numa_migration(va_space, uvm_migrate_args->dst_node_id, pages_in, 0);
+
     UVM_ASSERT(!bitmap_intersects(state->populate_pages_mask.page_mask,
                                   state->allocation_failed_mask.page_mask,
                                   state->num_pages));
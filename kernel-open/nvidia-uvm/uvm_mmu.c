@@ -74,8 +74,27 @@ module_param(uvm_page_table_location, charp, S_IRUGO);
 MODULE_PARM_DESC(uvm_page_table_location,
                 "Set the location for UVM-allocated page tables. Choices are: vid, sys.");
 
+#define UVM_PAGE_TABLE_POOL_DEPTH_DEFAULT 16
+#define UVM_PAGE_TABLE_POOL_DEPTH_MAX     512
+
+// Maximum number of allocations added to a pool by a single refill
+#define UVM_PAGE_TABLE_POOL_REFILL_BATCH  32
+
+static unsigned uvm_page_table_pool_depth = UVM_PAGE_TABLE_POOL_DEPTH_DEFAULT;
+module_param(uvm_page_table_pool_depth, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_page_table_pool_depth,
+                "Number of pre-zeroed vidmem page table allocations of each size kept by each GPU VA space. "
+                "0 disables the pool.");
+
 NV_STATUS uvm_mmu_init(void)
 {
+    if (uvm_page_table_pool_depth > UVM_PAGE_TABLE_POOL_DEPTH_MAX) {
+        UVM_INFO_PRINT("Invalid uvm_page_table_pool_depth %u. Using %u instead.\n",
+                       uvm_page_table_pool_depth,
+                       UVM_PAGE_TABLE_POOL_DEPTH_MAX);
+        uvm_page_table_pool_depth = UVM_PAGE_TABLE_POOL_DEPTH_MAX;
+    }
+
     UVM_ASSERT((page_table_aperture == UVM_APERTURE_VID) ||
                (page_table_aperture == UVM_APERTURE_SYS) ||
                (page_table_aperture == UVM_APERTURE_DEFAULT));
@@ -489,8 +508,12 @@ static void phys_mem_init(uvm_page_tree_t *tree, NvU64 page_size, uvm_page_direc
             *clear_bits = 0;
         }
 
-        // Initialize the memory to a reasonable value.
-        if (push) {
+        // Initialize the memory to a reasonable value, unless it is already
+        // zero-filled.
+        if (dir->zeroed && *clear_bits == 0) {
+            // Nothing to do
+        }
+        else if (push) {
             tree->gpu->parent->ce_hal->memset_8(push,
                                                 uvm_mmu_gpu_address(tree->gpu, dir->phys_alloc.addr),
                                                 *clear_bits,
@@ -508,12 +531,76 @@ static void phys_mem_init(uvm_page_tree_t *tree, NvU64 page_size, uvm_page_direc
         pde_fill(tree, dir, 0, entries_count, phys_allocs, push);
     }
 
+    dir->zeroed = false;
+}
+
+static bool page_tree_pool_enabled(uvm_page_tree_t *tree)
+{
+    return tree->pool.depth > 0 && !uvm_mmu_use_cpu(tree);
 }
 
+// Return the pool for allocations of the given size, claiming an unused pool
+// if there is none yet. Returns NULL if all the pools are used by other sizes.
+static uvm_page_tree_pool_t *page_tree_pool_get(uvm_page_tree_t *tree, NvLength size)
+{
+    uvm_page_tree_pool_t *unused = NULL;
+    NvU32 i;
+
+    uvm_assert_mutex_locked(&tree->lock);
+
+    for (i = 0; i < ARRAY_SIZE(tree->pool.pools); i++) {
+        uvm_page_tree_pool_t *pool = &tree->pool.pools[i];
+
+        if (pool->size == size)
+            return pool;
+
+        if (pool->size == 0 && !unused)
+            unused = pool;
+    }
+
+    if (unused)
+        unused->size = size;
+
+    return unused;
+}
+
+// Take a zero-filled allocation from the pool. Pools are registered on their
+// first miss, and refilled by page_tree_pool_refill().
+//
+// The allocation can only be used by pushes acquiring the tree tracker, which
+// orders them after the pending memset of the allocation.
+static bool page_tree_pool_alloc(uvm_page_tree_t *tree, NvLength size, uvm_mmu_page_table_alloc_t *out)
+{
+    uvm_page_tree_pool_t *pool;
+    bool allocated = false;
+
+    if (!page_tree_pool_enabled(tree))
+        return false;
+
+    uvm_mutex_lock(&tree->lock);
+
+    pool = page_tree_pool_get(tree, size);
+    if (pool && pool->count > 0) {
+        memset(out, 0, sizeof(*out));
+        out->handle.chunk = pool->chunks[--pool->count];
+        out->addr = uvm_gpu_phys_address(UVM_APERTURE_VID, out->handle.chunk->address);
+        out->size = size;
+        allocated = true;
+    }
+
+    uvm_mutex_unlock(&tree->lock);
+
+    return allocated;
+}
+
+// If from_pool is true, the directory may be taken zero-filled from the page
+// tree pool, in which case it can only be initialized by pushes acquiring the
+// tree tracker.
 static uvm_page_directory_t *allocate_directory(uvm_page_tree_t *tree,
                                                 NvU64 page_size,
                                                 NvU32 depth,
-                                                uvm_pmm_alloc_flags_t pmm_flags)
+                                                uvm_pmm_alloc_flags_t pmm_flags,
+                                                bool from_pool)
 {
     NV_STATUS status;
     uvm_mmu_mode_hal_t *hal = tree->hal;
@@ -534,6 +621,13 @@ static uvm_page_directory_t *allocate_directory(uvm_page_tree_t *tree,
     if (dir == NULL)
         return NULL;
 
+    dir->depth = depth;
+
+    if (from_pool && page_tree_pool_alloc(tree, phys_alloc_size, &dir->phys_alloc)) {
+        dir->zeroed = true;
+        return dir;
+    }
+
     status = phys_mem_allocate(tree, phys_alloc_size, tree->location, pmm_flags, &dir->phys_alloc);
 
     // Fall back to sysmem if allocating page tables in vidmem with eviction
@@ -549,7 +643,6 @@ static uvm_page_directory_t *allocate_directory(uvm_page_tree_t *tree,
         uvm_kvfree(dir);
         return NULL;
     }
-    dir->depth = depth;
 
     return dir;
 }
@@ -678,6 +771,173 @@ static NV_STATUS page_tree_end_and_wait(uvm_page_tree_t *tree, uvm_push_t *push)
     return NV_OK;
 }
 
+// Zero-fill the chunks with a single push and add them to the pool
+static NV_STATUS page_tree_pool_add_locked(uvm_page_tree_t *tree,
+                                           uvm_page_tree_pool_t *pool,
+                                           uvm_gpu_chunk_t **chunks,
+                                           NvU32 num_chunks)
+{
+    NV_STATUS status;
+    uvm_push_t push;
+    NvU32 i;
+
+    uvm_assert_mutex_locked(&tree->lock);
+    UVM_ASSERT(pool->count + num_chunks <= tree->pool.depth);
+
+    status = page_tree_begin_acquire(tree, &tree->tracker, &push, "refill %u page tables", num_chunks);
+    if (status != NV_OK)
+        return status;
+
+    for (i = 0; i < num_chunks; i++) {
+        // The chunks are not visible to the GPU yet, so their memsets can be
+        // pipelined and only need the membar at the end of the push.
+        uvm_push_set_flag(&push, UVM_PUSH_FLAG_CE_NEXT_PIPELINED);
+        uvm_push_set_flag(&push, UVM_PUSH_FLAG_NEXT_MEMBAR_NONE);
+        tree->gpu->parent->ce_hal->memset_8(&push,
+                                            uvm_mmu_gpu_address(tree->gpu,
+                                                                uvm_gpu_phys_address(UVM_APERTURE_VID,
+                                                                                     chunks[i]->address)),
+                                            0,
+                                            pool->size);
+    }
+
+    // All the chunks are in vidmem, and any later PDE write pointing to them
+    // is done by the same GPU, so a GPU-local membar is enough.
+    uvm_push_set_flag(&push, UVM_PUSH_FLAG_NEXT_MEMBAR_GPU);
+    page_tree_end(tree, &push);
+
+    // The push acquired the tracker so it's ok to just overwrite it with the
+    // entry tracking the push.
+    page_tree_tracker_overwrite_with_push(tree, &push);
+
+    for (i = 0; i < num_chunks; i++)
+        pool->chunks[pool->count++] = chunks[i];
+
+    return NV_OK;
+}
+
+// Top up the pools which dropped below half of their target depth. Allocations
+// are taken from PMM without eviction, so refilling never competes with user
+// memory. Failures are not reported, as the pools are only an optimization.
+static void page_tree_pool_refill(uvm_page_tree_t *tree)
+{
+    uvm_gpu_chunk_t *chunks[UVM_PAGE_TABLE_POOL_REFILL_BATCH];
+    unsigned long refilled_mask = 0;
+
+    if (!page_tree_pool_enabled(tree))
+        return;
+
+    BUILD_BUG_ON(UVM_PAGE_TREE_POOL_MAX_SIZES > BITS_PER_LONG);
+
+    uvm_mutex_lock(&tree->lock);
+
+    while (true) {
+        uvm_page_tree_pool_t *pool = NULL;
+        uvm_tracker_t local_tracker = UVM_TRACKER_INIT();
+        NV_STATUS status;
+        NvU32 num_chunks;
+        NvU32 i;
+
+        // Each pool is refilled at most once per call, so a failing refill
+        // can't loop forever.
+        for (i = 0; i < ARRAY_SIZE(tree->pool.pools); i++) {
+            uvm_page_tree_pool_t *candidate = &tree->pool.pools[i];
+
+            if (candidate->size == 0 || candidate->refilling || test_bit(i, &refilled_mask))
+                continue;
+
+            if (candidate->count * 2 < tree->pool.depth) {
+                pool = candidate;
+                __set_bit(i, &refilled_mask);
+                break;
+            }
+        }
+
+        if (!pool)
+            break;
+
+        num_chunks = min(tree->pool.depth - pool->count, (NvU32)ARRAY_SIZE(chunks));
+        pool->refilling = true;
+
+        uvm_mutex_unlock(&tree->lock);
+
+        status = uvm_pmm_gpu_alloc_kernel(&tree->gpu->pmm,
+                                          num_chunks,
+                                          pool->size,
+                                          UVM_PMM_ALLOC_FLAGS_NONE,
+                                          chunks,
+                                          &local_tracker);
+
+        uvm_mutex_lock(&tree->lock);
+
+        pool->refilling = false;
+
+        if (status == NV_OK) {
+            status = uvm_tracker_add_tracker_safe(&tree->tracker, &local_tracker);
+            if (status == NV_OK)
+                status = page_tree_pool_add_locked(tree, pool, chunks, num_chunks);
+
+            if (status != NV_OK) {
+                for (i = 0; i < num_chunks; i++)
+                    uvm_pmm_gpu_free(&tree->gpu->pmm, chunks[i], &tree->tracker);
+            }
+        }
+
+        uvm_tracker_deinit(&local_tracker);
+    }
+
+    uvm_mutex_unlock(&tree->lock);
+}
+
+static NV_STATUS page_tree_pool_init(uvm_page_tree_t *tree)
+{
+    uvm_gpu_chunk_t **chunks;
+    NvU32 depth = uvm_page_table_pool_depth;
+    NvU32 i;
+
+    // Kernel trees are mostly populated at GPU initialization, and sysmem
+    // allocations are cheap enough to not need pooling.
+    if (depth == 0 ||
+        tree->type != UVM_PAGE_TREE_TYPE_USER ||
+        tree->location != UVM_APERTURE_VID ||
+        tree->gpu->channel_manager == NULL)
+        return NV_OK;
+
+    chunks = uvm_kvmalloc_zero(sizeof(*chunks) * depth * ARRAY_SIZE(tree->pool.pools));
+    if (!chunks)
+        return NV_ERR_NO_MEMORY;
+
+    for (i = 0; i < ARRAY_SIZE(tree->pool.pools); i++)
+        tree->pool.pools[i].chunks = chunks + i * depth;
+
+    tree->pool.depth = depth;
+
+    return NV_OK;
+}
+
+static void page_tree_pool_deinit(uvm_page_tree_t *tree)
+{
+    NvU32 i;
+
+    uvm_assert_mutex_locked(&tree->lock);
+
+    if (tree->pool.depth == 0)
+        return;
+
+    for (i = 0; i < ARRAY_SIZE(tree->pool.pools); i++) {
+        uvm_page_tree_pool_t *pool = &tree->pool.pools[i];
+
+        UVM_ASSERT(!pool->refilling);
+
+        while (pool->count > 0)
+            uvm_pmm_gpu_free(&tree->gpu->pmm, pool->chunks[--pool->count], &tree->tracker);
+    }
+
+    // All the pools share the array of the first one
+    uvm_kvfree(tree->pool.pools[0].chunks);
+    memset(&tree->pool, 0, sizeof(tree->pool));
+}
+
 static NV_STATUS write_gpu_state_cpu(uvm_page_tree_t *tree,
                                      NvU64 page_size,
                                      NvS32 invalidate_depth,
@@ -982,7 +1242,8 @@ static NV_STATUS map_remap_init(uvm_page_tree_t *tree)
         tree->map_remap.pde0 = allocate_directory(tree,
                                                   UVM_PAGE_SIZE_2M,
                                                   tree->hal->page_table_depth(UVM_PAGE_SIZE_2M),
-                                                  UVM_PMM_ALLOC_FLAGS_EVICT);
+                                                  UVM_PMM_ALLOC_FLAGS_EVICT,
+                                                  false);
         if (tree->map_remap.pde0 == NULL) {
             status = NV_ERR_NO_MEMORY;
             goto error;
@@ -1142,11 +1403,15 @@ NV_STATUS uvm_page_tree_init(uvm_gpu_t *gpu,
 
     uvm_tracker_init(&tree->tracker);
 
-    tree->root = allocate_directory(tree, UVM_PAGE_SIZE_AGNOSTIC, 0, UVM_PMM_ALLOC_FLAGS_EVICT);
+    tree->root = allocate_directory(tree, UVM_PAGE_SIZE_AGNOSTIC, 0, UVM_PMM_ALLOC_FLAGS_EVICT, false);
 
     if (tree->root == NULL)
         return NV_ERR_NO_MEMORY;
 
+    status = page_tree_pool_init(tree);
+    if (status != NV_OK)
+        return status;
+
 
     // Refer to the comment for struct uvm_page_tree_struct::pdb_rm_dma_address
     // in uvm_mmu.h.
@@ -1216,6 +1481,8 @@ void uvm_page_tree_deinit(uvm_page_tree_t *tree)
         }
     }
 
+    page_tree_pool_deinit(tree);
+
     (void)uvm_tracker_wait(&tree->tracker);
     phys_mem_deallocate(tree, &tree->root->phys_alloc);
 
@@ -1557,7 +1824,7 @@ NV_STATUS uvm_page_tree_get_ptes_async(uvm_page_tree_t *tree,
         // parent's depth.
         // TODO: Bug 1766655: Allocate everything below cur_depth instead of
         //       retrying for every level.
-        dir_cache[cur_depth] = allocate_directory(tree, page_size, cur_depth + 1, pmm_flags);
+        dir_cache[cur_depth] = allocate_directory(tree, page_size, cur_depth + 1, pmm_flags, true);
         if (dir_cache[cur_depth] == NULL) {
             uvm_mutex_lock(&tree->lock);
             free_unused_directories(tree, 0, NULL, dir_cache);
@@ -1573,6 +1840,9 @@ NV_STATUS uvm_page_tree_get_ptes_async(uvm_page_tree_t *tree,
 
     uvm_mutex_unlock(&tree->lock);
 
+    if (status == NV_OK)
+        page_tree_pool_refill(tree);
+
     return status;
 }
 
@@ -1709,7 +1979,7 @@ NV_STATUS uvm_page_tree_alloc_table(uvm_page_tree_t *tree,
                                                     single->table->depth,
                                                     page_size);
 
-    dir = allocate_directory(tree, page_size, single->table->depth + 1, pmm_flags);
+    dir = allocate_directory(tree, page_size, single->table->depth + 1, pmm_flags, false);
     if (dir == NULL)
         return NV_ERR_NO_MEMORY;
 
@@ -163,6 +163,11 @@ struct uvm_page_directory_struct
     // depth from the root
     NvU32 depth;
 
+    // Set if phys_alloc was taken zero-filled from the page tree pool, in which
+    // case initializing it with zero entries can be skipped. Cleared once the
+    // directory is initialized.
+    bool zeroed;
+
     // pointers to child directories on the host.
     // this array is variable length, so it needs to be last to allow it to
     // take up extra space
@@ -272,6 +277,23 @@ typedef enum
     UVM_PAGE_TREE_TYPE_COUNT
 } uvm_page_tree_type_t;
 
+// Maximum number of distinct allocation sizes pooled by a page tree
+#define UVM_PAGE_TREE_POOL_MAX_SIZES 4
+
+typedef struct
+{
+    // Size of the pooled allocations, or 0 if the pool is unused
+    NvLength size;
+
+    // Zero-filled vidmem allocations. Their memsets are tracked by the tree
+    // tracker.
+    uvm_gpu_chunk_t **chunks;
+    NvU32 count;
+
+    // Set while a thread is refilling the pool with the tree lock dropped
+    bool refilling;
+} uvm_page_tree_pool_t;
+
 struct uvm_page_tree_struct
 {
     uvm_mutex_t lock;
@@ -335,6 +357,19 @@ struct uvm_page_tree_struct
     // canonical form addresses.
     uvm_page_table_range_t no_ats_ranges[2];
 
+    // Pools of pre-zeroed vidmem page table allocations, one per allocation
+    // size. New page directories and tables are taken from the pools when
+    // mapping a new region, and the pools are refilled in batches once the
+    // mapping is done. Only used by user trees in vidmem.
+    struct
+    {
+        // Protected by lock
+        uvm_page_tree_pool_t pools[UVM_PAGE_TREE_POOL_MAX_SIZES];
+
+        // Target number of allocations in each pool. 0 if pooling is disabled.
+        NvU32 depth;
+    } pool;
+
     // Tracker for all GPU operations on the tree
     uvm_tracker_t tracker;
 };
@@ -328,6 +328,45 @@ static bool assert_invalidate_range(NvU64 base,
     return false;
 }
 
+// Like assert_invalidate_range(), but also accepts a targeted invalidate
+// covering the range, as TLB batches can merge nearby ranges. The covering
+// invalidate can be broader, i.e. have a smaller page size and depth.
+static bool assert_invalidate_range_covered(NvU64 base,
+                                            NvU64 size,
+                                            NvU64 page_size,
+                                            bool allow_inval_all,
+                                            NvU32 range_depth,
+                                            NvU32 all_depth)
+{
+    NvU32 i;
+
+    UVM_ASSERT(g_fake_tlb_invals_tracking_enabled);
+
+    for (i = 0; i < g_fake_invals_count; ++i) {
+        fake_tlb_invalidate_t *inval = &g_fake_invals[i];
+
+        if (inval->base == 0 && inval->size == -1)
+            continue;
+
+        if (inval->base <= base && inval->base + inval->size >= base + size) {
+            if (inval->depth > range_depth || inval->page_size > page_size) {
+                UVM_TEST_PRINT("Range [0x%llx, 0x%llx) covered with depth %u page size %llu, expected at most %u %llu\n",
+                               base,
+                               base + size,
+                               inval->depth,
+                               inval->page_size,
+                               range_depth,
+                               page_size);
+                return false;
+            }
+
+            return true;
+        }
+    }
+
+    return assert_invalidate_range(base, size, page_size, allow_inval_all, range_depth, all_depth, false);
+}
+
 static NV_STATUS test_page_tree_init(uvm_gpu_t *gpu, NvU32 big_page_size, uvm_page_tree_t *tree)
 {
     return uvm_page_tree_init(gpu, NULL, UVM_PAGE_TREE_TYPE_USER, big_page_size, UVM_APERTURE_SYS, tree);
@@ -1377,13 +1416,12 @@ static NV_STATUS test_tlb_batch_invalidates_case(uvm_page_tree_t *tree,
             bool allow_inval_all = (total_pages > gpu->parent->tlb_batch.max_pages) ||
                                    !gpu->parent->tlb_batch.va_invalidate_supported ||
                                    (i > UVM_TLB_BATCH_MAX_ENTRIES);
-            TEST_CHECK_RET(assert_invalidate_range(base + (NvU64)j * 2 * size,
-                                                   size,
-                                                   min_page_size,
-                                                   allow_inval_all,
-                                                   expected_range_depth,
-                                                   expected_inval_all_depth,
-                                                   false));
+            TEST_CHECK_RET(assert_invalidate_range_covered(base + (NvU64)j * 2 * size,
+                                                           size,
+                                                           min_page_size,
+                                                           allow_inval_all,
+                                                           expected_range_depth,
+                                                           expected_inval_all_depth));
         }
 
         fake_tlb_invals_disable();
@@ -1394,6 +1432,43 @@ static NV_STATUS test_tlb_batch_invalidates_case(uvm_page_tree_t *tree,
     return status;
 }
 
+// Adjacent and overlapping ranges with the same smallest page size are merged
+// into a single targeted invalidate
+static NV_STATUS test_tlb_batch_merge(uvm_page_tree_t *tree, NvU64 base)
+{
+    NV_STATUS status = NV_OK;
+    uvm_push_t push;
+    uvm_tlb_batch_t batch;
+    uvm_gpu_t *gpu = tree->gpu;
+    NvU32 depth = tree->hal->page_table_depth(UVM_PAGE_SIZE_4K);
+
+    if (!gpu->parent->tlb_batch.va_invalidate_supported)
+        return NV_OK;
+
+    MEM_NV_CHECK_RET(uvm_push_begin_fake(gpu, &push), NV_OK);
+
+    fake_tlb_invals_enable();
+
+    uvm_tlb_batch_begin(tree, &batch);
+    uvm_tlb_batch_invalidate(&batch, base + UVM_PAGE_SIZE_4K, UVM_PAGE_SIZE_4K, UVM_PAGE_SIZE_4K, UVM_MEMBAR_NONE);
+    uvm_tlb_batch_invalidate(&batch, base + 3 * UVM_PAGE_SIZE_4K, UVM_PAGE_SIZE_4K, UVM_PAGE_SIZE_4K, UVM_MEMBAR_NONE);
+    uvm_tlb_batch_invalidate(&batch, base, 3 * UVM_PAGE_SIZE_4K, UVM_PAGE_SIZE_4K, UVM_MEMBAR_NONE);
+    TEST_CHECK_GOTO(batch.count == 1, done);
+    TEST_CHECK_GOTO(batch.merged_count == 2, done);
+    uvm_tlb_batch_end(&batch, &push, UVM_MEMBAR_NONE);
+
+    TEST_CHECK_GOTO(g_fake_invals_count == 1, done);
+    TEST_CHECK_GOTO(assert_invalidate_range(base, 4 * UVM_PAGE_SIZE_4K, UVM_PAGE_SIZE_4K, false, depth, depth, false),
+                    done);
+
+done:
+    fake_tlb_invals_disable();
+
+    uvm_push_end_fake(&push);
+
+    return status;
+}
+
 static NV_STATUS test_tlb_batch_invalidates(uvm_gpu_t *gpu, const NvU64 *page_sizes, const NvU32 page_sizes_count)
 {
     NV_STATUS status = NV_OK;
@@ -1423,6 +1498,8 @@ static NV_STATUS test_tlb_batch_invalidates(uvm_gpu_t *gpu, const NvU64 *page_si
         }
     }
 
+    TEST_CHECK_GOTO(test_tlb_batch_merge(&tree, 0) == NV_OK, done);
+
 done:
     uvm_page_tree_deinit(&tree);
 
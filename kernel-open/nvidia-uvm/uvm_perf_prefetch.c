@@ -30,6 +30,7 @@
 #include "uvm_va_block.h"
 #include "uvm_va_range.h"
 #include "uvm_test.h"
+#include "uvm_tools.h"
 
 //
 // Tunables for prefetch detection/prevention (configurable via module parameters)
@@ -55,14 +56,41 @@ static unsigned uvm_perf_prefetch_threshold  = UVM_PREFETCH_THRESHOLD_DEFAULT;
 // logic
 static unsigned uvm_perf_prefetch_min_faults = UVM_PREFETCH_MIN_FAULTS_DEFAULT;
 
+// Enable/disable the cross-block stream detector
+static unsigned uvm_perf_prefetch_stream_enable = 0;
+
+#define UVM_PREFETCH_STREAM_CONFIDENCE_MIN     1
+#define UVM_PREFETCH_STREAM_CONFIDENCE_DEFAULT 2
+#define UVM_PREFETCH_STREAM_CONFIDENCE_MAX     16
+
+// Number of accesses separated by the same stride that need to be observed
+// before the stream detector starts prefetching
+static unsigned uvm_perf_prefetch_stream_confidence = UVM_PREFETCH_STREAM_CONFIDENCE_DEFAULT;
+
+#define UVM_PREFETCH_STREAM_MAX_PAGES_MIN     1
+#define UVM_PREFETCH_STREAM_MAX_PAGES_DEFAULT PAGES_PER_UVM_VA_BLOCK
+#define UVM_PREFETCH_STREAM_MAX_PAGES_MAX     PAGES_PER_UVM_VA_BLOCK
+
+// Maximum number of pages prefetched by the stream detector on each access
+static unsigned uvm_perf_prefetch_stream_max_pages = UVM_PREFETCH_STREAM_MAX_PAGES_DEFAULT;
+
+// Maximum distance between consecutive accesses in a stream
+#define UVM_PREFETCH_STREAM_MAX_STRIDE (16 * UVM_VA_BLOCK_SIZE)
+
 // Module parameters for the tunables
 module_param(uvm_perf_prefetch_enable, uint, S_IRUGO);
 module_param(uvm_perf_prefetch_threshold, uint, S_IRUGO);
 module_param(uvm_perf_prefetch_min_faults, uint, S_IRUGO);
+module_param(uvm_perf_prefetch_stream_enable, uint, S_IRUGO);
+module_param(uvm_perf_prefetch_stream_confidence, uint, S_IRUGO);
+module_param(uvm_perf_prefetch_stream_max_pages, uint, S_IRUGO);
 
 static bool g_uvm_perf_prefetch_enable;
 static unsigned g_uvm_perf_prefetch_threshold;
 static unsigned g_uvm_perf_prefetch_min_faults;
+static bool g_uvm_perf_prefetch_stream_enable;
+static unsigned g_uvm_perf_prefetch_stream_confidence;
+static unsigned g_uvm_perf_prefetch_stream_max_pages;
 
 void uvm_perf_prefetch_bitmap_tree_iter_init(const uvm_perf_prefetch_bitmap_tree_t *bitmap_tree,
                                              uvm_page_index_t page_index,
@@ -318,6 +346,188 @@ static void compute_prefetch_mask(uvm_va_block_region_t faulted_region,
     }
 }
 
+void uvm_perf_prefetch_streams_init(uvm_perf_prefetch_streams_t *streams)
+{
+    memset(streams, 0, sizeof(*streams));
+
+    uvm_spin_lock_init(&streams->lock, UVM_LOCK_ORDER_LEAF);
+    streams->enabled = g_uvm_perf_prefetch_stream_enable;
+}
+
+static NvU64 stream_distance(NvU64 a, NvU64 b)
+{
+    return a > b ? a - b : b - a;
+}
+
+// Returns the stream continued by the access at [start, start + size) to the
+// given processor, or NULL if there is none.
+static uvm_perf_prefetch_stream_t *stream_find_hit(uvm_perf_prefetch_streams_t *streams,
+                                                   uvm_processor_id_t processor,
+                                                   NvU64 start,
+                                                   NvU64 size)
+{
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(streams->streams); ++i) {
+        uvm_perf_prefetch_stream_t *stream = &streams->streams[i];
+
+        if (stream->last_use == 0 || stream->stride == 0 || !uvm_id_equal(stream->processor, processor))
+            continue;
+
+        // Tolerate some jitter in the start of the access, since the number of
+        // pages faulted in each block depends on how faults are batched.
+        if (stream_distance(start, stream->next) <= max(size, stream->size))
+            return stream;
+    }
+
+    return NULL;
+}
+
+// Returns the stream whose last access is closest to start, within
+// UVM_PREFETCH_STREAM_MAX_STRIDE. If there is none, the least recently used
+// stream is reset and returned.
+static uvm_perf_prefetch_stream_t *stream_find_train(uvm_perf_prefetch_streams_t *streams,
+                                                     uvm_processor_id_t processor,
+                                                     NvU64 start)
+{
+    uvm_perf_prefetch_stream_t *closest = NULL;
+    uvm_perf_prefetch_stream_t *lru = &streams->streams[0];
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(streams->streams); ++i) {
+        uvm_perf_prefetch_stream_t *stream = &streams->streams[i];
+
+        if (stream->last_use < lru->last_use)
+            lru = stream;
+
+        if (stream->last_use == 0 || !uvm_id_equal(stream->processor, processor) || stream->last == start)
+            continue;
+
+        if (stream_distance(start, stream->last) > UVM_PREFETCH_STREAM_MAX_STRIDE)
+            continue;
+
+        if (!closest || stream_distance(start, stream->last) < stream_distance(start, closest->last))
+            closest = stream;
+    }
+
+    if (closest)
+        return closest;
+
+    memset(lru, 0, sizeof(*lru));
+    lru->processor = processor;
+
+    return lru;
+}
+
+// Add to prefetch_pages the pages within max_prefetch_region that the stream is
+// expected to access after the access at access_region, and advance the stream
+// past them.
+static void stream_compute_prefetch_mask(uvm_va_block_t *va_block,
+                                         uvm_perf_prefetch_stream_t *stream,
+                                         uvm_va_block_region_t access_region,
+                                         uvm_va_block_region_t max_prefetch_region,
+                                         uvm_page_mask_t *prefetch_pages)
+{
+    NvU64 start = uvm_va_block_region_start(va_block, access_region);
+    NvU64 size = uvm_va_block_region_size(access_region);
+    NvU64 region_start = uvm_va_block_region_start(va_block, max_prefetch_region);
+    NvU64 region_end = region_start + uvm_va_block_region_size(max_prefetch_region);
+    NvU64 max_size = (NvU64)g_uvm_perf_prefetch_stream_max_pages * PAGE_SIZE;
+    NvU64 abs_stride = stream->stride < 0 ? -stream->stride : stream->stride;
+    NvU64 prefetched = 0;
+    NvU64 next;
+
+    if (abs_stride <= size) {
+        // Dense stream: prefetch the rest of the region in the direction of
+        // the stream.
+        if (stream->stride > 0) {
+            NvU64 end = min(region_end, start + size + max_size);
+
+            if (end > start + size) {
+                uvm_page_mask_region_fill(prefetch_pages,
+                                          uvm_va_block_region_from_start_end(va_block, start + size, end - 1));
+            }
+
+            next = max(end, start + size);
+        }
+        else {
+            NvU64 first = start;
+
+            if (start > region_start)
+                first = start - min(start - region_start, max_size);
+
+            if (first < start)
+                uvm_page_mask_region_fill(prefetch_pages, uvm_va_block_region_from_start_end(va_block, first, start - 1));
+
+            next = first + stream->stride;
+        }
+    }
+    else {
+        // Strided stream: prefetch the accesses expected in the region, each
+        // of them with the size of the current access.
+        for (next = start + stream->stride;
+             next >= region_start && next + size <= region_end && prefetched + size <= max_size;
+             next += stream->stride) {
+            uvm_page_mask_region_fill(prefetch_pages, uvm_va_block_region_from_start_size(va_block, next, size));
+            prefetched += size;
+        }
+    }
+
+    stream->next = next;
+    stream->last = next - stream->stride;
+}
+
+// Update the stream detector with the access to faulted_pages and add to
+// prefetch_pages the pages that the stream it belongs to is expected to access
+// next in max_prefetch_region. Returns whether the access continued a known
+// stream.
+static bool stream_prenotify_fault_migrations(uvm_va_block_t *va_block,
+                                              uvm_processor_id_t new_residency,
+                                              const uvm_page_mask_t *faulted_pages,
+                                              uvm_va_block_region_t max_prefetch_region,
+                                              uvm_page_mask_t *prefetch_pages)
+{
+    uvm_va_space_t *va_space = uvm_va_block_get_va_space(va_block);
+    uvm_perf_prefetch_streams_t *streams = &va_space->prefetch_streams;
+    uvm_va_block_region_t access_region = uvm_va_block_region_from_mask(va_block, faulted_pages);
+    NvU64 start = uvm_va_block_region_start(va_block, access_region);
+    NvU64 size = uvm_va_block_region_size(access_region);
+    uvm_perf_prefetch_stream_t *stream;
+    bool hit = false;
+
+    uvm_spin_lock(&streams->lock);
+
+    stream = stream_find_hit(streams, new_residency, start, size);
+    if (stream) {
+        hit = true;
+
+        if (stream->confidence < UVM_PREFETCH_STREAM_CONFIDENCE_MAX)
+            ++stream->confidence;
+    }
+    else {
+        stream = stream_find_train(streams, new_residency, start);
+        if (stream->last_use != 0) {
+            stream->stride = (NvS64)(start - stream->last);
+            stream->confidence = 1;
+        }
+    }
+
+    stream->last = start;
+    stream->size = size;
+    stream->last_use = ++streams->clock;
+
+    if (stream->stride != 0) {
+        stream->next = start + stream->stride;
+
+        if (hit && stream->confidence >= g_uvm_perf_prefetch_stream_confidence)
+            stream_compute_prefetch_mask(va_block, stream, access_region, max_prefetch_region, prefetch_pages);
+    }
+
+    uvm_spin_unlock(&streams->lock);
+
+    return hit;
+}
+
 // Within a block we only allow prefetching to a single processor. Therefore,
 // if two processors are accessing non-overlapping regions within the same
 // block they won't benefit from prefetching.
@@ -333,6 +543,7 @@ static NvU32 uvm_perf_prefetch_prenotify_fault_migrations(uvm_va_block_t *va_blo
                                                           uvm_perf_prefetch_bitmap_tree_t *bitmap_tree)
 {
     const uvm_page_mask_t *resident_mask = NULL;
+    uvm_va_space_t *va_space = uvm_va_block_get_va_space(va_block);
     const uvm_va_policy_t *policy = uvm_va_policy_get_region(va_block, faulted_region);
     uvm_va_block_region_t max_prefetch_region;
     const uvm_page_mask_t *thrashing_pages = uvm_perf_thrashing_get_thrashing_pages(va_block);
@@ -387,6 +598,16 @@ static NvU32 uvm_perf_prefetch_prenotify_fault_migrations(uvm_va_block_t *va_blo
                               prefetch_pages);
     }
 
+    if (va_space->prefetch_streams.enabled && !uvm_page_mask_region_empty(faulted_pages, faulted_region)) {
+        bool hit = stream_prenotify_fault_migrations(va_block,
+                                                     new_residency,
+                                                     faulted_pages,
+                                                     max_prefetch_region,
+                                                     prefetch_pages);
+
+        uvm_tools_record_prefetch_stream(va_space, new_residency, hit);
+    }
+
     // Do not prefetch pages that are going to be migrated/populated due to a
     // fault
     uvm_page_mask_andnot(prefetch_pages, prefetch_pages, faulted_pages);
@@ -531,6 +752,32 @@ NV_STATUS uvm_perf_prefetch_init(void)
         g_uvm_perf_prefetch_min_faults = UVM_PREFETCH_MIN_FAULTS_DEFAULT;
     }
 
+    g_uvm_perf_prefetch_stream_enable = uvm_perf_prefetch_stream_enable != 0;
+
+    if (uvm_perf_prefetch_stream_confidence >= UVM_PREFETCH_STREAM_CONFIDENCE_MIN &&
+        uvm_perf_prefetch_stream_confidence <= UVM_PREFETCH_STREAM_CONFIDENCE_MAX) {
+        g_uvm_perf_prefetch_stream_confidence = uvm_perf_prefetch_stream_confidence;
+    }
+    else {
+        UVM_INFO_PRINT("Invalid value %u for uvm_perf_prefetch_stream_confidence. Using %u instead\n",
+                       uvm_perf_prefetch_stream_confidence,
+                       UVM_PREFETCH_STREAM_CONFIDENCE_DEFAULT);
+
+        g_uvm_perf_prefetch_stream_confidence = UVM_PREFETCH_STREAM_CONFIDENCE_DEFAULT;
+    }
+
+    if (uvm_perf_prefetch_stream_max_pages >= UVM_PREFETCH_STREAM_MAX_PAGES_MIN &&
+        uvm_perf_prefetch_stream_max_pages <= UVM_PREFETCH_STREAM_MAX_PAGES_MAX) {
+        g_uvm_perf_prefetch_stream_max_pages = uvm_perf_prefetch_stream_max_pages;
+    }
+    else {
+        UVM_INFO_PRINT("Invalid value %u for uvm_perf_prefetch_stream_max_pages. Using %u instead\n",
+                       uvm_perf_prefetch_stream_max_pages,
+                       (unsigned)UVM_PREFETCH_STREAM_MAX_PAGES_DEFAULT);
+
+        g_uvm_perf_prefetch_stream_max_pages = UVM_PREFETCH_STREAM_MAX_PAGES_DEFAULT;
+    }
+
     return NV_OK;
 }
 
@@ -25,6 +25,7 @@
 #define __UVM_PERF_PREFETCH_H__
 
 #include "uvm_linux.h"
+#include "uvm_lock.h"
 #include "uvm_processors.h"
 #include "uvm_va_block_types.h"
 
@@ -58,9 +59,60 @@ typedef struct
     uvm_page_index_t node_idx;
 } uvm_perf_prefetch_bitmap_tree_iter_t;
 
+// Number of streams tracked per VA space by the stream detector
+#define UVM_PERF_PREFETCH_STREAM_COUNT 8
+
+// Sequence of accesses to the same processor separated by a constant stride.
+// Addresses are page-aligned and may belong to different VA blocks.
+typedef struct
+{
+    // Start address of the last access in the stream
+    NvU64 last;
+
+    // Size in bytes of the last access in the stream
+    NvU64 size;
+
+    // Start address at which the next access in the stream is expected. Only
+    // valid if stride is not 0.
+    NvU64 next;
+
+    // Distance in bytes between the start of consecutive accesses. It is
+    // negative for descending streams, and 0 if the stream has a single
+    // access.
+    NvS64 stride;
+
+    // Number of consecutive accesses separated by stride
+    NvU32 confidence;
+
+    // Value of the detector clock when the stream was last accessed. It is 0
+    // if the stream slot is unused.
+    NvU64 last_use;
+
+    uvm_processor_id_t processor;
+} uvm_perf_prefetch_stream_t;
+
+// Per-VA space stream detector. It learns strides across fault batches and VA
+// blocks, so that the first fault in a block that continues a known stream
+// prefetches the pages the stream is expected to touch next in the block.
+typedef struct
+{
+    bool enabled;
+
+    // Protects the fields below, which are updated with the VA space lock held
+    // in read mode.
+    uvm_spinlock_t lock;
+
+    NvU64 clock;
+
+    uvm_perf_prefetch_stream_t streams[UVM_PERF_PREFETCH_STREAM_COUNT];
+} uvm_perf_prefetch_streams_t;
+
 // Global initialization function (no clean up needed).
 NV_STATUS uvm_perf_prefetch_init(void);
 
+// Initialize the stream detector of a VA space.
+void uvm_perf_prefetch_streams_init(uvm_perf_prefetch_streams_t *streams);
+
 // Returns whether prefetching is enabled in the VA space.
 // va_space cannot be NULL.
 bool uvm_perf_prefetch_enabled(uvm_va_space_t *va_space);
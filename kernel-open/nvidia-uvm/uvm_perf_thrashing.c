@@ -34,6 +34,7 @@
 #include "uvm_tools.h"
 #include "uvm_procfs.h"
 #include "uvm_test.h"
+#include "uvm_test_rng.h"
 
 // Number of bits for page-granularity time stamps. Currently we ignore the first 6 bits
 // of the timestamp (i.e. we have 64ns resolution, which is good enough)
@@ -107,6 +108,10 @@ typedef struct
 
     uvm_page_mask_t                  thrashing_pages;
 
+    // Pages unpinned when their pinning timeout expired. Used to detect the
+    // pages that thrash again after being unpinned.
+    uvm_page_mask_t                    expired_pages;
+
     struct
     {
         NvU32                                  count;
@@ -140,6 +145,41 @@ typedef struct
     struct list_head             va_block_list_entry;
 } pinned_page_t;
 
+// Outcomes of the thrashing mitigation observed on a VA space. They are used
+// to adapt the throttling and pinning parameters of the VA space.
+typedef struct
+{
+    // Number of times a processor was throttled on a page
+    NvU32 throttles;
+
+    // Number of times a page got pinned
+    NvU32 pins;
+
+    // Number of pinned pages unpinned when their timeout expired
+    NvU32 unpins;
+
+    // Number of pins of pages which had been unpinned on timeout
+    NvU32 repins;
+} thrashing_outcomes_t;
+
+typedef enum
+{
+    THRASHING_OUTCOME_THROTTLE,
+    THRASHING_OUTCOME_PIN,
+    THRASHING_OUTCOME_UNPIN,
+    THRASHING_OUTCOME_REPIN,
+} thrashing_outcome_t;
+
+// Parameters adapted at runtime
+typedef struct
+{
+    unsigned pin_threshold;
+
+    NvU64 nap_ns;
+
+    NvU64 pin_ns;
+} thrashing_adaptive_params_t;
+
 // Per-VA space data structures and policy configuration
 typedef struct
 {
@@ -181,6 +221,14 @@ typedef struct
         // test ioctls
         bool                          test_overrides;
 
+        // true if the thrashing mitigation parameters have been set by the
+        // process with UVM_SET_THRASHING_POLICY
+        bool                          user_overrides;
+
+        // Whether pin_threshold, nap_ns and pin_ns are adapted to the
+        // observed outcomes. See thrashing_adapt_params().
+        bool                                adaptive;
+
         //
         // Fields below are the thrashing mitigation parameters on the VA space
         //
@@ -199,6 +247,18 @@ typedef struct
         NvU64                                 pin_ns;
     } params;
 
+    struct
+    {
+        // Protects outcomes and the updates of the adapted parameters
+        uvm_spinlock_t                          lock;
+
+        // Outcomes observed since the last adaptation
+        thrashing_outcomes_t                outcomes;
+
+        // Values around which the parameters are adapted
+        thrashing_adaptive_params_t             base;
+    } adaptive;
+
     uvm_va_space_t                         *va_space;
 } va_space_thrashing_info_t;
 
@@ -304,6 +364,12 @@ static unsigned uvm_perf_thrashing_pin = UVM_PERF_THRASHING_PIN_DEFAULT;
 
 static unsigned uvm_perf_thrashing_max_resets = UVM_PERF_THRASHING_MAX_RESETS_DEFAULT;
 
+#define UVM_PERF_THRASHING_ADAPTIVE_DEFAULT 0
+
+// Adapt the throttling and pinning parameters of each VA space to the
+// observed outcomes of thrashing mitigation. Disabled by default.
+static unsigned uvm_perf_thrashing_adaptive = UVM_PERF_THRASHING_ADAPTIVE_DEFAULT;
+
 // Module parameters for the tunables
 module_param(uvm_perf_thrashing_enable,        uint, S_IRUGO);
 module_param(uvm_perf_thrashing_threshold,     uint, S_IRUGO);
@@ -313,6 +379,7 @@ module_param(uvm_perf_thrashing_nap,           uint, S_IRUGO);
 module_param(uvm_perf_thrashing_epoch,         uint, S_IRUGO);
 module_param(uvm_perf_thrashing_pin,           uint, S_IRUGO);
 module_param(uvm_perf_thrashing_max_resets,    uint, S_IRUGO);
+module_param(uvm_perf_thrashing_adaptive,      uint, S_IRUGO);
 
 // See map_remote_on_atomic_fault uvm_va_block.c
 unsigned uvm_perf_map_remote_on_native_atomics_fault = 0;
@@ -328,6 +395,7 @@ static NvU64 g_uvm_perf_thrashing_nap;
 static NvU64 g_uvm_perf_thrashing_epoch;
 static NvU64 g_uvm_perf_thrashing_pin;
 static unsigned g_uvm_perf_thrashing_max_resets;
+static bool g_uvm_perf_thrashing_adaptive;
 
 // Helper macros to initialize thrashing parameters from module parameters
 //
@@ -560,6 +628,143 @@ static va_space_thrashing_info_t *va_space_thrashing_info_get(uvm_va_space_t *va
     return va_space_thrashing;
 }
 
+// Number of outcomes between two adaptations of the parameters
+#define THRASHING_ADAPT_WINDOW 32
+
+// Bounds of the adapted parameters, relative to their base value
+#define THRASHING_ADAPT_PIN_THRESHOLD_MAX_FACTOR 4
+#define THRASHING_ADAPT_NAP_MAX_FACTOR           4
+#define THRASHING_ADAPT_PIN_MAX_FACTOR           16
+#define THRASHING_ADAPT_PIN_MIN_DIVISOR          4
+
+// Adapt the throttling and pinning parameters to the outcomes observed with
+// them:
+// - If most throttled pages end up pinned anyway, throttling only delays the
+//   processors, so pin sooner and throttle for shorter periods. This favors
+//   latency-sensitive workloads.
+// - If throttling is enough to stop thrashing, pin later and throttle for
+//   longer periods, so that processors keep working on local memory. This
+//   favors bulk workloads.
+// - If pages unpinned on timeout keep thrashing again, pin them for longer. If
+//   none do, give them back to the migration heuristics sooner.
+//
+// The parameters stay within bounds relative to base, and pin_ns is never set
+// to 0 if base->pin_ns is not 0.
+static void thrashing_adapt_params(const thrashing_outcomes_t *outcomes,
+                                   const thrashing_adaptive_params_t *base,
+                                   NvU64 lapse_ns,
+                                   thrashing_adaptive_params_t *params)
+{
+    if (outcomes->throttles > 0) {
+        unsigned max_pin_threshold = min(base->pin_threshold * THRASHING_ADAPT_PIN_THRESHOLD_MAX_FACTOR,
+                                         (unsigned)UVM_PERF_THRASHING_PIN_THRESHOLD_MAX);
+
+        // A page gets pinned after pin_threshold throttling periods
+        if ((NvU64)outcomes->pins * params->pin_threshold * 2 >= outcomes->throttles) {
+            params->pin_threshold = max(params->pin_threshold / 2, 1u);
+            params->nap_ns = max(params->nap_ns / 2, lapse_ns);
+        }
+        else if (outcomes->pins == 0) {
+            params->pin_threshold = min(params->pin_threshold + 1, max_pin_threshold);
+            params->nap_ns = min(params->nap_ns * 2, base->nap_ns * THRASHING_ADAPT_NAP_MAX_FACTOR);
+        }
+    }
+
+    if (base->pin_ns > 0 && outcomes->unpins > 0) {
+        if (outcomes->repins * 2 >= outcomes->unpins) {
+            params->pin_ns = min(params->pin_ns * 2, base->pin_ns * THRASHING_ADAPT_PIN_MAX_FACTOR);
+        }
+        else if (outcomes->repins == 0) {
+            NvU64 min_pin_ns = max(base->pin_ns / THRASHING_ADAPT_PIN_MIN_DIVISOR, lapse_ns);
+
+            params->pin_ns = max(params->pin_ns / 2, min_pin_ns);
+        }
+    }
+}
+
+static void thrashing_outcomes_add(thrashing_outcomes_t *outcomes, thrashing_outcome_t outcome)
+{
+    switch (outcome) {
+        case THRASHING_OUTCOME_THROTTLE:
+            ++outcomes->throttles;
+            break;
+        case THRASHING_OUTCOME_PIN:
+            ++outcomes->pins;
+            break;
+        case THRASHING_OUTCOME_UNPIN:
+            ++outcomes->unpins;
+            break;
+        case THRASHING_OUTCOME_REPIN:
+            ++outcomes->repins;
+            break;
+    }
+}
+
+static bool thrashing_outcomes_window_full(const thrashing_outcomes_t *outcomes)
+{
+    return outcomes->throttles + outcomes->pins + outcomes->unpins >= THRASHING_ADAPT_WINDOW;
+}
+
+// Restart the adaptation from the current parameters
+static void thrashing_adapt_reset(va_space_thrashing_info_t *va_space_thrashing)
+{
+    memset(&va_space_thrashing->adaptive.outcomes, 0, sizeof(va_space_thrashing->adaptive.outcomes));
+
+    va_space_thrashing->adaptive.base.pin_threshold = va_space_thrashing->params.pin_threshold;
+    va_space_thrashing->adaptive.base.nap_ns        = va_space_thrashing->params.nap_ns;
+    va_space_thrashing->adaptive.base.pin_ns        = va_space_thrashing->params.pin_ns;
+}
+
+// Record a mitigation outcome and adapt the parameters of the VA space once
+// enough outcomes have been observed.
+//
+// The parameters are read without the adaptive lock, with READ_ONCE() pairing
+// with the WRITE_ONCE() below. This is fine since any value within the bounds
+// is valid and pin_ns never changes between 0 and non-0.
+static void thrashing_adapt_record(va_space_thrashing_info_t *va_space_thrashing, thrashing_outcome_t outcome)
+{
+    thrashing_outcomes_t *outcomes = &va_space_thrashing->adaptive.outcomes;
+
+    // Parameters injected by tests must stay as they were set
+    if (!va_space_thrashing->params.adaptive || va_space_thrashing->params.test_overrides)
+        return;
+
+    uvm_spin_lock(&va_space_thrashing->adaptive.lock);
+
+    thrashing_outcomes_add(outcomes, outcome);
+
+    if (thrashing_outcomes_window_full(outcomes)) {
+        thrashing_adaptive_params_t params;
+
+        params.pin_threshold = va_space_thrashing->params.pin_threshold;
+        params.nap_ns        = va_space_thrashing->params.nap_ns;
+        params.pin_ns        = va_space_thrashing->params.pin_ns;
+
+        thrashing_adapt_params(outcomes,
+                               &va_space_thrashing->adaptive.base,
+                               va_space_thrashing->params.lapse_ns,
+                               &params);
+
+        WRITE_ONCE(va_space_thrashing->params.pin_threshold, params.pin_threshold);
+        WRITE_ONCE(va_space_thrashing->params.nap_ns, params.nap_ns);
+        WRITE_ONCE(va_space_thrashing->params.pin_ns, params.pin_ns);
+
+        memset(outcomes, 0, sizeof(*outcomes));
+    }
+
+    uvm_spin_unlock(&va_space_thrashing->adaptive.lock);
+}
+
+static NvU64 thrashing_default_lapse_ns(void)
+{
+    // Default thrashing parameters are overriden for simulated/emulated GPUs
+    if (g_uvm_global.num_simulated_devices > 0 &&
+        (g_uvm_perf_thrashing_lapse_usec == UVM_PERF_THRASHING_LAPSE_USEC_DEFAULT))
+        return UVM_PERF_THRASHING_LAPSE_USEC_DEFAULT_EMULATION * 1000;
+
+    return g_uvm_perf_thrashing_lapse_usec * 1000;
+}
+
 static void va_space_thrashing_info_init_params(va_space_thrashing_info_t *va_space_thrashing)
 {
     UVM_ASSERT(!va_space_thrashing->params.test_overrides);
@@ -569,15 +774,7 @@ static void va_space_thrashing_info_init_params(va_space_thrashing_info_t *va_sp
     // Snap the thrashing parameters so that they can be tuned per VA space
     va_space_thrashing->params.threshold     = g_uvm_perf_thrashing_threshold;
     va_space_thrashing->params.pin_threshold = g_uvm_perf_thrashing_pin_threshold;
-
-    // Default thrashing parameters are overriden for simulated/emulated GPUs
-    if (g_uvm_global.num_simulated_devices > 0 &&
-        (g_uvm_perf_thrashing_lapse_usec == UVM_PERF_THRASHING_LAPSE_USEC_DEFAULT)) {
-        va_space_thrashing->params.lapse_ns  = UVM_PERF_THRASHING_LAPSE_USEC_DEFAULT_EMULATION * 1000;
-    }
-    else {
-        va_space_thrashing->params.lapse_ns  = g_uvm_perf_thrashing_lapse_usec * 1000;
-    }
+    va_space_thrashing->params.lapse_ns      = thrashing_default_lapse_ns();
 
     va_space_thrashing->params.nap_ns        = va_space_thrashing->params.lapse_ns * g_uvm_perf_thrashing_nap;
     va_space_thrashing->params.epoch_ns      = va_space_thrashing->params.lapse_ns * g_uvm_perf_thrashing_epoch;
@@ -591,6 +788,10 @@ static void va_space_thrashing_info_init_params(va_space_thrashing_info_t *va_sp
     }
 
     va_space_thrashing->params.max_resets    = g_uvm_perf_thrashing_max_resets;
+
+    va_space_thrashing->params.adaptive      = g_uvm_perf_thrashing_adaptive;
+
+    thrashing_adapt_reset(va_space_thrashing);
 }
 
 // Create the thrashing detection struct for the given VA space
@@ -615,6 +816,8 @@ static va_space_thrashing_info_t *va_space_thrashing_info_create(uvm_va_space_t
         va_space_thrashing->pinned_pages.va_block_context = block_context;
         va_space_thrashing->va_space = va_space;
 
+        uvm_spin_lock_init(&va_space_thrashing->adaptive.lock, UVM_LOCK_ORDER_LEAF);
+
         va_space_thrashing_info_init_params(va_space_thrashing);
 
         uvm_perf_module_type_set_data(va_space->perf_modules_data, va_space_thrashing, UVM_PERF_MODULE_TYPE_THRASHING);
@@ -785,7 +988,7 @@ static void thrashing_throttle_update(va_space_thrashing_info_t *va_space_thrash
     uvm_assert_mutex_locked(&va_block->lock);
 
     if (time_stamp > current_end_time_stamp) {
-        NvU64 throttling_end_time_stamp = time_stamp + va_space_thrashing->params.nap_ns;
+        NvU64 throttling_end_time_stamp = time_stamp + READ_ONCE(va_space_thrashing->params.nap_ns);
         page_thrashing_set_throttling_end_time_stamp(page_thrashing, throttling_end_time_stamp);
 
         // Avoid choosing the same processor in consecutive thrashing periods
@@ -821,6 +1024,8 @@ static void thrashing_throttle_processor(uvm_va_block_t *va_block,
     UVM_ASSERT(!uvm_id_equal(processor, page_thrashing->do_not_throttle_processor_id));
 
     if (!uvm_processor_mask_test_and_set(&page_thrashing->throttled_processors, processor)) {
+        thrashing_adapt_record(va_space_thrashing_info_get(va_space), THRASHING_OUTCOME_THROTTLE);
+
         // CPU is throttled by sleeping. This is done in uvm_vm_fault so it
         // drops the VA block and VA space locks. Throttling start/end events
         // are recorded around the sleep calls.
@@ -928,14 +1133,16 @@ static NV_STATUS thrashing_pin_page(va_space_thrashing_info_t *va_space_thrashin
         thrashing_throttling_reset_page(va_block, block_thrashing, page_thrashing, page_index);
 
     if (!page_thrashing->pinned) {
-        if (va_space_thrashing->params.pin_ns > 0) {
+        NvU64 pin_ns = READ_ONCE(va_space_thrashing->params.pin_ns);
+
+        if (pin_ns > 0) {
             pinned_page_t *pinned_page = nv_kmem_cache_zalloc(g_pinned_page_cache, NV_UVM_GFP_FLAGS);
             if (!pinned_page)
                 return NV_ERR_NO_MEMORY;
 
             pinned_page->va_block = va_block;
             pinned_page->page_index = page_index;
-            pinned_page->deadline = time_stamp + va_space_thrashing->params.pin_ns;
+            pinned_page->deadline = time_stamp + pin_ns;
 
             uvm_spin_lock(&va_space_thrashing->pinned_pages.lock);
 
@@ -951,7 +1158,7 @@ static NV_STATUS thrashing_pin_page(va_space_thrashing_info_t *va_space_thrashin
                 !va_space_thrashing->pinned_pages.in_va_space_teardown) {
                 int scheduled;
                 scheduled = schedule_delayed_work(&va_space_thrashing->pinned_pages.dwork,
-                                                  usecs_to_jiffies(va_space_thrashing->params.pin_ns / 1000));
+                                                  usecs_to_jiffies(pin_ns / 1000));
                 UVM_ASSERT(scheduled != 0);
             }
 
@@ -985,7 +1192,7 @@ static void thrashing_unpin_page(va_space_thrashing_info_t *va_space_thrashing,
     uvm_assert_mutex_locked(&va_block->lock);
     UVM_ASSERT(page_thrashing->pinned);
 
-    if (va_space_thrashing->params.pin_ns > 0) {
+    if (READ_ONCE(va_space_thrashing->params.pin_ns) > 0) {
         bool do_free = false;
         pinned_page_t *pinned_page = find_pinned_page(block_thrashing, page_index);
 
@@ -1088,7 +1295,12 @@ static void thrashing_reset_pages_in_region(uvm_va_block_t *va_block, NvU64 addr
     uvm_va_block_region_t region = uvm_va_block_region_from_start_size(va_block, address, bytes);
 
     block_thrashing = thrashing_info_get(va_block);
-    if (!block_thrashing || !block_thrashing->pages)
+    if (!block_thrashing)
+        return;
+
+    uvm_page_mask_region_clear(&block_thrashing->expired_pages, region);
+
+    if (!block_thrashing->pages)
         return;
 
     // Update all pages in the region
@@ -1551,7 +1763,7 @@ static uvm_perf_thrashing_hint_t get_hint_for_migration_thrashing(va_space_thras
         else if (!uvm_id_equal(preferred_location, do_not_throttle_processor)) {
             hint.type = UVM_PERF_THRASHING_HINT_TYPE_THROTTLE;
         }
-        else if (page_thrashing->throttling_count >= va_space_thrashing->params.pin_threshold) {
+        else if (page_thrashing->throttling_count >= READ_ONCE(va_space_thrashing->params.pin_threshold)) {
             hint.type = UVM_PERF_THRASHING_HINT_TYPE_PIN;
             hint.pin.residency = preferred_location;
         }
@@ -1596,7 +1808,7 @@ static uvm_perf_thrashing_hint_t get_hint_for_migration_thrashing(va_space_thras
     else if (!uvm_id_equal(requester, do_not_throttle_processor)) {
         hint.type = UVM_PERF_THRASHING_HINT_TYPE_THROTTLE;
     }
-    else if (page_thrashing->throttling_count >= va_space_thrashing->params.pin_threshold) {
+    else if (page_thrashing->throttling_count >= READ_ONCE(va_space_thrashing->params.pin_threshold)) {
         hint.type = UVM_PERF_THRASHING_HINT_TYPE_PIN;
         hint.pin.residency = requester;
     }
@@ -1747,6 +1959,7 @@ uvm_perf_thrashing_hint_t uvm_perf_thrashing_get_hint(uvm_va_block_t *va_block,
 
 done:
     if (hint.type == UVM_PERF_THRASHING_HINT_TYPE_PIN) {
+        bool was_pinned = page_thrashing->pinned;
         NV_STATUS status = thrashing_pin_page(va_space_thrashing,
                                               va_block,
                                               va_block_context,
@@ -1769,6 +1982,13 @@ done:
                 PROCESSOR_THRASHING_STATS_INC(requester, num_pin_remote);
 
             uvm_processor_mask_copy(&hint.pin.processors, &page_thrashing->processors);
+
+            if (!was_pinned) {
+                thrashing_adapt_record(va_space_thrashing, THRASHING_OUTCOME_PIN);
+
+                if (uvm_page_mask_test_and_clear(&block_thrashing->expired_pages, page_index))
+                    thrashing_adapt_record(va_space_thrashing, THRASHING_OUTCOME_REPIN);
+            }
         }
     }
 
@@ -1906,6 +2126,9 @@ static void thrashing_unpin_pages(struct work_struct *work)
                                                              va_block_context,
                                                              uvm_va_block_region_for_page(page_index));
             thrashing_reset_page(va_space_thrashing, va_block, block_thrashing, page_index);
+
+            uvm_page_mask_set(&block_thrashing->expired_pages, page_index);
+            thrashing_adapt_record(va_space_thrashing, THRASHING_OUTCOME_UNPIN);
         }
 
         uvm_mutex_unlock(&va_block->lock);
@@ -1984,7 +2207,9 @@ void uvm_perf_thrashing_register_gpu(uvm_va_space_t *va_space, uvm_gpu_t *gpu)
 
     // If a simulated GPU is registered, re-initialize thrashing parameters in
     // case they need to be adjusted.
-    if ((g_uvm_global.num_simulated_devices > 0) && !va_space_thrashing->params.test_overrides)
+    if ((g_uvm_global.num_simulated_devices > 0) &&
+        !va_space_thrashing->params.test_overrides &&
+        !va_space_thrashing->params.user_overrides)
         va_space_thrashing_info_init_params(va_space_thrashing);
 }
 
@@ -2022,6 +2247,8 @@ NV_STATUS uvm_perf_thrashing_init(void)
 
     INIT_THRASHING_PARAMETER(uvm_perf_thrashing_max_resets, UVM_PERF_THRASHING_MAX_RESETS_DEFAULT);
 
+    INIT_THRASHING_PARAMETER_TOGGLE(uvm_perf_thrashing_adaptive, UVM_PERF_THRASHING_ADAPTIVE_DEFAULT);
+
     g_va_block_thrashing_info_cache = NV_KMEM_CACHE_CREATE("uvm_block_thrashing_info_t", block_thrashing_info_t);
     if (!g_va_block_thrashing_info_cache) {
         status = NV_ERR_NO_MEMORY;
@@ -2067,6 +2294,230 @@ void uvm_perf_thrashing_remove_gpu(uvm_gpu_t *gpu)
     gpu_thrashing_stats_destroy(gpu);
 }
 
+// Destroy the thrashing tracking information of all the VA blocks in the VA
+// space, and unpin their pages.
+//
+// VA space lock needs to be held in write mode
+static NV_STATUS thrashing_destroy_va_space_state(uvm_va_space_t *va_space)
+{
+    uvm_va_range_managed_t *managed_range;
+    NV_STATUS status;
+
+    uvm_assert_rwsem_locked_write(&va_space->lock);
+
+    uvm_for_each_va_range_managed(managed_range, va_space) {
+        uvm_va_block_t *va_block;
+
+        for_each_va_block_in_va_range(managed_range, va_block) {
+            uvm_va_block_region_t va_block_region = uvm_va_block_region_from_block(va_block);
+            uvm_va_block_context_t *block_context = uvm_va_space_block_context(va_space, NULL);
+
+            uvm_mutex_lock(&va_block->lock);
+
+            // Unmap may split PTEs and require a retry. Needs to be called
+            // before the pinned pages information is destroyed.
+            status = UVM_VA_BLOCK_RETRY_LOCKED(va_block, NULL,
+                         uvm_perf_thrashing_unmap_remote_pinned_pages_all(va_block,
+                                                                          block_context,
+                                                                          va_block_region));
+
+            uvm_perf_thrashing_info_destroy(va_block);
+
+            uvm_mutex_unlock(&va_block->lock);
+
+            if (status != NV_OK)
+                return status;
+        }
+    }
+
+    return uvm_hmm_clear_thrashing_policy(va_space);
+}
+
+NV_STATUS uvm_api_set_thrashing_policy(UVM_SET_THRASHING_POLICY_PARAMS *params, struct file *filp)
+{
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+    va_space_thrashing_info_t *va_space_thrashing;
+    NV_STATUS status = NV_OK;
+
+    if (params->mode != UVM_THRASHING_POLICY_MODE_DEFAULT && params->mode != UVM_THRASHING_POLICY_MODE_FIXED)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    if (params->threshold > UVM_PERF_THRASHING_THRESHOLD_MAX ||
+        params->pinThreshold > UVM_PERF_THRASHING_PIN_THRESHOLD_MAX ||
+        params->lapseUsec > UINT_MAX ||
+        params->napUsec > UINT_MAX ||
+        params->pinUsec > UINT_MAX)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    if (params->mode == UVM_THRASHING_POLICY_MODE_DEFAULT &&
+        (params->threshold || params->pinThreshold || params->lapseUsec || params->napUsec || params->pinUsec))
+        return NV_ERR_INVALID_ARGUMENT;
+
+    if (!g_uvm_perf_thrashing_enable)
+        return NV_ERR_NOT_SUPPORTED;
+
+    // Apply the same bounds as the uvm_perf_thrashing_nap module parameter:
+    // the nap must last between 1 and UVM_PERF_THRASHING_NAP_MAX lapses.
+    if (params->napUsec) {
+        NvU64 lapse_ns = params->lapseUsec ? params->lapseUsec * 1000 : thrashing_default_lapse_ns();
+        NvU64 nap_ns = params->napUsec * 1000;
+
+        if (nap_ns < lapse_ns || nap_ns > lapse_ns * UVM_PERF_THRASHING_NAP_MAX)
+            return NV_ERR_INVALID_ARGUMENT;
+    }
+
+    uvm_va_space_down_write(va_space);
+
+    va_space_thrashing = va_space_thrashing_info_get(va_space);
+
+    // The detection parameters are checked against the existing tracking
+    // state, and pinned pages are tracked differently depending on pin_ns.
+    // Start over with the new parameters.
+    if (va_space_thrashing->params.enable) {
+        status = thrashing_destroy_va_space_state(va_space);
+        if (status != NV_OK)
+            goto done;
+    }
+
+    va_space_thrashing->params.test_overrides = false;
+    va_space_thrashing->params.user_overrides = false;
+    va_space_thrashing_info_init_params(va_space_thrashing);
+
+    if (params->mode == UVM_THRASHING_POLICY_MODE_FIXED) {
+        va_space_thrashing->params.user_overrides = true;
+        va_space_thrashing->params.adaptive = false;
+
+        if (params->threshold)
+            va_space_thrashing->params.threshold = params->threshold;
+
+        if (params->pinThreshold)
+            va_space_thrashing->params.pin_threshold = params->pinThreshold;
+
+        if (params->lapseUsec) {
+            va_space_thrashing->params.lapse_ns = params->lapseUsec * 1000;
+            va_space_thrashing->params.nap_ns   = va_space_thrashing->params.lapse_ns * g_uvm_perf_thrashing_nap;
+            va_space_thrashing->params.epoch_ns = va_space_thrashing->params.lapse_ns * g_uvm_perf_thrashing_epoch;
+
+            if (va_space_thrashing->params.pin_ns > 0)
+                va_space_thrashing->params.pin_ns = va_space_thrashing->params.lapse_ns * g_uvm_perf_thrashing_pin;
+        }
+
+        if (params->napUsec)
+            va_space_thrashing->params.nap_ns = params->napUsec * 1000;
+
+        if (params->pinUsec && va_space_thrashing->params.pin_ns > 0)
+            va_space_thrashing->params.pin_ns = params->pinUsec * 1000;
+
+        thrashing_adapt_reset(va_space_thrashing);
+    }
+
+done:
+    uvm_va_space_up_write(va_space);
+
+    return status;
+}
+
+// Simulate the adaptation of the parameters on a synthetic sequence of
+// thrashing pages. Each page is throttled until it stops thrashing after
+// resolve_periods throttling periods (never if 0), or until it gets pinned.
+// Pinned pages are unpinned on timeout and thrash again with a probability
+// of repin_percent for the base pinning time, inversely proportional to the
+// current pinning time.
+static void thrashing_adapt_simulate(uvm_test_rng_t *rng,
+                                     NvU32 iterations,
+                                     NvU32 resolve_periods,
+                                     NvU32 repin_percent,
+                                     const thrashing_adaptive_params_t *base,
+                                     NvU64 lapse_ns,
+                                     thrashing_adaptive_params_t *params)
+{
+    thrashing_outcomes_t outcomes = {0};
+    NvU32 i;
+
+    *params = *base;
+
+    for (i = 0; i < iterations; i++) {
+        NvU32 periods = 0;
+        bool pinned = false;
+
+        while (true) {
+            thrashing_outcomes_add(&outcomes, THRASHING_OUTCOME_THROTTLE);
+            ++periods;
+
+            if (resolve_periods > 0 && periods >= resolve_periods)
+                break;
+
+            if (periods >= params->pin_threshold) {
+                thrashing_outcomes_add(&outcomes, THRASHING_OUTCOME_PIN);
+                pinned = true;
+                break;
+            }
+        }
+
+        if (pinned && params->pin_ns > 0) {
+            NvU64 repin_chance = repin_percent * base->pin_ns / params->pin_ns;
+
+            thrashing_outcomes_add(&outcomes, THRASHING_OUTCOME_UNPIN);
+            if (uvm_test_rng_range_32(rng, 0, 99) < repin_chance) {
+                thrashing_outcomes_add(&outcomes, THRASHING_OUTCOME_PIN);
+                thrashing_outcomes_add(&outcomes, THRASHING_OUTCOME_REPIN);
+            }
+        }
+
+        if (thrashing_outcomes_window_full(&outcomes)) {
+            thrashing_adapt_params(&outcomes, base, lapse_ns, params);
+            memset(&outcomes, 0, sizeof(outcomes));
+        }
+    }
+}
+
+NV_STATUS uvm_test_thrashing_adapt_simulate(UVM_TEST_THRASHING_ADAPT_SIMULATE_PARAMS *params, struct file *filp)
+{
+    const NvU64 lapse_ns = UVM_PERF_THRASHING_LAPSE_USEC_DEFAULT * 1000ULL;
+    const thrashing_adaptive_params_t base =
+    {
+        .pin_threshold = UVM_PERF_THRASHING_PIN_THRESHOLD_DEFAULT,
+        .nap_ns        = lapse_ns * UVM_PERF_THRASHING_NAP_DEFAULT * 2,
+        .pin_ns        = lapse_ns * UVM_PERF_THRASHING_PIN_DEFAULT,
+    };
+    thrashing_adaptive_params_t adapted;
+    NvU32 iterations = params->iterations ? params->iterations : 4096;
+    uvm_test_rng_t rng;
+
+    if (iterations < 16 * THRASHING_ADAPT_WINDOW)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    uvm_test_rng_init(&rng, params->seed);
+
+    // Pages never stop thrashing while throttled: throttling must become as
+    // short as possible.
+    thrashing_adapt_simulate(&rng, iterations, 0, 0, &base, lapse_ns, &adapted);
+    TEST_CHECK_RET(adapted.pin_threshold == 1);
+    TEST_CHECK_RET(adapted.nap_ns == lapse_ns);
+    params->latency_pin_threshold = adapted.pin_threshold;
+
+    // Pages stop thrashing after two throttling periods: pinning must be
+    // delayed as much as possible.
+    thrashing_adapt_simulate(&rng, iterations, 2, 0, &base, lapse_ns, &adapted);
+    TEST_CHECK_RET(adapted.pin_threshold == base.pin_threshold * THRASHING_ADAPT_PIN_THRESHOLD_MAX_FACTOR);
+    TEST_CHECK_RET(adapted.nap_ns == base.nap_ns * THRASHING_ADAPT_NAP_MAX_FACTOR);
+    params->bulk_pin_threshold = adapted.pin_threshold;
+
+    // Unpinned pages always thrash again at the base pinning time: pages must
+    // be pinned for longer.
+    thrashing_adapt_simulate(&rng, iterations, 0, 100, &base, lapse_ns, &adapted);
+    TEST_CHECK_RET(adapted.pin_ns > base.pin_ns);
+    TEST_CHECK_RET(adapted.pin_ns <= base.pin_ns * THRASHING_ADAPT_PIN_MAX_FACTOR);
+    params->repin_pin_ns = adapted.pin_ns;
+
+    // Unpinned pages never thrash again: pages must be unpinned sooner.
+    thrashing_adapt_simulate(&rng, iterations, 0, 0, &base, lapse_ns, &adapted);
+    TEST_CHECK_RET(adapted.pin_ns == base.pin_ns / THRASHING_ADAPT_PIN_MIN_DIVISOR);
+    params->expire_pin_ns = adapted.pin_ns;
+
+    return NV_OK;
+}
+
 NV_STATUS uvm_test_get_page_thrashing_policy(UVM_TEST_GET_PAGE_THRASHING_POLICY_PARAMS *params, struct file *filp)
 {
     uvm_va_space_t *va_space = uvm_va_space_get(filp);
@@ -2078,8 +2529,8 @@ NV_STATUS uvm_test_get_page_thrashing_policy(UVM_TEST_GET_PAGE_THRASHING_POLICY_
 
     if (va_space_thrashing->params.enable) {
         params->policy = UVM_TEST_PAGE_THRASHING_POLICY_ENABLE;
-        params->nap_ns = va_space_thrashing->params.nap_ns;
-        params->pin_ns = va_space_thrashing->params.pin_ns;
+        params->nap_ns = READ_ONCE(va_space_thrashing->params.nap_ns);
+        params->pin_ns = READ_ONCE(va_space_thrashing->params.pin_ns);
         params->map_remote_on_native_atomics_fault = uvm_perf_map_remote_on_native_atomics_fault != 0;
     }
     else {
@@ -2114,6 +2565,8 @@ NV_STATUS uvm_test_set_page_thrashing_policy(UVM_TEST_SET_PAGE_THRASHING_POLICY_
 
         va_space_thrashing->params.pin_ns = params->pin_ns;
         va_space_thrashing->params.enable = true;
+
+        thrashing_adapt_reset(va_space_thrashing);
     }
     else {
         if (!va_space_thrashing->params.enable)
@@ -2125,45 +2578,12 @@ NV_STATUS uvm_test_set_page_thrashing_policy(UVM_TEST_SET_PAGE_THRASHING_POLICY_
     // When disabling thrashing detection, destroy the thrashing tracking
     // information for all VA blocks and unpin pages
     if (!va_space_thrashing->params.enable) {
-        uvm_va_range_managed_t *managed_range;
-
-        uvm_for_each_va_range_managed(managed_range, va_space) {
-            uvm_va_block_t *va_block;
-
-            for_each_va_block_in_va_range(managed_range, va_block) {
-                uvm_va_block_region_t va_block_region = uvm_va_block_region_from_block(va_block);
-                uvm_va_block_context_t *block_context = uvm_va_space_block_context(va_space, NULL);
-
-                uvm_mutex_lock(&va_block->lock);
-
-                // Unmap may split PTEs and require a retry. Needs to be called
-                // before the pinned pages information is destroyed.
-                status = UVM_VA_BLOCK_RETRY_LOCKED(va_block, NULL,
-                             uvm_perf_thrashing_unmap_remote_pinned_pages_all(va_block,
-                                                                              block_context,
-                                                                              va_block_region));
-
-                uvm_perf_thrashing_info_destroy(va_block);
-
-                uvm_mutex_unlock(&va_block->lock);
-
-                // Re-enable thrashing on failure to avoid getting asserts
-                // about having state while thrashing is disabled
-                if (status != NV_OK) {
-                    va_space_thrashing->params.enable = true;
-                    goto done_unlock_va_space;
-                }
-            }
-        }
-
-        status = uvm_hmm_clear_thrashing_policy(va_space);
+        status = thrashing_destroy_va_space_state(va_space);
 
         // Re-enable thrashing on failure to avoid getting asserts
         // about having state while thrashing is disabled
-        if (status != NV_OK) {
+        if (status != NV_OK)
             va_space_thrashing->params.enable = true;
-            goto done_unlock_va_space;
-        }
     }
 
 done_unlock_va_space:
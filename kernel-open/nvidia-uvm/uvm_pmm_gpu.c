@@ -173,6 +173,7 @@
 #include "uvm_va_block.h"
 #include "uvm_va_range.h"
 #include "uvm_test.h"
+#include "uvm_test_rng.h"
 #include "uvm_linux.h"
 
 #if defined(CONFIG_PCI_P2PDMA) && defined(NV_STRUCT_PAGE_HAS_ZONE_DEVICE_DATA)
@@ -191,6 +192,33 @@ MODULE_PARM_DESC(uvm_global_oversubscription, "Enable (1) or disable (0) global
 static unsigned uvm_perf_pma_batch_nonpinned_order = UVM_PERF_PMA_BATCH_NONPINNED_ORDER_DEFAULT;
 module_param(uvm_perf_pma_batch_nonpinned_order, uint, S_IRUGO);
 
+// Number of free root chunks that background eviction tries to keep available
+// in PMA on each GPU. 0 disables background eviction.
+static unsigned uvm_perf_pmm_evict_watermark = 0;
+module_param(uvm_perf_pmm_evict_watermark, uint, S_IRUGO);
+
+#define UVM_PERF_PMM_EVICT_BATCH_DEFAULT 4
+#define UVM_PERF_PMM_EVICT_BATCH_MAX     32
+
+// Number of root chunks evicted concurrently by background eviction. The
+// copies out of all the root chunks in a batch are issued before waiting for
+// any of them.
+static unsigned uvm_perf_pmm_evict_batch = UVM_PERF_PMM_EVICT_BATCH_DEFAULT;
+module_param(uvm_perf_pmm_evict_batch, uint, S_IRUGO);
+
+// Policy used to pick the next root chunk used by VA blocks to evict. See
+// uvm_pmm_gpu_evict_policy_t. Can be changed per GPU at runtime by tests.
+static unsigned uvm_perf_pmm_evict_policy = UVM_PMM_GPU_EVICT_POLICY_LIST;
+module_param(uvm_perf_pmm_evict_policy, uint, S_IRUGO);
+
+// Maximum value of uvm_gpu_root_chunk_t::accessed, that is, the maximum number
+// of times the CLOCK hand skips over a root chunk which is not accessed again.
+#define UVM_PMM_ROOT_CHUNK_ACCESSED_MAX 3
+
+// Maximum number of root chunks the CLOCK hand looks at under the list lock
+// when picking a root chunk to evict
+#define UVM_PMM_EVICT_CLOCK_MAX_SCAN 256
+
 // Helper type for refcounting cache
 typedef struct
 {
@@ -314,6 +342,7 @@ static NV_STATUS split_gpu_chunk(uvm_pmm_gpu_t *pmm, uvm_gpu_chunk_t *chunk);
 static void free_chunk(uvm_pmm_gpu_t *pmm, uvm_gpu_chunk_t *chunk);
 static void free_chunk_with_merges(uvm_pmm_gpu_t *pmm, uvm_gpu_chunk_t *chunk);
 static bool free_next_available_root_chunk(uvm_pmm_gpu_t *pmm, uvm_pmm_gpu_memory_type_t type);
+static void background_eviction_kick(uvm_pmm_gpu_t *pmm);
 static struct list_head *find_free_list(uvm_pmm_gpu_t *pmm,
                                         uvm_pmm_gpu_memory_type_t type,
                                         uvm_chunk_size_t chunk_size,
@@ -1447,6 +1476,66 @@ void uvm_pmm_gpu_mark_root_chunk_discarded(uvm_pmm_gpu_t *pmm, uvm_gpu_chunk_t *
     root_chunk_update_eviction_list(pmm, chunk, &pmm->root_chunks.va_block_discarded);
 }
 
+static void root_chunk_mark_accessed(uvm_gpu_root_chunk_t *root_chunk)
+{
+    NvU8 accessed = READ_ONCE(root_chunk->accessed);
+
+    // Racing updates may lose accesses, which is fine for a hint
+    if (accessed < UVM_PMM_ROOT_CHUNK_ACCESSED_MAX)
+        WRITE_ONCE(root_chunk->accessed, accessed + 1);
+}
+
+void uvm_pmm_gpu_mark_root_chunk_accessed(uvm_pmm_gpu_t *pmm, uvm_gpu_chunk_t *chunk)
+{
+    UVM_ASSERT(uvm_gpu_chunk_is_user(chunk));
+
+    if (READ_ONCE(pmm->evict_policy) == UVM_PMM_GPU_EVICT_POLICY_LIST)
+        return;
+
+    root_chunk_mark_accessed(root_chunk_from_chunk(pmm, chunk));
+}
+
+// Pick the root chunk to evict from a list of root chunks used by VA blocks,
+// ordered from the least recently marked as used. The CLOCK policy reorders the
+// list as it goes.
+//
+// The list is the used list of a PMM, and the list lock must be held, or a
+// simulated one (see uvm_test_pmm_evict_policy_replay()).
+static uvm_gpu_chunk_t *pick_used_root_chunk(struct list_head *used_list, uvm_pmm_gpu_evict_policy_t policy)
+{
+    uvm_gpu_chunk_t *chunk;
+    NvU32 i;
+
+    if (policy == UVM_PMM_GPU_EVICT_POLICY_LIST)
+        return list_first_chunk(used_list);
+
+    for (i = 0; i < UVM_PMM_EVICT_CLOCK_MAX_SCAN; i++) {
+        uvm_gpu_root_chunk_t *root_chunk;
+        NvU8 accessed;
+
+        chunk = list_first_chunk(used_list);
+        if (!chunk)
+            return NULL;
+
+        // Only root chunks are on the used list, so the chunk is embedded in
+        // its uvm_gpu_root_chunk_t.
+        UVM_ASSERT(uvm_gpu_chunk_get_size(chunk) == UVM_CHUNK_SIZE_MAX);
+        root_chunk = container_of(chunk, uvm_gpu_root_chunk_t, chunk);
+
+        accessed = READ_ONCE(root_chunk->accessed);
+        if (accessed == 0)
+            return chunk;
+
+        // Give the chunk another pass of the hand
+        WRITE_ONCE(root_chunk->accessed, accessed - 1);
+        list_move_tail(&chunk->list, used_list);
+    }
+
+    // Every chunk looked at was accessed recently. Fall back to the chunk the
+    // hand passed the longest time ago.
+    return list_first_chunk(used_list);
+}
+
 static uvm_gpu_root_chunk_t *pick_root_chunk_to_evict(uvm_pmm_gpu_t *pmm)
 {
     uvm_gpu_chunk_t *chunk;
@@ -1483,7 +1572,7 @@ static uvm_gpu_root_chunk_t *pick_root_chunk_to_evict(uvm_pmm_gpu_t *pmm)
     // TODO: Bug 1765193: Move the chunks to the tail of the used list whenever
     // they get mapped.
     if (!chunk)
-        chunk = list_first_chunk(&pmm->root_chunks.va_block_used);
+        chunk = pick_used_root_chunk(&pmm->root_chunks.va_block_used, pmm->evict_policy);
 
     if (chunk)
         chunk_start_eviction(pmm, chunk);
@@ -1570,6 +1659,129 @@ static NV_STATUS pick_and_evict_root_chunk_retry(uvm_pmm_gpu_t *pmm,
     return status;
 }
 
+static bool background_eviction_needed(uvm_pmm_gpu_t *pmm)
+{
+    if (pmm->background_eviction.watermark == 0)
+        return false;
+
+    return READ_ONCE(pmm->pma_stats->numFreePages2m) < pmm->background_eviction.watermark;
+}
+
+// Evict up to batch_size root chunks and return them to PMA. All the root
+// chunks are evicted before any of them is freed, so that the copies out of
+// the root chunks overlap. Returns the number of root chunks returned to PMA.
+static NvU32 background_evict_batch(uvm_pmm_gpu_t *pmm)
+{
+    uvm_gpu_root_chunk_t *root_chunks[UVM_PERF_PMM_EVICT_BATCH_MAX];
+    NvU32 num_root_chunks = 0;
+    NvU32 i;
+
+    UVM_ASSERT(pmm->background_eviction.batch_size <= ARRAY_SIZE(root_chunks));
+
+    uvm_mutex_lock(&pmm->lock);
+
+    for (i = 0; i < pmm->background_eviction.batch_size; ++i) {
+        uvm_gpu_root_chunk_t *root_chunk = pick_root_chunk_to_evict(pmm);
+        NV_STATUS status;
+
+        if (!root_chunk)
+            break;
+
+        // Chunks picked for eviction are pinned once evict_root_chunk()
+        // returns NV_OK and their copies out are tracked by the root chunk
+        // tracker. On error, the root chunk has already been put back on an
+        // eviction list or freed.
+        status = evict_root_chunk(pmm, root_chunk, PMM_CONTEXT_DEFAULT);
+        if (status == NV_ERR_IN_USE)
+            continue;
+        if (status != NV_OK)
+            break;
+
+        root_chunks[num_root_chunks++] = root_chunk;
+    }
+
+    uvm_mutex_unlock(&pmm->lock);
+
+    // free_root_chunk() waits for the root chunk tracker before returning it to
+    // PMA
+    for (i = 0; i < num_root_chunks; ++i)
+        free_root_chunk(pmm, root_chunks[i], FREE_ROOT_CHUNK_MODE_DEFAULT);
+
+    atomic64_add(num_root_chunks, &pmm->background_eviction.num_evicted);
+
+    return num_root_chunks;
+}
+
+static void background_evict(uvm_pmm_gpu_t *pmm)
+{
+    while (background_eviction_needed(pmm)) {
+        if (uvm_global_get_status() != NV_OK)
+            break;
+
+        // Stop if nothing can be evicted. The next allocation will kick the
+        // eviction again.
+        if (background_evict_batch(pmm) == 0)
+            break;
+    }
+}
+
+static void background_evict_entry(void *args)
+{
+    UVM_ENTRY_VOID(background_evict(args));
+}
+
+static void background_eviction_kick(uvm_pmm_gpu_t *pmm)
+{
+    if (!background_eviction_needed(pmm))
+        return;
+
+    // This is a no-op if the eviction is already scheduled
+    nv_kthread_q_schedule_q_item(&pmm->background_eviction.q, &pmm->background_eviction.q_item);
+}
+
+static NV_STATUS background_eviction_init(uvm_pmm_gpu_t *pmm)
+{
+    uvm_gpu_t *gpu = uvm_pmm_to_gpu(pmm);
+    char kthread_name[TASK_COMM_LEN + 1];
+    NvU32 batch_size;
+    NV_STATUS status;
+
+    if (uvm_perf_pmm_evict_watermark == 0 || !pmm->pma_stats || !uvm_parent_gpu_supports_eviction(gpu->parent))
+        return NV_OK;
+
+    batch_size = max(uvm_perf_pmm_evict_batch, 1u);
+    batch_size = min(batch_size, (NvU32)UVM_PERF_PMM_EVICT_BATCH_MAX);
+    if (batch_size != uvm_perf_pmm_evict_batch) {
+        UVM_INFO_PRINT("Invalid uvm_perf_pmm_evict_batch value on GPU %s: %u. Valid range [1:%u] Using %u instead\n",
+                       uvm_gpu_name(gpu),
+                       uvm_perf_pmm_evict_batch,
+                       UVM_PERF_PMM_EVICT_BATCH_MAX,
+                       batch_size);
+    }
+
+    nv_kthread_q_item_init(&pmm->background_eviction.q_item, background_evict_entry, pmm);
+
+    snprintf(kthread_name, sizeof(kthread_name), "UVM GPU%u evict", uvm_id_value(gpu->id));
+    status = errno_to_nv_status(nv_kthread_q_init_on_node(&pmm->background_eviction.q,
+                                                          kthread_name,
+                                                          gpu->parent->closest_cpu_numa_node));
+    if (status != NV_OK)
+        return status;
+
+    // Only enable the eviction once the queue can accept work
+    pmm->background_eviction.batch_size = batch_size;
+    pmm->background_eviction.watermark = uvm_perf_pmm_evict_watermark;
+
+    return NV_OK;
+}
+
+static void background_eviction_deinit(uvm_pmm_gpu_t *pmm)
+{
+    pmm->background_eviction.watermark = 0;
+
+    nv_kthread_q_stop(&pmm->background_eviction.q);
+}
+
 static uvm_gpu_chunk_t *find_free_chunk_locked(uvm_pmm_gpu_t *pmm,
                                                uvm_pmm_gpu_memory_type_t type,
                                                uvm_chunk_size_t chunk_size,
@@ -1665,8 +1877,12 @@ static NV_STATUS alloc_or_evict_root_chunk(uvm_pmm_gpu_t *pmm,
 
     status = alloc_root_chunk(pmm, type, flags, &chunk);
     if (status != NV_OK) {
-        if ((flags & UVM_PMM_ALLOC_FLAGS_EVICT) && uvm_parent_gpu_supports_eviction(gpu->parent))
+        if ((flags & UVM_PMM_ALLOC_FLAGS_EVICT) && uvm_parent_gpu_supports_eviction(gpu->parent)) {
+            atomic64_inc(&pmm->background_eviction.num_sync_evictions);
+            background_eviction_kick(pmm);
+
             status = pick_and_evict_root_chunk_retry(pmm, type, PMM_CONTEXT_DEFAULT, chunk_out);
+        }
 
         return status;
     }
@@ -1688,6 +1904,9 @@ static NV_STATUS alloc_or_evict_root_chunk_unlocked(uvm_pmm_gpu_t *pmm,
     status = alloc_root_chunk(pmm, type, flags, &chunk);
     if (status != NV_OK) {
         if ((flags & UVM_PMM_ALLOC_FLAGS_EVICT) && uvm_parent_gpu_supports_eviction(gpu->parent)) {
+            atomic64_inc(&pmm->background_eviction.num_sync_evictions);
+            background_eviction_kick(pmm);
+
             uvm_mutex_lock(&pmm->lock);
             status = pick_and_evict_root_chunk_retry(pmm, type, PMM_CONTEXT_DEFAULT, chunk_out);
             uvm_mutex_unlock(&pmm->lock);
@@ -1855,6 +2074,7 @@ static void init_root_chunk(uvm_pmm_gpu_t *pmm,
     root_chunk_lock(pmm, root_chunk);
 
     uvm_tracker_init(&root_chunk->tracker);
+    root_chunk->accessed = 0;
 
     uvm_spin_lock(&pmm->list_lock);
 
@@ -1999,6 +2219,9 @@ exit_unlock:
     if (used_kmem_cache)
         kmem_cache_free(g_pma_address_batch_cache_ref.cache, pas);
 
+    if (status == NV_OK)
+        background_eviction_kick(pmm);
+
     return status;
 }
 
@@ -3570,6 +3793,17 @@ NV_STATUS uvm_pmm_gpu_init(uvm_pmm_gpu_t *pmm)
     uvm_init_rwsem(&pmm->pma_lock, UVM_LOCK_ORDER_PMM_PMA);
     uvm_spin_lock_init(&pmm->list_lock, UVM_LOCK_ORDER_LEAF);
 
+    if (uvm_perf_pmm_evict_policy < UVM_PMM_GPU_EVICT_POLICY_COUNT) {
+        pmm->evict_policy = uvm_perf_pmm_evict_policy;
+    }
+    else {
+        UVM_INFO_PRINT("Invalid uvm_perf_pmm_evict_policy value on GPU %s: %u. Using %u instead\n",
+                       uvm_gpu_name(gpu),
+                       uvm_perf_pmm_evict_policy,
+                       UVM_PMM_GPU_EVICT_POLICY_LIST);
+        pmm->evict_policy = UVM_PMM_GPU_EVICT_POLICY_LIST;
+    }
+
     pmm->initialized = true;
 
     for (i = 0; i < UVM_PMM_GPU_MEMORY_TYPE_COUNT; i++) {
@@ -3641,6 +3875,10 @@ NV_STATUS uvm_pmm_gpu_init(uvm_pmm_gpu_t *pmm)
             if (status != NV_OK)
                 goto cleanup;
         }
+
+        status = background_eviction_init(pmm);
+        if (status != NV_OK)
+            goto cleanup;
     }
 
     return NV_OK;
@@ -3678,6 +3916,8 @@ void uvm_pmm_gpu_deinit(uvm_pmm_gpu_t *pmm)
 
     gpu = uvm_pmm_to_gpu(pmm);
 
+    background_eviction_deinit(pmm);
+
     nv_kthread_q_flush(&gpu->parent->lazy_free_q);
     UVM_ASSERT(list_empty(&pmm->root_chunks.va_block_lazy_free));
     UVM_ASSERT(uvm_pmm_gpu_check_orphan_pages(pmm));
@@ -4073,3 +4313,163 @@ NV_STATUS uvm_test_pmm_query_pma_stats(UVM_TEST_PMM_QUERY_PMA_STATS_PARAMS *para
     uvm_gpu_release(gpu);
     return NV_OK;
 }
+
+NV_STATUS uvm_test_pmm_set_evict_policy(UVM_TEST_PMM_SET_EVICT_POLICY_PARAMS *params, struct file *filp)
+{
+    uvm_gpu_t *gpu;
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+
+    if (params->policy >= UVM_PMM_GPU_EVICT_POLICY_COUNT)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    gpu = uvm_va_space_retain_gpu_by_uuid(va_space, &params->gpu_uuid);
+    if (!gpu)
+        return NV_ERR_INVALID_DEVICE;
+
+    uvm_spin_lock(&gpu->pmm.list_lock);
+    WRITE_ONCE(gpu->pmm.evict_policy, params->policy);
+    uvm_spin_unlock(&gpu->pmm.list_lock);
+
+    uvm_gpu_release(gpu);
+    return NV_OK;
+}
+
+#define EVICT_POLICY_REPLAY_MAX_CAPACITY    (1 << 16)
+#define EVICT_POLICY_REPLAY_MAX_WORKING_SET (1 << 20)
+#define EVICT_POLICY_REPLAY_MAX_ACCESSES    (1ULL << 26)
+#define EVICT_POLICY_REPLAY_NOT_RESIDENT    ((NvU32)-1)
+
+// Next VA block accessed by the trace: either a random block of the hot set,
+// or the next block of a sequential scan over the remaining blocks.
+static NvU32 evict_policy_replay_next_block(UVM_TEST_PMM_EVICT_POLICY_REPLAY_PARAMS *params,
+                                            uvm_test_rng_t *rng,
+                                            NvU32 *scan_next)
+{
+    NvU32 block;
+
+    if (params->hot_set == params->working_set ||
+        (params->hot_set > 0 && uvm_test_rng_range_32(rng, 0, 99) < params->hot_percent))
+        return uvm_test_rng_range_32(rng, 0, params->hot_set - 1);
+
+    block = *scan_next;
+    if (++(*scan_next) == params->working_set)
+        *scan_next = params->hot_set;
+
+    return block;
+}
+
+// Replay the trace through a simulated GPU memory of params->capacity root
+// chunks, each holding one VA block, and return the number of accesses which
+// found their VA block resident. Misses model a fault migrating the VA block
+// in, evicting a root chunk picked by the policy if the memory is full.
+static NV_STATUS evict_policy_replay(UVM_TEST_PMM_EVICT_POLICY_REPLAY_PARAMS *params,
+                                     uvm_pmm_gpu_evict_policy_t policy,
+                                     NvU64 *out_hits)
+{
+    uvm_test_rng_t rng;
+    uvm_gpu_root_chunk_t *root_chunks;
+    NvU32 *block_to_slot = NULL;
+    NvU32 *slot_to_block = NULL;
+    LIST_HEAD(used_list);
+    NvU32 num_used = 0;
+    NvU32 scan_next = params->hot_set;
+    NvU64 hits = 0;
+    NvU64 i;
+    NV_STATUS status = NV_OK;
+
+    root_chunks = uvm_kvmalloc_zero(sizeof(*root_chunks) * params->capacity);
+    slot_to_block = uvm_kvmalloc(sizeof(*slot_to_block) * params->capacity);
+    block_to_slot = uvm_kvmalloc(sizeof(*block_to_slot) * params->working_set);
+    if (!root_chunks || !slot_to_block || !block_to_slot) {
+        status = NV_ERR_NO_MEMORY;
+        goto done;
+    }
+
+    for (i = 0; i < params->capacity; i++) {
+        INIT_LIST_HEAD(&root_chunks[i].chunk.list);
+        uvm_gpu_chunk_set_size(&root_chunks[i].chunk, UVM_CHUNK_SIZE_MAX);
+    }
+
+    for (i = 0; i < params->working_set; i++)
+        block_to_slot[i] = EVICT_POLICY_REPLAY_NOT_RESIDENT;
+
+    uvm_test_rng_init(&rng, params->seed);
+
+    for (i = 0; i < params->accesses; i++) {
+        NvU32 block = evict_policy_replay_next_block(params, &rng, &scan_next);
+        NvU32 slot = block_to_slot[block];
+
+        if (slot == EVICT_POLICY_REPLAY_NOT_RESIDENT) {
+            if (num_used < params->capacity) {
+                slot = num_used++;
+            }
+            else {
+                uvm_gpu_chunk_t *victim = pick_used_root_chunk(&used_list, policy);
+
+                TEST_CHECK_GOTO(victim, done);
+
+                slot = container_of(victim, uvm_gpu_root_chunk_t, chunk) - root_chunks;
+                TEST_CHECK_GOTO(slot < num_used, done);
+
+                block_to_slot[slot_to_block[slot]] = EVICT_POLICY_REPLAY_NOT_RESIDENT;
+                list_del_init(&victim->list);
+            }
+
+            block_to_slot[block] = slot;
+            slot_to_block[slot] = block;
+            root_chunks[slot].accessed = 0;
+
+            // Migrating the VA block in marks its root chunk as used
+            list_add_tail(&root_chunks[slot].chunk.list, &used_list);
+        }
+        else {
+            ++hits;
+        }
+
+        // Servicing the fault marks the root chunk as accessed
+        root_chunk_mark_accessed(&root_chunks[slot]);
+    }
+
+    *out_hits = hits;
+
+done:
+    uvm_kvfree(block_to_slot);
+    uvm_kvfree(slot_to_block);
+    uvm_kvfree(root_chunks);
+
+    return status;
+}
+
+NV_STATUS uvm_test_pmm_evict_policy_replay(UVM_TEST_PMM_EVICT_POLICY_REPLAY_PARAMS *params, struct file *filp)
+{
+    NV_STATUS status;
+
+    if (params->capacity == 0 ||
+        params->capacity > EVICT_POLICY_REPLAY_MAX_CAPACITY ||
+        params->working_set == 0 ||
+        params->working_set > EVICT_POLICY_REPLAY_MAX_WORKING_SET ||
+        params->hot_set > params->working_set ||
+        params->hot_percent > 100 ||
+        params->accesses > EVICT_POLICY_REPLAY_MAX_ACCESSES)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    status = evict_policy_replay(params, UVM_PMM_GPU_EVICT_POLICY_LIST, &params->list_hits);
+    if (status != NV_OK)
+        return status;
+
+    status = evict_policy_replay(params, UVM_PMM_GPU_EVICT_POLICY_CLOCK, &params->clock_hits);
+    if (status != NV_OK)
+        return status;
+
+    TEST_CHECK_RET(params->list_hits <= params->accesses);
+    TEST_CHECK_RET(params->clock_hits <= params->accesses);
+
+    // Once the memory is warm, a trace which fits in it never misses,
+    // regardless of the policy.
+    if (params->working_set <= params->capacity) {
+        TEST_CHECK_RET(params->list_hits == params->clock_hits);
+        TEST_CHECK_RET(params->accesses - params->list_hits <= params->working_set);
+    }
+
+    return NV_OK;
+}
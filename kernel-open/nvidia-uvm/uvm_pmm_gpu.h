@@ -321,8 +321,33 @@ typedef struct uvm_gpu_root_chunk_struct
     //
     // Protected by the corresponding root chunk bit lock.
     uvm_tracker_t tracker;
+
+    // Saturating count of the accesses to the root chunk recently reported
+    // with uvm_pmm_gpu_mark_root_chunk_accessed(). Used by
+    // UVM_PMM_GPU_EVICT_POLICY_CLOCK, which decrements it each time the chunk
+    // is skipped over when looking for an eviction victim.
+    //
+    // Updated without synchronization, the count is only a hint.
+    NvU8 accessed;
 } uvm_gpu_root_chunk_t;
 
+// Policies for choosing which root chunk used by VA blocks to evict next.
+// Unused and discarded root chunks are always evicted first.
+typedef enum
+{
+    // Evict the root chunk least recently marked as used, that is, the one
+    // which least recently had pages migrated to it.
+    UVM_PMM_GPU_EVICT_POLICY_LIST,
+
+    // Second-chance CLOCK over the used list, weighted by access frequency:
+    // root chunks accessed since the hand last passed them are moved to the
+    // tail of the list instead of being evicted. Accesses are reported by
+    // fault servicing and by access counter notifications.
+    UVM_PMM_GPU_EVICT_POLICY_CLOCK,
+
+    UVM_PMM_GPU_EVICT_POLICY_COUNT
+} uvm_pmm_gpu_evict_policy_t;
+
 typedef struct uvm_pmm_gpu_struct
 {
     // Sizes of the MMU
@@ -376,6 +401,34 @@ typedef struct uvm_pmm_gpu_struct
         nv_kthread_q_item_t va_block_lazy_free_q_item;
     } root_chunks;
 
+    // Background eviction of root chunks. When the number of free root chunks
+    // in PMA drops below the watermark, a kthread evicts batches of root
+    // chunks ahead of demand, so that allocations only need to evict
+    // synchronously once PMA runs out of memory.
+    struct
+    {
+        // Number of free root chunks to keep available in PMA. 0 if background
+        // eviction is disabled.
+        NvU32 watermark;
+
+        // Maximum number of root chunks whose eviction copies are in flight at
+        // the same time
+        NvU32 batch_size;
+
+        nv_kthread_q_t q;
+        nv_kthread_q_item_t q_item;
+
+        // Number of root chunks evicted in the background
+        atomic64_t num_evicted;
+
+        // Number of allocations that had to evict synchronously
+        atomic64_t num_sync_evictions;
+    } background_eviction;
+
+    // Policy used to pick root chunks to evict from root_chunks.va_block_used.
+    // Read under list_lock.
+    uvm_pmm_gpu_evict_policy_t evict_policy;
+
     // Lock protecting PMA allocation, freeing and eviction
     uvm_rw_semaphore_t pma_lock;
 
@@ -565,6 +618,14 @@ void uvm_pmm_gpu_mark_chunk_evicted(uvm_pmm_gpu_t *pmm, uvm_gpu_chunk_t *chunk);
 // Allow that state to make this API easy to use for the caller.
 void uvm_pmm_gpu_mark_root_chunk_used(uvm_pmm_gpu_t *pmm, uvm_gpu_chunk_t *chunk);
 
+// Record an access to the root chunk containing the given user chunk. The
+// access is only taken into account by eviction policies other than
+// UVM_PMM_GPU_EVICT_POLICY_LIST.
+//
+// This is cheap enough to be called on every serviced fault: it doesn't take
+// any locks.
+void uvm_pmm_gpu_mark_root_chunk_accessed(uvm_pmm_gpu_t *pmm, uvm_gpu_chunk_t *chunk);
+
 // Mark an allocated user chunk as unused
 void uvm_pmm_gpu_mark_root_chunk_unused(uvm_pmm_gpu_t *pmm, uvm_gpu_chunk_t *chunk);
 
@@ -21,6 +21,8 @@
 
 *******************************************************************************/
 
+#include "uvm_api.h"
+#include "uvm_global.h"
 #include "uvm_gpu.h"
 #include "uvm_pmm_sysmem.h"
 #include "uvm_kvmalloc.h"
@@ -31,6 +33,379 @@ static int uvm_cpu_chunk_allocation_sizes = UVM_CPU_CHUNK_SIZES;
 module_param(uvm_cpu_chunk_allocation_sizes, uint, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(uvm_cpu_chunk_allocation_sizes, "OR'ed value of all CPU chunk allocation sizes.");
 
+#define UVM_CPU_CHUNK_POOL_MAX_CHUNKS 1024
+
+static unsigned uvm_cpu_chunk_pool_2m = 0;
+module_param(uvm_cpu_chunk_pool_2m, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_cpu_chunk_pool_2m, "Number of 2MB CPU chunks kept in reserve on each NUMA node.");
+
+static unsigned uvm_cpu_chunk_pool_64k = 0;
+module_param(uvm_cpu_chunk_pool_64k, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_cpu_chunk_pool_64k, "Number of 64KB CPU chunks kept in reserve on each NUMA node.");
+
+// Sizes of the chunks kept by the CPU chunk pool, largest first
+static const uvm_chunk_size_t g_cpu_chunk_pool_sizes[] = { UVM_PAGE_SIZE_2M, UVM_PAGE_SIZE_64K };
+
+#define UVM_CPU_CHUNK_POOL_SIZE_COUNT ARRAY_SIZE(g_cpu_chunk_pool_sizes)
+
+typedef struct
+{
+    // Physical chunks ready to be handed out. Each one is DMA-mapped on one
+    // GPU of every parent GPU retained when the chunk was added to the pool.
+    uvm_cpu_chunk_t **chunks;
+    NvU32 count;
+
+    // Number of chunks the refill tries to keep in the pool. 0 if the size is
+    // not pooled.
+    NvU32 target;
+} uvm_cpu_chunk_pool_list_t;
+
+typedef struct
+{
+    int nid;
+
+    uvm_cpu_chunk_pool_list_t lists[UVM_CPU_CHUNK_POOL_SIZE_COUNT];
+
+    nv_kthread_q_item_t refill_q_item;
+} uvm_cpu_chunk_pool_node_t;
+
+// Reserve of preallocated large CPU chunks on each NUMA node with memory.
+// Large allocations from the kernel can fail or stall on compaction under
+// fragmentation, and creating their DMA mappings can be expensive with an
+// IOMMU. The pool is refilled in the background and its chunks are mapped on
+// the GPUs ahead of time, so that taking a chunk from it does neither.
+static struct
+{
+    // Protects the lists of all the nodes and the DMA mappings of the pooled
+    // chunks. GPU removal takes this lock to unmap the pooled chunks, so the
+    // GPUs with a mapping on a pooled chunk stay valid while it's held.
+    uvm_mutex_t lock;
+
+    nv_kthread_q_t refill_q;
+
+    uvm_cpu_chunk_pool_node_t *nodes[MAX_NUMNODES];
+
+    bool enabled;
+} g_cpu_chunk_pool;
+
+static NV_STATUS cpu_chunk_map_gpu_phys(uvm_cpu_chunk_t *chunk, uvm_gpu_t *gpu);
+static void cpu_chunk_unmap_gpu_phys(uvm_cpu_chunk_t *chunk, uvm_gpu_id_t gpu_id);
+static uvm_cpu_phys_mapping_t *chunk_phys_mapping_get(uvm_cpu_physical_chunk_t *chunk, uvm_parent_gpu_id_t id);
+
+// Map the chunk on one GPU of every retained parent GPU. Mapping failures are
+// not fatal, the mapping will be created when the chunk is used.
+static void cpu_chunk_pool_map_gpus(uvm_cpu_chunk_t *chunk)
+{
+    uvm_parent_processor_mask_t mapped_parents;
+    uvm_gpu_t *gpu;
+
+    uvm_assert_mutex_locked(&g_uvm_global.global_lock);
+
+    // DMA mappings of CPU chunks are not used when the Confidential Computing
+    // feature is enabled.
+    if (g_uvm_global.conf_computing_enabled)
+        return;
+
+    uvm_parent_processor_mask_zero(&mapped_parents);
+
+    for_each_gpu_in_mask(gpu, &g_uvm_global.retained_gpus) {
+        if (uvm_parent_processor_mask_test_and_set(&mapped_parents, gpu->parent->id))
+            continue;
+
+        (void)cpu_chunk_map_gpu_phys(chunk, gpu);
+    }
+}
+
+// Remove the DMA mappings of a pooled chunk for all the GPUs not in keep_gpus
+static void cpu_chunk_pool_unmap_gpus(uvm_cpu_chunk_t *chunk, const uvm_processor_mask_t *keep_gpus)
+{
+    uvm_cpu_physical_chunk_t *phys_chunk = uvm_cpu_chunk_to_physical(chunk);
+    uvm_processor_mask_t unmap_gpus;
+    uvm_parent_processor_id_t parent_id;
+    uvm_gpu_id_t gpu_id;
+
+    uvm_assert_mutex_locked(&g_cpu_chunk_pool.lock);
+
+    uvm_processor_mask_zero(&unmap_gpus);
+
+    uvm_mutex_lock(&phys_chunk->lock);
+
+    for_each_parent_id_in_mask(parent_id, &phys_chunk->gpu_mappings.dma_addrs_mask) {
+        uvm_cpu_phys_mapping_t *mapping = chunk_phys_mapping_get(phys_chunk, parent_id);
+        NvU32 sub_index;
+
+        for_each_sub_processor_index_in_mask(sub_index, &mapping->sub_processors) {
+            gpu_id = uvm_gpu_id_from_sub_processor(parent_id, sub_index);
+            if (!keep_gpus || !uvm_processor_mask_test(keep_gpus, gpu_id))
+                uvm_processor_mask_set(&unmap_gpus, gpu_id);
+        }
+    }
+
+    uvm_mutex_unlock(&phys_chunk->lock);
+
+    for_each_gpu_id_in_mask(gpu_id, &unmap_gpus)
+        cpu_chunk_unmap_gpu_phys(chunk, gpu_id);
+}
+
+static void cpu_chunk_pool_refill(void *args)
+{
+    uvm_cpu_chunk_pool_node_t *node = (uvm_cpu_chunk_pool_node_t *)args;
+    size_t i;
+
+    for (i = 0; i < UVM_CPU_CHUNK_POOL_SIZE_COUNT; i++) {
+        uvm_cpu_chunk_pool_list_t *list = &node->lists[i];
+
+        while (READ_ONCE(list->count) < list->target) {
+            uvm_cpu_chunk_t *chunk;
+            NV_STATUS status;
+
+            // The refill is off the critical path, so let the kernel compact
+            // memory if needed. Pooled chunks are zeroed so they can satisfy
+            // any allocation.
+            status = uvm_cpu_chunk_alloc(g_cpu_chunk_pool_sizes[i],
+                                         UVM_CPU_CHUNK_ALLOC_FLAGS_ZERO |
+                                         UVM_CPU_CHUNK_ALLOC_FLAGS_STRICT |
+                                         UVM_CPU_CHUNK_ALLOC_FLAGS_RECLAIM,
+                                         node->nid,
+                                         &chunk);
+            if (status != NV_OK)
+                break;
+
+            // The global lock keeps the set of retained GPUs stable until the
+            // chunk is visible to GPU removal.
+            uvm_mutex_lock(&g_uvm_global.global_lock);
+
+            cpu_chunk_pool_map_gpus(chunk);
+
+            uvm_mutex_lock(&g_cpu_chunk_pool.lock);
+            if (list->count < list->target) {
+                list->chunks[list->count++] = chunk;
+                chunk = NULL;
+            }
+            uvm_mutex_unlock(&g_cpu_chunk_pool.lock);
+
+            // Freeing the chunk destroys its DMA mappings, which requires the
+            // GPUs to still be there.
+            uvm_cpu_chunk_free(chunk);
+
+            uvm_mutex_unlock(&g_uvm_global.global_lock);
+        }
+    }
+}
+
+static void cpu_chunk_pool_refill_entry(void *args)
+{
+    UVM_ENTRY_VOID(cpu_chunk_pool_refill(args));
+}
+
+static NvU32 cpu_chunk_pool_target(uvm_chunk_size_t size)
+{
+    unsigned target = (size == UVM_PAGE_SIZE_2M) ? uvm_cpu_chunk_pool_2m : uvm_cpu_chunk_pool_64k;
+
+    // PAGE_SIZE chunks are cheap to allocate and are not pooled
+    if (size <= PAGE_SIZE || !(uvm_cpu_chunk_get_allocation_sizes() & size))
+        return 0;
+
+    if (target > UVM_CPU_CHUNK_POOL_MAX_CHUNKS) {
+        UVM_INFO_PRINT("Invalid value %u for the %uKB CPU chunk pool. Using %u instead\n",
+                       target,
+                       size / 1024,
+                       UVM_CPU_CHUNK_POOL_MAX_CHUNKS);
+        target = UVM_CPU_CHUNK_POOL_MAX_CHUNKS;
+    }
+
+    return target;
+}
+
+static void cpu_chunk_pool_deinit(void)
+{
+    int nid;
+
+    if (!g_cpu_chunk_pool.enabled)
+        return;
+
+    nv_kthread_q_stop(&g_cpu_chunk_pool.refill_q);
+
+    for_each_possible_uvm_node(nid) {
+        uvm_cpu_chunk_pool_node_t *node = g_cpu_chunk_pool.nodes[nid];
+        size_t i;
+
+        if (!node)
+            continue;
+
+        for (i = 0; i < UVM_CPU_CHUNK_POOL_SIZE_COUNT; i++) {
+            uvm_cpu_chunk_pool_list_t *list = &node->lists[i];
+
+            // All the GPUs are gone, and so are the DMA mappings
+            while (list->count > 0)
+                uvm_cpu_chunk_free(list->chunks[--list->count]);
+
+            uvm_kvfree(list->chunks);
+        }
+
+        uvm_kvfree(node);
+        g_cpu_chunk_pool.nodes[nid] = NULL;
+    }
+
+    g_cpu_chunk_pool.enabled = false;
+}
+
+static NV_STATUS cpu_chunk_pool_init(void)
+{
+    NvU32 targets[UVM_CPU_CHUNK_POOL_SIZE_COUNT];
+    bool any_target = false;
+    NV_STATUS status;
+    size_t i;
+    int nid;
+
+    uvm_mutex_init(&g_cpu_chunk_pool.lock, UVM_LOCK_ORDER_CPU_CHUNK_POOL);
+
+    for (i = 0; i < UVM_CPU_CHUNK_POOL_SIZE_COUNT; i++) {
+        targets[i] = cpu_chunk_pool_target(g_cpu_chunk_pool_sizes[i]);
+        if (targets[i] > 0)
+            any_target = true;
+    }
+
+    if (!any_target)
+        return NV_OK;
+
+    status = errno_to_nv_status(nv_kthread_q_init(&g_cpu_chunk_pool.refill_q, "UVM CPU chunk pool"));
+    if (status != NV_OK)
+        return status;
+
+    // Nothing can allocate from the pool until module initialization is over,
+    // so it's safe to enable it while the nodes are still being set up.
+    g_cpu_chunk_pool.enabled = true;
+
+    for_each_possible_uvm_node(nid) {
+        uvm_cpu_chunk_pool_node_t *node;
+
+        if (!node_state(nid, N_MEMORY))
+            continue;
+
+        node = uvm_kvmalloc_zero(sizeof(*node));
+        if (!node) {
+            status = NV_ERR_NO_MEMORY;
+            goto error;
+        }
+
+        g_cpu_chunk_pool.nodes[nid] = node;
+        node->nid = nid;
+        nv_kthread_q_item_init(&node->refill_q_item, cpu_chunk_pool_refill_entry, node);
+
+        for (i = 0; i < UVM_CPU_CHUNK_POOL_SIZE_COUNT; i++) {
+            uvm_cpu_chunk_pool_list_t *list = &node->lists[i];
+
+            if (targets[i] == 0)
+                continue;
+
+            list->chunks = uvm_kvmalloc(targets[i] * sizeof(*list->chunks));
+            if (!list->chunks) {
+                status = NV_ERR_NO_MEMORY;
+                goto error;
+            }
+
+            list->target = targets[i];
+        }
+    }
+
+    for_each_possible_uvm_node(nid) {
+        if (g_cpu_chunk_pool.nodes[nid])
+            nv_kthread_q_schedule_q_item(&g_cpu_chunk_pool.refill_q, &g_cpu_chunk_pool.nodes[nid]->refill_q_item);
+    }
+
+    return NV_OK;
+
+error:
+    cpu_chunk_pool_deinit();
+    return status;
+}
+
+NV_STATUS uvm_cpu_chunk_pool_alloc(uvm_chunk_size_t alloc_size,
+                                   int nid,
+                                   const uvm_processor_mask_t *keep_gpus,
+                                   uvm_cpu_chunk_t **new_chunk)
+{
+    uvm_cpu_chunk_pool_node_t *node;
+    uvm_cpu_chunk_pool_list_t *list = NULL;
+    uvm_cpu_chunk_t *chunk = NULL;
+    size_t i;
+
+    if (!g_cpu_chunk_pool.enabled)
+        return NV_ERR_NO_MEMORY;
+
+    if (nid == NUMA_NO_NODE)
+        nid = numa_mem_id();
+
+    node = g_cpu_chunk_pool.nodes[nid];
+    if (!node)
+        return NV_ERR_NO_MEMORY;
+
+    for (i = 0; i < UVM_CPU_CHUNK_POOL_SIZE_COUNT; i++) {
+        if (g_cpu_chunk_pool_sizes[i] == alloc_size)
+            list = &node->lists[i];
+    }
+
+    if (!list || list->target == 0)
+        return NV_ERR_NO_MEMORY;
+
+    uvm_mutex_lock(&g_cpu_chunk_pool.lock);
+
+    if (list->count > 0) {
+        chunk = list->chunks[--list->count];
+
+        // Only keep the mappings the caller is going to track. The others
+        // could outlive their GPU.
+        cpu_chunk_pool_unmap_gpus(chunk, keep_gpus);
+    }
+
+    uvm_mutex_unlock(&g_cpu_chunk_pool.lock);
+
+    // This is a no-op if the refill is already scheduled
+    nv_kthread_q_schedule_q_item(&g_cpu_chunk_pool.refill_q, &node->refill_q_item);
+
+    if (!chunk)
+        return NV_ERR_NO_MEMORY;
+
+    *new_chunk = chunk;
+    return NV_OK;
+}
+
+bool uvm_cpu_chunk_pool_enabled(void)
+{
+    return g_cpu_chunk_pool.enabled;
+}
+
+void uvm_cpu_chunk_pool_unmap_gpu(uvm_gpu_t *gpu)
+{
+    int nid;
+
+    uvm_assert_mutex_locked(&g_uvm_global.global_lock);
+
+    if (!g_cpu_chunk_pool.enabled)
+        return;
+
+    uvm_mutex_lock(&g_cpu_chunk_pool.lock);
+
+    for_each_possible_uvm_node(nid) {
+        uvm_cpu_chunk_pool_node_t *node = g_cpu_chunk_pool.nodes[nid];
+        size_t i;
+
+        if (!node)
+            continue;
+
+        for (i = 0; i < UVM_CPU_CHUNK_POOL_SIZE_COUNT; i++) {
+            uvm_cpu_chunk_pool_list_t *list = &node->lists[i];
+            NvU32 j;
+
+            for (j = 0; j < list->count; j++)
+                cpu_chunk_unmap_gpu_phys(list->chunks[j], gpu->id);
+        }
+    }
+
+    uvm_mutex_unlock(&g_cpu_chunk_pool.lock);
+}
+
 NV_STATUS uvm_pmm_sysmem_init(void)
 {
     // Ensure that only supported CPU chunk sizes are enabled.
@@ -42,11 +417,12 @@ NV_STATUS uvm_pmm_sysmem_init(void)
         uvm_cpu_chunk_allocation_sizes = UVM_CPU_CHUNK_SIZES;
     }
 
-    return NV_OK;
+    return cpu_chunk_pool_init();
 }
 
 void uvm_pmm_sysmem_exit(void)
 {
+    cpu_chunk_pool_deinit();
 }
 
 uvm_chunk_sizes_mask_t uvm_cpu_chunk_get_allocation_sizes(void)
@@ -455,11 +831,19 @@ static struct page *uvm_cpu_chunk_alloc_page(uvm_chunk_size_t alloc_size,
 
     // For allocation sizes higher than PAGE_SIZE, use __GFP_NORETRY in order
     // to avoid higher allocation latency from the kernel compacting memory to
-    // satisfy the request.
+    // satisfy the request, unless the caller asked for it.
     // Use __GFP_NOWARN to avoid printing allocation failure to the kernel log.
     // High order allocation failures are handled gracefully by the caller.
-    if (alloc_size > PAGE_SIZE)
-        kernel_alloc_flags |= __GFP_COMP | __GFP_NORETRY | __GFP_NOWARN;
+    if (alloc_size > PAGE_SIZE) {
+        kernel_alloc_flags |= __GFP_COMP | __GFP_NOWARN;
+
+#if defined(__GFP_RETRY_MAYFAIL)
+        if (alloc_flags & UVM_CPU_CHUNK_ALLOC_FLAGS_RECLAIM)
+            kernel_alloc_flags |= __GFP_RETRY_MAYFAIL;
+        else
+#endif
+            kernel_alloc_flags |= __GFP_NORETRY;
+    }
 
     if (alloc_flags & UVM_CPU_CHUNK_ALLOC_FLAGS_ZERO)
         kernel_alloc_flags |= __GFP_ZERO;
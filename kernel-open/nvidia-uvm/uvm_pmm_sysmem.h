@@ -55,6 +55,10 @@ typedef enum
 
     // Allow chunk allocations from ZONE_MOVABLE.
     UVM_CPU_CHUNK_ALLOC_FLAGS_ALLOW_MOVABLE = (1 << 3),
+
+    // Let the kernel reclaim and compact memory to satisfy allocations larger
+    // than PAGE_SIZE, instead of failing fast.
+    UVM_CPU_CHUNK_ALLOC_FLAGS_RECLAIM = (1 << 4),
 } uvm_cpu_chunk_alloc_flags_t;
 
 typedef enum
@@ -204,6 +208,29 @@ NV_STATUS uvm_cpu_chunk_alloc(uvm_chunk_size_t alloc_size,
                               int nid,
                               uvm_cpu_chunk_t **new_chunk);
 
+// Take a zeroed physical CPU chunk of alloc_size from the reserve pool of node
+// nid (the current node if nid is NUMA_NO_NODE). The pool is configured with
+// the uvm_cpu_chunk_pool_2m and uvm_cpu_chunk_pool_64k module parameters and
+// is refilled in the background.
+//
+// Pooled chunks may already be DMA-mapped on some GPUs. Only the mappings of
+// the GPUs in keep_gpus are preserved, so the caller must either track the
+// chunk's mappings on those GPUs or pass NULL.
+//
+// Returns NV_ERR_NO_MEMORY if the pool is disabled for that size or empty.
+NV_STATUS uvm_cpu_chunk_pool_alloc(uvm_chunk_size_t alloc_size,
+                                   int nid,
+                                   const uvm_processor_mask_t *keep_gpus,
+                                   uvm_cpu_chunk_t **new_chunk);
+
+// Returns whether the CPU chunk pool holds chunks of any size.
+bool uvm_cpu_chunk_pool_enabled(void);
+
+// Remove the DMA mappings of the pooled chunks on the given GPU.
+//
+// LOCKING: the global lock must be held.
+void uvm_cpu_chunk_pool_unmap_gpu(uvm_gpu_t *gpu);
+
 // Allocate a HMM CPU chunk.
 //
 // HMM chunks differ from normal CPU chunks in that the kernel has already
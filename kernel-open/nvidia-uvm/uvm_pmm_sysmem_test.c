@@ -811,6 +811,86 @@ static NV_STATUS test_cpu_chunk_numa_alloc(uvm_va_space_t *va_space)
     return NV_OK;
 }
 
+static NV_STATUS do_test_cpu_chunk_pool(uvm_va_space_t *va_space,
+                                        const uvm_processor_mask_t *test_gpus,
+                                        const uvm_processor_mask_t *keep_gpus,
+                                        uvm_chunk_size_t size,
+                                        int nid)
+{
+    uvm_cpu_chunk_t *chunk;
+    uvm_gpu_t *gpu;
+    NV_STATUS status;
+
+    // The pool may be disabled or not refilled yet
+    status = uvm_cpu_chunk_pool_alloc(size, nid, keep_gpus, &chunk);
+    if (status == NV_ERR_NO_MEMORY)
+        return NV_OK;
+
+    TEST_NV_CHECK_RET(status);
+
+    TEST_CHECK_GOTO(uvm_cpu_chunk_is_physical(chunk), done);
+    TEST_CHECK_GOTO(uvm_cpu_chunk_get_size(chunk) == size, done);
+    TEST_CHECK_GOTO(uvm_cpu_chunk_get_numa_node(chunk) == nid, done);
+
+    // Pooled chunks are zeroed
+    TEST_CHECK_GOTO(uvm_cpu_chunk_is_dirty(chunk, 0), done);
+
+    // Only the mappings of the GPUs in keep_gpus may remain
+    for_each_va_space_gpu_in_mask(gpu, va_space, test_gpus) {
+        if (!uvm_processor_mask_test(keep_gpus, gpu->id))
+            TEST_CHECK_GOTO(uvm_cpu_chunk_get_gpu_phys_addr(chunk, gpu) == 0, done);
+    }
+
+    for_each_va_space_gpu_in_mask(gpu, va_space, test_gpus) {
+        TEST_NV_CHECK_GOTO(uvm_cpu_chunk_map_gpu(chunk, gpu), done);
+        TEST_NV_CHECK_GOTO(test_cpu_chunk_mapping_access(chunk, gpu), done);
+    }
+
+done:
+    uvm_cpu_chunk_free(chunk);
+    return status;
+}
+
+static NV_STATUS test_cpu_chunk_pool(uvm_va_space_t *va_space, const uvm_processor_mask_t *test_gpus)
+{
+    uvm_chunk_sizes_mask_t alloc_sizes = uvm_cpu_chunk_get_allocation_sizes();
+    uvm_processor_mask_t *keep_gpus;
+    uvm_gpu_t *gpu;
+    size_t size;
+    NV_STATUS status = NV_OK;
+
+    if (!uvm_cpu_chunk_pool_enabled())
+        return NV_OK;
+
+    keep_gpus = uvm_processor_mask_cache_alloc();
+    if (!keep_gpus)
+        return NV_ERR_NO_MEMORY;
+
+    // Keep the mappings of the first GPU only, the others must be removed
+    uvm_processor_mask_zero(keep_gpus);
+    gpu = uvm_processor_mask_find_first_va_space_gpu(test_gpus, va_space);
+    if (gpu)
+        uvm_processor_mask_set(keep_gpus, gpu->id);
+
+    for_each_chunk_size(size, alloc_sizes) {
+        int nid;
+
+        if (size <= PAGE_SIZE)
+            continue;
+
+        for_each_possible_uvm_node(nid) {
+            if (!node_state(nid, N_MEMORY))
+                continue;
+
+            TEST_NV_CHECK_GOTO(do_test_cpu_chunk_pool(va_space, test_gpus, keep_gpus, size, nid), done);
+        }
+    }
+
+done:
+    uvm_processor_mask_cache_free(keep_gpus);
+    return status;
+}
+
 static uvm_gpu_t *find_first_parent_gpu(const uvm_processor_mask_t *test_gpus,
                                         uvm_va_space_t *va_space)
 {
@@ -878,6 +958,7 @@ NV_STATUS uvm_test_cpu_chunk_api(UVM_TEST_CPU_CHUNK_API_PARAMS *params, struct f
 
     TEST_NV_CHECK_GOTO(test_cpu_chunk_free(va_space, test_gpus), done);
     TEST_NV_CHECK_GOTO(test_cpu_chunk_numa_alloc(va_space), done);
+    TEST_NV_CHECK_GOTO(test_cpu_chunk_pool(va_space, test_gpus), done);
 
     if (uvm_processor_mask_get_gpu_count(test_gpus) >= 2) {
         uvm_gpu_t *gpu2, *gpu3 = NULL;
@@ -105,6 +105,70 @@ uvm_api_range_type_t uvm_api_range_type_check(uvm_va_space_t *va_space, struct m
     return UVM_API_RANGE_TYPE_MANAGED;
 }
 
+typedef struct
+{
+    // Whether the VA space lock is held in write mode
+    bool va_space_write_locked;
+
+    // Whether range is locked in the VA space range lock
+    bool range_locked;
+
+    uvm_range_lock_range_t range;
+} policy_lock_t;
+
+// Lock the VA space for a policy change on [base, base + length - 1] and return
+// the range type.
+//
+// Policy changes on managed ranges can split VA ranges, so they take the VA
+// space lock in write mode. Policy changes on HMM ranges only update the policy
+// nodes of the HMM va_blocks under their locks, so they take the VA space lock
+// in read mode along with the VA space range lock. This lets faults and
+// migrations on unrelated ranges make progress. ATS policies are handled in
+// user-space, so the read mode is enough for them.
+//
+// Managed and HMM ranges can't be created or destroyed with the VA space lock
+// held in read mode and the mmap_lock held, so the range type is stable.
+static uvm_api_range_type_t policy_lock(uvm_va_space_t *va_space,
+                                        struct mm_struct *mm,
+                                        NvU64 base,
+                                        NvU64 length,
+                                        policy_lock_t *lock)
+{
+    uvm_api_range_type_t type;
+
+    lock->range_locked = false;
+
+    uvm_va_space_down_read(va_space);
+    lock->va_space_write_locked = false;
+
+    type = uvm_api_range_type_check(va_space, mm, base, length);
+    if (type == UVM_API_RANGE_TYPE_ATS)
+        return type;
+
+    if (type == UVM_API_RANGE_TYPE_HMM) {
+        uvm_range_lock(&va_space->range_lock, &lock->range, base, base + length - 1);
+        lock->range_locked = true;
+        return type;
+    }
+
+    uvm_va_space_up_read(va_space);
+    uvm_va_space_down_write(va_space);
+    lock->va_space_write_locked = true;
+
+    return uvm_api_range_type_check(va_space, mm, base, length);
+}
+
+static void policy_unlock(uvm_va_space_t *va_space, policy_lock_t *lock)
+{
+    if (lock->range_locked)
+        uvm_range_unlock(&va_space->range_lock, &lock->range);
+
+    if (lock->va_space_write_locked)
+        uvm_va_space_up_write(va_space);
+    else
+        uvm_va_space_up_read(va_space);
+}
+
 static NV_STATUS split_as_needed(uvm_va_space_t *va_space,
                                  NvU64 addr,
                                  uvm_va_policy_is_split_needed_t split_needed_cb,
@@ -148,7 +212,7 @@ static NV_STATUS split_span_as_needed(uvm_va_space_t *va_space,
 {
     NV_STATUS status;
 
-    uvm_assert_rwsem_locked_write(&va_space->lock);
+    uvm_va_space_assert_policy_locked(va_space, start_addr, end_addr - 1);
 
     status = split_as_needed(va_space, start_addr, split_needed_cb, data);
     if (status != NV_OK)
@@ -250,7 +314,7 @@ static NV_STATUS preferred_location_set(uvm_va_space_t *va_space,
     preferred_location_split_params_t split_params;
     NV_STATUS status;
 
-    uvm_assert_rwsem_locked_write(&va_space->lock);
+    uvm_va_space_assert_policy_locked(va_space, base, last_address);
 
     if (UVM_ID_IS_VALID(preferred_location)) {
         *first_managed_range_to_migrate = NULL;
@@ -330,7 +394,7 @@ NV_STATUS uvm_api_set_preferred_location(const UVM_SET_PREFERRED_LOCATION_PARAMS
     struct mm_struct *mm;
     uvm_processor_id_t preferred_location_id;
     int preferred_cpu_nid = NUMA_NO_NODE;
-    bool has_va_space_write_lock;
+    policy_lock_t lock;
     const NvU64 start = params->requestedBase;
     const NvU64 length = params->length;
     const NvU64 end = start + length - 1;
@@ -339,10 +403,7 @@ NV_STATUS uvm_api_set_preferred_location(const UVM_SET_PREFERRED_LOCATION_PARAMS
     UVM_ASSERT(va_space);
 
     mm = uvm_va_space_mm_or_current_retain_lock(va_space);
-    uvm_va_space_down_write(va_space);
-    has_va_space_write_lock = true;
-
-    type = uvm_api_range_type_check(va_space, mm, start, length);
+    type = policy_lock(va_space, mm, start, length, &lock);
     if (type == UVM_API_RANGE_TYPE_INVALID) {
         status = NV_ERR_INVALID_ADDRESS;
         goto done;
@@ -419,8 +480,9 @@ NV_STATUS uvm_api_set_preferred_location(const UVM_SET_PREFERRED_LOCATION_PARAMS
     if (!first_managed_range_to_migrate)
         goto done;
 
+    UVM_ASSERT(lock.va_space_write_locked);
     uvm_va_space_downgrade_write(va_space);
-    has_va_space_write_lock = false;
+    lock.va_space_write_locked = false;
 
     // No need to check for holes in the managed ranges span here, this was
     // checked by preferred_location_set
@@ -443,11 +505,7 @@ NV_STATUS uvm_api_set_preferred_location(const UVM_SET_PREFERRED_LOCATION_PARAMS
 done:
     tracker_status = uvm_tracker_wait_deinit(&local_tracker);
 
-    if (has_va_space_write_lock)
-        uvm_va_space_up_write(va_space);
-    else
-        uvm_va_space_up_read(va_space);
-
+    policy_unlock(va_space, &lock);
     uvm_va_space_mm_or_current_release_unlock(va_space, mm);
 
     return status == NV_OK ? tracker_status : status;
@@ -461,13 +519,12 @@ NV_STATUS uvm_api_unset_preferred_location(const UVM_UNSET_PREFERRED_LOCATION_PA
     struct mm_struct *mm;
     uvm_tracker_t local_tracker = UVM_TRACKER_INIT();
     uvm_api_range_type_t type;
+    policy_lock_t lock;
 
     UVM_ASSERT(va_space);
 
     mm = uvm_va_space_mm_or_current_retain_lock(va_space);
-    uvm_va_space_down_write(va_space);
-
-    type = uvm_api_range_type_check(va_space, mm, params->requestedBase, params->length);
+    type = policy_lock(va_space, mm, params->requestedBase, params->length, &lock);
     if (type == UVM_API_RANGE_TYPE_INVALID) {
         status = NV_ERR_INVALID_ADDRESS;
         goto done;
@@ -495,7 +552,7 @@ NV_STATUS uvm_api_unset_preferred_location(const UVM_UNSET_PREFERRED_LOCATION_PA
 done:
     tracker_status = uvm_tracker_wait_deinit(&local_tracker);
 
-    uvm_va_space_up_write(va_space);
+    policy_unlock(va_space, &lock);
     uvm_va_space_mm_or_current_release_unlock(va_space, mm);
     return status == NV_OK ? tracker_status : status;
 }
@@ -591,13 +648,12 @@ static NV_STATUS accessed_by_set(uvm_va_space_t *va_space,
     NV_STATUS status = NV_OK;
     NV_STATUS tracker_status;
     uvm_api_range_type_t type;
+    policy_lock_t lock;
 
     UVM_ASSERT(va_space);
 
     mm = uvm_va_space_mm_or_current_retain_lock(va_space);
-    uvm_va_space_down_write(va_space);
-
-    type = uvm_api_range_type_check(va_space, mm, base, length);
+    type = policy_lock(va_space, mm, base, length, &lock);
     if (type == UVM_API_RANGE_TYPE_INVALID) {
         status = NV_ERR_INVALID_ADDRESS;
         goto done;
@@ -676,7 +732,7 @@ static NV_STATUS accessed_by_set(uvm_va_space_t *va_space,
 done:
     tracker_status = uvm_tracker_wait_deinit(&local_tracker);
 
-    uvm_va_space_up_write(va_space);
+    policy_unlock(va_space, &lock);
     uvm_va_space_mm_or_current_release_unlock(va_space, mm);
 
     return status == NV_OK ? tracker_status : status;
@@ -867,14 +923,13 @@ static NV_STATUS read_duplication_set(uvm_va_space_t *va_space, NvU64 base, NvU6
     NV_STATUS status;
     uvm_read_duplication_policy_t new_policy;
     uvm_api_range_type_t type;
+    policy_lock_t lock;
 
     UVM_ASSERT(va_space);
 
     // We need mmap_lock as we may create CPU mappings
     mm = uvm_va_space_mm_or_current_retain_lock(va_space);
-    uvm_va_space_down_write(va_space);
-
-    type = uvm_api_range_type_check(va_space, mm, base, length);
+    type = policy_lock(va_space, mm, base, length, &lock);
     if (type == UVM_API_RANGE_TYPE_INVALID) {
         status = NV_ERR_INVALID_ADDRESS;
         goto done;
@@ -941,7 +996,7 @@ static NV_STATUS read_duplication_set(uvm_va_space_t *va_space, NvU64 base, NvU6
     }
 
 done:
-    uvm_va_space_up_write(va_space);
+    policy_unlock(va_space, &lock);
     uvm_va_space_mm_or_current_release_unlock(va_space, mm);
     return status;
 }
@@ -960,6 +1015,64 @@ NV_STATUS uvm_api_disable_read_duplication(const UVM_DISABLE_READ_DUPLICATION_PA
     return read_duplication_set(va_space, params->requestedBase, params->length, false);
 }
 
+static bool read_duplication_write_tracking_is_split_needed(const uvm_va_policy_t *policy, void *data)
+{
+    bool enable;
+
+    UVM_ASSERT(data);
+
+    enable = *(bool *)data;
+    return policy->read_duplication_write_tracking != enable;
+}
+
+NV_STATUS uvm_api_set_read_duplication_write_tracking(const UVM_SET_READ_DUPLICATION_WRITE_TRACKING_PARAMS *params,
+                                                      struct file *filp)
+{
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+    const NvU64 base = params->requestedBase;
+    const NvU64 length = params->length;
+    const NvU64 last_address = base + length - 1;
+    bool enable = params->enable != 0;
+    uvm_va_range_managed_t *managed_range;
+    struct mm_struct *mm;
+    uvm_api_range_type_t type;
+    policy_lock_t lock;
+    NV_STATUS status;
+
+    mm = uvm_va_space_mm_or_current_retain_lock(va_space);
+    type = policy_lock(va_space, mm, base, length, &lock);
+
+    if (type == UVM_API_RANGE_TYPE_INVALID) {
+        status = NV_ERR_INVALID_ADDRESS;
+        goto done;
+    }
+
+    // Read duplication is not supported on HMM and ATS ranges, so there is
+    // nothing to track.
+    if (type != UVM_API_RANGE_TYPE_MANAGED) {
+        status = NV_OK;
+        goto done;
+    }
+
+    status = split_span_as_needed(va_space,
+                                  base,
+                                  last_address + 1,
+                                  read_duplication_write_tracking_is_split_needed,
+                                  &enable);
+    if (status != NV_OK)
+        goto done;
+
+    // Pages already tracked when the mode is disabled are only used again if
+    // the mode is re-enabled, so they don't need to be cleared.
+    uvm_for_each_va_range_managed_in_contig(managed_range, va_space, base, last_address)
+        managed_range->policy.read_duplication_write_tracking = enable;
+
+done:
+    policy_unlock(va_space, &lock);
+    uvm_va_space_mm_or_current_release_unlock(va_space, mm);
+    return status;
+}
+
 static NV_STATUS system_wide_atomics_set(uvm_va_space_t *va_space, const NvProcessorUuid *gpu_uuid, bool enable)
 {
     NV_STATUS status = NV_OK;
@@ -658,8 +658,8 @@ done:
     return status;
 }
 
-// Test doing UVM_PUSHBUFFER_CHUNKS independent pushes expecting each one to use
-// a different chunk in the pushbuffer.
+// Test doing as many independent pushes as there are active chunks, expecting
+// each one to use a different chunk in the pushbuffer.
 static NV_STATUS test_idle_chunks_on_gpu(uvm_gpu_t *gpu)
 {
     NV_STATUS status;
@@ -667,6 +667,7 @@ static NV_STATUS test_idle_chunks_on_gpu(uvm_gpu_t *gpu)
     uvm_gpu_semaphore_t sema;
     uvm_tracker_t tracker = UVM_TRACKER_INIT();
     NvU32 i;
+    NvU32 num_active_chunks;
     uvm_channel_type_t channel_type = UVM_CHANNEL_TYPE_GPU_INTERNAL;
 
     // Use SEC2 channel when Confidential Compute is enabled since all other
@@ -687,7 +688,10 @@ static NV_STATUS test_idle_chunks_on_gpu(uvm_gpu_t *gpu)
     status = uvm_channel_manager_wait(gpu->channel_manager);
     TEST_CHECK_GOTO(status == NV_OK, done);
 
-    for (i = 0; i < UVM_PUSHBUFFER_CHUNKS; ++i) {
+    num_active_chunks = uvm_pushbuffer_num_active_chunks(gpu->channel_manager->pushbuffer);
+    TEST_CHECK_GOTO(test_count_idle_chunks(gpu->channel_manager->pushbuffer) == num_active_chunks, done);
+
+    for (i = 0; i < num_active_chunks; ++i) {
         NvU64 semaphore_gpu_va;
         uvm_push_t push;
 
@@ -700,9 +704,9 @@ static NV_STATUS test_idle_chunks_on_gpu(uvm_gpu_t *gpu)
 
         TEST_NV_CHECK_GOTO(uvm_tracker_add_push(&tracker, &push), done);
 
-        if (test_count_idle_chunks(gpu->channel_manager->pushbuffer) != UVM_PUSHBUFFER_CHUNKS - i - 1) {
+        if (test_count_idle_chunks(gpu->channel_manager->pushbuffer) != num_active_chunks - i - 1) {
             UVM_TEST_PRINT("Unexpected count of idle chunks in the pushbuffer %u instead of %u\n",
-                           test_count_idle_chunks(gpu->channel_manager->pushbuffer), UVM_PUSHBUFFER_CHUNKS - i - 1);
+                           test_count_idle_chunks(gpu->channel_manager->pushbuffer), num_active_chunks - i - 1);
             uvm_pushbuffer_print(gpu->channel_manager->pushbuffer);
             status = NV_ERR_INVALID_STATE;
             goto done;
@@ -713,7 +717,9 @@ static NV_STATUS test_idle_chunks_on_gpu(uvm_gpu_t *gpu)
     status = uvm_channel_manager_wait(gpu->channel_manager);
     TEST_CHECK_GOTO(status == NV_OK, done);
 
-    if (test_count_idle_chunks(gpu->channel_manager->pushbuffer) != UVM_PUSHBUFFER_CHUNKS) {
+    // Idle chunks may have been deactivated in the meantime
+    if (test_count_idle_chunks(gpu->channel_manager->pushbuffer) !=
+        uvm_pushbuffer_num_active_chunks(gpu->channel_manager->pushbuffer)) {
         UVM_TEST_PRINT("Unexpected count of idle chunks in the pushbuffer %u\n",
                        test_count_idle_chunks(gpu->channel_manager->pushbuffer));
         uvm_pushbuffer_print(gpu->channel_manager->pushbuffer);
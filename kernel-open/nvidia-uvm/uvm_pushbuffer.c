@@ -34,9 +34,22 @@
 #include "uvm_linux.h"
 #include "uvm_conf_computing.h"
 
+#define UVM_PUSHBUFFER_MIN_CHUNKS_DEFAULT 8
+
+// Number of pushbuffer chunks in use when there is no contention
+static unsigned uvm_pushbuffer_min_chunks = UVM_PUSHBUFFER_MIN_CHUNKS_DEFAULT;
+module_param(uvm_pushbuffer_min_chunks, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_pushbuffer_min_chunks,
+                 "Number of pushbuffer chunks in use before growing on contention, up to 32. Default: 8.");
+
+// Time without growth after which idle chunks are deactivated
+#define UVM_PUSHBUFFER_SHRINK_DELAY_NS (1000ULL * 1000 * 1000)
+
 // Print pushbuffer state into a seq_file if provided or with UVM_DBG_PRINT() if not.
 static void uvm_pushbuffer_print_common(uvm_pushbuffer_t *pushbuffer, struct seq_file *s);
 
+static void uvm_pushbuffer_print_stats(uvm_pushbuffer_t *pushbuffer, struct seq_file *s);
+
 static int nv_procfs_read_pushbuffer_info(struct seq_file *s, void *v)
 {
     uvm_pushbuffer_t *pushbuffer = (uvm_pushbuffer_t *)s->private;
@@ -58,10 +71,41 @@ static int nv_procfs_read_pushbuffer_info_entry(struct seq_file *s, void *v)
 
 UVM_DEFINE_SINGLE_PROCFS_FILE(pushbuffer_info_entry);
 
+static int nv_procfs_read_pushbuffer_stats(struct seq_file *s, void *v)
+{
+    uvm_pushbuffer_t *pushbuffer = (uvm_pushbuffer_t *)s->private;
+
+    if (!uvm_down_read_trylock(&g_uvm_global.pm.lock))
+            return -EAGAIN;
+
+    uvm_pushbuffer_print_stats(pushbuffer, s);
+
+    uvm_up_read(&g_uvm_global.pm.lock);
+
+    return 0;
+}
+
+static int nv_procfs_read_pushbuffer_stats_entry(struct seq_file *s, void *v)
+{
+    UVM_ENTRY_RET(nv_procfs_read_pushbuffer_stats(s, v));
+}
+
+UVM_DEFINE_SINGLE_PROCFS_FILE(pushbuffer_stats_entry);
+
 static NV_STATUS create_procfs(uvm_pushbuffer_t *pushbuffer)
 {
     uvm_gpu_t *gpu = pushbuffer->channel_manager->gpu;
 
+    if (!uvm_procfs_is_enabled())
+        return NV_OK;
+
+    pushbuffer->procfs.stats_file = NV_CREATE_PROC_FILE("pushbuffer_stats",
+                                                        gpu->procfs.dir,
+                                                        pushbuffer_stats_entry,
+                                                        pushbuffer);
+    if (pushbuffer->procfs.stats_file == NULL)
+        return NV_ERR_OPERATING_SYSTEM;
+
     // The pushbuffer info file is for debug only
     if (!uvm_procfs_is_debug_enabled())
         return NV_OK;
@@ -89,11 +133,11 @@ NV_STATUS uvm_pushbuffer_create(uvm_channel_manager_t *channel_manager, uvm_push
 
     pushbuffer->channel_manager = channel_manager;
 
-    uvm_spin_lock_init(&pushbuffer->lock, UVM_LOCK_ORDER_LEAF);
-
-    // Currently the pushbuffer supports UVM_PUSHBUFFER_CHUNKS of concurrent
-    // pushes.
-    uvm_sema_init(&pushbuffer->concurrent_pushes_sema, UVM_PUSHBUFFER_CHUNKS, UVM_LOCK_ORDER_PUSH);
+    // Each push in progress claims a chunk of its own, so there have to be at
+    // least as many chunks as concurrent pushes. The active chunks grow on
+    // demand up to UVM_PUSHBUFFER_CHUNKS.
+    BUILD_BUG_ON(UVM_PUSH_MAX_CONCURRENT_PUSHES > UVM_PUSHBUFFER_CHUNKS);
+    uvm_sema_init(&pushbuffer->concurrent_pushes_sema, UVM_PUSH_MAX_CONCURRENT_PUSHES, UVM_LOCK_ORDER_PUSH);
 
     UVM_ASSERT(channel_manager->conf.pushbuffer_loc == UVM_BUFFER_LOCATION_SYS ||
                channel_manager->conf.pushbuffer_loc == UVM_BUFFER_LOCATION_VID);
@@ -153,11 +197,16 @@ NV_STATUS uvm_pushbuffer_create(uvm_channel_manager_t *channel_manager, uvm_push
     // Verify the GPU can access the pushbuffer.
     UVM_ASSERT((uvm_pushbuffer_get_gpu_va_base(pushbuffer) + UVM_PUSHBUFFER_SIZE - 1) < gpu->parent->max_host_va);
 
-    bitmap_fill(pushbuffer->idle_chunks, UVM_PUSHBUFFER_CHUNKS);
-    bitmap_fill(pushbuffer->available_chunks, UVM_PUSHBUFFER_CHUNKS);
+    pushbuffer->min_active_chunks = max(min(uvm_pushbuffer_min_chunks, (unsigned)UVM_PUSHBUFFER_CHUNKS), 1u);
+    atomic_set(&pushbuffer->num_active_chunks, pushbuffer->min_active_chunks);
 
-    for (i = 0; i < UVM_PUSHBUFFER_CHUNKS; ++i)
+    bitmap_set(pushbuffer->idle_chunks, 0, pushbuffer->min_active_chunks);
+    bitmap_set(pushbuffer->available_chunks, 0, pushbuffer->min_active_chunks);
+
+    for (i = 0; i < UVM_PUSHBUFFER_CHUNKS; ++i) {
+        uvm_spin_lock_init(&pushbuffer->chunks[i].lock, UVM_LOCK_ORDER_LEAF);
         INIT_LIST_HEAD(&pushbuffer->chunks[i].pending_gpfifos);
+    }
 
     status = create_procfs(pushbuffer);
     if (status != NV_OK)
@@ -172,28 +221,6 @@ error:
     return status;
 }
 
-static uvm_pushbuffer_chunk_t *get_chunk_in_mask(uvm_pushbuffer_t *pushbuffer, unsigned long *mask)
-{
-    NvU32 index = find_first_bit(mask, UVM_PUSHBUFFER_CHUNKS);
-
-    uvm_assert_spinlock_locked(&pushbuffer->lock);
-
-    if (index == UVM_PUSHBUFFER_CHUNKS)
-        return NULL;
-
-    return &pushbuffer->chunks[index];
-}
-
-static uvm_pushbuffer_chunk_t *get_available_chunk(uvm_pushbuffer_t *pushbuffer)
-{
-    return get_chunk_in_mask(pushbuffer, pushbuffer->available_chunks);
-}
-
-static uvm_pushbuffer_chunk_t *get_idle_chunk(uvm_pushbuffer_t *pushbuffer)
-{
-    return get_chunk_in_mask(pushbuffer, pushbuffer->idle_chunks);
-}
-
 static NvU32 chunk_get_index(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chunk_t *chunk)
 {
     NvU32 index = chunk - pushbuffer->chunks;
@@ -210,51 +237,177 @@ static void set_chunk(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chunk_t *chun
 {
     NvU32 index = chunk_get_index(pushbuffer, chunk);
 
-    uvm_assert_spinlock_locked(&pushbuffer->lock);
+    uvm_assert_spinlock_locked(&chunk->lock);
 
-    __set_bit(index, mask);
+    set_bit(index, mask);
 }
 
 static void clear_chunk(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chunk_t *chunk, unsigned long *mask)
 {
     NvU32 index = chunk_get_index(pushbuffer, chunk);
 
-    uvm_assert_spinlock_locked(&pushbuffer->lock);
+    uvm_assert_spinlock_locked(&chunk->lock);
 
-    __clear_bit(index, mask);
+    clear_bit(index, mask);
 }
 
-static uvm_pushbuffer_chunk_t *pick_chunk(uvm_pushbuffer_t *pushbuffer)
+unsigned uvm_pushbuffer_num_active_chunks(uvm_pushbuffer_t *pushbuffer)
 {
-    uvm_pushbuffer_chunk_t *chunk = get_idle_chunk(pushbuffer);
+    return atomic_read(&pushbuffer->num_active_chunks);
+}
 
-    uvm_assert_spinlock_locked(&pushbuffer->lock);
+// Claim the chunk for the push if it is available
+static bool try_claim_this_chunk(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chunk_t *chunk, uvm_push_t *push)
+{
+    bool claimed = false;
 
-    if (chunk == NULL)
-        chunk = get_available_chunk(pushbuffer);
+    uvm_spin_lock(&chunk->lock);
 
-    return chunk;
+    if (test_and_clear_bit(chunk_get_index(pushbuffer, chunk), pushbuffer->available_chunks)) {
+        UVM_ASSERT(chunk->current_push == NULL);
+
+        chunk->current_push = push;
+        clear_chunk(pushbuffer, chunk, pushbuffer->idle_chunks);
+        claimed = true;
+    }
+
+    uvm_spin_unlock(&chunk->lock);
+
+    return claimed;
 }
 
-static bool try_claim_chunk(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push, uvm_pushbuffer_chunk_t **chunk_out)
+static uvm_pushbuffer_chunk_t *try_claim_chunk_in_mask(uvm_pushbuffer_t *pushbuffer,
+                                                       uvm_push_t *push,
+                                                       unsigned long *mask)
 {
-    uvm_pushbuffer_chunk_t *chunk;
+    unsigned num_active_chunks = uvm_pushbuffer_num_active_chunks(pushbuffer);
+    NvU32 index;
+
+    for_each_set_bit(index, mask, num_active_chunks) {
+        uvm_pushbuffer_chunk_t *chunk = &pushbuffer->chunks[index];
+
+        if (try_claim_this_chunk(pushbuffer, chunk, push))
+            return chunk;
+    }
+
+    return NULL;
+}
+
+// Activate the next chunk and claim it for the push, if the pushbuffer is not
+// fully grown yet
+static uvm_pushbuffer_chunk_t *try_grow(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push)
+{
+    int num_active_chunks = atomic_read(&pushbuffer->num_active_chunks);
+
+    while (num_active_chunks < UVM_PUSHBUFFER_CHUNKS) {
+        int old = atomic_cmpxchg(&pushbuffer->num_active_chunks, num_active_chunks, num_active_chunks + 1);
+
+        if (old == num_active_chunks) {
+            uvm_pushbuffer_chunk_t *chunk = &pushbuffer->chunks[num_active_chunks];
+
+            // Inactive chunks are idle and not in the bitmaps, so the chunk
+            // belongs to this push already.
+            uvm_spin_lock(&chunk->lock);
+            UVM_ASSERT(chunk->current_push == NULL);
+            UVM_ASSERT(list_empty(&chunk->pending_gpfifos));
+            UVM_ASSERT(chunk->next_push_start == 0);
+            chunk->current_push = push;
+            uvm_spin_unlock(&chunk->lock);
+
+            atomic64_inc(&pushbuffer->stats.grows);
+            atomic64_set(&pushbuffer->stats.last_grow_ns, NV_GETTIME());
 
-    uvm_spin_lock(&pushbuffer->lock);
+            return chunk;
+        }
+
+        num_active_chunks = old;
+    }
+
+    return NULL;
+}
+
+// Deactivate idle chunks at the end of the active range if the pushbuffer has
+// not needed to grow for a while.
+static void try_shrink(uvm_pushbuffer_t *pushbuffer)
+{
+    while (true) {
+        int num_active_chunks = atomic_read(&pushbuffer->num_active_chunks);
+        uvm_pushbuffer_chunk_t *chunk;
+        NvU32 index;
+        bool shrunk = false;
+
+        if ((unsigned)num_active_chunks <= pushbuffer->min_active_chunks)
+            return;
+
+        index = num_active_chunks - 1;
+        if (!test_bit(index, pushbuffer->idle_chunks))
+            return;
+
+        if (NV_GETTIME() - atomic64_read(&pushbuffer->stats.last_grow_ns) < UVM_PUSHBUFFER_SHRINK_DELAY_NS)
+            return;
+
+        chunk = &pushbuffer->chunks[index];
+
+        uvm_spin_lock(&chunk->lock);
+
+        // Claiming the available bit prevents new pushes in the chunk while it
+        // is being deactivated.
+        if (test_bit(index, pushbuffer->idle_chunks) &&
+            test_and_clear_bit(index, pushbuffer->available_chunks)) {
+            clear_chunk(pushbuffer, chunk, pushbuffer->idle_chunks);
+
+            if (atomic_cmpxchg(&pushbuffer->num_active_chunks, num_active_chunks, num_active_chunks - 1) ==
+                num_active_chunks) {
+                shrunk = true;
+            }
+            else {
+                set_chunk(pushbuffer, chunk, pushbuffer->idle_chunks);
+                set_chunk(pushbuffer, chunk, pushbuffer->available_chunks);
+            }
+        }
+
+        uvm_spin_unlock(&chunk->lock);
+
+        if (!shrunk)
+            return;
+
+        atomic64_inc(&pushbuffer->stats.shrinks);
+    }
+}
+
+static uvm_pushbuffer_chunk_t *pick_chunk_for_push(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push)
+{
+    uvm_channel_pool_t *pool = push->channel->pool;
+    NvU32 hint = READ_ONCE(pool->pushbuffer_chunk_hint);
+    uvm_pushbuffer_chunk_t *chunk = NULL;
+
+    // Prefer the chunk last used by the pool if it is idle, so that the pools
+    // keep reusing their own chunks instead of contending on the same ones.
+    if (hint < uvm_pushbuffer_num_active_chunks(pushbuffer) && test_bit(hint, pushbuffer->idle_chunks)) {
+        if (try_claim_this_chunk(pushbuffer, &pushbuffer->chunks[hint], push))
+            chunk = &pushbuffer->chunks[hint];
+    }
+
+    if (!chunk)
+        chunk = try_claim_chunk_in_mask(pushbuffer, push, pushbuffer->idle_chunks);
 
-    chunk = pick_chunk(pushbuffer);
     if (!chunk)
-        goto done;
+        chunk = try_claim_chunk_in_mask(pushbuffer, push, pushbuffer->available_chunks);
 
-    chunk->current_push = push;
-    clear_chunk(pushbuffer, chunk, pushbuffer->idle_chunks);
-    clear_chunk(pushbuffer, chunk, pushbuffer->available_chunks);
+    if (!chunk)
+        chunk = try_grow(pushbuffer, push);
+
+    if (chunk)
+        WRITE_ONCE(pool->pushbuffer_chunk_hint, chunk_get_index(pushbuffer, chunk));
+
+    return chunk;
+}
 
-done:
-    uvm_spin_unlock(&pushbuffer->lock);
-    *chunk_out = chunk;
+static bool try_claim_chunk(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push, uvm_pushbuffer_chunk_t **chunk_out)
+{
+    *chunk_out = pick_chunk_for_push(pushbuffer, push);
 
-    return chunk != NULL;
+    return *chunk_out != NULL;
 }
 
 static char *get_base_cpu_va(uvm_pushbuffer_t *pushbuffer)
@@ -283,7 +436,12 @@ static NvU32 *chunk_get_next_push_start_addr(uvm_pushbuffer_t *pushbuffer, uvm_p
     return (NvU32*)push_start;
 }
 
-static NV_STATUS claim_chunk(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push, uvm_pushbuffer_chunk_t **chunk_out)
+// Claim a chunk for the push, waiting for pending pushes to complete if needed.
+// *stall_start is set to the time the wait started, if it was not set already.
+static NV_STATUS claim_chunk(uvm_pushbuffer_t *pushbuffer,
+                             uvm_push_t *push,
+                             uvm_pushbuffer_chunk_t **chunk_out,
+                             NvU64 *stall_start)
 {
     NV_STATUS status = NV_OK;
     uvm_channel_manager_t *channel_manager = pushbuffer->channel_manager;
@@ -292,6 +450,9 @@ static NV_STATUS claim_chunk(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push, uvm
     if (try_claim_chunk(pushbuffer, push, chunk_out))
         return NV_OK;
 
+    if (*stall_start == 0)
+        *stall_start = NV_GETTIME();
+
     uvm_channel_manager_update_progress(channel_manager);
 
     uvm_spin_loop_init(&spin);
@@ -304,9 +465,27 @@ static NV_STATUS claim_chunk(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push, uvm
     return status;
 }
 
+static void record_stall(uvm_pushbuffer_t *pushbuffer, NvU64 stall_ns)
+{
+    NvU64 max_stall_ns = atomic64_read(&pushbuffer->stats.max_stall_ns);
+
+    atomic64_inc(&pushbuffer->stats.stalls);
+    atomic64_add(stall_ns, &pushbuffer->stats.stall_ns);
+
+    while (stall_ns > max_stall_ns) {
+        NvU64 old = atomic64_cmpxchg(&pushbuffer->stats.max_stall_ns, max_stall_ns, stall_ns);
+
+        if (old == max_stall_ns)
+            break;
+
+        max_stall_ns = old;
+    }
+}
+
 NV_STATUS uvm_pushbuffer_begin_push(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push)
 {
     uvm_pushbuffer_chunk_t *chunk;
+    NvU64 stall_start = 0;
     NV_STATUS status;
 
     UVM_ASSERT(pushbuffer);
@@ -322,10 +501,15 @@ NV_STATUS uvm_pushbuffer_begin_push(uvm_pushbuffer_t *pushbuffer, uvm_push_t *pu
         return NV_OK;
     }
 
+    atomic64_inc(&pushbuffer->stats.pushes);
+
     // Note that this semaphore is uvm_up()ed in end_push().
-    uvm_down(&pushbuffer->concurrent_pushes_sema);
+    if (!uvm_down_trylock(&pushbuffer->concurrent_pushes_sema)) {
+        stall_start = NV_GETTIME();
+        uvm_down(&pushbuffer->concurrent_pushes_sema);
+    }
 
-    status = claim_chunk(pushbuffer, push, &chunk);
+    status = claim_chunk(pushbuffer, push, &chunk, &stall_start);
     if (status != NV_OK) {
         uvm_up(&pushbuffer->concurrent_pushes_sema);
         return status;
@@ -333,6 +517,9 @@ NV_STATUS uvm_pushbuffer_begin_push(uvm_pushbuffer_t *pushbuffer, uvm_push_t *pu
 
     UVM_ASSERT(chunk);
 
+    if (stall_start != 0)
+        record_stall(pushbuffer, NV_GETTIME() - stall_start);
+
     push->begin = chunk_get_next_push_start_addr(pushbuffer, chunk);
     push->next = push->begin;
 
@@ -354,7 +541,7 @@ static NvU32 chunk_get_cpu_put(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chun
 {
     uvm_gpfifo_entry_t *gpfifo = chunk_get_last_gpfifo(chunk);
 
-    uvm_assert_spinlock_locked(&pushbuffer->lock);
+    uvm_assert_spinlock_locked(&chunk->lock);
 
     if (gpfifo != NULL)
         return gpfifo->pushbuffer_offset + gpfifo->pushbuffer_size - chunk_get_offset(pushbuffer, chunk);
@@ -367,7 +554,7 @@ static NvU32 chunk_get_gpu_get(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chun
 {
     uvm_gpfifo_entry_t *gpfifo = chunk_get_first_gpfifo(chunk);
 
-    uvm_assert_spinlock_locked(&pushbuffer->lock);
+    uvm_assert_spinlock_locked(&chunk->lock);
 
     if (gpfifo != NULL)
         return gpfifo->pushbuffer_offset - chunk_get_offset(pushbuffer, chunk);
@@ -375,19 +562,21 @@ static NvU32 chunk_get_gpu_get(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chun
         return 0;
 }
 
-static void update_chunk(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chunk_t *chunk)
+// Update the chunk bitmaps after pushes of the chunk have ended or completed.
+// Returns true if the chunk became idle.
+static bool update_chunk(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chunk_t *chunk)
 {
     NvU32 gpu_get = chunk_get_gpu_get(pushbuffer, chunk);
     NvU32 cpu_put = chunk_get_cpu_put(pushbuffer, chunk);
 
-    uvm_assert_spinlock_locked(&pushbuffer->lock);
+    uvm_assert_spinlock_locked(&chunk->lock);
 
     if (gpu_get == cpu_put) {
         // cpu_put can be equal to gpu_get both when the chunk is full and empty. We
         // can tell apart the cases by checking whether the pending GPFIFOs list is
         // empty.
         if (!list_empty(&chunk->pending_gpfifos))
-            return;
+            return false;
 
         // Chunk completely idle
         set_chunk(pushbuffer, chunk, pushbuffer->idle_chunks);
@@ -398,6 +587,8 @@ static void update_chunk(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chunk_t *c
         // helps avoid the waste that can happen at the very end of the chunk
         // described at the top of uvm_pushbuffer.h.
         chunk->next_push_start = 0;
+
+        return true;
     }
     else if (gpu_get > cpu_put) {
         if (gpu_get - cpu_put >= UVM_MAX_PUSH_SIZE) {
@@ -420,6 +611,8 @@ static void update_chunk(uvm_pushbuffer_t *pushbuffer, uvm_pushbuffer_chunk_t *c
         set_chunk(pushbuffer, chunk, pushbuffer->available_chunks);
         chunk->next_push_start = 0;
     }
+
+    return false;
 }
 
 void uvm_pushbuffer_destroy(uvm_pushbuffer_t *pushbuffer)
@@ -428,6 +621,7 @@ void uvm_pushbuffer_destroy(uvm_pushbuffer_t *pushbuffer)
         return;
 
     proc_remove(pushbuffer->procfs.info_file);
+    proc_remove(pushbuffer->procfs.stats_file);
 
     uvm_rm_mem_free(pushbuffer->memory_unprotected_sysmem);
     uvm_kvfree(pushbuffer->memory_protected_sysmem);
@@ -493,6 +687,7 @@ void uvm_pushbuffer_mark_completed(uvm_channel_t *channel, uvm_gpfifo_entry_t *g
 {
     uvm_pushbuffer_chunk_t *chunk;
     bool need_to_update_chunk = false;
+    bool chunk_idle = false;
     uvm_push_info_t *push_info = gpfifo->push_info;
     uvm_pushbuffer_t *pushbuffer = uvm_channel_get_pushbuffer(channel);
 
@@ -508,7 +703,7 @@ void uvm_pushbuffer_mark_completed(uvm_channel_t *channel, uvm_gpfifo_entry_t *g
         push_info->on_complete_data = NULL;
     }
 
-    uvm_spin_lock(&pushbuffer->lock);
+    uvm_spin_lock(&chunk->lock);
 
     if (gpfifo == chunk_get_first_gpfifo(chunk))
         need_to_update_chunk = true;
@@ -520,9 +715,12 @@ void uvm_pushbuffer_mark_completed(uvm_channel_t *channel, uvm_gpfifo_entry_t *g
     // If current_push is not NULL, updating the chunk is delayed till
     // uvm_pushbuffer_end_push() is called for that push.
     if (need_to_update_chunk && chunk->current_push == NULL)
-        update_chunk(pushbuffer, chunk);
+        chunk_idle = update_chunk(pushbuffer, chunk);
+
+    uvm_spin_unlock(&chunk->lock);
 
-    uvm_spin_unlock(&pushbuffer->lock);
+    if (chunk_idle)
+        try_shrink(pushbuffer);
 }
 
 NvU32 uvm_pushbuffer_get_offset_for_push(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push)
@@ -612,7 +810,7 @@ void uvm_pushbuffer_end_push(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push, uvm
 
     uvm_channel_pool_assert_locked(push->channel->pool);
 
-    uvm_spin_lock(&pushbuffer->lock);
+    uvm_spin_lock(&chunk->lock);
 
     list_add_tail(&gpfifo->pending_list_node, &chunk->pending_gpfifos);
 
@@ -621,7 +819,7 @@ void uvm_pushbuffer_end_push(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push, uvm
     UVM_ASSERT(chunk->current_push == push);
     chunk->current_push = NULL;
 
-    uvm_spin_unlock(&pushbuffer->lock);
+    uvm_spin_unlock(&chunk->lock);
 
     // uvm_pushbuffer_end_push() needs to be called with the channel lock held
     // while the concurrent pushes sema has a higher lock order. To keep the
@@ -631,15 +829,12 @@ void uvm_pushbuffer_end_push(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push, uvm
 
 bool uvm_pushbuffer_has_space(uvm_pushbuffer_t *pushbuffer)
 {
-    bool has_space;
+    unsigned num_active_chunks = uvm_pushbuffer_num_active_chunks(pushbuffer);
 
-    uvm_spin_lock(&pushbuffer->lock);
+    if (num_active_chunks < UVM_PUSHBUFFER_CHUNKS)
+        return true;
 
-    has_space = pick_chunk(pushbuffer) != NULL;
-
-    uvm_spin_unlock(&pushbuffer->lock);
-
-    return has_space;
+    return find_first_bit(pushbuffer->available_chunks, num_active_chunks) < num_active_chunks;
 }
 
 void uvm_pushbuffer_print_common(uvm_pushbuffer_t *pushbuffer, struct seq_file *s)
@@ -648,22 +843,37 @@ void uvm_pushbuffer_print_common(uvm_pushbuffer_t *pushbuffer, struct seq_file *
 
     UVM_SEQ_OR_DBG_PRINT(s, "Pushbuffer for GPU %s\n", uvm_gpu_name(pushbuffer->channel_manager->gpu));
     UVM_SEQ_OR_DBG_PRINT(s, " has space: %d\n", uvm_pushbuffer_has_space(pushbuffer));
-
-    uvm_spin_lock(&pushbuffer->lock);
+    UVM_SEQ_OR_DBG_PRINT(s, " active chunks: %u\n", uvm_pushbuffer_num_active_chunks(pushbuffer));
 
     for (i = 0; i < UVM_PUSHBUFFER_CHUNKS; ++i) {
         uvm_pushbuffer_chunk_t *chunk = &pushbuffer->chunks[i];
-        NvU32 cpu_put = chunk_get_cpu_put(pushbuffer, chunk);
-        NvU32 gpu_get = chunk_get_gpu_get(pushbuffer, chunk);
+        NvU32 cpu_put, gpu_get;
+
+        uvm_spin_lock(&chunk->lock);
+
+        cpu_put = chunk_get_cpu_put(pushbuffer, chunk);
+        gpu_get = chunk_get_gpu_get(pushbuffer, chunk);
         UVM_SEQ_OR_DBG_PRINT(s, " chunk %u put %u get %u next %u available %d idle %d\n",
                 i,
                 cpu_put, gpu_get, chunk->next_push_start,
                 test_bit(i, pushbuffer->available_chunks) ? 1 : 0,
                 test_bit(i, pushbuffer->idle_chunks) ? 1 : 0);
 
+        uvm_spin_unlock(&chunk->lock);
     }
+}
 
-    uvm_spin_unlock(&pushbuffer->lock);
+static void uvm_pushbuffer_print_stats(uvm_pushbuffer_t *pushbuffer, struct seq_file *s)
+{
+    UVM_SEQ_OR_DBG_PRINT(s, "active_chunks      %u\n", uvm_pushbuffer_num_active_chunks(pushbuffer));
+    UVM_SEQ_OR_DBG_PRINT(s, "max_chunks         %u\n", UVM_PUSHBUFFER_CHUNKS);
+    UVM_SEQ_OR_DBG_PRINT(s, "chunk_size         %u\n", UVM_PUSHBUFFER_CHUNK_SIZE);
+    UVM_SEQ_OR_DBG_PRINT(s, "pushes             %llu\n", (NvU64)atomic64_read(&pushbuffer->stats.pushes));
+    UVM_SEQ_OR_DBG_PRINT(s, "stalls             %llu\n", (NvU64)atomic64_read(&pushbuffer->stats.stalls));
+    UVM_SEQ_OR_DBG_PRINT(s, "stall_ns           %llu\n", (NvU64)atomic64_read(&pushbuffer->stats.stall_ns));
+    UVM_SEQ_OR_DBG_PRINT(s, "max_stall_ns       %llu\n", (NvU64)atomic64_read(&pushbuffer->stats.max_stall_ns));
+    UVM_SEQ_OR_DBG_PRINT(s, "grows              %llu\n", (NvU64)atomic64_read(&pushbuffer->stats.grows));
+    UVM_SEQ_OR_DBG_PRINT(s, "shrinks            %llu\n", (NvU64)atomic64_read(&pushbuffer->stats.shrinks));
 }
 
 void uvm_pushbuffer_print(uvm_pushbuffer_t *pushbuffer)
@@ -118,6 +118,20 @@
 // the pending pushes cannot wrap around in the chunk leading to some potential
 // waste at the end.
 //
+// The number of chunks in use grows and shrinks with the contention on the
+// pushbuffer. Only the first num_active_chunks chunks can be claimed. When a
+// push finds no available chunk among them, the next chunk is activated and
+// claimed right away instead of waiting for pending pushes to complete. Once
+// the pushbuffer has not grown for a while, idle chunks at the end of the
+// active range are deactivated again as they complete. The backing allocation
+// always covers all the chunks, since channels are programmed with a fixed
+// pushbuffer segment.
+//
+// Each chunk has its own lock, and the chunk bitmaps are updated atomically, so
+// concurrent pushes on different chunks do not contend on a shared lock. Pushes
+// on a channel pool first try the chunk last used by that pool if it is idle,
+// so that pools tend to keep to their own chunks.
+//
 // The pushbuffer implementation is configurable through a few defines below,
 // but careful tweaking of them is yet to be done.
 //
@@ -144,8 +158,11 @@
 // Total                                                            Total= ~100k
 //
 #define UVM_MAX_PUSH_SIZE (128 * 1024)
-#define UVM_PUSHBUFFER_CHUNK_SIZE (8 * UVM_MAX_PUSH_SIZE)
-#define UVM_PUSHBUFFER_CHUNKS 16
+#define UVM_PUSHBUFFER_CHUNK_SIZE (4 * UVM_MAX_PUSH_SIZE)
+
+// Maximum number of chunks. See uvm_pushbuffer_num_active_chunks() for the
+// number of chunks in use.
+#define UVM_PUSHBUFFER_CHUNKS 32
 
 // Total size of the pushbuffer
 #define UVM_PUSHBUFFER_SIZE (UVM_PUSHBUFFER_CHUNK_SIZE * UVM_PUSHBUFFER_CHUNKS)
@@ -153,7 +170,11 @@
 // The max number of concurrent pushes that can be happening at the same time.
 // Concurrent pushes are ones that are after uvm_push_begin*(), but before
 // uvm_push_end().
-#define UVM_PUSH_MAX_CONCURRENT_PUSHES UVM_PUSHBUFFER_CHUNKS
+//
+// This also sizes the channel pools, so it is kept independent of the number of
+// chunks. Each push in progress claims a chunk of its own, and the extra chunks
+// let the pushbuffer grow while completed pushes wait for the GPU.
+#define UVM_PUSH_MAX_CONCURRENT_PUSHES 16
 
 // Push space needed for static part for the WLC schedule, as initialized in
 // 'setup_wlc_schedule':
@@ -193,6 +214,9 @@
 
 typedef struct
 {
+    // Lock protecting the chunk state and its bits in the chunk bitmaps
+    uvm_spinlock_t lock;
+
     // Offset within the chunk of where a next push should begin if there is
     // space for one. Updated in update_chunk().
     NvU32 next_push_start;
@@ -221,16 +245,21 @@ struct uvm_pushbuffer_struct
     // Array of the pushbuffer chunks
     uvm_pushbuffer_chunk_t chunks[UVM_PUSHBUFFER_CHUNKS];
 
-    // Chunks that do not have an on-going push and have at least
-    // UVM_MAX_PUSH_SIZE space free.
+    // Number of chunks that can be claimed, always the first ones in the
+    // array.
+    atomic_t num_active_chunks;
+
+    // Number of chunks the pushbuffer shrinks back to
+    unsigned min_active_chunks;
+
+    // Active chunks that do not have an on-going push and have at least
+    // UVM_MAX_PUSH_SIZE space free. Bits are set and cleared atomically with
+    // the lock of the corresponding chunk held.
     DECLARE_BITMAP(available_chunks, UVM_PUSHBUFFER_CHUNKS);
 
-    // Chunks that do not have an on-going push nor any pending pushes.
+    // Active chunks that do not have an on-going push nor any pending pushes.
     DECLARE_BITMAP(idle_chunks, UVM_PUSHBUFFER_CHUNKS);
 
-    // Lock protecting chunk state and the bitmaps.
-    uvm_spinlock_t lock;
-
     // Semaphore enforcing a limited number of concurrent pushes.
     // Decremented in uvm_pushbuffer_begin_push(), incremented in
     // uvm_pushbuffer_end_push().
@@ -238,9 +267,29 @@ struct uvm_pushbuffer_struct
     // are supported.
     uvm_semaphore_t concurrent_pushes_sema;
 
+    struct
+    {
+        // Number of pushes begun in the pushbuffer
+        atomic64_t pushes;
+
+        // Number of pushes that had to wait for a concurrent push to end or
+        // for a chunk to have space, and the total and maximum time waited.
+        atomic64_t stalls;
+        atomic64_t stall_ns;
+        atomic64_t max_stall_ns;
+
+        // Number of chunk activations and deactivations
+        atomic64_t grows;
+        atomic64_t shrinks;
+
+        // Time of the last chunk activation
+        atomic64_t last_grow_ns;
+    } stats;
+
     struct
     {
         struct proc_dir_entry *info_file;
+        struct proc_dir_entry *stats_file;
     } procfs;
 };
 
@@ -277,10 +326,14 @@ NvU32 uvm_pushbuffer_get_offset_for_push(uvm_pushbuffer_t *pushbuffer, uvm_push_
 // enough space left.
 void uvm_pushbuffer_end_push(uvm_pushbuffer_t *pushbuffer, uvm_push_t *push, uvm_gpfifo_entry_t *gpfifo);
 
-// Query whether the pushbuffer has space for another push
+// Query whether the pushbuffer has space for another push, possibly after
+// activating another chunk.
 // Mostly useful in pushbuffer tests
 bool uvm_pushbuffer_has_space(uvm_pushbuffer_t *pushbuffer);
 
+// Number of chunks currently in use
+unsigned uvm_pushbuffer_num_active_chunks(uvm_pushbuffer_t *pushbuffer);
+
 // Helper to print pushbuffer state for debugging
 void uvm_pushbuffer_print(uvm_pushbuffer_t *pushbuffer);
 
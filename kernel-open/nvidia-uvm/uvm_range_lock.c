@@ -0,0 +1,128 @@
+/*******************************************************************************
+    Copyright (c) 2025 NVIDIA Corporation
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+*******************************************************************************/
+
+#include "uvm_common.h"
+#include "uvm_range_lock.h"
+
+void uvm_range_lock_init(uvm_range_lock_t *range_lock, uvm_lock_order_t lock_order)
+{
+    uvm_interval_tree_init(&range_lock->ranges);
+    range_lock->next_seq = 0;
+    uvm_spin_lock_init(&range_lock->lock, UVM_LOCK_ORDER_LEAF);
+    init_waitqueue_head(&range_lock->wait_queue);
+    uvm_lock_debug_init(range_lock, lock_order);
+}
+
+void uvm_range_lock_deinit(uvm_range_lock_t *range_lock)
+{
+    UVM_ASSERT(uvm_interval_tree_empty(&range_lock->ranges));
+}
+
+static uvm_range_lock_range_t *range_lock_range_from_node(uvm_interval_tree_node_t *node)
+{
+    return container_of(node, uvm_range_lock_range_t, node);
+}
+
+// A range is granted once no overlapping range was requested before it. Ranges
+// requested before it are either locked or waiting, and in both cases they go
+// first.
+static bool range_lock_is_granted(uvm_range_lock_t *range_lock, uvm_range_lock_range_t *range)
+{
+    uvm_interval_tree_node_t *node;
+    bool granted = true;
+
+    uvm_spin_lock(&range_lock->lock);
+
+    uvm_interval_tree_for_each_in(node, &range_lock->ranges, range->node.start, range->node.end) {
+        uvm_range_lock_range_t *other = range_lock_range_from_node(node);
+
+        if (other->seq < range->seq) {
+            granted = false;
+            break;
+        }
+    }
+
+    uvm_spin_unlock(&range_lock->lock);
+
+    return granted;
+}
+
+void uvm_range_lock(uvm_range_lock_t *range_lock, uvm_range_lock_range_t *range, NvU64 start, NvU64 end)
+{
+    UVM_ASSERT(start <= end);
+
+    range->node.start = start;
+    range->node.end = end;
+    range->granted = false;
+
+    uvm_record_lock(range_lock, UVM_LOCK_FLAGS_MODE_EXCLUSIVE);
+
+    uvm_spin_lock(&range_lock->lock);
+    range->seq = range_lock->next_seq++;
+    uvm_interval_tree_insert(&range_lock->ranges, &range->node);
+    uvm_spin_unlock(&range_lock->lock);
+
+    wait_event(range_lock->wait_queue, range_lock_is_granted(range_lock, range));
+
+    uvm_spin_lock(&range_lock->lock);
+    range->granted = true;
+    uvm_spin_unlock(&range_lock->lock);
+}
+
+void uvm_range_unlock(uvm_range_lock_t *range_lock, uvm_range_lock_range_t *range)
+{
+    uvm_spin_lock(&range_lock->lock);
+    uvm_interval_tree_remove(&range_lock->ranges, &range->node);
+    uvm_spin_unlock(&range_lock->lock);
+
+    // Waiters re-check their own overlaps, so waking up all of them is only a
+    // performance concern when there are many disjoint waiters.
+    wake_up_all(&range_lock->wait_queue);
+
+    uvm_record_unlock(range_lock, UVM_LOCK_FLAGS_MODE_EXCLUSIVE);
+}
+
+bool uvm_range_lock_is_locked(uvm_range_lock_t *range_lock, NvU64 start, NvU64 end)
+{
+    uvm_interval_tree_node_t *node;
+    bool locked = false;
+
+    uvm_spin_lock(&range_lock->lock);
+
+    uvm_interval_tree_for_each_in(node, &range_lock->ranges, start, end) {
+        uvm_range_lock_range_t *range = range_lock_range_from_node(node);
+
+        if (range->node.start > start || range->node.end < end)
+            continue;
+
+        // Waiting ranges are in the tree too
+        if (range->granted) {
+            locked = true;
+            break;
+        }
+    }
+
+    uvm_spin_unlock(&range_lock->lock);
+
+    return locked;
+}
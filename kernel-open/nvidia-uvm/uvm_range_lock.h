@@ -0,0 +1,91 @@
+/*******************************************************************************
+    Copyright (c) 2025 NVIDIA Corporation
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+        The above copyright notice and this permission notice shall be
+        included in all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+    THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+    DEALINGS IN THE SOFTWARE.
+
+*******************************************************************************/
+
+#ifndef __UVM_RANGE_LOCK_H__
+#define __UVM_RANGE_LOCK_H__
+
+#include "uvm_linux.h"
+#include "uvm_lock.h"
+#include "uvm_range_tree.h"
+
+// Lock over [start, end] address ranges. A locked range excludes any other
+// overlapping range, and non-overlapping ranges never wait for each other.
+//
+// Waiters are granted in request order among overlapping ranges, so a waiter
+// can't be starved by a stream of later overlapping lockers.
+//
+// The lock is tracked by the lock order checker like any other UVM lock, so a
+// thread can hold a single range of a given range lock at a time.
+typedef struct
+{
+    // Locked and waiting ranges. Protected by lock.
+    uvm_interval_tree_t ranges;
+
+    // Request order of the next range. Protected by lock.
+    NvU64 next_seq;
+
+    uvm_spinlock_t lock;
+
+    // Woken up when a range is unlocked
+    wait_queue_head_t wait_queue;
+
+#if UVM_IS_DEBUG()
+    uvm_lock_order_t lock_order;
+#endif
+} uvm_range_lock_t;
+
+// Locked or waiting range of a uvm_range_lock_t. Provided by the caller, and
+// usually allocated on the stack.
+typedef struct
+{
+    uvm_interval_tree_node_t node;
+
+    NvU64 seq;
+
+    // Set once the range stops waiting. Protected by the range lock spinlock.
+    bool granted;
+} uvm_range_lock_range_t;
+
+void uvm_range_lock_init(uvm_range_lock_t *range_lock, uvm_lock_order_t lock_order);
+
+// The range lock must be unlocked
+void uvm_range_lock_deinit(uvm_range_lock_t *range_lock);
+
+// Lock [start, end], waiting for any overlapping range to be unlocked. end is
+// inclusive.
+void uvm_range_lock(uvm_range_lock_t *range_lock, uvm_range_lock_range_t *range, NvU64 start, NvU64 end);
+
+void uvm_range_unlock(uvm_range_lock_t *range_lock, uvm_range_lock_range_t *range);
+
+// Returns whether [start, end] is covered by a single locked range. The range
+// is not necessarily locked by the calling thread, so this is intended to be
+// used in assertions along with uvm_check_locked().
+bool uvm_range_lock_is_locked(uvm_range_lock_t *range_lock, NvU64 start, NvU64 end);
+
+#define uvm_assert_range_locked(range_lock, start, end) ({                                  \
+        typeof(range_lock) _range_lock_ = (range_lock);                                     \
+        UVM_ASSERT(uvm_range_lock_is_locked(_range_lock_, (start), (end)) &&                \
+                   uvm_check_locked(_range_lock_, UVM_LOCK_FLAGS_MODE_EXCLUSIVE));          \
+    })
+
+#endif // __UVM_RANGE_LOCK_H__
@@ -24,6 +24,8 @@
 #include "uvm_common.h"
 #include "uvm_range_tree.h"
 
+#include <linux/rbtree_augmented.h>
+
 static uvm_range_tree_node_t *get_range_node(struct rb_node *rb_node)
 {
     return rb_entry(rb_node, uvm_range_tree_node_t, rb_node);
@@ -170,20 +172,34 @@ void uvm_range_tree_split(uvm_range_tree_t *tree,
                           uvm_range_tree_node_t *existing,
                           uvm_range_tree_node_t *new)
 {
-    NV_STATUS status;
+    struct rb_node **link;
+    struct rb_node *parent;
 
     UVM_ASSERT(new->start > existing->start);
     UVM_ASSERT(new->start <= existing->end);
 
     // existing doesn't have to move anywhere, we just need to adjust its
     // ranges. new will need to be inserted into the tree.
-    //
-    // Future optimization: insertion could walk down the tree starting from
-    // existing rather than from the root.
     new->end = existing->end;
     existing->end = new->start - 1;
-    status = uvm_range_tree_add(tree, new);
-    UVM_ASSERT(status == NV_OK); // There shouldn't be any collisions
+
+    // new immediately follows existing in address order, so it can be linked
+    // as the in-order successor of existing without walking down from the
+    // root: as the right child of existing if it has none, or as the left
+    // child of the leftmost node of existing's right subtree otherwise.
+    parent = &existing->rb_node;
+    link = &parent->rb_right;
+    while (*link) {
+        parent = *link;
+        link = &parent->rb_left;
+    }
+
+    rb_link_node(&new->rb_node, parent, link);
+    rb_insert_color(&new->rb_node, &tree->rb_root);
+    list_add(&new->list, &existing->list);
+
+    UVM_ASSERT(uvm_range_tree_next(tree, existing) == new);
+    UVM_ASSERT(!uvm_range_tree_next(tree, new) || uvm_range_tree_next(tree, new)->start > new->end);
 }
 
 uvm_range_tree_node_t *uvm_range_tree_merge_prev(uvm_range_tree_t *tree, uvm_range_tree_node_t *node)
@@ -289,3 +305,216 @@ NV_STATUS uvm_range_tree_find_hole_in(uvm_range_tree_t *tree, NvU64 addr, NvU64
 
     return status;
 }
+
+static uvm_interval_tree_node_t *get_interval_node(struct rb_node *rb_node)
+{
+    return rb_entry(rb_node, uvm_interval_tree_node_t, rb_node);
+}
+
+static NvU64 interval_node_compute_subtree_end(uvm_interval_tree_node_t *node)
+{
+    NvU64 subtree_end = node->end;
+
+    if (node->rb_node.rb_left)
+        subtree_end = max(subtree_end, get_interval_node(node->rb_node.rb_left)->subtree_end);
+
+    if (node->rb_node.rb_right)
+        subtree_end = max(subtree_end, get_interval_node(node->rb_node.rb_right)->subtree_end);
+
+    return subtree_end;
+}
+
+// Augmented rbtree callbacks maintaining subtree_end. See
+// include/linux/rbtree_augmented.h.
+static void interval_node_propagate(struct rb_node *rb_node, struct rb_node *stop)
+{
+    while (rb_node != stop) {
+        uvm_interval_tree_node_t *node = get_interval_node(rb_node);
+        NvU64 subtree_end = interval_node_compute_subtree_end(node);
+
+        if (node->subtree_end == subtree_end)
+            break;
+
+        node->subtree_end = subtree_end;
+        rb_node = rb_parent(&node->rb_node);
+    }
+}
+
+static void interval_node_copy(struct rb_node *rb_old, struct rb_node *rb_new)
+{
+    get_interval_node(rb_new)->subtree_end = get_interval_node(rb_old)->subtree_end;
+}
+
+static void interval_node_rotate(struct rb_node *rb_old, struct rb_node *rb_new)
+{
+    uvm_interval_tree_node_t *old = get_interval_node(rb_old);
+
+    get_interval_node(rb_new)->subtree_end = old->subtree_end;
+    old->subtree_end = interval_node_compute_subtree_end(old);
+}
+
+static const struct rb_augment_callbacks interval_tree_callbacks =
+{
+    .propagate = interval_node_propagate,
+    .copy = interval_node_copy,
+    .rotate = interval_node_rotate,
+};
+
+void uvm_interval_tree_init(uvm_interval_tree_t *tree)
+{
+    memset(tree, 0, sizeof(*tree));
+    tree->rb_root = RB_ROOT;
+}
+
+void uvm_interval_tree_insert(uvm_interval_tree_t *tree, uvm_interval_tree_node_t *node)
+{
+    struct rb_node **link = &tree->rb_root.rb_node;
+    struct rb_node *parent = NULL;
+
+    UVM_ASSERT(node->start <= node->end);
+
+    while (*link) {
+        uvm_interval_tree_node_t *cur;
+
+        parent = *link;
+        cur = get_interval_node(parent);
+
+        // The new node will be in the subtree of every node on the way down
+        if (cur->subtree_end < node->end)
+            cur->subtree_end = node->end;
+
+        if (node->start < cur->start)
+            link = &parent->rb_left;
+        else
+            link = &parent->rb_right;
+    }
+
+    node->subtree_end = node->end;
+    rb_link_node(&node->rb_node, parent, link);
+    rb_insert_augmented(&node->rb_node, &tree->rb_root, &interval_tree_callbacks);
+}
+
+void uvm_interval_tree_remove(uvm_interval_tree_t *tree, uvm_interval_tree_node_t *node)
+{
+    rb_erase_augmented(&node->rb_node, &tree->rb_root, &interval_tree_callbacks);
+}
+
+void uvm_interval_tree_set_end(uvm_interval_tree_node_t *node, NvU64 new_end)
+{
+    UVM_ASSERT_MSG(node->start <= new_end, "start 0x%llx new_end 0x%llx\n", node->start, new_end);
+
+    node->end = new_end;
+    interval_node_propagate(&node->rb_node, NULL);
+}
+
+void uvm_interval_tree_split(uvm_interval_tree_t *tree,
+                             uvm_interval_tree_node_t *existing,
+                             uvm_interval_tree_node_t *new)
+{
+    UVM_ASSERT(new->start > existing->start);
+    UVM_ASSERT(new->start <= existing->end);
+
+    // Unlike in uvm_range_tree_split, other nodes may start between existing
+    // and new so new has to be inserted from the root.
+    new->end = existing->end;
+    uvm_interval_tree_set_end(existing, new->start - 1);
+    uvm_interval_tree_insert(tree, new);
+}
+
+void uvm_interval_tree_merge(uvm_interval_tree_t *tree,
+                             uvm_interval_tree_node_t *node,
+                             uvm_interval_tree_node_t *other)
+{
+    UVM_ASSERT(other != node);
+    UVM_ASSERT(other->start >= node->start);
+    UVM_ASSERT(node->end == ULLONG_MAX || other->start <= node->end + 1);
+
+    uvm_interval_tree_remove(tree, other);
+
+    if (other->end > node->end)
+        uvm_interval_tree_set_end(node, other->end);
+}
+
+// Returns the first node in start order within the subtree rooted at node which
+// overlaps [start, end]. node->subtree_end must be >= start.
+static uvm_interval_tree_node_t *interval_subtree_first(uvm_interval_tree_node_t *node, NvU64 start, NvU64 end)
+{
+    while (true) {
+        // Nodes on the left come first if any of them ends late enough
+        if (node->rb_node.rb_left) {
+            uvm_interval_tree_node_t *left = get_interval_node(node->rb_node.rb_left);
+
+            if (left->subtree_end >= start) {
+                node = left;
+                continue;
+            }
+        }
+
+        // Nodes on the right start after node, so none of them can overlap if
+        // node starts after end.
+        if (node->start > end)
+            return NULL;
+
+        if (node->end >= start)
+            return node;
+
+        if (!node->rb_node.rb_right)
+            return NULL;
+
+        node = get_interval_node(node->rb_node.rb_right);
+        if (node->subtree_end < start)
+            return NULL;
+    }
+}
+
+uvm_interval_tree_node_t *uvm_interval_tree_iter_first(uvm_interval_tree_t *tree, NvU64 start, NvU64 end)
+{
+    uvm_interval_tree_node_t *root;
+
+    UVM_ASSERT(start <= end);
+
+    if (!tree->rb_root.rb_node)
+        return NULL;
+
+    root = get_interval_node(tree->rb_root.rb_node);
+    if (root->subtree_end < start)
+        return NULL;
+
+    return interval_subtree_first(root, start, end);
+}
+
+uvm_interval_tree_node_t *uvm_interval_tree_iter_next(uvm_interval_tree_node_t *node, NvU64 start, NvU64 end)
+{
+    struct rb_node *rb_node = node->rb_node.rb_right;
+
+    UVM_ASSERT(start <= end);
+
+    while (true) {
+        struct rb_node *prev;
+
+        // The next nodes in start order are the ones in the right subtree,
+        // followed by the first ancestor reached from a left child.
+        if (rb_node) {
+            uvm_interval_tree_node_t *right = get_interval_node(rb_node);
+
+            if (right->subtree_end >= start)
+                return interval_subtree_first(right, start, end);
+        }
+
+        do {
+            prev = &node->rb_node;
+            rb_node = rb_parent(prev);
+            if (!rb_node)
+                return NULL;
+
+            node = get_interval_node(rb_node);
+            rb_node = node->rb_node.rb_right;
+        } while (prev == rb_node);
+
+        if (node->start > end)
+            return NULL;
+
+        if (node->end >= start)
+            return node;
+    }
+}
@@ -177,4 +177,81 @@ static NvU64 uvm_range_tree_node_size(uvm_range_tree_node_t *node)
          (node) ? ((next) = uvm_range_tree_iter_next((tree), (node), (end)), true) : false; \
          (node) = (next))
 
+// Tree-based data structure for looking up objects with provided [start, end]
+// ranges which, unlike uvm_range_tree_t, are allowed to overlap. Each node
+// tracks the largest end in its subtree so finding all the nodes overlapping a
+// range takes O(log n + k) for k overlapping nodes, instead of walking every
+// node which starts before the end of the range.
+//
+// All locking is up to the caller.
+
+typedef struct uvm_interval_tree_struct
+{
+    // Tree of uvm_interval_tree_node_t's sorted by start, augmented with
+    // subtree_end.
+    struct rb_root rb_root;
+} uvm_interval_tree_t;
+
+typedef struct uvm_interval_tree_node_struct
+{
+    NvU64 start;
+    // end is inclusive
+    NvU64 end;
+
+    // Largest end of the nodes in the subtree rooted at this node
+    NvU64 subtree_end;
+
+    struct rb_node rb_node;
+} uvm_interval_tree_node_t;
+
+void uvm_interval_tree_init(uvm_interval_tree_t *tree);
+
+// Set node->start and node->end before calling this function. Nodes with equal
+// starts are kept in insertion order.
+void uvm_interval_tree_insert(uvm_interval_tree_t *tree, uvm_interval_tree_node_t *node);
+
+void uvm_interval_tree_remove(uvm_interval_tree_t *tree, uvm_interval_tree_node_t *node);
+
+// Change the end of an existing node. new_end must be >= node->start. The start
+// of a node can only be changed by removing and inserting it again.
+void uvm_interval_tree_set_end(uvm_interval_tree_node_t *node, NvU64 new_end);
+
+// Splits an existing node into two pieces, like uvm_range_tree_split. The
+// caller must set new->start before calling this function.
+//
+// Before: [----------- existing ------------]
+// After:  [---- existing ----][---- new ----]
+//                             ^new->start
+void uvm_interval_tree_split(uvm_interval_tree_t *tree,
+                             uvm_interval_tree_node_t *existing,
+                             uvm_interval_tree_node_t *new);
+
+// Extends node to also cover other, which is removed from the tree. other must
+// start within or right after node.
+void uvm_interval_tree_merge(uvm_interval_tree_t *tree,
+                             uvm_interval_tree_node_t *node,
+                             uvm_interval_tree_node_t *other);
+
+// Returns the first node in start order overlapping [start, end], if any
+uvm_interval_tree_node_t *uvm_interval_tree_iter_first(uvm_interval_tree_t *tree, NvU64 start, NvU64 end);
+
+// Returns the node following the provided node in start order which overlaps
+// [start, end], if any.
+uvm_interval_tree_node_t *uvm_interval_tree_iter_next(uvm_interval_tree_node_t *node, NvU64 start, NvU64 end);
+
+static bool uvm_interval_tree_empty(uvm_interval_tree_t *tree)
+{
+    return RB_EMPTY_ROOT(&tree->rb_root);
+}
+
+#define uvm_interval_tree_for_each_in(node, tree, start, end)                    \
+    for ((node) = uvm_interval_tree_iter_first((tree), (start), (end));         \
+         (node);                                                                \
+         (node) = uvm_interval_tree_iter_next((node), (start), (end)))
+
+#define uvm_interval_tree_for_each_in_safe(node, next, tree, start, end)                               \
+    for ((node) = uvm_interval_tree_iter_first((tree), (start), (end));                                \
+         (node) ? ((next) = uvm_interval_tree_iter_next((node), (start), (end)), true) : false;        \
+         (node) = (next))
+
 #endif // __UVM_RANGE_TREE_H__
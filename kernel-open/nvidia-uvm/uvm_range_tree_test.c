@@ -998,6 +998,107 @@ static NV_STATUS rtt_directed(rtt_state_t *state)
     return NV_OK;
 }
 
+// ------------------- Interval Tree Test (ITT) ------------------- //
+
+// Check that iterating over the nodes overlapping [start, end] returns exactly
+// the expected nodes, in order.
+static NV_STATUS itt_check_expected(uvm_interval_tree_t *tree,
+                                    NvU64 start,
+                                    NvU64 end,
+                                    uvm_interval_tree_node_t **expected,
+                                    size_t count)
+{
+    uvm_interval_tree_node_t *node;
+    size_t i = 0;
+
+    uvm_interval_tree_for_each_in(node, tree, start, end) {
+        TEST_CHECK_RET(i < count);
+        TEST_CHECK_RET(node == expected[i]);
+        i++;
+    }
+
+    TEST_CHECK_RET(i == count);
+    return NV_OK;
+}
+
+static NV_STATUS itt_directed(void)
+{
+    uvm_interval_tree_t tree;
+    uvm_interval_tree_node_t nodes[6];
+    uvm_interval_tree_node_t *node, *next;
+    const NvU64 ranges[][2] = {{0, 9}, {5, 14}, {20, 29}, {25, 25}, {40, 49}};
+    size_t i;
+
+    uvm_interval_tree_init(&tree);
+    TEST_CHECK_RET(uvm_interval_tree_empty(&tree));
+    TEST_CHECK_RET(uvm_interval_tree_iter_first(&tree, 0, ULLONG_MAX) == NULL);
+
+    // Insert out of order: [0, 9] [5, 14] [20, 29] [25, 25] [40, 49]
+    for (i = 0; i < ARRAY_SIZE(ranges); i++) {
+        size_t index = (i * 3) % ARRAY_SIZE(ranges);
+
+        nodes[index].start = ranges[index][0];
+        nodes[index].end = ranges[index][1];
+        uvm_interval_tree_insert(&tree, &nodes[index]);
+    }
+
+    {
+        uvm_interval_tree_node_t *all[] = {&nodes[0], &nodes[1], &nodes[2], &nodes[3], &nodes[4]};
+        uvm_interval_tree_node_t *mid[] = {&nodes[1]};
+        uvm_interval_tree_node_t *dup[] = {&nodes[2], &nodes[3]};
+        uvm_interval_tree_node_t *edge[] = {&nodes[0], &nodes[1]};
+
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 0, ULLONG_MAX, all, ARRAY_SIZE(all)));
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 10, 19, mid, ARRAY_SIZE(mid)));
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 15, 19, NULL, 0));
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 25, 25, dup, ARRAY_SIZE(dup)));
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 9, 9, edge, ARRAY_SIZE(edge)));
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 50, ULLONG_MAX, NULL, 0));
+    }
+
+    // Grow [0, 9] to [0, 30] over the hole
+    uvm_interval_tree_set_end(&nodes[0], 30);
+    {
+        uvm_interval_tree_node_t *hole[] = {&nodes[0]};
+
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 15, 19, hole, ARRAY_SIZE(hole)));
+    }
+
+    // Split it into [0, 14] and [15, 30]
+    nodes[5].start = 15;
+    uvm_interval_tree_split(&tree, &nodes[0], &nodes[5]);
+    TEST_CHECK_RET(nodes[0].end == 14);
+    TEST_CHECK_RET(nodes[5].end == 30);
+    {
+        uvm_interval_tree_node_t *split[] = {&nodes[0], &nodes[1], &nodes[5]};
+        uvm_interval_tree_node_t *after[] = {&nodes[5], &nodes[2], &nodes[3]};
+
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 14, 15, split, ARRAY_SIZE(split)));
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 16, 30, after, ARRAY_SIZE(after)));
+    }
+
+    // Merging [25, 25] into [20, 29] leaves the bounds unchanged
+    uvm_interval_tree_merge(&tree, &nodes[2], &nodes[3]);
+    TEST_CHECK_RET(nodes[2].start == 20 && nodes[2].end == 29);
+
+    // Shrink [20, 29] and merge [40, 49] into it through [30, 39]
+    uvm_interval_tree_set_end(&nodes[2], 39);
+    uvm_interval_tree_merge(&tree, &nodes[2], &nodes[4]);
+    TEST_CHECK_RET(nodes[2].end == 49);
+    {
+        uvm_interval_tree_node_t *merged[] = {&nodes[2]};
+
+        TEST_NV_CHECK_RET(itt_check_expected(&tree, 45, 100, merged, ARRAY_SIZE(merged)));
+    }
+
+    uvm_interval_tree_for_each_in_safe(node, next, &tree, 0, ULLONG_MAX)
+        uvm_interval_tree_remove(&tree, node);
+
+    TEST_CHECK_RET(uvm_interval_tree_empty(&tree));
+
+    return NV_OK;
+}
+
 NV_STATUS uvm_test_range_tree_directed(UVM_TEST_RANGE_TREE_DIRECTED_PARAMS *params, struct file *filp)
 {
     rtt_state_t *state;
@@ -1008,7 +1109,10 @@ NV_STATUS uvm_test_range_tree_directed(UVM_TEST_RANGE_TREE_DIRECTED_PARAMS *para
         return NV_ERR_NO_MEMORY;
     status = rtt_directed(state);
     rtt_state_destroy(state);
-    return status;
+    if (status != NV_OK)
+        return status;
+
+    return itt_directed();
 }
 
 // ------------------------------ Random Test ------------------------------ //
@@ -1714,3 +1818,366 @@ NV_STATUS uvm_test_range_tree_random(UVM_TEST_RANGE_TREE_RANDOM_PARAMS *params,
     rtt_state_destroy(state);
     return status;
 }
+
+// ------------------- Interval Tree Random Test ------------------- //
+
+typedef struct
+{
+    uvm_interval_tree_node_t node;
+
+    bool inserted;
+
+    // Last query which returned this node, to catch duplicates
+    NvU64 query_id;
+} itt_node_t;
+
+typedef struct
+{
+    uvm_interval_tree_t tree;
+    uvm_test_rng_t rng;
+
+    itt_node_t *nodes;
+
+    // Number of nodes in the tree
+    NvU32 count;
+
+    NvU64 query_id;
+
+    UVM_TEST_INTERVAL_TREE_RANDOM_PARAMS *params;
+} itt_state_t;
+
+static void itt_rand_range(itt_state_t *state, NvU64 *start, NvU64 *end)
+{
+    NvU64 size = uvm_test_rng_range_log64(&state->rng, 1, state->params->max_size);
+
+    *start = uvm_test_rng_range_64(&state->rng, 0, state->params->max_end);
+    if (size - 1 > state->params->max_end - *start)
+        *end = state->params->max_end;
+    else
+        *end = *start + size - 1;
+}
+
+// Pick a random node which is in the tree or not
+static itt_node_t *itt_rand_node(itt_state_t *state, bool inserted)
+{
+    NvU32 max_nodes = state->params->max_nodes;
+    NvU32 first = uvm_test_rng_range_32(&state->rng, 0, max_nodes - 1);
+    NvU32 i;
+
+    if (inserted && state->count == 0)
+        return NULL;
+
+    if (!inserted && state->count == max_nodes)
+        return NULL;
+
+    for (i = 0; i < max_nodes; i++) {
+        itt_node_t *node = &state->nodes[(first + i) % max_nodes];
+
+        if (node->inserted == inserted)
+            return node;
+    }
+
+    UVM_ASSERT(0);
+    return NULL;
+}
+
+// Verify the tree order and subtree_end of every node. Returns the largest end
+// in the subtree through subtree_end.
+static NV_STATUS itt_check_subtree(struct rb_node *rb_node, NvU32 *count, NvU64 *subtree_end)
+{
+    uvm_interval_tree_node_t *node = rb_entry(rb_node, uvm_interval_tree_node_t, rb_node);
+    NvU64 expected_end = node->end;
+    NvU64 child_end;
+
+    TEST_CHECK_RET(node->start <= node->end);
+
+    if (rb_node->rb_left) {
+        TEST_CHECK_RET(rb_entry(rb_node->rb_left, uvm_interval_tree_node_t, rb_node)->start <= node->start);
+        TEST_NV_CHECK_RET(itt_check_subtree(rb_node->rb_left, count, &child_end));
+        expected_end = max(expected_end, child_end);
+    }
+
+    if (rb_node->rb_right) {
+        TEST_CHECK_RET(rb_entry(rb_node->rb_right, uvm_interval_tree_node_t, rb_node)->start >= node->start);
+        TEST_NV_CHECK_RET(itt_check_subtree(rb_node->rb_right, count, &child_end));
+        expected_end = max(expected_end, child_end);
+    }
+
+    if (node->subtree_end != expected_end) {
+        UVM_TEST_PRINT("Node [0x%llx, 0x%llx] subtree_end 0x%llx, expected 0x%llx\n",
+                       node->start,
+                       node->end,
+                       node->subtree_end,
+                       expected_end);
+        return NV_ERR_INVALID_STATE;
+    }
+
+    (*count)++;
+    *subtree_end = expected_end;
+    return NV_OK;
+}
+
+static NV_STATUS itt_check_tree(itt_state_t *state)
+{
+    NvU32 count = 0;
+    NvU64 subtree_end;
+
+    if (uvm_interval_tree_empty(&state->tree)) {
+        TEST_CHECK_RET(state->count == 0);
+        return NV_OK;
+    }
+
+    TEST_NV_CHECK_RET(itt_check_subtree(state->tree.rb_root.rb_node, &count, &subtree_end));
+    TEST_CHECK_RET(count == state->count);
+
+    return NV_OK;
+}
+
+// Compare the nodes returned by the tree iterator for [start, end] with the
+// nodes found by checking all of them.
+static NV_STATUS itt_check_query(itt_state_t *state, NvU64 start, NvU64 end)
+{
+    uvm_interval_tree_node_t *node;
+    NvU64 prev_start = 0;
+    NvU32 expected = 0;
+    NvU32 found = 0;
+    NvU32 i;
+
+    ++state->query_id;
+
+    for (i = 0; i < state->params->max_nodes; i++) {
+        itt_node_t *itt_node = &state->nodes[i];
+
+        if (itt_node->inserted && uvm_ranges_overlap(itt_node->node.start, itt_node->node.end, start, end))
+            expected++;
+    }
+
+    uvm_interval_tree_for_each_in(node, &state->tree, start, end) {
+        itt_node_t *itt_node = container_of(node, itt_node_t, node);
+
+        TEST_CHECK_RET(itt_node->inserted);
+        TEST_CHECK_RET(itt_node->query_id != state->query_id);
+        TEST_CHECK_RET(uvm_ranges_overlap(node->start, node->end, start, end));
+        TEST_CHECK_RET(node->start >= prev_start);
+
+        itt_node->query_id = state->query_id;
+        prev_start = node->start;
+        found++;
+    }
+
+    if (found != expected) {
+        UVM_TEST_PRINT("Query [0x%llx, 0x%llx] found %u nodes, expected %u\n", start, end, found, expected);
+        return NV_ERR_INVALID_STATE;
+    }
+
+    return NV_OK;
+}
+
+static void itt_insert(itt_state_t *state, itt_node_t *node)
+{
+    node->inserted = true;
+    uvm_interval_tree_insert(&state->tree, &node->node);
+    state->count++;
+}
+
+static void itt_remove(itt_state_t *state, itt_node_t *node)
+{
+    uvm_interval_tree_remove(&state->tree, &node->node);
+    node->inserted = false;
+    state->count--;
+}
+
+static void itt_rand_op(itt_state_t *state)
+{
+    NvU32 op = uvm_test_rng_range_32(&state->rng, 0, 99);
+    itt_node_t *node;
+    itt_node_t *new;
+    NvU64 start, end;
+
+    // Insert while the tree is small, remove while it is large
+    if (op < 40) {
+        bool grow = uvm_test_rng_range_32(&state->rng, 0, state->params->max_nodes) >= state->count;
+
+        if (grow) {
+            node = itt_rand_node(state, false);
+            if (node) {
+                itt_rand_range(state, &node->node.start, &node->node.end);
+                itt_insert(state, node);
+            }
+        }
+        else {
+            node = itt_rand_node(state, true);
+            if (node)
+                itt_remove(state, node);
+        }
+    }
+    else if (op < 60) {
+        // Change the end of a node
+        node = itt_rand_node(state, true);
+        if (node) {
+            itt_rand_range(state, &start, &end);
+            uvm_interval_tree_set_end(&node->node, max(node->node.start, end));
+        }
+    }
+    else if (op < 80) {
+        // Split a node
+        node = itt_rand_node(state, true);
+        new = itt_rand_node(state, false);
+        if (node && new && node->node.start < node->node.end) {
+            new->node.start = uvm_test_rng_range_64(&state->rng, node->node.start + 1, node->node.end);
+            uvm_interval_tree_split(&state->tree, &node->node, &new->node);
+            new->inserted = true;
+            state->count++;
+        }
+    }
+    else {
+        // Merge a node with another one starting within or right after it
+        uvm_interval_tree_node_t *other;
+
+        node = itt_rand_node(state, true);
+        if (!node)
+            return;
+
+        start = node->node.start;
+        end = node->node.end == state->params->max_end ? node->node.end : node->node.end + 1;
+        uvm_interval_tree_for_each_in(other, &state->tree, start, end) {
+            if (other != &node->node && other->start >= start)
+                break;
+        }
+
+        if (other) {
+            uvm_interval_tree_merge(&state->tree, &node->node, other);
+            container_of(other, itt_node_t, node)->inserted = false;
+            state->count--;
+        }
+    }
+}
+
+// Time the timed_queries queries with the tree iterator and by walking all the
+// nodes in start order until the end of the query, as done with a tree sorted
+// only by start.
+static NV_STATUS itt_time_queries(itt_state_t *state)
+{
+    UVM_TEST_INTERVAL_TREE_RANDOM_PARAMS *params = state->params;
+    NvU64 *queries;
+    NvU64 tree_overlaps = 0;
+    NvU64 linear_overlaps = 0;
+    NvU64 start_time;
+    NvU32 i;
+
+    if (params->timed_queries == 0)
+        return NV_OK;
+
+    queries = uvm_kvmalloc(2 * sizeof(*queries) * params->timed_queries);
+    if (!queries)
+        return NV_ERR_NO_MEMORY;
+
+    for (i = 0; i < params->timed_queries; i++)
+        itt_rand_range(state, &queries[2 * i], &queries[2 * i + 1]);
+
+    start_time = NV_GETTIME();
+    for (i = 0; i < params->timed_queries; i++) {
+        uvm_interval_tree_node_t *node;
+
+        uvm_interval_tree_for_each_in(node, &state->tree, queries[2 * i], queries[2 * i + 1])
+            tree_overlaps++;
+    }
+    params->tree_query_ns = NV_GETTIME() - start_time;
+
+    start_time = NV_GETTIME();
+    for (i = 0; i < params->timed_queries; i++) {
+        struct rb_node *rb_node;
+
+        for (rb_node = rb_first(&state->tree.rb_root); rb_node; rb_node = rb_next(rb_node)) {
+            uvm_interval_tree_node_t *node = rb_entry(rb_node, uvm_interval_tree_node_t, rb_node);
+
+            if (node->start > queries[2 * i + 1])
+                break;
+
+            if (node->end >= queries[2 * i])
+                linear_overlaps++;
+        }
+    }
+    params->linear_query_ns = NV_GETTIME() - start_time;
+
+    uvm_kvfree(queries);
+
+    params->overlaps = tree_overlaps;
+    TEST_CHECK_RET(tree_overlaps == linear_overlaps);
+
+    return NV_OK;
+}
+
+static NV_STATUS itt_random(itt_state_t *state)
+{
+    UVM_TEST_INTERVAL_TREE_RANDOM_PARAMS *params = state->params;
+    NvU64 i;
+    NvU32 j;
+
+    for (i = 0; i < params->main_iterations; i++) {
+        NvU64 start, end;
+
+        // Since we could spend a long time here, catch ctrl-c
+        if (fatal_signal_pending(current))
+            return NV_ERR_SIGNAL_PENDING;
+
+        if (params->verbose)
+            UVM_TEST_PRINT("Iteration %llu: count %u\n", i, state->count);
+
+        itt_rand_op(state);
+
+        TEST_NV_CHECK_RET(itt_check_tree(state));
+
+        for (j = 0; j < params->query_checks; j++) {
+            itt_rand_range(state, &start, &end);
+            TEST_NV_CHECK_RET(itt_check_query(state, start, end));
+        }
+    }
+
+    // Fill up the tree before timing the queries
+    for (j = 0; j < params->max_nodes; j++) {
+        itt_node_t *node = &state->nodes[j];
+
+        if (!node->inserted) {
+            itt_rand_range(state, &node->node.start, &node->node.end);
+            itt_insert(state, node);
+        }
+    }
+
+    TEST_NV_CHECK_RET(itt_check_tree(state));
+
+    return itt_time_queries(state);
+}
+
+NV_STATUS uvm_test_interval_tree_random(UVM_TEST_INTERVAL_TREE_RANDOM_PARAMS *params, struct file *filp)
+{
+    itt_state_t *state;
+    NV_STATUS status;
+
+    if (params->max_nodes == 0 ||
+        params->max_nodes > UVM_TEST_INTERVAL_TREE_MAX_NODES ||
+        params->max_size == 0 ||
+        params->timed_queries > UVM_TEST_INTERVAL_TREE_MAX_TIMED_QUERIES)
+        return NV_ERR_INVALID_PARAMETER;
+
+    state = uvm_kvmalloc_zero(sizeof(*state));
+    if (!state)
+        return NV_ERR_NO_MEMORY;
+
+    state->nodes = uvm_kvmalloc_zero(sizeof(*state->nodes) * params->max_nodes);
+    if (!state->nodes) {
+        uvm_kvfree(state);
+        return NV_ERR_NO_MEMORY;
+    }
+
+    state->params = params;
+    uvm_interval_tree_init(&state->tree);
+    uvm_test_rng_init(&state->rng, params->seed);
+
+    status = itt_random(state);
+
+    uvm_kvfree(state->nodes);
+    uvm_kvfree(state);
+
+    return status;
+}
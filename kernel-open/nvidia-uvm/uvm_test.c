@@ -360,6 +360,23 @@ long uvm_test_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_VA_BLOCK_DISCARD_STATUS,      uvm_test_va_block_discard_status);
         UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_VA_BLOCK_DISCARD_CHECK_PMM_STATE,
                                        uvm_test_va_block_discard_check_pmm_state);
+        UVM_ROUTE_CMD_STACK_NO_INIT_CHECK(UVM_TEST_FAULT_BATCH_SORT,          uvm_test_fault_batch_sort);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_PMM_SET_EVICT_POLICY,         uvm_test_pmm_set_evict_policy);
+        UVM_ROUTE_CMD_STACK_NO_INIT_CHECK(UVM_TEST_PMM_EVICT_POLICY_REPLAY,   uvm_test_pmm_evict_policy_replay);
+        UVM_ROUTE_CMD_STACK_NO_INIT_CHECK(UVM_TEST_THRASHING_ADAPT_SIMULATE,  uvm_test_thrashing_adapt_simulate);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_CHANNEL_STRIPE_BANDWIDTH,     uvm_test_channel_stripe_bandwidth);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_VA_BLOCK_CPU_FAULT_BENCH,     uvm_test_va_block_cpu_fault_bench);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_INTERVAL_TREE_RANDOM,         uvm_test_interval_tree_random);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_PAGE_MASK,                    uvm_test_page_mask);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_ACCESS_COUNTER_PLANNER,       uvm_test_access_counter_planner);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_RANGE_LOCK_STRESS,            uvm_test_range_lock_stress);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_FAULT_TRACE_CAPTURE,          uvm_test_fault_trace_capture);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_FAULT_TRACE_READ,             uvm_test_fault_trace_read);
+        UVM_ROUTE_CMD_STACK_NO_INIT_CHECK(UVM_TEST_FAULT_TRACE_REPLAY,        uvm_test_fault_trace_replay);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_MIGRATE_FENCE,                uvm_test_migrate_fence);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_TOOLS_ATS_PREFETCH_COUNTERS,  uvm_test_tools_ats_prefetch_counters);
+        UVM_ROUTE_CMD_STACK_INIT_CHECK(UVM_TEST_READ_DUPLICATION_WRITE_TRACKING,
+                                       uvm_test_read_duplication_write_tracking);
     }
 
     return -EINVAL;
@@ -102,6 +102,7 @@ long uvm_test_ioctl(struct file *filp, unsigned int cmd, unsigned long arg);
 
 NV_STATUS uvm_test_range_tree_directed(UVM_TEST_RANGE_TREE_DIRECTED_PARAMS *params, struct file *filp);
 NV_STATUS uvm_test_range_tree_random(UVM_TEST_RANGE_TREE_RANDOM_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_interval_tree_random(UVM_TEST_INTERVAL_TREE_RANDOM_PARAMS *params, struct file *filp);
 NV_STATUS uvm_test_range_allocator_sanity(UVM_TEST_RANGE_ALLOCATOR_SANITY_PARAMS *params, struct file *filp);
 NV_STATUS uvm_test_page_tree(UVM_TEST_PAGE_TREE_PARAMS *params, struct file *filp);
 NV_STATUS uvm_test_rm_mem_sanity(UVM_TEST_RM_MEM_SANITY_PARAMS *params, struct file *filp);
@@ -120,6 +121,7 @@ NV_STATUS uvm_test_ce_sanity(UVM_TEST_CE_SANITY_PARAMS *params, struct file *fil
 NV_STATUS uvm_test_host_sanity(UVM_TEST_HOST_SANITY_PARAMS *params, struct file *filp);
 
 NV_STATUS uvm_test_lock_sanity(UVM_TEST_LOCK_SANITY_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_range_lock_stress(UVM_TEST_RANGE_LOCK_STRESS_PARAMS *params, struct file *filp);
 
 NV_STATUS uvm_test_perf_utils_sanity(UVM_TEST_PERF_UTILS_SANITY_PARAMS *params, struct file *filp);
 
@@ -146,6 +148,7 @@ NV_STATUS uvm_test_peer_identity_mappings(UVM_TEST_PEER_IDENTITY_MAPPINGS_PARAMS
 NV_STATUS uvm_test_set_prefetch_filtering(UVM_TEST_SET_PREFETCH_FILTERING_PARAMS *params, struct file *filp);
 
 NV_STATUS uvm_test_va_block(UVM_TEST_VA_BLOCK_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_page_mask(UVM_TEST_PAGE_MASK_PARAMS *params, struct file *filp);
 
 NV_STATUS uvm_test_evict_chunk(UVM_TEST_EVICT_CHUNK_PARAMS *params, struct file *filp);
 
@@ -178,6 +181,18 @@ NV_STATUS uvm_test_pmm_release_free_root_chunks(UVM_TEST_PMM_RELEASE_FREE_ROOT_C
                                                 struct file *filp);
 
 NV_STATUS uvm_test_drain_replayable_faults(UVM_TEST_DRAIN_REPLAYABLE_FAULTS_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_fault_batch_sort(UVM_TEST_FAULT_BATCH_SORT_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_fault_trace_capture(UVM_TEST_FAULT_TRACE_CAPTURE_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_fault_trace_read(UVM_TEST_FAULT_TRACE_READ_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_fault_trace_replay(UVM_TEST_FAULT_TRACE_REPLAY_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_migrate_fence(UVM_TEST_MIGRATE_FENCE_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_pmm_set_evict_policy(UVM_TEST_PMM_SET_EVICT_POLICY_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_pmm_evict_policy_replay(UVM_TEST_PMM_EVICT_POLICY_REPLAY_PARAMS *params,
+                                           struct file *filp);
+NV_STATUS uvm_test_thrashing_adapt_simulate(UVM_TEST_THRASHING_ADAPT_SIMULATE_PARAMS *params,
+                                            struct file *filp);
+NV_STATUS uvm_test_channel_stripe_bandwidth(UVM_TEST_CHANNEL_STRIPE_BANDWIDTH_PARAMS *params,
+                                            struct file *filp);
 
 NV_STATUS uvm_test_va_space_add_dummy_thread_contexts(UVM_TEST_VA_SPACE_ADD_DUMMY_THREAD_CONTEXTS_PARAMS *params,
                                                       struct file *filp);
@@ -210,6 +210,8 @@ typedef struct
 
     // NV_ERR_INVALID_ADDRESS   lookup_address doesn't match a UVM range
     NV_STATUS                       rmStatus;                                           // Out
+
+    NvBool                          read_duplication_write_tracking;                    // Out
 } UVM_TEST_VA_RANGE_INFO_PARAMS;
 
 #define UVM_TEST_RM_MEM_SANITY                           UVM_TEST_IOCTL_BASE(5)
@@ -1549,6 +1551,20 @@ typedef struct
     NvU8 num_notification_buffers;          // Out
     NvU32 num_notification_entries;         // Out
 
+    // Access counter migration planner statistics, summed over all the
+    // notification buffers. All zero if the planner is disabled. See
+    // uvm_access_counter_planner_t.
+    NvBool planner_enabled;                                 // Out
+    NvU64 planner_plans                 NV_ALIGN_BYTES(8);  // Out
+    NvU64 planner_recorded              NV_ALIGN_BYTES(8);  // Out
+    NvU64 planner_evicted               NV_ALIGN_BYTES(8);  // Out
+    NvU64 planner_expired               NV_ALIGN_BYTES(8);  // Out
+    NvU64 planner_contested             NV_ALIGN_BYTES(8);  // Out
+    NvU64 planner_outvoted              NV_ALIGN_BYTES(8);  // Out
+    NvU64 planner_deferred              NV_ALIGN_BYTES(8);  // Out
+    NvU64 planner_migrated              NV_ALIGN_BYTES(8);  // Out
+    NvU64 planner_bytes_migrated        NV_ALIGN_BYTES(8);  // Out
+
     NV_STATUS rmStatus;                     // Out
 } UVM_TEST_QUERY_ACCESS_COUNTERS_PARAMS;
 
@@ -1578,6 +1594,339 @@ typedef struct
     NV_STATUS rmStatus;                                  // Out
 } UVM_TEST_VA_BLOCK_DISCARD_CHECK_PMM_STATE_PARAMS;
 
+// Check that the radix-bucketed ordering of replayable fault batches matches
+// the comparison-based ordering on randomly generated batches. No GPU is
+// required.
+#define UVM_TEST_FAULT_BATCH_SORT                        UVM_TEST_IOCTL_BASE(112)
+typedef struct
+{
+    NvU32 iterations;                                    // In
+    NvU32 max_faults;                                    // In
+    NvU32 seed;                                          // In
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_FAULT_BATCH_SORT_PARAMS;
+
+// Set the policy used to pick root chunks to evict on the given GPU. See
+// uvm_pmm_gpu_evict_policy_t for the valid values. The default is set by the
+// uvm_perf_pmm_evict_policy module parameter.
+#define UVM_TEST_PMM_SET_EVICT_POLICY                    UVM_TEST_IOCTL_BASE(113)
+typedef struct
+{
+    NvProcessorUuid gpu_uuid;                            // In
+    NvU32 policy;                                        // In
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_PMM_SET_EVICT_POLICY_PARAMS;
+
+// Replay a synthetic VA block access trace through a simulated GPU memory of
+// capacity root chunks, using both the list and the CLOCK eviction policies,
+// and report the number of accesses which found their VA block resident under
+// each. hot_percent percent of the accesses go to random blocks among the
+// first hot_set blocks, the rest scan the remaining blocks sequentially. No GPU
+// is required.
+#define UVM_TEST_PMM_EVICT_POLICY_REPLAY                 UVM_TEST_IOCTL_BASE(114)
+typedef struct
+{
+    NvU64 accesses                   NV_ALIGN_BYTES(8);  // In
+    NvU32 capacity;                                      // In
+    NvU32 working_set;                                   // In
+    NvU32 hot_set;                                       // In
+    NvU32 hot_percent;                                   // In
+    NvU32 seed;                                          // In
+    NvU64 list_hits                  NV_ALIGN_BYTES(8);  // Out
+    NvU64 clock_hits                 NV_ALIGN_BYTES(8);  // Out
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_PMM_EVICT_POLICY_REPLAY_PARAMS;
+
+// Drive the adaptive thrashing mitigation controller with synthetic
+// throttling and pinning outcomes, and check that it converges towards the
+// expected parameters for latency-bound and bulk access patterns, and for
+// pages which thrash again or not after being unpinned. iterations is the
+// number of simulated thrashing pages per pattern, 0 selects the default. No
+// GPU is required.
+#define UVM_TEST_THRASHING_ADAPT_SIMULATE                UVM_TEST_IOCTL_BASE(115)
+typedef struct
+{
+    NvU32 iterations;                                    // In
+    NvU32 seed;                                          // In
+    NvU32 latency_pin_threshold;                         // Out
+    NvU32 bulk_pin_threshold;                            // Out
+    NvU64 repin_pin_ns               NV_ALIGN_BYTES(8);  // Out
+    NvU64 expire_pin_ns              NV_ALIGN_BYTES(8);  // Out
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_THRASHING_ADAPT_SIMULATE_PARAMS;
+
+// Copy size bytes between sysmem and vidmem of the given GPU, once on a single
+// channel and once striped across the channels returned by
+// uvm_channel_manager_stripe_channel(), and report the time taken and the
+// bandwidth reached for each, over iterations copies. Before timing, the data
+// is checked to survive a striped round trip. 0 selects the default for size,
+// stripes and iterations.
+#define UVM_TEST_CHANNEL_STRIPE_DIRECTION_CPU_TO_GPU 0
+#define UVM_TEST_CHANNEL_STRIPE_DIRECTION_GPU_TO_CPU 1
+
+#define UVM_TEST_CHANNEL_STRIPE_BANDWIDTH                UVM_TEST_IOCTL_BASE(116)
+typedef struct
+{
+    NvProcessorUuid gpu_uuid;                            // In
+    NvU64 size                       NV_ALIGN_BYTES(8);  // In
+    NvU32 direction;                                     // In
+    NvU32 stripes;                                       // In
+    NvU32 iterations;                                    // In
+    NvU32 stripes_used;                                  // Out
+    NvU64 single_ns                  NV_ALIGN_BYTES(8);  // Out
+    NvU64 striped_ns                 NV_ALIGN_BYTES(8);  // Out
+    NvU64 single_mbps                NV_ALIGN_BYTES(8);  // Out
+    NvU64 striped_mbps               NV_ALIGN_BYTES(8);  // Out
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_CHANNEL_STRIPE_BANDWIDTH_PARAMS;
+
+// Measure the latency of resolving a CPU fault on the page at lookup_address
+// from num_threads kernel threads concurrently, with the lock-free CPU fault
+// snapshot of the VA block and with the VA block lock, over iterations lookups
+// per thread. The page must be resident on the CPU and mapped for read, or for
+// write if write is set, for the lookups to hit. The reported times are the
+// average per lookup.
+#define UVM_TEST_VA_BLOCK_CPU_FAULT_BENCH_MAX_THREADS 256
+
+#define UVM_TEST_VA_BLOCK_CPU_FAULT_BENCH                UVM_TEST_IOCTL_BASE(117)
+typedef struct
+{
+    NvU64 lookup_address             NV_ALIGN_BYTES(8);  // In
+    NvU32 num_threads;                                   // In
+    NvU32 iterations;                                    // In
+    NvU32 write;                                         // In
+    NvU64 fast_path_ns               NV_ALIGN_BYTES(8);  // Out
+    NvU64 fast_path_hits             NV_ALIGN_BYTES(8);  // Out
+    NvU64 locked_path_ns             NV_ALIGN_BYTES(8);  // Out
+    NvU64 locked_path_hits           NV_ALIGN_BYTES(8);  // Out
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_VA_BLOCK_CPU_FAULT_BENCH_PARAMS;
+
+// Randomly insert, remove, resize, split and merge possibly overlapping nodes
+// in a uvm_interval_tree_t of up to max_nodes nodes, checking the tree
+// invariants after every operation and query_checks random overlap queries
+// against a brute force search. Ranges are within [0, max_end] and at most
+// max_size long.
+//
+// The tree is then filled up to max_nodes and timed_queries random overlap
+// queries are timed, once with the interval tree iterator and once walking the
+// nodes in start order. The total time of each is returned, along with the
+// total number of overlaps found.
+#define UVM_TEST_INTERVAL_TREE_MAX_NODES                 (1024 * 1024)
+#define UVM_TEST_INTERVAL_TREE_MAX_TIMED_QUERIES         (1024 * 1024)
+
+#define UVM_TEST_INTERVAL_TREE_RANDOM                    UVM_TEST_IOCTL_BASE(118)
+typedef struct
+{
+    NvU32 seed;                                          // In
+    NvU32 verbose;                                       // In
+    NvU64 main_iterations            NV_ALIGN_BYTES(8);  // In
+    NvU32 max_nodes;                                     // In
+    NvU32 query_checks;                                  // In
+    NvU64 max_end                    NV_ALIGN_BYTES(8);  // In
+    NvU64 max_size                   NV_ALIGN_BYTES(8);  // In
+    NvU32 timed_queries;                                 // In
+    NvU64 tree_query_ns              NV_ALIGN_BYTES(8);  // Out
+    NvU64 linear_query_ns            NV_ALIGN_BYTES(8);  // Out
+    NvU64 overlaps                   NV_ALIGN_BYTES(8);  // Out
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_INTERVAL_TREE_RANDOM_PARAMS;
+
+// Check the fused uvm_page_mask_t operations and the word-based run iteration
+// against compositions of the two-operand bitmap helpers, over iterations sets
+// of random masks. The checks don't require any GPU to be registered.
+//
+// Then time bench_iterations passes of each implementation over a fixed set of
+// random masks and return the total get_cycles() delta of each. The fused
+// cycles cover uvm_page_mask_and3(), uvm_page_mask_and_andnot(),
+// uvm_page_mask_andnot2() and the fused weights, the composed cycles the same
+// expressions built with uvm_page_mask_and()/andnot()/weight().
+#define UVM_TEST_PAGE_MASK_MAX_BENCH_ITERATIONS          (1024 * 1024)
+
+#define UVM_TEST_PAGE_MASK                               UVM_TEST_IOCTL_BASE(119)
+typedef struct
+{
+    NvU32 seed;                                          // In
+    NvU32 iterations;                                    // In
+    NvU32 bench_iterations;                              // In
+    NvU64 fused_cycles               NV_ALIGN_BYTES(8);  // Out
+    NvU64 composed_cycles            NV_ALIGN_BYTES(8);  // Out
+    NvU64 word_run_cycles            NV_ALIGN_BYTES(8);  // Out
+    NvU64 bit_run_cycles             NV_ALIGN_BYTES(8);  // Out
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_PAGE_MASK_PARAMS;
+
+// Exercise the access counter migration planner on a private candidate table,
+// with synthetic notifications. It checks score accumulation and decay,
+// resolution of regions contested by several GPUs, ranking by score per page
+// and the per-GPU budget. It doesn't require access counter support. On the
+// registered GPUs supporting access counters, it also checks that notifications
+// are not recorded once access counters have been disabled for the VA space.
+#define UVM_TEST_ACCESS_COUNTER_PLANNER                  UVM_TEST_IOCTL_BASE(120)
+typedef struct
+{
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_ACCESS_COUNTER_PLANNER_PARAMS;
+
+// Stress the VA space range lock from num_threads kernel threads, each holding
+// the VA space lock in read mode. Threads lock random, possibly overlapping
+// spans like HMM policy updates do, and check that the data protected by the
+// range lock is never modified concurrently.
+// num_threads must be in [1, 16].
+#define UVM_TEST_RANGE_LOCK_STRESS                       UVM_TEST_IOCTL_BASE(121)
+typedef struct
+{
+    NvU32 iterations;                                    // In
+    NvU32 num_threads;                                   // In
+    NvU32 seed;                                          // In
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_RANGE_LOCK_STRESS_PARAMS;
+
+// Record of a replayable fault trace captured with UVM_TEST_FAULT_TRACE_CAPTURE.
+// Each fetched batch produces a batch record followed by one fault record per
+// fault buffer entry in the batch, in fetch order.
+#define UVM_TEST_FAULT_TRACE_RECORD_TYPE_BATCH           0
+#define UVM_TEST_FAULT_TRACE_RECORD_TYPE_FAULT           1
+
+typedef struct
+{
+    NvU32 type;                                          // UVM_TEST_FAULT_TRACE_RECORD_TYPE_*
+    NvU32 batch_id;
+
+    // Fault records: fields of the parsed fault buffer entry. fault_address is
+    // aligned to PAGE_SIZE and timestamp is the GPU timestamp of the entry.
+    NvU64 fault_address              NV_ALIGN_BYTES(8);
+    NvU64 timestamp                  NV_ALIGN_BYTES(8);
+    NvU64 instance_ptr               NV_ALIGN_BYTES(8);
+    NvU32 instance_ptr_aperture;                         // uvm_aperture_t
+    NvU32 fault_type;                                    // uvm_fault_type_t
+    NvU32 access_type;                                   // uvm_fault_access_type_t
+    NvU32 client_type;                                   // uvm_fault_client_type_t
+    NvU32 client_id;
+    NvU32 gpc_id;
+    NvU32 utlb_id;
+    NvU32 ve_id;
+    NvU32 mmu_engine_type;                               // uvm_mmu_engine_type_t
+
+    // Batch records. Times are CPU times in nanoseconds. preprocess_ns and
+    // service_ns are 0 if the batch was not serviced, for example because the
+    // fault buffer was flushed during preprocessing.
+    NvU32 num_cached_faults;
+    NvU32 num_coalesced_faults;
+    NvU32 num_duplicate_faults;
+    NvU64 fetch_start_ns             NV_ALIGN_BYTES(8);
+    NvU64 fetch_ns                   NV_ALIGN_BYTES(8);
+    NvU64 preprocess_ns              NV_ALIGN_BYTES(8);
+    NvU64 service_ns                 NV_ALIGN_BYTES(8);
+} UVM_TEST_FAULT_TRACE_RECORD;
+
+#define UVM_TEST_FAULT_TRACE_MAX_RECORDS                 (1024 * 1024)
+
+// Start capturing the replayable faults fetched on the given GPU into a trace
+// of up to max_records records. Records that don't fit are dropped and
+// counted. A max_records of 0 stops the capture and discards the trace.
+//
+// Starting a capture while one is in progress discards the previous trace.
+#define UVM_TEST_FAULT_TRACE_CAPTURE                     UVM_TEST_IOCTL_BASE(122)
+typedef struct
+{
+    NvProcessorUuid gpu_uuid;                            // In
+    NvU32 max_records;                                   // In
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_FAULT_TRACE_CAPTURE_PARAMS;
+
+// Move up to max_records of the oldest records of the trace being captured on
+// the given GPU to the user buffer at records. num_dropped is the number of
+// records dropped since the last read because the trace was full.
+#define UVM_TEST_FAULT_TRACE_READ                        UVM_TEST_IOCTL_BASE(123)
+typedef struct
+{
+    NvProcessorUuid gpu_uuid;                            // In
+    NvU64 records                    NV_ALIGN_BYTES(8);  // In (UVM_TEST_FAULT_TRACE_RECORD *)
+    NvU32 max_records;                                   // In
+    NvU32 num_records;                                   // Out
+    NvU64 num_dropped                NV_ALIGN_BYTES(8);  // Out
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_FAULT_TRACE_READ_PARAMS;
+
+// Replay a fault trace through the GPU-independent stages of replayable fault
+// batch processing: fetch-time coalescing (subject to uvm_perf_fault_coalesce),
+// grouping by instance pointer and ordering by VA space, address and access
+// type. Instance pointers are translated to mock VA spaces, one per
+// {instance_ptr, ve_id} pair, so no GPU is required. The ordering of each batch
+// is checked against the comparison sort.
+//
+// Batches must not hold more than UVM_TEST_FAULT_TRACE_MAX_BATCH_FAULTS faults.
+// Fault records that precede the first batch record are ignored, as the trace
+// may have been read while a batch was being captured.
+//
+// Statistics are accumulated over all batches. num_duplicate_faults follows the
+// accounting of the fault servicing path, num_block_groups is the number of
+// {VA space, UVM_VA_BLOCK_SIZE-aligned region} runs in the ordered batches, and
+// preprocess_ns is the time spent coalescing and ordering.
+//
+// The prefetch and thrashing heuristics depend on VA block residency state, so
+// they are not part of the replay.
+#define UVM_TEST_FAULT_TRACE_MAX_BATCH_FAULTS            (1 << 16)
+
+#define UVM_TEST_FAULT_TRACE_REPLAY                      UVM_TEST_IOCTL_BASE(124)
+typedef struct
+{
+    NvU64 records                    NV_ALIGN_BYTES(8);  // In (const UVM_TEST_FAULT_TRACE_RECORD *)
+    NvU32 num_records;                                   // In
+    NvU32 num_batches;                                   // Out
+    NvU64 num_faults                 NV_ALIGN_BYTES(8);  // Out
+    NvU64 num_coalesced_faults       NV_ALIGN_BYTES(8);  // Out
+    NvU64 num_duplicate_faults       NV_ALIGN_BYTES(8);  // Out
+    NvU64 num_instance_ptr_groups    NV_ALIGN_BYTES(8);  // Out
+    NvU64 num_block_groups           NV_ALIGN_BYTES(8);  // Out
+    NvU64 preprocess_ns              NV_ALIGN_BYTES(8);  // Out
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_FAULT_TRACE_REPLAY_PARAMS;
+
+// Migrate [base, base + length) like UVM_MIGRATE_FENCE, wait for the fence to
+// be signaled and check that it reports the completion of the migration: the
+// fence status and poll() flags, and the trackers of the migrated VA blocks.
+// The migration status is returned in rmStatus.
+#define UVM_TEST_MIGRATE_FENCE                           UVM_TEST_IOCTL_BASE(125)
+typedef struct
+{
+    NvU64 base                       NV_ALIGN_BYTES(8);  // In
+    NvU64 length                     NV_ALIGN_BYTES(8);  // In
+    NvProcessorUuid destination_uuid;                    // In
+    NvS32 cpu_numa_node;                                 // In
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_MIGRATE_FENCE_PARAMS;
+
+// Subscribe in-kernel counter trackers of both the UVM_TOTAL_COUNTERS and
+// UVM_TOTAL_COUNTERS_V3 layouts to the ATS prefetch counters, record an ATS
+// prefetch outcome of hit_pages and waste_pages on the given GPU, and check
+// that only the UVM_TOTAL_COUNTERS_V3 tracker counted them.
+#define UVM_TEST_TOOLS_ATS_PREFETCH_COUNTERS             UVM_TEST_IOCTL_BASE(126)
+typedef struct
+{
+    NvProcessorUuid gpu_uuid;                            // In
+    NvU64 hit_pages                  NV_ALIGN_BYTES(8);  // In
+    NvU64 waste_pages                NV_ALIGN_BYTES(8);  // In
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_TOOLS_ATS_PREFETCH_COUNTERS_PARAMS;
+
+// Enable and then disable UVM_SET_READ_DUPLICATION_WRITE_TRACKING on
+// [base, base + length), and check after each call that UVM_TEST_VA_RANGE_INFO
+// reports the mode on the managed ranges at both ends of the span, and that
+// the ranges were split at its boundaries.
+//
+// Error returns:
+// NV_ERR_INVALID_ADDRESS
+//  - The span is not fully covered by managed ranges
+#define UVM_TEST_READ_DUPLICATION_WRITE_TRACKING         UVM_TEST_IOCTL_BASE(127)
+typedef struct
+{
+    NvU64 base                       NV_ALIGN_BYTES(8);  // In
+    NvU64 length                     NV_ALIGN_BYTES(8);  // In
+    NV_STATUS rmStatus;                                  // Out
+} UVM_TEST_READ_DUPLICATION_WRITE_TRACKING_PARAMS;
+
 #ifdef __cplusplus
 }
 #endif
@@ -86,53 +86,255 @@ static void tlb_batch_flush_invalidate_all(uvm_tlb_batch_t *batch, uvm_push_t *p
     gpu->parent->host_hal->tlb_invalidate_all(push, uvm_page_tree_pdb_address(tree), page_table_depth, batch->membar);
 }
 
+static NvU64 range_end(const uvm_tlb_batch_range_t *range)
+{
+    return range->start + range->size;
+}
+
+// log2 of the size of the naturally aligned power-of-two block covering the
+// range, which is what VA range invalidates apply to
+static NvU32 range_covering_shift(NvU64 start, NvU64 end)
+{
+    return __fls((unsigned long)(start ^ (end - 1))) + 1;
+}
+
+// Cost of invalidating a range with targeted invalidates. A VA range
+// invalidate is a single operation, otherwise each page of the smallest page
+// size is invalidated separately.
+static NvU64 tlb_batch_range_cost(uvm_tlb_batch_t *batch, NvU64 start, NvU64 end, NvU64 page_sizes)
+{
+    if (batch->tree->gpu->parent->tlb_batch.va_range_invalidate_supported)
+        return 1;
+
+    return uvm_div_pow2_64(end - start, smallest_page_size(page_sizes));
+}
+
+static NvU64 tlb_batch_cost(uvm_tlb_batch_t *batch)
+{
+    NvU64 cost = 0;
+    NvU32 i;
+
+    for (i = 0; i < batch->count; i++) {
+        uvm_tlb_batch_range_t *range = &batch->ranges[i];
+
+        cost += tlb_batch_range_cost(batch, range->start, range_end(range), range->page_sizes);
+    }
+
+    return cost;
+}
+
+// Maximum cost of the targeted invalidates before invalidate all is cheaper
+static NvU64 tlb_batch_budget(uvm_tlb_batch_t *batch)
+{
+    uvm_parent_gpu_t *parent_gpu = batch->tree->gpu->parent;
+
+    if (parent_gpu->tlb_batch.va_range_invalidate_supported)
+        return parent_gpu->tlb_batch.max_ranges;
+
+    return parent_gpu->tlb_batch.max_pages;
+}
+
+// Returns whether merging the two ranges keeps the VA range invalidate of the
+// result within uvm_parent_gpu_t::tlb_batch.max_merged_range_size, or at least
+// within the bigger of the blocks invalidated for the two ranges on their own.
+static bool tlb_batch_merge_size_ok(uvm_tlb_batch_t *batch,
+                                    const uvm_tlb_batch_range_t *range,
+                                    const uvm_tlb_batch_range_t *other)
+{
+    uvm_parent_gpu_t *parent_gpu = batch->tree->gpu->parent;
+    NvU64 start = min(range->start, other->start);
+    NvU64 end = max(range_end(range), range_end(other));
+    NvU32 max_shift;
+
+    if (!parent_gpu->tlb_batch.va_range_invalidate_supported)
+        return true;
+
+    max_shift = max(range_covering_shift(range->start, range_end(range)),
+                    range_covering_shift(other->start, range_end(other)));
+    if (parent_gpu->tlb_batch.max_merged_range_size)
+        max_shift = max(max_shift, (NvU32)__fls((unsigned long)parent_gpu->tlb_batch.max_merged_range_size));
+
+    return range_covering_shift(start, end) <= max_shift;
+}
+
+// Overlapping or adjacent ranges with the same smallest page size can be
+// merged without invalidating any extra pages on GPUs invalidating each page
+// separately. On GPUs with VA range invalidates, the naturally aligned block
+// covered by the merged range can be bigger than the blocks of the two ranges,
+// up to uvm_parent_gpu_t::tlb_batch.max_merged_range_size.
+static bool tlb_batch_can_merge_free(uvm_tlb_batch_t *batch,
+                                     const uvm_tlb_batch_range_t *range,
+                                     const uvm_tlb_batch_range_t *other)
+{
+    if (range->start > range_end(other) || other->start > range_end(range))
+        return false;
+
+    if (smallest_page_size(range->page_sizes) != smallest_page_size(other->page_sizes))
+        return false;
+
+    return tlb_batch_merge_size_ok(batch, range, other);
+}
+
+// The merged range uses the smallest page size of both ranges for the density
+// of the invalidate, and the biggest one for its depth.
+static void tlb_batch_range_merge(uvm_tlb_batch_range_t *range, const uvm_tlb_batch_range_t *other)
+{
+    NvU64 start = min(range->start, other->start);
+    NvU64 end = max(range_end(range), range_end(other));
+
+    range->start = start;
+    range->size = end - start;
+    range->page_sizes |= other->page_sizes;
+}
+
+static void tlb_batch_remove_range(uvm_tlb_batch_t *batch, NvU32 index)
+{
+    UVM_ASSERT(index < batch->count);
+
+    batch->ranges[index] = batch->ranges[--batch->count];
+    batch->merged_count++;
+}
+
+// Merge the two closest ranges which can be merged within budget. Returns false
+// if there are no such ranges.
+static bool tlb_batch_merge_closest(uvm_tlb_batch_t *batch)
+{
+    NvU64 cost = tlb_batch_cost(batch);
+    NvU64 budget = tlb_batch_budget(batch);
+    NvU64 best_gap = ~0ULL;
+    NvU32 best_i = 0;
+    NvU32 best_j = 0;
+    NvU32 i, j;
+
+    for (i = 0; i < batch->count; i++) {
+        for (j = i + 1; j < batch->count; j++) {
+            uvm_tlb_batch_range_t *range = &batch->ranges[i];
+            uvm_tlb_batch_range_t *other = &batch->ranges[j];
+            NvU64 start = min(range->start, other->start);
+            NvU64 end = max(range_end(range), range_end(other));
+            NvU64 gap = 0;
+            NvU64 merged_cost;
+
+            if (range_end(range) < other->start)
+                gap = other->start - range_end(range);
+            else if (range_end(other) < range->start)
+                gap = range->start - range_end(other);
+
+            if (gap >= best_gap)
+                continue;
+
+            if (!tlb_batch_merge_size_ok(batch, range, other))
+                continue;
+
+            // Merging never lowers the cost of per-page invalidates, so only
+            // merge if the batch stays cheaper than invalidate all.
+            merged_cost = cost -
+                          tlb_batch_range_cost(batch, range->start, range_end(range), range->page_sizes) -
+                          tlb_batch_range_cost(batch, other->start, range_end(other), other->page_sizes) +
+                          tlb_batch_range_cost(batch, start, end, range->page_sizes | other->page_sizes);
+            if (!batch->tree->gpu->parent->tlb_batch.va_range_invalidate_supported && merged_cost > budget)
+                continue;
+
+            best_gap = gap;
+            best_i = i;
+            best_j = j;
+        }
+    }
+
+    if (best_gap == ~0ULL)
+        return false;
+
+    tlb_batch_range_merge(&batch->ranges[best_i], &batch->ranges[best_j]);
+    tlb_batch_remove_range(batch, best_j);
+
+    return true;
+}
+
 static bool tlb_batch_should_invalidate_all(uvm_tlb_batch_t *batch)
 {
     if (!batch->tree->gpu->parent->tlb_batch.va_invalidate_supported)
         return true;
 
-    if (batch->count > UVM_TLB_BATCH_MAX_ENTRIES)
+    if (batch->invalidate_all)
         return true;
 
-    if (batch->tree->gpu->parent->tlb_batch.va_range_invalidate_supported)
-        return batch->total_ranges > batch->tree->gpu->parent->tlb_batch.max_ranges;
-
-    return batch->total_pages > batch->tree->gpu->parent->tlb_batch.max_pages;
+    return tlb_batch_cost(batch) > tlb_batch_budget(batch);
 }
 
 void uvm_tlb_batch_end(uvm_tlb_batch_t *batch, uvm_push_t *push, uvm_membar_t tlb_membar)
 {
-    if (batch->count == 0)
+    uvm_parent_gpu_t *parent_gpu = batch->tree->gpu->parent;
+
+    if (batch->count == 0 && !batch->invalidate_all)
         return;
 
     batch->membar = uvm_membar_max(tlb_membar, batch->membar);
 
-    if (tlb_batch_should_invalidate_all(batch))
+    // With VA range invalidates, merging nearby ranges can bring the batch
+    // back within budget.
+    if (!batch->invalidate_all && parent_gpu->tlb_batch.va_range_invalidate_supported) {
+        while (batch->count > tlb_batch_budget(batch) && tlb_batch_merge_closest(batch))
+            ;
+    }
+
+    if (tlb_batch_should_invalidate_all(batch)) {
         tlb_batch_flush_invalidate_all(batch, push);
-    else
+        atomic64_inc(&parent_gpu->stats.tlb_batch.num_invalidate_all);
+    }
+    else {
         tlb_batch_flush_invalidate_per_va(batch, push);
+        atomic64_inc(&parent_gpu->stats.tlb_batch.num_targeted);
+    }
+
+    if (batch->merged_count > 0)
+        atomic64_add(batch->merged_count, &parent_gpu->stats.tlb_batch.num_merged_ranges);
 }
 
 void uvm_tlb_batch_invalidate(uvm_tlb_batch_t *batch, NvU64 start, NvU64 size, NvU64 page_sizes, uvm_membar_t tlb_membar)
 {
-    uvm_tlb_batch_range_t *new_entry;
+    uvm_parent_gpu_t *parent_gpu = batch->tree->gpu->parent;
+    uvm_tlb_batch_range_t new_range;
+    NvU32 i;
 
     batch->membar = uvm_membar_max(tlb_membar, batch->membar);
+    batch->biggest_page_size = max(batch->biggest_page_size, biggest_page_size(page_sizes));
 
-    ++batch->count;
+    if (batch->invalidate_all)
+        return;
 
-    if (batch->tree->gpu->parent->tlb_batch.va_range_invalidate_supported)
-        batch->total_ranges++;
-    else
-        batch->total_pages += uvm_div_pow2_64(size, smallest_page_size(page_sizes));
+    if (!parent_gpu->tlb_batch.va_invalidate_supported) {
+        batch->invalidate_all = true;
+        return;
+    }
 
-    batch->biggest_page_size = max(batch->biggest_page_size, biggest_page_size(page_sizes));
+    new_range.start = start;
+    new_range.size = size;
+    new_range.page_sizes = page_sizes;
+
+    // Absorb all the queued up ranges the new range can be merged with for
+    // free. Merging can make the new range reach other ranges, so start over
+    // after each merge.
+    i = 0;
+    while (i < batch->count) {
+        if (tlb_batch_can_merge_free(batch, &batch->ranges[i], &new_range)) {
+            tlb_batch_range_merge(&new_range, &batch->ranges[i]);
+            tlb_batch_remove_range(batch, i);
+            i = 0;
+        }
+        else {
+            i++;
+        }
+    }
 
-    if (tlb_batch_should_invalidate_all(batch))
+    batch->ranges[batch->count++] = new_range;
+
+    if (batch->count > UVM_TLB_BATCH_MAX_ENTRIES && !tlb_batch_merge_closest(batch)) {
+        batch->invalidate_all = true;
         return;
+    }
 
-    new_entry = &batch->ranges[batch->count - 1];
-    new_entry->start = start;
-    new_entry->size = size;
-    new_entry->page_sizes = page_sizes;
+    // The cost of per-page invalidates can't go down as more ranges are
+    // queued up, so stop tracking them once over budget.
+    if (!parent_gpu->tlb_batch.va_range_invalidate_supported && tlb_batch_cost(batch) > tlb_batch_budget(batch))
+        batch->invalidate_all = true;
 }
@@ -27,13 +27,14 @@
 #include "uvm_forward_decl.h"
 #include "uvm_hal_types.h"
 
-// Max number of separate VA ranges to track before falling back to invalidate all.
-// TLB batches take space on the stack so this number should be big enough to
-// cover our common cases, but not bigger.
+// Max number of separate VA ranges to track. Ranges are merged when possible,
+// and the batch falls back to invalidate all when too many ranges can't be
+// merged. TLB batches take space on the stack so this number should be big
+// enough to cover our common cases, but not bigger.
 //
 // TODO: Bug 1767241: Once we have all the paths using TLB invalidates
 //       implemented, verify whether it makes sense.
-#define UVM_TLB_BATCH_MAX_ENTRIES 4
+#define UVM_TLB_BATCH_MAX_ENTRIES 8
 
 typedef struct
 {
@@ -48,19 +49,18 @@ struct uvm_tlb_batch_struct
 {
     uvm_page_tree_t *tree;
 
-    union
-    {
-        // Total number of pages covered by the queued up ranges so far
-        NvU32 total_pages;
+    // Queued up ranges to invalidate. There is room for one extra range, which
+    // is merged into the others before the batch goes back to
+    // UVM_TLB_BATCH_MAX_ENTRIES ranges.
+    uvm_tlb_batch_range_t ranges[UVM_TLB_BATCH_MAX_ENTRIES + 1];
+    NvU32 count;
 
-        // Total number of ranges that have been invalidated so far
-        // Each range can be invalidated using a single Host method on supported GPUs
-        NvU32 total_ranges;
-    };
+    // Number of queued up ranges merged into other ranges
+    NvU32 merged_count;
 
-    // Queued up ranges to invalidate
-    uvm_tlb_batch_range_t ranges[UVM_TLB_BATCH_MAX_ENTRIES];
-    NvU32 count;
+    // Set once the batch is known to invalidate all, at which point the ranges
+    // are no longer tracked
+    bool invalidate_all;
 
     // Biggest page size across all queued up invalidates
     NvU64 biggest_page_size;
@@ -86,7 +86,11 @@ void uvm_tlb_batch_invalidate(uvm_tlb_batch_t *batch, NvU64 start, NvU64 size, N
 // End a TLB invalidate batch
 //
 // This will push the required TLB invalidate to invalidate all the queued up
-// ranges.
+// ranges. Overlapping and adjacent ranges with the same smallest page size are
+// merged as they are queued up. The batch then uses targeted invalidates if
+// their cost, as described by the uvm_parent_gpu_t::tlb_batch parameters, is
+// within budget, possibly after merging nearby ranges. Otherwise all the TLB
+// entries of the PDB are invalidated.
 //
 // The tlb_membar argument has the same behavior as in uvm_tlb_batch_invalidate.
 // This allows callers which use the same membar for all calls to
@@ -36,6 +36,7 @@
 #include "uvm_forward_decl.h"
 #include "uvm_range_group.h"
 #include "uvm_mem.h"
+#include "uvm_test.h"
 #include "nv_speculation_barrier.h"
 
 // We limit the number of times a page can be retained by the kernel
@@ -51,6 +52,24 @@ typedef struct
     NvU32 put_behind;
 } uvm_tools_queue_snapshot_t;
 
+// Upper bound for uvm_tools_cpu_ring_entries
+#define UVM_TOOLS_CPU_RING_ENTRIES_MAX 4096
+
+// Number of entries of each per-CPU staging ring of an event queue. 0 disables
+// the staging rings, and events are then written to the queue directly.
+static unsigned uvm_tools_cpu_ring_entries = 64;
+module_param(uvm_tools_cpu_ring_entries, uint, S_IRUGO);
+
+// Single-producer ring staging the events recorded on one CPU. The producer
+// writes with preemption disabled, so there is a single writer of put. get is
+// only written with the queue lock held.
+typedef struct
+{
+    NvU32 put;
+
+    NvU32 get ____cacheline_aligned_in_smp;
+} ____cacheline_aligned_in_smp uvm_tools_cpu_ring_t;
+
 typedef struct
 {
     uvm_spinlock_t lock;
@@ -68,13 +87,31 @@ typedef struct
     wait_queue_head_t wait_queue;
     bool is_wakeup_get_valid;
     NvU32 wakeup_get;
+
+    // Events are recorded into per-CPU rings without taking the lock above,
+    // and moved to the user-visible queue by drain_q_item, poll and event
+    // flushes. Events recorded on different CPUs can thus be reordered.
+    // cpu_rings is NULL if staging is disabled.
+    uvm_tools_cpu_ring_t *cpu_rings;
+    NvU32 cpu_ring_count;
+    void *cpu_ring_entries;
+    NvU8 *cpu_ring_event_types;
+
+    // Set while drain_q_item is scheduled
+    atomic_t drain_pending;
+    nv_kthread_q_item_t drain_q_item;
 } uvm_tools_queue_t;
 
 typedef struct
 {
-    struct list_head counter_nodes[UVM_TOTAL_COUNTERS];
+    struct list_head counter_nodes[UVM_TOTAL_COUNTERS_V3];
     NvU64 subscribed_counters;
 
+    // Number of counters in the user buffer, UVM_TOTAL_COUNTERS or
+    // UVM_TOTAL_COUNTERS_V3 depending on the version of the tracker. Only
+    // these counters can be enabled.
+    NvU32 num_counters;
+
     struct page **counter_buffer_pages;
     NvU64 *counters;
 
@@ -393,41 +430,26 @@ static void destroy_event_tracker(uvm_tools_event_tracker_t *event_tracker)
 
         if (event_tracker->is_queue) {
             uvm_tools_queue_t *queue = &event_tracker->queue;
-            NvU64 buffer_size;
-
-            buffer_size = queue->queue_buffer_count * event_tracker->entry_size;
 
             remove_event_tracker(va_space,
                                  queue->queue_nodes,
                                  UvmEventNumTypesAll,
                                  queue->subscribed_queues,
                                  &queue->subscribed_queues);
-
-            if (queue->queue_buffer != NULL) {
-                unmap_user_pages(queue->queue_buffer_pages,
-                                 queue->queue_buffer,
-                                 buffer_size);
-            }
-
-            if (queue->control != NULL) {
-                unmap_user_pages(queue->control_buffer_pages,
-                                 queue->control,
-                                 sizeof(UvmToolsEventControlData));
-            }
         }
         else {
             uvm_tools_counter_t *counters = &event_tracker->counter;
 
             remove_event_tracker(va_space,
                                  counters->counter_nodes,
-                                 UVM_TOTAL_COUNTERS,
+                                 counters->num_counters,
                                  counters->subscribed_counters,
                                  &counters->subscribed_counters);
 
             if (counters->counters != NULL) {
                 unmap_user_pages(counters->counter_buffer_pages,
                                  counters->counters,
-                                 UVM_TOTAL_COUNTERS * sizeof(NvU64));
+                                 counters->num_counters * sizeof(NvU64));
             }
         }
 
@@ -442,62 +464,266 @@ static void destroy_event_tracker(uvm_tools_event_tracker_t *event_tracker)
         fput(event_tracker->uvm_file);
     }
 
+    if (event_tracker->is_queue) {
+        uvm_tools_queue_t *queue = &event_tracker->queue;
+        NvU64 buffer_size = queue->queue_buffer_count * event_tracker->entry_size;
+
+        // No new events can be recorded into the queue, but a drain may still
+        // be pending. It accesses the user buffers, so wait for it before
+        // unmapping them. The tools lock must not be held here, since other
+        // items of the queue acquire it.
+        if (queue->cpu_rings)
+            nv_kthread_q_flush(&g_tools_queue);
+
+        if (queue->queue_buffer != NULL) {
+            unmap_user_pages(queue->queue_buffer_pages,
+                             queue->queue_buffer,
+                             buffer_size);
+        }
+
+        if (queue->control != NULL) {
+            unmap_user_pages(queue->control_buffer_pages,
+                             queue->control,
+                             sizeof(UvmToolsEventControlData));
+        }
+
+        uvm_kvfree(queue->cpu_rings);
+        uvm_kvfree(queue->cpu_ring_entries);
+        uvm_kvfree(queue->cpu_ring_event_types);
+    }
+
     kmem_cache_free(g_tools_event_tracker_cache, event_tracker);
 }
 
-static void enqueue_event(const void *entry, size_t entry_size, NvU8 eventType, uvm_tools_queue_t *queue)
+static void queue_snapshot_put_locked(uvm_tools_queue_t *queue, uvm_tools_queue_snapshot_t *sn)
 {
     UvmToolsEventControlData *ctrl = queue->control;
-    uvm_tools_queue_snapshot_t sn;
-    NvU32 queue_size = queue->queue_buffer_count;
-    NvU32 queue_mask = queue_size - 1;
-
-    // Prevent processor speculation prior to accessing user-mapped memory to
-    // avoid leaking information from side-channel attacks. There are many
-    // possible paths leading to this point and it would be difficult and error-
-    // prone to audit all of them to determine whether user mode could guide
-    // this access to kernel memory under speculative execution, so to be on the
-    // safe side we'll just always block speculation.
-    nv_speculation_barrier();
+    NvU32 queue_mask = queue->queue_buffer_count - 1;
 
-    uvm_spin_lock(&queue->lock);
+    uvm_assert_spinlock_locked(&queue->lock);
 
     // ctrl is mapped into user space with read and write permissions,
     // so its values cannot be trusted.
-    sn.get_behind = atomic_read((atomic_t *)&ctrl->get_behind) & queue_mask;
-    sn.put_behind = atomic_read((atomic_t *)&ctrl->put_behind) & queue_mask;
-    sn.put_ahead = (sn.put_behind + 1) & queue_mask;
+    sn->get_behind = atomic_read((atomic_t *)&ctrl->get_behind) & queue_mask;
+    sn->put_behind = atomic_read((atomic_t *)&ctrl->put_behind) & queue_mask;
+}
+
+// Copy an event to the user-visible queue at sn->put_behind. Returns false if
+// the queue is full, in which case the event is accounted as dropped.
+static bool queue_insert_event_locked(uvm_tools_queue_t *queue,
+                                      const void *entry,
+                                      size_t entry_size,
+                                      NvU8 eventType,
+                                      uvm_tools_queue_snapshot_t *sn)
+{
+    NvU32 queue_size = queue->queue_buffer_count;
+    NvU32 queue_mask = queue_size - 1;
+
+    uvm_assert_spinlock_locked(&queue->lock);
 
     // one free element means that the queue is full
-    if (((queue_size + sn.get_behind - sn.put_behind) & queue_mask) == 1) {
-        atomic64_inc((atomic64_t *)&ctrl->dropped + eventType);
-        goto unlock;
+    if (((queue_size + sn->get_behind - sn->put_behind) & queue_mask) == 1) {
+        atomic64_inc((atomic64_t *)&queue->control->dropped + eventType);
+        return false;
     }
 
-    memcpy((char *)queue->queue_buffer + sn.put_behind * entry_size, entry, entry_size);
+    memcpy((char *)queue->queue_buffer + sn->put_behind * entry_size, entry, entry_size);
+
+    sn->put_behind = (sn->put_behind + 1) & queue_mask;
 
-    sn.put_behind = sn.put_ahead;
+    return true;
+}
+
+// Make the events inserted since the last snapshot visible to user space, and
+// wake up the waiters if needed.
+static void queue_publish_put_locked(uvm_tools_queue_t *queue, uvm_tools_queue_snapshot_t *sn)
+{
+    UvmToolsEventControlData *ctrl = queue->control;
+
+    uvm_assert_spinlock_locked(&queue->lock);
 
     // put_ahead and put_behind will always be the same outside of queue->lock
     // this allows the user-space consumer to choose either a 2 or 4 pointer
     // synchronization approach.
-    atomic_set((atomic_t *)&ctrl->put_ahead, sn.put_behind);
-    atomic_set((atomic_t *)&ctrl->put_behind, sn.put_behind);
+    sn->put_ahead = sn->put_behind;
+    atomic_set((atomic_t *)&ctrl->put_ahead, sn->put_behind);
+    atomic_set((atomic_t *)&ctrl->put_behind, sn->put_behind);
 
-    sn.get_ahead = atomic_read((atomic_t *)&ctrl->get_ahead);
+    sn->get_ahead = atomic_read((atomic_t *)&ctrl->get_ahead);
 
     // if the queue needs to be woken up, only signal if we haven't signaled
     // before for this value of get_ahead.
-    if (queue_needs_wakeup(queue, &sn) && !(queue->is_wakeup_get_valid && queue->wakeup_get == sn.get_ahead)) {
+    if (queue_needs_wakeup(queue, sn) && !(queue->is_wakeup_get_valid && queue->wakeup_get == sn->get_ahead)) {
         queue->is_wakeup_get_valid = true;
-        queue->wakeup_get = sn.get_ahead;
+        queue->wakeup_get = sn->get_ahead;
         wake_up_all(&queue->wait_queue);
     }
+}
+
+// Move the events staged in the per-CPU rings to the user-visible queue
+static void queue_drain_cpu_rings_locked(uvm_tools_queue_t *queue, size_t entry_size)
+{
+    uvm_tools_queue_snapshot_t sn;
+    NvU32 ring_mask = queue->cpu_ring_count - 1;
+    bool inserted = false;
+    int cpu;
+
+    uvm_assert_spinlock_locked(&queue->lock);
+
+    if (!queue->cpu_rings)
+        return;
+
+    // See the comment in enqueue_event_direct()
+    nv_speculation_barrier();
+
+    queue_snapshot_put_locked(queue, &sn);
+
+    for_each_possible_cpu(cpu) {
+        uvm_tools_cpu_ring_t *ring = &queue->cpu_rings[cpu];
+        NvU32 put = smp_load_acquire(&ring->put);
+        NvU32 get = ring->get;
+
+        if (get == put)
+            continue;
+
+        for (; get != put; get++) {
+            size_t index = (size_t)cpu * queue->cpu_ring_count + (get & ring_mask);
+
+            if (queue_insert_event_locked(queue,
+                                          (char *)queue->cpu_ring_entries + index * entry_size,
+                                          entry_size,
+                                          queue->cpu_ring_event_types[index],
+                                          &sn))
+                inserted = true;
+        }
+
+        // Release the slots to the producer only after they've been copied
+        smp_store_release(&ring->get, get);
+    }
+
+    if (inserted)
+        queue_publish_put_locked(queue, &sn);
+}
+
+static void queue_drain(void *args)
+{
+    uvm_tools_event_tracker_t *event_tracker = (uvm_tools_event_tracker_t *)args;
+    uvm_tools_queue_t *queue = &event_tracker->queue;
+
+    // Clear the flag before draining, so that events staged after the drain
+    // read the ring schedule a new one. atomic_xchg() is a full barrier.
+    atomic_xchg(&queue->drain_pending, 0);
+
+    uvm_spin_lock(&queue->lock);
+    queue_drain_cpu_rings_locked(queue, event_tracker->entry_size);
+    uvm_spin_unlock(&queue->lock);
+}
+
+static void queue_drain_entry(void *args)
+{
+    UVM_ENTRY_VOID(queue_drain(args));
+}
+
+static void enqueue_event_direct(const void *entry, size_t entry_size, NvU8 eventType, uvm_tools_queue_t *queue)
+{
+    uvm_tools_queue_snapshot_t sn;
+
+    // Prevent processor speculation prior to accessing user-mapped memory to
+    // avoid leaking information from side-channel attacks. There are many
+    // possible paths leading to this point and it would be difficult and error-
+    // prone to audit all of them to determine whether user mode could guide
+    // this access to kernel memory under speculative execution, so to be on the
+    // safe side we'll just always block speculation.
+    nv_speculation_barrier();
+
+    uvm_spin_lock(&queue->lock);
+
+    queue_snapshot_put_locked(queue, &sn);
+
+    if (queue_insert_event_locked(queue, entry, entry_size, eventType, &sn))
+        queue_publish_put_locked(queue, &sn);
 
-unlock:
     uvm_spin_unlock(&queue->lock);
 }
 
+static void enqueue_event(const void *entry, size_t entry_size, NvU8 eventType, uvm_tools_queue_t *queue)
+{
+    uvm_tools_cpu_ring_t *ring;
+    NvU32 put;
+    size_t index;
+    int cpu;
+
+    if (!queue->cpu_rings) {
+        enqueue_event_direct(entry, entry_size, eventType, queue);
+        return;
+    }
+
+    // Disabling preemption makes this CPU the only producer of its ring
+    cpu = get_cpu();
+    ring = &queue->cpu_rings[cpu];
+    put = ring->put;
+
+    if (put - smp_load_acquire(&ring->get) == queue->cpu_ring_count) {
+        put_cpu();
+
+        // The drain is lagging behind. See the comment in
+        // enqueue_event_direct() about the speculation barrier.
+        nv_speculation_barrier();
+        atomic64_inc((atomic64_t *)&queue->control->dropped + eventType);
+        return;
+    }
+
+    index = (size_t)cpu * queue->cpu_ring_count + (put & (queue->cpu_ring_count - 1));
+    memcpy((char *)queue->cpu_ring_entries + index * entry_size, entry, entry_size);
+    queue->cpu_ring_event_types[index] = eventType;
+
+    // Publish the entry to the drain
+    smp_store_release(&ring->put, put + 1);
+
+    put_cpu();
+
+    // Only write the shared flag when no drain is pending, so that staging an
+    // event doesn't bounce its cache line between CPUs. The barrier orders the
+    // put above with the flag read, pairing with the one in queue_drain(): a
+    // pending drain which is seen here reads the ring after the put.
+    smp_mb();
+    if (atomic_read(&queue->drain_pending) == 0 && atomic_xchg(&queue->drain_pending, 1) == 0)
+        nv_kthread_q_schedule_q_item(&g_tools_queue, &queue->drain_q_item);
+}
+
+static NV_STATUS queue_alloc_cpu_rings(uvm_tools_event_tracker_t *event_tracker)
+{
+    uvm_tools_queue_t *queue = &event_tracker->queue;
+    NvU32 count = min(uvm_tools_cpu_ring_entries, (unsigned)UVM_TOOLS_CPU_RING_ENTRIES_MAX);
+    size_t num_entries;
+
+    nv_kthread_q_item_init(&queue->drain_q_item, queue_drain_entry, event_tracker);
+    atomic_set(&queue->drain_pending, 0);
+
+    if (count == 0)
+        return NV_OK;
+
+    count = rounddown_pow_of_two(count);
+    num_entries = (size_t)nr_cpu_ids * count;
+
+    queue->cpu_rings = uvm_kvmalloc_zero(nr_cpu_ids * sizeof(*queue->cpu_rings));
+    queue->cpu_ring_entries = uvm_kvmalloc(num_entries * event_tracker->entry_size);
+    queue->cpu_ring_event_types = uvm_kvmalloc(num_entries * sizeof(*queue->cpu_ring_event_types));
+    if (!queue->cpu_rings || !queue->cpu_ring_entries || !queue->cpu_ring_event_types) {
+        uvm_kvfree(queue->cpu_rings);
+        uvm_kvfree(queue->cpu_ring_entries);
+        uvm_kvfree(queue->cpu_ring_event_types);
+        queue->cpu_rings = NULL;
+        queue->cpu_ring_entries = NULL;
+        queue->cpu_ring_event_types = NULL;
+        return NV_ERR_NO_MEMORY;
+    }
+
+    queue->cpu_ring_count = count;
+
+    return NV_OK;
+}
+
 static void uvm_tools_enqueue_event(struct list_head *head, const void *entry, size_t entry_size, NvU8 eventType)
 {
     uvm_tools_queue_t *queue;
@@ -542,7 +768,7 @@ static void uvm_tools_inc_counter(uvm_va_space_t *va_space,
                                   NvU64 amount,
                                   const NvProcessorUuid *processor)
 {
-    UVM_ASSERT((NvU32)counter < UVM_TOTAL_COUNTERS);
+    UVM_ASSERT((NvU32)counter < UVM_TOTAL_COUNTERS_V3);
     uvm_assert_rwsem_locked(&va_space->tools.lock);
 
     if (amount > 0) {
@@ -569,7 +795,7 @@ static bool tools_is_counter_enabled(uvm_va_space_t *va_space, UvmCounterName co
 {
     uvm_assert_rwsem_locked(&va_space->tools.lock);
 
-    UVM_ASSERT(counter < UVM_TOTAL_COUNTERS);
+    UVM_ASSERT(counter < UVM_TOTAL_COUNTERS_V3);
 
     return !list_empty(va_space->tools.counters + counter);
 }
@@ -614,7 +840,7 @@ static bool tools_are_enabled(uvm_va_space_t *va_space)
 
     uvm_assert_rwsem_locked(&va_space->tools.lock);
 
-    for (i = 0; i < UVM_TOTAL_COUNTERS; i++) {
+    for (i = 0; i < UVM_TOTAL_COUNTERS_V3; i++) {
         if (tools_is_counter_enabled(va_space, i))
             return true;
     }
@@ -677,6 +903,7 @@ static long uvm_tools_unlocked_ioctl(struct file *filp, unsigned int cmd, unsign
         UVM_ROUTE_CMD_STACK_NO_INIT_CHECK(UVM_TOOLS_ENABLE_COUNTERS,            uvm_api_tools_enable_counters);
         UVM_ROUTE_CMD_STACK_NO_INIT_CHECK(UVM_TOOLS_DISABLE_COUNTERS,           uvm_api_tools_disable_counters);
         UVM_ROUTE_CMD_STACK_NO_INIT_CHECK(UVM_TOOLS_INIT_EVENT_TRACKER_V2,      uvm_api_tools_init_event_tracker_v2);
+        UVM_ROUTE_CMD_STACK_NO_INIT_CHECK(UVM_TOOLS_INIT_EVENT_TRACKER_V3,      uvm_api_tools_init_event_tracker_v3);
     }
 
     uvm_thread_assert_all_unlocked();
@@ -705,6 +932,8 @@ static unsigned uvm_tools_poll(struct file *filp, poll_table *wait)
 
     uvm_spin_lock(&event_tracker->queue.lock);
 
+    queue_drain_cpu_rings_locked(&event_tracker->queue, event_tracker->entry_size);
+
     event_tracker->queue.is_wakeup_get_valid = false;
     ctrl = event_tracker->queue.control;
     sn.get_ahead = atomic_read((atomic_t *)&ctrl->get_ahead);
@@ -1838,6 +2067,75 @@ void uvm_tools_record_throttling_end(uvm_va_space_t *va_space, NvU64 address, uv
     uvm_up_read(&va_space->tools.lock);
 }
 
+void uvm_tools_record_prefetch_stream(uvm_va_space_t *va_space, uvm_processor_id_t processor, bool hit)
+{
+    UvmCounterName counter = hit ? UvmCounterNameStreamPrefetchHitCount : UvmCounterNameStreamPrefetchMissCount;
+
+    UVM_ASSERT(UVM_ID_IS_VALID(processor));
+
+    uvm_assert_rwsem_locked(&va_space->lock);
+
+    if (!va_space->tools.enabled)
+        return;
+
+    uvm_down_read(&va_space->tools.lock);
+    if (tools_is_counter_enabled(va_space, counter)) {
+        if (UVM_ID_IS_CPU(processor)) {
+            uvm_tools_inc_counter(va_space, counter, 1, &NV_PROCESSOR_UUID_CPU_DEFAULT);
+        }
+        else {
+            uvm_gpu_t *gpu = uvm_gpu_get(processor);
+
+            uvm_tools_inc_counter(va_space, counter, 1, &gpu->uuid);
+        }
+    }
+    uvm_up_read(&va_space->tools.lock);
+}
+
+void uvm_tools_record_ats_prefetch(uvm_va_space_t *va_space, uvm_gpu_t *gpu, NvU64 hit_pages, NvU64 waste_pages)
+{
+    uvm_assert_rwsem_locked(&va_space->lock);
+
+    if (!va_space->tools.enabled)
+        return;
+
+    uvm_down_read(&va_space->tools.lock);
+
+    if (hit_pages && tools_is_counter_enabled(va_space, UvmCounterNameAtsPrefetchHitPageCount))
+        uvm_tools_inc_counter(va_space, UvmCounterNameAtsPrefetchHitPageCount, hit_pages, &gpu->uuid);
+
+    if (waste_pages && tools_is_counter_enabled(va_space, UvmCounterNameAtsPrefetchWastePageCount))
+        uvm_tools_inc_counter(va_space, UvmCounterNameAtsPrefetchWastePageCount, waste_pages, &gpu->uuid);
+
+    uvm_up_read(&va_space->tools.lock);
+}
+
+void uvm_tools_record_numa_migration(uvm_va_space_t *va_space, int nid, NvU64 pages_in, NvU64 pages_out)
+{
+    uvm_va_space_numa_counters_t *counters;
+
+    if (nid == NUMA_NO_NODE)
+        return;
+
+    UVM_ASSERT(nid >= 0 && nid < nr_node_ids);
+
+    counters = &va_space->tools.numa_counters[nid];
+    if (pages_in)
+        atomic64_add(pages_in, &counters->pages_in);
+    if (pages_out)
+        atomic64_add(pages_out, &counters->pages_out);
+}
+
+void uvm_tools_record_numa_misplaced(uvm_va_space_t *va_space, int nid, NvU64 pages)
+{
+    if (nid == NUMA_NO_NODE)
+        return;
+
+    UVM_ASSERT(nid >= 0 && nid < nr_node_ids);
+
+    atomic64_add(pages, &va_space->tools.numa_counters[nid].pages_misplaced);
+}
+
 static void record_map_remote_events(void *args)
 {
     block_map_remote_data_t *block_map_remote = (block_map_remote_data_t *)args;
@@ -2022,6 +2320,7 @@ done:
 
 static NV_STATUS create_event_tracker(UVM_TOOLS_INIT_EVENT_TRACKER_V2_PARAMS *params,
                                       size_t entry_size,
+                                      NvU32 num_counters,
                                       struct file *filp)
 {
     NV_STATUS status = NV_OK;
@@ -2093,13 +2392,18 @@ static NV_STATUS create_event_tracker(UVM_TOOLS_INIT_EVENT_TRACKER_V2_PARAMS *pa
 
         if (status != NV_OK)
             goto fail;
+
+        status = queue_alloc_cpu_rings(event_tracker);
+        if (status != NV_OK)
+            goto fail;
     }
     else {
         uvm_tools_counter_t *counter = &event_tracker->counter;
         counter->all_processors = params->allProcessors;
         counter->processor = params->processor;
+        counter->num_counters = num_counters;
         status = map_user_pages(params->controlBuffer,
-                                sizeof(NvU64) * UVM_TOTAL_COUNTERS,
+                                sizeof(NvU64) * num_counters,
                                 (void **)&counter->counters,
                                 &counter->counter_buffer_pages);
         if (status != NV_OK)
@@ -2124,12 +2428,17 @@ NV_STATUS uvm_api_tools_init_event_tracker(UVM_TOOLS_INIT_EVENT_TRACKER_PARAMS *
 
     BUILD_BUG_ON(!__same_type(params, params_v2));
 
-    return create_event_tracker(params_v2, sizeof(UvmEventEntry), filp);
+    return create_event_tracker(params_v2, sizeof(UvmEventEntry), UVM_TOTAL_COUNTERS, filp);
 }
 
 NV_STATUS uvm_api_tools_init_event_tracker_v2(UVM_TOOLS_INIT_EVENT_TRACKER_V2_PARAMS *params, struct file *filp)
 {
-    return create_event_tracker(params, sizeof(UvmEventEntry_V2), filp);
+    return create_event_tracker(params, sizeof(UvmEventEntry_V2), UVM_TOTAL_COUNTERS, filp);
+}
+
+NV_STATUS uvm_api_tools_init_event_tracker_v3(UVM_TOOLS_INIT_EVENT_TRACKER_V3_PARAMS *params, struct file *filp)
+{
+    return create_event_tracker(params, sizeof(UvmEventEntry_V2), UVM_TOTAL_COUNTERS_V3, filp);
 }
 
 NV_STATUS uvm_api_tools_set_notification_threshold(UVM_TOOLS_SET_NOTIFICATION_THRESHOLD_PARAMS *params, struct file *filp)
@@ -2361,7 +2670,7 @@ NV_STATUS uvm_api_tools_enable_counters(UVM_TOOLS_ENABLE_COUNTERS_PARAMS *params
 
     insert_event_tracker(va_space,
                          event_tracker->counter.counter_nodes,
-                         UVM_TOTAL_COUNTERS,
+                         event_tracker->counter.num_counters,
                          params->counterTypeFlags,
                          &event_tracker->counter.subscribed_counters,
                          va_space->tools.counters,
@@ -2372,7 +2681,7 @@ NV_STATUS uvm_api_tools_enable_counters(UVM_TOOLS_ENABLE_COUNTERS_PARAMS *params
     if (status != NV_OK) {
         remove_event_tracker(va_space,
                              event_tracker->counter.counter_nodes,
-                             UVM_TOTAL_COUNTERS,
+                             event_tracker->counter.num_counters,
                              inserted_lists,
                              &event_tracker->counter.subscribed_counters);
     }
@@ -2400,7 +2709,7 @@ NV_STATUS uvm_api_tools_disable_counters(UVM_TOOLS_DISABLE_COUNTERS_PARAMS *para
     uvm_down_write(&va_space->tools.lock);
     remove_event_tracker(va_space,
                          event_tracker->counter.counter_nodes,
-                         UVM_TOTAL_COUNTERS,
+                         event_tracker->counter.num_counters,
                          params->counterTypeFlags,
                          &event_tracker->counter.subscribed_counters);
 
@@ -2650,7 +2959,7 @@ NV_STATUS uvm_test_increment_tools_counter(UVM_TEST_INCREMENT_TOOLS_COUNTER_PARA
     NvU32 i;
     uvm_va_space_t *va_space = uvm_va_space_get(filp);
 
-    if (params->counter >= UVM_TOTAL_COUNTERS)
+    if (params->counter >= UVM_TOTAL_COUNTERS_V3)
         return NV_ERR_INVALID_ARGUMENT;
 
     uvm_down_read(&va_space->tools.lock);
@@ -2661,6 +2970,121 @@ NV_STATUS uvm_test_increment_tools_counter(UVM_TEST_INCREMENT_TOOLS_COUNTER_PARA
     return NV_OK;
 }
 
+static void test_counter_trackers_update(uvm_va_space_t *va_space,
+                                         uvm_tools_counter_t *trackers,
+                                         size_t num_trackers,
+                                         NvU64 counter_flags,
+                                         bool enable)
+{
+    size_t i;
+    NV_STATUS status;
+
+    uvm_down_write(&g_tools_va_space_list_lock);
+    uvm_down_write(&va_space->perf_events.lock);
+    uvm_down_write(&va_space->tools.lock);
+
+    for (i = 0; i < num_trackers; i++) {
+        uvm_tools_counter_t *counter = &trackers[i];
+        NvU64 inserted_lists;
+
+        if (enable) {
+            insert_event_tracker(va_space,
+                                 counter->counter_nodes,
+                                 counter->num_counters,
+                                 counter_flags,
+                                 &counter->subscribed_counters,
+                                 va_space->tools.counters,
+                                 &inserted_lists);
+        }
+        else {
+            remove_event_tracker(va_space,
+                                 counter->counter_nodes,
+                                 counter->num_counters,
+                                 counter_flags,
+                                 &counter->subscribed_counters);
+        }
+    }
+
+    // The ATS prefetch counters don't need any perf events callback, so the
+    // update cannot fail
+    status = tools_update_status(va_space);
+    UVM_ASSERT(status == NV_OK);
+
+    uvm_up_write(&va_space->tools.lock);
+    uvm_up_write(&va_space->perf_events.lock);
+    uvm_up_write(&g_tools_va_space_list_lock);
+}
+
+NV_STATUS uvm_test_tools_ats_prefetch_counters(UVM_TEST_TOOLS_ATS_PREFETCH_COUNTERS_PARAMS *params,
+                                               struct file *filp)
+{
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+    const NvU64 counter_flags = UVM_COUNTER_NAME_FLAG_ATS_PREFETCH_HIT_PAGE_COUNT |
+                                UVM_COUNTER_NAME_FLAG_ATS_PREFETCH_WASTE_PAGE_COUNT;
+    uvm_tools_counter_t *trackers;
+    NvU64 *legacy_counters;
+    NvU64 *counters;
+    uvm_gpu_t *gpu;
+    NvU32 i;
+    NV_STATUS status = NV_OK;
+
+    // Trackers:
+    // 0: UVM_TOTAL_COUNTERS layout. The buffer has room for
+    //    UVM_TOTAL_COUNTERS_V3 counters to catch writes past its end.
+    // 1: UVM_TOTAL_COUNTERS_V3 layout
+    trackers = uvm_kvmalloc_zero(sizeof(*trackers) * 2);
+    legacy_counters = uvm_kvmalloc_zero(sizeof(*legacy_counters) * UVM_TOTAL_COUNTERS_V3);
+    counters = uvm_kvmalloc_zero(sizeof(*counters) * UVM_TOTAL_COUNTERS_V3);
+    if (!trackers || !legacy_counters || !counters) {
+        status = NV_ERR_NO_MEMORY;
+        goto out_free;
+    }
+
+    trackers[0].num_counters = UVM_TOTAL_COUNTERS;
+    trackers[0].counters = legacy_counters;
+    trackers[1].num_counters = UVM_TOTAL_COUNTERS_V3;
+    trackers[1].counters = counters;
+
+    for (i = 0; i < 2; i++)
+        trackers[i].all_processors = true;
+
+    test_counter_trackers_update(va_space, trackers, 2, counter_flags, true);
+
+    uvm_va_space_down_read(va_space);
+
+    gpu = uvm_va_space_get_gpu_by_uuid(va_space, &params->gpu_uuid);
+    if (gpu)
+        uvm_tools_record_ats_prefetch(va_space, gpu, params->hit_pages, params->waste_pages);
+    else
+        status = NV_ERR_INVALID_DEVICE;
+
+    uvm_va_space_up_read(va_space);
+
+    test_counter_trackers_update(va_space, trackers, 2, counter_flags, false);
+
+    if (status != NV_OK)
+        goto out_free;
+
+    for (i = 0; i < UVM_TOTAL_COUNTERS_V3; i++) {
+        NvU64 expected = 0;
+
+        if (i == UvmCounterNameAtsPrefetchHitPageCount)
+            expected = params->hit_pages;
+        else if (i == UvmCounterNameAtsPrefetchWastePageCount)
+            expected = params->waste_pages;
+
+        TEST_CHECK_GOTO(legacy_counters[i] == 0, out_free);
+        TEST_CHECK_GOTO(counters[i] == expected, out_free);
+    }
+
+out_free:
+    uvm_kvfree(counters);
+    uvm_kvfree(legacy_counters);
+    uvm_kvfree(trackers);
+
+    return status;
+}
+
 static NV_STATUS uvm_tools_get_processor_uuid_table_common(UVM_TOOLS_GET_PROCESSOR_UUID_TABLE_V2_PARAMS *params,
                                                            uvm_va_space_t *va_space,
                                                            NvU32 max_processors_count)
@@ -2735,6 +3159,32 @@ NV_STATUS uvm_api_tools_flush_events(UVM_TOOLS_FLUSH_EVENTS_PARAMS *params, stru
     return NV_OK;
 }
 
+NV_STATUS uvm_api_tools_get_numa_migration_counters(UVM_TOOLS_GET_NUMA_MIGRATION_COUNTERS_PARAMS *params,
+                                                     struct file *filp)
+{
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+    UvmToolsNumaMigrationCounters __user *table = (UvmToolsNumaMigrationCounters __user *)params->tablePtr;
+    NvU32 count = min_t(NvU32, params->count, nr_node_ids);
+    NvU32 nid;
+
+    for (nid = 0; nid < count; nid++) {
+        uvm_va_space_numa_counters_t *counters = &va_space->tools.numa_counters[nid];
+        UvmToolsNumaMigrationCounters entry;
+
+        memset(&entry, 0, sizeof(entry));
+        entry.pagesMigratedIn = atomic64_read(&counters->pages_in);
+        entry.pagesMigratedOut = atomic64_read(&counters->pages_out);
+        entry.pagesMisplaced = atomic64_read(&counters->pages_misplaced);
+
+        if (copy_to_user(&table[nid], &entry, sizeof(entry)))
+            return NV_ERR_INVALID_ADDRESS;
+    }
+
+    params->count = nr_node_ids;
+
+    return NV_OK;
+}
+
 NV_STATUS uvm_test_tools_flush_replay_events(UVM_TEST_TOOLS_FLUSH_REPLAY_EVENTS_PARAMS *params, struct file *filp)
 {
     NV_STATUS status = NV_OK;
@@ -35,6 +35,8 @@
 NV_STATUS uvm_test_inject_tools_event(UVM_TEST_INJECT_TOOLS_EVENT_PARAMS *params, struct file *filp);
 NV_STATUS uvm_test_inject_tools_event_v2(UVM_TEST_INJECT_TOOLS_EVENT_V2_PARAMS *params, struct file *filp);
 NV_STATUS uvm_test_increment_tools_counter(UVM_TEST_INCREMENT_TOOLS_COUNTER_PARAMS *params, struct file *filp);
+NV_STATUS uvm_test_tools_ats_prefetch_counters(UVM_TEST_TOOLS_ATS_PREFETCH_COUNTERS_PARAMS *params,
+                                               struct file *filp);
 NV_STATUS uvm_test_tools_flush_replay_events(UVM_TEST_TOOLS_FLUSH_REPLAY_EVENTS_PARAMS *params, struct file *filp);
 
 NV_STATUS uvm_api_tools_read_process_memory(UVM_TOOLS_READ_PROCESS_MEMORY_PARAMS *params, struct file *filp);
@@ -43,6 +45,8 @@ NV_STATUS uvm_api_tools_get_processor_uuid_table(UVM_TOOLS_GET_PROCESSOR_UUID_TA
 NV_STATUS uvm_api_tools_get_processor_uuid_table_v2(UVM_TOOLS_GET_PROCESSOR_UUID_TABLE_V2_PARAMS *params,
                                                     struct file *filp);
 NV_STATUS uvm_api_tools_flush_events(UVM_TOOLS_FLUSH_EVENTS_PARAMS *params, struct file *filp);
+NV_STATUS uvm_api_tools_get_numa_migration_counters(UVM_TOOLS_GET_NUMA_MIGRATION_COUNTERS_PARAMS *params,
+                                                     struct file *filp);
 
 static UvmEventFatalReason uvm_tools_status_to_fatal_fault_reason(NV_STATUS status)
 {
@@ -81,6 +85,23 @@ void uvm_tools_record_throttling_start(uvm_va_space_t *va_space, NvU64 address,
 
 void uvm_tools_record_throttling_end(uvm_va_space_t *va_space, NvU64 address, uvm_processor_id_t processor);
 
+// Account a faulting access to the given processor in the stream prefetcher
+// hit or miss counter, depending on whether it continued a known stream.
+void uvm_tools_record_prefetch_stream(uvm_va_space_t *va_space, uvm_processor_id_t processor, bool hit);
+
+// Account pages populated by the sequential ATS prefetcher for the given GPU in
+// the ATS prefetch hit and waste counters.
+void uvm_tools_record_ats_prefetch(uvm_va_space_t *va_space, uvm_gpu_t *gpu, NvU64 hit_pages, NvU64 waste_pages);
+
+// Account pages migrated into and out of the given NUMA node in the per-node
+// counters of the VA space. nid can be NUMA_NO_NODE, in which case nothing is
+// recorded.
+void uvm_tools_record_numa_migration(uvm_va_space_t *va_space, int nid, NvU64 pages_in, NvU64 pages_out);
+
+// Account pages which were meant to be placed on the given NUMA node, but were
+// allocated on another node.
+void uvm_tools_record_numa_misplaced(uvm_va_space_t *va_space, int nid, NvU64 pages);
+
 void uvm_tools_record_map_remote(uvm_va_block_t *va_block,
                                  uvm_push_t *push,
                                  uvm_processor_id_t processor,
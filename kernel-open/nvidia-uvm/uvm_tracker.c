@@ -30,6 +30,130 @@
 #include "uvm_common.h"
 #include "uvm_linux.h"
 
+static unsigned uvm_tracker_wait_adaptive = 0;
+module_param(uvm_tracker_wait_adaptive, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_tracker_wait_adaptive,
+                 "Sleep instead of spinning in tracker waits that take longer than recent waits on the same GPU. "
+                 "Fault servicing waits always spin.");
+
+static unsigned uvm_tracker_wait_max_spin_us = 100;
+module_param(uvm_tracker_wait_max_spin_us, uint, S_IRUGO);
+MODULE_PARM_DESC(uvm_tracker_wait_max_spin_us,
+                 "Maximum time in microseconds spent spinning in a tracker wait before sleeping.");
+
+#define TRACKER_WAIT_MIN_SPIN_NS    (5 * 1000ULL)
+#define TRACKER_WAIT_MIN_SLEEP_US   20
+#define TRACKER_WAIT_MAX_SLEEP_US   1000
+
+typedef enum
+{
+    // Sleep past the spin budget if uvm_tracker_wait_adaptive is set
+    TRACKER_WAIT_MODE_DEFAULT,
+
+    // Never sleep
+    TRACKER_WAIT_MODE_SPIN,
+
+    // Always sleep past the spin budget
+    TRACKER_WAIT_MODE_SLEEP,
+} tracker_wait_mode_t;
+
+// Hybrid waiter used by all the tracker waits. It spins while the wait is
+// shorter than the spin budget, which is twice the recent wait latency of the
+// GPU, up to uvm_tracker_wait_max_spin_us. Past the budget it sleeps with an
+// exponential backoff, letting other threads use the CPU during long waits.
+// There is no completion interrupt available to UVM, so sleeps are timed. Each
+// sleep is capped to a fraction of the time waited so far to bound the added
+// latency.
+typedef struct
+{
+    uvm_spin_loop_t spin;
+
+    bool may_sleep;
+
+    // GPU whose latency sets the spin budget, and which is credited with the
+    // sleeps. NULL if the wait doesn't track any GPU work.
+    uvm_parent_gpu_t *parent_gpu;
+
+    NvU64 spin_budget_ns;
+
+    // Duration of the next sleep
+    NvU32 sleep_us;
+
+    NvU64 num_sleeps;
+    NvU64 sleep_ns;
+} tracker_waiter_t;
+
+static void tracker_waiter_init(tracker_waiter_t *waiter, uvm_channel_t *channel, tracker_wait_mode_t mode)
+{
+    NvU64 max_spin_ns = uvm_tracker_wait_max_spin_us * 1000ULL;
+
+    memset(waiter, 0, sizeof(*waiter));
+    uvm_spin_loop_init(&waiter->spin);
+    waiter->may_sleep = mode == TRACKER_WAIT_MODE_SLEEP || (mode == TRACKER_WAIT_MODE_DEFAULT && uvm_tracker_wait_adaptive);
+    waiter->sleep_us = TRACKER_WAIT_MIN_SLEEP_US;
+    waiter->spin_budget_ns = max_spin_ns;
+
+    if (!channel)
+        return;
+
+    waiter->parent_gpu = uvm_channel_get_gpu(channel)->parent;
+
+    // Waits which take about as long as the recent ones are expected to keep
+    // doing so, and are not worth sleeping for.
+    waiter->spin_budget_ns = 2 * atomic64_read(&waiter->parent_gpu->tracker_wait.latency_ns);
+    waiter->spin_budget_ns = max(waiter->spin_budget_ns, TRACKER_WAIT_MIN_SPIN_NS);
+    waiter->spin_budget_ns = min(waiter->spin_budget_ns, max_spin_ns);
+}
+
+// Same as UVM_SPIN_LOOP(), but sleeps once the spin budget is exhausted
+static NV_STATUS tracker_waiter_wait(tracker_waiter_t *waiter)
+{
+    NvU64 elapsed_ns = uvm_spin_loop_elapsed(&waiter->spin);
+    NvU64 start_ns;
+    NvU32 sleep_us;
+
+    if (!waiter->may_sleep || !NV_MAY_SLEEP() || elapsed_ns < waiter->spin_budget_ns)
+        return UVM_SPIN_LOOP(&waiter->spin);
+
+    // Don't sleep for more than a quarter of the time waited so far, so that a
+    // sleep which outlasts the work delays the wait by well under half of its
+    // duration.
+    sleep_us = min(waiter->sleep_us, (NvU32)max(elapsed_ns / (4 * 1000), (NvU64)TRACKER_WAIT_MIN_SLEEP_US));
+
+    // usleep_range() is preferred because msleep() has a 20ms granularity
+    start_ns = NV_GETTIME();
+    usleep_range(sleep_us, sleep_us + sleep_us / 2);
+    waiter->sleep_ns += NV_GETTIME() - start_ns;
+    waiter->num_sleeps++;
+
+    waiter->sleep_us = min(waiter->sleep_us * 2, (NvU32)TRACKER_WAIT_MAX_SLEEP_US);
+
+    // Keep reporting waits which are stuck
+    return UVM_SPIN_LOOP(&waiter->spin);
+}
+
+static void tracker_waiter_done(tracker_waiter_t *waiter)
+{
+    uvm_parent_gpu_t *parent_gpu = waiter->parent_gpu;
+    NvU64 latency_ns;
+    NvU64 avg_ns;
+
+    if (!parent_gpu)
+        return;
+
+    // Exponential moving average with a weight of 1/8 for the new sample.
+    // Concurrent waiters can lose each other's updates, which only makes the
+    // average slightly less accurate.
+    latency_ns = uvm_spin_loop_elapsed(&waiter->spin);
+    avg_ns = atomic64_read(&parent_gpu->tracker_wait.latency_ns);
+    atomic64_set(&parent_gpu->tracker_wait.latency_ns, avg_ns - avg_ns / 8 + latency_ns / 8);
+
+    if (waiter->num_sleeps > 0) {
+        atomic64_add(waiter->num_sleeps, &parent_gpu->tracker_wait.num_sleeps);
+        atomic64_add(waiter->sleep_ns, &parent_gpu->tracker_wait.sleep_ns);
+    }
+}
+
 static bool tracker_is_using_static_entries(uvm_tracker_t *tracker)
 {
     return tracker->max_size == ARRAY_SIZE(tracker->static_entries);
@@ -298,12 +422,12 @@ static void uvm_tracker_print_pending_pushes(uvm_tracker_t *tracker)
         uvm_tracker_entry_print_pending_pushes(entry);
 }
 
-static NV_STATUS wait_for_entry_with_spin(uvm_tracker_entry_t *tracker_entry, uvm_spin_loop_t *spin)
+static NV_STATUS wait_for_entry_with_waiter(uvm_tracker_entry_t *tracker_entry, tracker_waiter_t *waiter)
 {
     NV_STATUS status = NV_OK;
 
     while (!uvm_tracker_is_entry_completed(tracker_entry) && status == NV_OK) {
-        if (UVM_SPIN_LOOP(spin) == NV_ERR_TIMEOUT_RETRY)
+        if (tracker_waiter_wait(waiter) == NV_ERR_TIMEOUT_RETRY)
             uvm_tracker_entry_print_pending_pushes(tracker_entry);
 
         status = uvm_channel_check_errors(tracker_entry->channel);
@@ -323,24 +447,39 @@ static NV_STATUS wait_for_entry_with_spin(uvm_tracker_entry_t *tracker_entry, uv
 
 NV_STATUS uvm_tracker_wait_for_entry(uvm_tracker_entry_t *tracker_entry)
 {
-    uvm_spin_loop_t spin;
-    uvm_spin_loop_init(&spin);
-    return wait_for_entry_with_spin(tracker_entry, &spin);
+    tracker_waiter_t waiter;
+    NV_STATUS status;
+
+    if (uvm_tracker_is_entry_completed(tracker_entry))
+        return NV_OK;
+
+    tracker_waiter_init(&waiter, tracker_entry->channel, TRACKER_WAIT_MODE_DEFAULT);
+    status = wait_for_entry_with_waiter(tracker_entry, &waiter);
+    tracker_waiter_done(&waiter);
+
+    return status;
 }
 
-NV_STATUS uvm_tracker_wait(uvm_tracker_t *tracker)
+static NV_STATUS tracker_wait(uvm_tracker_t *tracker, tracker_wait_mode_t mode)
 {
     NV_STATUS status = NV_OK;
-    uvm_spin_loop_t spin;
+    tracker_waiter_t waiter;
 
-    uvm_spin_loop_init(&spin);
+    if (uvm_tracker_is_completed(tracker))
+        return NV_OK;
+
+    // The remaining entries are all pending. Use the first one for the spin
+    // budget.
+    tracker_waiter_init(&waiter, uvm_tracker_get_entries(tracker)[0].channel, mode);
     while (!uvm_tracker_is_completed(tracker) && status == NV_OK) {
-        if (UVM_SPIN_LOOP(&spin) == NV_ERR_TIMEOUT_RETRY)
+        if (tracker_waiter_wait(&waiter) == NV_ERR_TIMEOUT_RETRY)
             uvm_tracker_print_pending_pushes(tracker);
 
         status = uvm_tracker_check_errors(tracker);
     }
 
+    tracker_waiter_done(&waiter);
+
     if (status != NV_OK) {
         UVM_ASSERT(status == uvm_global_get_status());
 
@@ -357,23 +496,47 @@ NV_STATUS uvm_tracker_wait(uvm_tracker_t *tracker)
     return status;
 }
 
+NV_STATUS uvm_tracker_wait(uvm_tracker_t *tracker)
+{
+    return tracker_wait(tracker, TRACKER_WAIT_MODE_DEFAULT);
+}
+
+NV_STATUS uvm_tracker_wait_spin(uvm_tracker_t *tracker)
+{
+    return tracker_wait(tracker, TRACKER_WAIT_MODE_SPIN);
+}
+
+NV_STATUS uvm_tracker_wait_sleep(uvm_tracker_t *tracker)
+{
+    return tracker_wait(tracker, TRACKER_WAIT_MODE_SLEEP);
+}
+
 NV_STATUS uvm_tracker_wait_for_other_gpus(uvm_tracker_t *tracker, uvm_gpu_t *gpu)
 {
     NV_STATUS status = NV_OK;
     uvm_tracker_entry_t *entry;
-    uvm_spin_loop_t spin;
-
-    uvm_spin_loop_init(&spin);
+    tracker_waiter_t waiter;
+    bool waited = false;
 
     for_each_tracker_entry(entry, tracker) {
-        if (uvm_tracker_entry_gpu(entry) == gpu)
+        if (uvm_tracker_entry_gpu(entry) == gpu || uvm_tracker_is_entry_completed(entry))
             continue;
 
-        status = wait_for_entry_with_spin(entry, &spin);
+        // A single waiter is used for all the entries, so that stuck waits are
+        // reported based on the total time
+        if (!waited) {
+            tracker_waiter_init(&waiter, entry->channel, TRACKER_WAIT_MODE_DEFAULT);
+            waited = true;
+        }
+
+        status = wait_for_entry_with_waiter(entry, &waiter);
         if (status != NV_OK)
             break;
     }
 
+    if (waited)
+        tracker_waiter_done(&waiter);
+
     if (status == NV_OK) {
         uvm_tracker_remove_completed(tracker);
     }
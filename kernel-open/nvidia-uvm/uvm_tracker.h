@@ -148,9 +148,20 @@ bool uvm_tracker_is_completed(uvm_tracker_t *tracker);
 // remove some entries from the tracker and they would eventually become invalid
 // after the channels they track are destroyed.
 //
+// The wait spins, then sleeps if it lasts longer than the recent waits on the
+// GPU and the uvm_tracker_wait_adaptive module parameter is set.
+//
 // This won't change the max size of the tracker.
 NV_STATUS uvm_tracker_wait(uvm_tracker_t *tracker);
 
+// Same as uvm_tracker_wait(), but never sleeps. Used by the fault servicing
+// paths, where the oversleeping of a timed sleep would delay the replay.
+NV_STATUS uvm_tracker_wait_spin(uvm_tracker_t *tracker);
+
+// Same as uvm_tracker_wait(), but sleeps past the spin budget regardless of
+// the uvm_tracker_wait_adaptive module parameter.
+NV_STATUS uvm_tracker_wait_sleep(uvm_tracker_t *tracker);
+
 // Wait for all tracker entries for other GPUs to complete
 //
 // This can only fail if a fatal error is hit that uvm_tracker_check_errors()
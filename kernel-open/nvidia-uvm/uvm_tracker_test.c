@@ -147,6 +147,86 @@ done:
     return status;
 }
 
+// Delay before the CPU lets the GPU work of test_tracker_wait_sleep() complete.
+// It is longer than the default spin budget of tracker waits
+// (uvm_tracker_wait_max_spin_us), so the wait has to sleep.
+#define TRACKER_TEST_SLEEP_DELAY_US 20000
+
+static void test_tracker_release_sema_delayed(void *args)
+{
+    uvm_gpu_semaphore_t *sema = args;
+
+    usleep_range(TRACKER_TEST_SLEEP_DELAY_US, TRACKER_TEST_SLEEP_DELAY_US + 1000);
+    uvm_gpu_semaphore_set_payload(sema, 1);
+}
+
+// This test schedules GPU work behind a semaphore released from a kthread
+// after a delay, and checks that a sleeping wait on it completes and sleeps.
+static NV_STATUS test_tracker_wait_sleep(uvm_va_space_t *va_space)
+{
+    uvm_gpu_t *gpu;
+    uvm_tracker_t tracker;
+    uvm_gpu_semaphore_t sema;
+    uvm_push_t push;
+    nv_kthread_q_t q;
+    nv_kthread_q_item_t q_item;
+    NvU64 num_sleeps;
+    NvU64 start_ns;
+    NV_STATUS status = NV_OK;
+
+    // See test_tracker_completion()
+    if (g_uvm_global.conf_computing_enabled)
+        return NV_OK;
+
+    gpu = uvm_va_space_find_first_gpu(va_space);
+    TEST_CHECK_RET(gpu != NULL);
+
+    TEST_NV_CHECK_RET(uvm_gpu_semaphore_alloc(gpu->semaphore_pool, &sema));
+
+    uvm_tracker_init(&tracker);
+
+    if (nv_kthread_q_init(&q, "UVM tracker test") != 0) {
+        status = NV_ERR_NO_MEMORY;
+        goto done_free_sema;
+    }
+
+    TEST_NV_CHECK_GOTO(uvm_push_begin(gpu->channel_manager, UVM_CHANNEL_TYPE_GPU_INTERNAL, &push, "Test push"),
+                       done);
+    gpu->parent->host_hal->semaphore_acquire(&push,
+                                             uvm_gpu_semaphore_get_gpu_va(&sema,
+                                                                          gpu,
+                                                                          uvm_channel_is_proxy(push.channel)),
+                                             1);
+    uvm_push_end(&push);
+
+    TEST_NV_CHECK_GOTO(uvm_tracker_add_push(&tracker, &push), done);
+    TEST_NV_CHECK_GOTO(assert_tracker_is_not_completed(&tracker), done);
+
+    num_sleeps = atomic64_read(&gpu->parent->tracker_wait.num_sleeps);
+
+    start_ns = NV_GETTIME();
+    nv_kthread_q_item_init(&q_item, test_tracker_release_sema_delayed, &sema);
+    TEST_CHECK_GOTO(nv_kthread_q_schedule_q_item(&q, &q_item) != 0, done);
+
+    TEST_NV_CHECK_GOTO(uvm_tracker_wait_sleep(&tracker), done);
+
+    TEST_CHECK_GOTO(NV_GETTIME() - start_ns >= TRACKER_TEST_SLEEP_DELAY_US * 1000ULL, done);
+    TEST_CHECK_GOTO(atomic64_read(&gpu->parent->tracker_wait.num_sleeps) > num_sleeps, done);
+    TEST_NV_CHECK_GOTO(assert_tracker_is_completed(&tracker), done);
+
+done:
+    // Let the pending push complete if the test failed before releasing the
+    // semaphore
+    nv_kthread_q_stop(&q);
+    uvm_gpu_semaphore_set_payload(&sema, 1);
+    uvm_tracker_wait_deinit(&tracker);
+
+done_free_sema:
+    uvm_gpu_semaphore_free(&sema);
+
+    return status;
+}
+
 static NV_STATUS test_tracker_basic(uvm_va_space_t *va_space)
 {
     uvm_gpu_t *gpu;
@@ -449,6 +529,10 @@ NV_STATUS uvm_test_tracker_sanity(UVM_TEST_TRACKER_SANITY_PARAMS *params, struct
     if (status != NV_OK)
         goto done;
 
+    status = test_tracker_wait_sleep(va_space);
+    if (status != NV_OK)
+        goto done;
+
     status = test_tracker_overwrite(va_space);
     if (status != NV_OK)
         goto done;
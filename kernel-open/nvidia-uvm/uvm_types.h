@@ -93,6 +93,16 @@ typedef struct
     NvU32           gpuCompressionType; // UvmGpuCompressionType
 } UvmGpuMappingAttributes;
 
+// Range of a batched migration. See UvmMigrate for the meaning of the fields.
+typedef struct
+{
+    NvU64           base;
+    NvU64           length;
+    NvProcessorUuid destinationUuid;
+    NvS32           cpuNumaNode;
+    NvU32           padding;        // Must be 0
+} UvmMigrateBatchRange;
+
 // forward declaration of OS-dependent structure
 typedef struct UvmGlobalState_tag UvmGlobalState;
 
@@ -232,7 +242,35 @@ typedef enum
     // number of faults reported on the GPU
     //
     UvmCounterNameGpuPageFaultCount = 9,
-    UVM_TOTAL_COUNTERS
+    //
+    // Number of counters in the counter buffer of the trackers created with
+    // UVM_TOOLS_INIT_EVENT_TRACKER and UVM_TOOLS_INIT_EVENT_TRACKER_V2. The
+    // counters that follow are only available to the trackers created with
+    // UVM_TOOLS_INIT_EVENT_TRACKER_V3, whose buffer holds
+    // UVM_TOTAL_COUNTERS_V3 counters.
+    //
+    UVM_TOTAL_COUNTERS = 10,
+    //
+    // number of faulting accesses that continued a stream learned by the
+    // stream prefetcher
+    //
+    UvmCounterNameStreamPrefetchHitCount = 10,
+    //
+    // number of faulting accesses that did not continue any stream learned by
+    // the stream prefetcher
+    //
+    UvmCounterNameStreamPrefetchMissCount = 11,
+    //
+    // number of pages populated by the sequential ATS prefetcher that the
+    // faulting stream moved past without faulting on them
+    //
+    UvmCounterNameAtsPrefetchHitPageCount = 12,
+    //
+    // number of pages populated by the sequential ATS prefetcher that the
+    // faulting stream did not reach before it stopped
+    //
+    UvmCounterNameAtsPrefetchWastePageCount = 13,
+    UVM_TOTAL_COUNTERS_V3
 } UvmCounterName;
 
 #define UVM_COUNTER_NAME_FLAG_BYTES_XFER_HTD 0x1
@@ -245,6 +283,10 @@ typedef enum
 #define UVM_COUNTER_NAME_FLAG_PREFETCH_BYTES_XFER_HTD 0x80
 #define UVM_COUNTER_NAME_FLAG_PREFETCH_BYTES_XFER_DTH 0x100
 #define UVM_COUNTER_NAME_FLAG_GPU_PAGE_FAULT_COUNT 0x200
+#define UVM_COUNTER_NAME_FLAG_STREAM_PREFETCH_HIT_COUNT 0x400
+#define UVM_COUNTER_NAME_FLAG_STREAM_PREFETCH_MISS_COUNT 0x800
+#define UVM_COUNTER_NAME_FLAG_ATS_PREFETCH_HIT_PAGE_COUNT 0x1000
+#define UVM_COUNTER_NAME_FLAG_ATS_PREFETCH_WASTE_PAGE_COUNT 0x2000
 
 //------------------------------------------------------------------------------
 // UVM counter config structure
@@ -54,6 +54,17 @@ typedef enum
 
 static NvU64 uvm_perf_authorized_cpu_fault_tracking_window_ns = 300000;
 
+// Resolve CPU faults on pages already resident and mapped with the required
+// permissions without taking the block lock.
+static int uvm_perf_cpu_fault_fast_path __read_mostly = 1;
+module_param(uvm_perf_cpu_fault_fast_path, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(uvm_perf_cpu_fault_fast_path,
+                 "Resolve CPU faults on resident and mapped pages without taking the VA block lock. Default: 1.");
+
+// Maximum number of faults resolved in the fast path before one has to go
+// through the regular path.
+#define UVM_CPU_FAULT_FAST_PATH_MAX_FAULTS 64
+
 static struct kmem_cache *g_uvm_va_block_cache __read_mostly;
 static struct kmem_cache *g_uvm_va_block_gpu_state_cache __read_mostly;
 static struct kmem_cache *g_uvm_page_mask_cache __read_mostly;
@@ -71,6 +82,21 @@ static int uvm_block_cpu_to_cpu_copy_with_ce __read_mostly = 0;
 module_param(uvm_block_cpu_to_cpu_copy_with_ce, int, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(uvm_block_cpu_to_cpu_copy_with_ce, "Use GPU CEs for CPU-to-CPU migrations.");
 
+// Physically-contiguous copies between the CPU and a GPU are split across up to
+// this many channels, spread over the CEs suitable for the transfer direction.
+// 1 disables striping.
+static unsigned uvm_block_copy_max_stripes __read_mostly = 8;
+module_param(uvm_block_copy_max_stripes, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(uvm_block_copy_max_stripes,
+                 "Maximum number of channels a CPU-GPU VA block copy is striped across. 1 disables striping.");
+
+// Copies are only striped in parts of at least this size
+#define UVM_BLOCK_COPY_STRIPE_MIN_SIZE (256 * 1024)
+
+// Maximum number of stripes of a block copy pushed to other channels than the
+// block's main push
+#define UVM_BLOCK_COPY_MAX_STRIPES (UVM_VA_BLOCK_SIZE / UVM_BLOCK_COPY_STRIPE_MIN_SIZE)
+
 // Caching is always disabled for mappings to remote memory. The following two
 // module parameters can be used to force caching for GPU peer/sysmem mappings.
 //
@@ -589,10 +615,30 @@ static uvm_cpu_chunk_t *uvm_cpu_chunk_next_in_region(uvm_va_block_t *va_block,
                                             (nid),                                                                     \
                                             uvm_va_block_region_from_block((va_block)))
 
+// Clear the CPU fault snapshot. This must be called with the block lock held
+// whenever CPU residency or mappings are removed.
+static void block_cpu_fault_snapshot_clear(uvm_va_block_t *va_block)
+{
+    uvm_pte_bits_cpu_t pte_bit;
+
+    // Plain seqcount writers must not be preempted
+    preempt_disable();
+    write_seqcount_begin(&va_block->cpu.fault_snapshot.seq);
+
+    uvm_page_mask_zero(&va_block->cpu.fault_snapshot.resident);
+    for (pte_bit = 0; pte_bit < UVM_PTE_BITS_CPU_MAX; pte_bit++)
+        uvm_page_mask_zero(&va_block->cpu.fault_snapshot.pte_bits[pte_bit]);
+
+    write_seqcount_end(&va_block->cpu.fault_snapshot.seq);
+    preempt_enable();
+}
+
 static void block_update_cpu_resident_mask(uvm_va_block_t *va_block)
 {
     int nid;
 
+    block_cpu_fault_snapshot_clear(va_block);
+
     uvm_page_mask_zero(&va_block->cpu.resident);
     for_each_possible_uvm_node(nid) {
         uvm_va_block_cpu_node_state_t *node_state = block_node_state_get(va_block, nid);
@@ -698,8 +744,7 @@ static void uvm_va_block_cpu_clear_resident_all_chunks(uvm_va_block_t *va_block,
             uvm_page_mask_t *nid_resident = uvm_va_block_resident_mask_get(va_block, UVM_ID_CPU, nid);
             uvm_page_mask_t *migrated_pages = &va_block_context->make_resident.pages_migrated;
 
-            uvm_page_mask_andnot(node_pages_mask, nid_resident, node_alloc_mask);
-            if (uvm_page_mask_and(node_pages_mask, migrated_pages, node_pages_mask))
+            if (uvm_page_mask_and_andnot(node_pages_mask, migrated_pages, nid_resident, node_alloc_mask))
                 uvm_va_block_cpu_clear_resident_mask(va_block, nid, node_pages_mask);
         }
         else {
@@ -1305,6 +1350,7 @@ NV_STATUS uvm_va_block_create(uvm_va_range_managed_t *managed_range,
 
     nv_kref_init(&block->kref);
     uvm_mutex_init(&block->lock, UVM_LOCK_ORDER_VA_BLOCK);
+    seqcount_init(&block->cpu.fault_snapshot.seq);
     block->start = start;
     block->end = end;
     block->managed_range = managed_range;
@@ -1529,6 +1575,37 @@ static bool block_cpu_page_is_dirty(uvm_va_block_t *block, uvm_page_index_t page
     return uvm_cpu_chunk_is_dirty(chunk, page_index - chunk_region.first);
 }
 
+// Take a chunk from the CPU chunk pool, keeping the DMA mappings it may already
+// have on the GPUs the block tracks mappings for.
+static NV_STATUS block_alloc_cpu_chunk_from_pool(uvm_va_block_t *block,
+                                                 uvm_chunk_size_t alloc_size,
+                                                 int nid,
+                                                 uvm_cpu_chunk_t **chunk)
+{
+    uvm_processor_mask_t *keep_gpus;
+    uvm_gpu_id_t id;
+    NV_STATUS status;
+
+    if (!uvm_cpu_chunk_pool_enabled())
+        return NV_ERR_NO_MEMORY;
+
+    keep_gpus = uvm_processor_mask_cache_alloc();
+    if (!keep_gpus)
+        return NV_ERR_NO_MEMORY;
+
+    uvm_processor_mask_zero(keep_gpus);
+    for_each_gpu_id(id) {
+        if (uvm_va_block_gpu_state_get(block, id))
+            uvm_processor_mask_set(keep_gpus, id);
+    }
+
+    status = uvm_cpu_chunk_pool_alloc(alloc_size, nid, keep_gpus, chunk);
+
+    uvm_processor_mask_cache_free(keep_gpus);
+
+    return status;
+}
+
 // Allocate a CPU chunk with the given properties. This may involve retrying if
 // allocations fail. Allocating larger chunk sizes takes priority over
 // allocating on the specified node in the following manner:
@@ -1567,6 +1644,15 @@ static NV_STATUS block_alloc_cpu_chunk(uvm_va_block_t *block,
     }
 
     for_each_chunk_size_rev(alloc_size, cpu_allocation_sizes) {
+        // Allocations which are not charged to a process, like the ones on the
+        // eviction path, can be served from the CPU chunk pool. Its chunks are
+        // zeroed and allocated on the requested node.
+        if (!(flags & UVM_CPU_CHUNK_ALLOC_FLAGS_ACCOUNT) && alloc_size > PAGE_SIZE) {
+            status = block_alloc_cpu_chunk_from_pool(block, alloc_size, nid, chunk);
+            if (status == NV_OK)
+                break;
+        }
+
         status = uvm_cpu_chunk_alloc(alloc_size, flags, nid, chunk);
         if (status == NV_OK)
             break;
@@ -3344,6 +3430,20 @@ typedef struct
     // True if at least one CE transfer (such as a memcopy) has already been
     // pushed to the GPU during the VA block copy thus far.
     bool copy_pushed;
+
+    // True if the push began by block_copy_begin_push invalidated the
+    // physical TLB of the copying GPU. Stripe pushes on other channels need
+    // to do the same, since they are not ordered with that push.
+    bool needs_phys_invalidate;
+
+    // Parts of the copy left to stripe pushes, which are only begun once the
+    // main push has ended. See block_copy_pages_striped().
+    struct
+    {
+        uvm_va_block_region_t region;
+        unsigned index;
+    } stripes[UVM_BLOCK_COPY_MAX_STRIPES];
+    unsigned num_stripes;
 } block_copy_state_t;
 
 // Begin a push appropriate for copying data from src_id processor to dst_id
@@ -3460,8 +3560,11 @@ static NV_STATUS block_copy_begin_push(uvm_va_block_t *va_block, block_copy_stat
     // wish to allow GPU -> GPU copies through the SYS aperture in the future.
     // In any case, the invalidate is only issued if there have been un-flushed
     // DMA mappings created since the last time we checked.
-    if (status == NV_OK)
+    if (status == NV_OK) {
+        copy_state->needs_phys_invalidate = uvm_parent_processor_mask_test(&va_block->needs_phys_invalidate,
+                                                                           gpu->parent->id);
         block_tlb_invalidate_phys(va_block, push);
+    }
 
 out:
     // Caller is responsible for freeing the DMA buffer on error
@@ -3533,6 +3636,29 @@ static void block_mark_memory_used(uvm_va_block_t *block, uvm_processor_id_t id)
     }
 }
 
+void uvm_va_block_mark_memory_accessed(uvm_va_block_t *va_block, uvm_processor_id_t id)
+{
+    uvm_gpu_t *gpu;
+    uvm_gpu_chunk_t *chunk;
+
+    uvm_assert_mutex_locked(&va_block->lock);
+
+    if (UVM_ID_IS_CPU(id) || !uvm_processor_mask_test(&va_block->resident, id))
+        return;
+
+    gpu = uvm_gpu_get(id);
+
+    // Same conditions as block_mark_memory_used()
+    if (uvm_va_block_is_hmm(va_block) ||
+        uvm_va_block_size(va_block) != UVM_CHUNK_SIZE_MAX ||
+        !uvm_parent_gpu_supports_eviction(gpu->parent))
+        return;
+
+    chunk = uvm_va_block_gpu_state_get(va_block, gpu->id)->chunks[0];
+    if (chunk)
+        uvm_pmm_gpu_mark_root_chunk_accessed(&gpu->pmm, chunk);
+}
+
 static void block_set_resident_processor(uvm_va_block_t *block, uvm_processor_id_t id)
 {
     UVM_ASSERT(!uvm_page_mask_empty(uvm_va_block_resident_mask_get(block, id, NUMA_NO_NODE)));
@@ -3957,6 +4083,155 @@ static NV_STATUS block_copy_pages(uvm_va_block_t *va_block,
     return NV_OK;
 }
 
+// Returns the channel type of the copy if it can be striped across several
+// channels, or UVM_CHANNEL_TYPE_COUNT otherwise.
+static uvm_channel_type_t block_copy_stripe_channel_type(uvm_va_block_t *va_block, block_copy_state_t *copy_state)
+{
+    uvm_processor_id_t src_id = copy_state->src.id;
+    uvm_processor_id_t dst_id = copy_state->dst.id;
+
+    // The Confidential Computing copy path uses a single staging buffer per
+    // copy.
+    if (g_uvm_global.conf_computing_enabled)
+        return UVM_CHANNEL_TYPE_COUNT;
+
+    if (!copy_state->src.is_block_contig || !copy_state->dst.is_block_contig)
+        return UVM_CHANNEL_TYPE_COUNT;
+
+    if (UVM_ID_IS_CPU(src_id) && UVM_ID_IS_GPU(dst_id))
+        return UVM_CHANNEL_TYPE_CPU_TO_GPU;
+
+    if (UVM_ID_IS_GPU(src_id) && UVM_ID_IS_CPU(dst_id))
+        return UVM_CHANNEL_TYPE_GPU_TO_CPU;
+
+    return UVM_CHANNEL_TYPE_COUNT;
+}
+
+// Copy a physically-contiguous region, splitting it across several channels
+// of the copying GPU when it is large enough. The first stripe is copied in
+// push. The others are only recorded in copy_state, and copied by
+// block_copy_push_stripes() once push has ended: a thread can't have more than
+// one push open at a time.
+static NV_STATUS block_copy_pages_striped(uvm_va_block_t *va_block,
+                                          block_copy_state_t *copy_state,
+                                          uvm_va_block_region_t region,
+                                          uvm_push_t *push)
+{
+    uvm_gpu_t *gpu;
+    uvm_channel_type_t channel_type;
+    uvm_page_index_t stripe_first;
+    NvU32 stripe_pages;
+    unsigned num_stripes;
+    unsigned stripe;
+
+    if (!block_copy_should_use_push(va_block, copy_state))
+        return block_copy_pages(va_block, copy_state, region, push);
+
+    channel_type = block_copy_stripe_channel_type(va_block, copy_state);
+    if (channel_type == UVM_CHANNEL_TYPE_COUNT)
+        return block_copy_pages(va_block, copy_state, region, push);
+
+    gpu = uvm_push_get_gpu(push);
+
+    num_stripes = min(uvm_block_copy_max_stripes,
+                      uvm_channel_manager_num_stripe_channels(gpu->channel_manager, channel_type));
+    num_stripes = min(num_stripes, (unsigned)(uvm_va_block_region_size(region) / UVM_BLOCK_COPY_STRIPE_MIN_SIZE));
+    num_stripes = min(num_stripes, (unsigned)(UVM_BLOCK_COPY_MAX_STRIPES - copy_state->num_stripes + 1));
+    if (num_stripes <= 1)
+        return block_copy_pages(va_block, copy_state, region, push);
+
+    stripe_pages = DIV_ROUND_UP(uvm_va_block_region_num_pages(region), num_stripes);
+
+    block_copy_pages(va_block, copy_state, uvm_va_block_region(region.first, region.first + stripe_pages), push);
+
+    for (stripe = 1, stripe_first = region.first + stripe_pages;
+         stripe < num_stripes && stripe_first < region.outer;
+         stripe++, stripe_first += stripe_pages) {
+        UVM_ASSERT(copy_state->num_stripes < UVM_BLOCK_COPY_MAX_STRIPES);
+
+        copy_state->stripes[copy_state->num_stripes].region = uvm_va_block_region(stripe_first,
+                                                                                  min(stripe_first + stripe_pages,
+                                                                                      (uvm_page_index_t)region.outer));
+        copy_state->stripes[copy_state->num_stripes].index = stripe;
+        copy_state->num_stripes++;
+    }
+
+    return NV_OK;
+}
+
+// Copy the stripes recorded by block_copy_pages_striped(), each in its own
+// push on a stripe channel of the copying GPU. The pushes acquire the block
+// tracker like the main push did, and are added to copy_tracker, which ends up
+// in the block tracker. The pages of stripes which couldn't be pushed are
+// removed from copy_mask.
+//
+// Must be called after the main push has ended.
+static NV_STATUS block_copy_push_stripes(uvm_va_block_t *va_block,
+                                         block_copy_state_t *copy_state,
+                                         uvm_gpu_t *gpu,
+                                         uvm_page_mask_t *copy_mask,
+                                         uvm_tracker_t *copy_tracker)
+{
+    uvm_channel_type_t channel_type;
+    NV_STATUS status = NV_OK;
+    unsigned i;
+
+    if (copy_state->num_stripes == 0)
+        return NV_OK;
+
+    channel_type = block_copy_stripe_channel_type(va_block, copy_state);
+    UVM_ASSERT(channel_type != UVM_CHANNEL_TYPE_COUNT);
+
+    for (i = 0; i < copy_state->num_stripes; i++) {
+        uvm_va_block_region_t stripe_region = copy_state->stripes[i].region;
+        unsigned stripe = copy_state->stripes[i].index;
+        uvm_channel_t *channel = uvm_channel_manager_stripe_channel(gpu->channel_manager, channel_type, stripe);
+        uvm_gpu_address_t dst_address;
+        uvm_gpu_address_t src_address;
+        uvm_push_t push;
+
+        if (status != NV_OK) {
+            uvm_page_mask_region_clear(copy_mask, stripe_region);
+            continue;
+        }
+
+        status = uvm_push_begin_acquire_on_channel(channel,
+                                                   &va_block->tracker,
+                                                   &push,
+                                                   "Copy stripe %u from %s to %s for block [0x%llx, 0x%llx]",
+                                                   stripe,
+                                                   uvm_processor_get_name(copy_state->src.id),
+                                                   uvm_processor_get_name(copy_state->dst.id),
+                                                   va_block->start,
+                                                   va_block->end);
+        if (status != NV_OK) {
+            uvm_page_mask_region_clear(copy_mask, stripe_region);
+            continue;
+        }
+
+        // The physical TLB invalidate done in the main push is not ordered
+        // with this push, so do it again if needed.
+        if (copy_state->needs_phys_invalidate)
+            uvm_hal_tlb_invalidate_phys(&push, gpu->parent->ats.dma_map_invalidation);
+
+        dst_address = block_copy_get_address(va_block, &copy_state->dst, stripe_region.first, gpu);
+        src_address = block_copy_get_address(va_block, &copy_state->src, stripe_region.first, gpu);
+
+        uvm_push_set_flag(&push, UVM_PUSH_FLAG_NEXT_MEMBAR_NONE);
+        gpu->parent->ce_hal->memcopy(&push, dst_address, src_address, uvm_va_block_region_size(stripe_region));
+
+        uvm_push_end(&push);
+
+        // On tracking failure, wait for the push instead of losing track of it
+        if (uvm_tracker_add_push_safe(copy_tracker, &push) != NV_OK)
+            status = uvm_push_wait(&push);
+    }
+
+    copy_state->num_stripes = 0;
+
+    return status;
+}
+
 static NV_STATUS zero_destination_mem_if_needed(uvm_va_block_t *block,
                                                 uvm_va_block_region_t region,
                                                 uvm_page_mask_t *copy_mask,
@@ -4076,11 +4351,13 @@ static NV_STATUS block_copy_resident_pages_between(uvm_va_block_t *block,
         UVM_ASSERT(dst_nid != NUMA_NO_NODE);
 
     // If there are no pages to be copied, exit early
-    if (!uvm_page_mask_andnot(copy_mask, copy_mask, dst_resident_mask))
-        return NV_OK;
-
-    if (migrated_pages && !uvm_page_mask_andnot(copy_mask, copy_mask, migrated_pages))
+    if (migrated_pages) {
+        if (!uvm_page_mask_andnot2(copy_mask, copy_mask, dst_resident_mask, migrated_pages))
+            return NV_OK;
+    }
+    else if (!uvm_page_mask_andnot(copy_mask, copy_mask, dst_resident_mask)) {
         return NV_OK;
+    }
 
     copy_state.src.id = src_id;
     copy_state.dst.id = dst_id;
@@ -4250,7 +4527,7 @@ static NV_STATUS block_copy_resident_pages_between(uvm_va_block_t *block,
             // If both src and dst are physically-contiguous, consolidate copies
             // of contiguous pages into a single method.
             if (copy_state.src.is_block_contig && copy_state.dst.is_block_contig) {
-                status = block_copy_pages(block, &copy_state, contig_region, &push);
+                status = block_copy_pages_striped(block, &copy_state, contig_region, &push);
                 if (status != NV_OK)
                     break;
             }
@@ -4299,7 +4576,7 @@ static NV_STATUS block_copy_resident_pages_between(uvm_va_block_t *block,
     contig_region = uvm_va_block_region(contig_start_index, last_index + 1);
     if (uvm_va_block_region_size(contig_region) && uvm_va_block_region_contains_region(region, contig_region)) {
         if (copy_state.src.is_block_contig && copy_state.dst.is_block_contig) {
-            status = block_copy_pages(block, &copy_state, contig_region, &push);
+            status = block_copy_pages_striped(block, &copy_state, contig_region, &push);
             if (status != NV_OK)
                 return status;
         }
@@ -4331,8 +4608,15 @@ static NV_STATUS block_copy_resident_pages_between(uvm_va_block_t *block,
                                                 &block_context->make_resident);
         }
 
-        if (block_copy_should_use_push(block, &copy_state) && copying_gpu)
+        if (block_copy_should_use_push(block, &copy_state) && copying_gpu) {
+            NV_STATUS stripes_status;
+
             status = block_copy_end_push(block, &copy_state, copy_tracker, status, &push);
+
+            stripes_status = block_copy_push_stripes(block, &copy_state, copying_gpu, copy_mask, copy_tracker);
+            if (status == NV_OK)
+                status = stripes_status;
+        }
     }
 
     // Update VA block status bits
@@ -4507,6 +4791,23 @@ static NV_STATUS block_copy_resident_pages_mask(uvm_va_block_t *block,
     return status;
 }
 
+// Whether the GPUs losing their read duplicates in a make_resident operation
+// should remember the pages, see uvm_va_policy_t::read_duplication_write_tracking.
+// Only faults break read duplication because of a write. Other causes, such as
+// explicit migrations, are not tracked.
+static bool block_tracks_read_duplicate_writes(uvm_va_block_t *block, uvm_va_block_context_t *block_context)
+{
+    uvm_make_resident_cause_t cause = block_context->make_resident.cause;
+
+    if (uvm_va_block_is_hmm(block))
+        return false;
+
+    if (cause != UVM_MAKE_RESIDENT_CAUSE_REPLAYABLE_FAULT && cause != UVM_MAKE_RESIDENT_CAUSE_NON_REPLAYABLE_FAULT)
+        return false;
+
+    return block->managed_range->policy.read_duplication_write_tracking;
+}
+
 static void break_read_duplication_in_region(uvm_va_block_t *block,
                                              uvm_va_block_context_t *block_context,
                                              uvm_processor_id_t dst_id,
@@ -4515,6 +4816,7 @@ static void break_read_duplication_in_region(uvm_va_block_t *block,
 {
     uvm_processor_id_t id;
     uvm_page_mask_t *break_pages_in_region = &block_context->scratch_page_mask;
+    bool track_writes = block_tracks_read_duplicate_writes(block, block_context);
 
     uvm_page_mask_init_from_region(break_pages_in_region, region, page_mask);
 
@@ -4542,6 +4844,18 @@ static void break_read_duplication_in_region(uvm_va_block_t *block,
         }
         else {
             other_resident_mask = uvm_va_block_resident_mask_get(block, id, NUMA_NO_NODE);
+
+            // Pages resident on both dst_id and this GPU were read duplicated
+            if (track_writes) {
+                uvm_va_block_gpu_state_t *gpu_state = uvm_va_block_gpu_state_get(block, id);
+                uvm_page_index_t page_index;
+
+                for_each_va_block_page_in_region_mask(page_index, break_pages_in_region, region) {
+                    if (uvm_page_mask_test(other_resident_mask, page_index))
+                        uvm_page_mask_set(&gpu_state->read_duplicate_write_invalidated, page_index);
+                }
+            }
+
             uvm_page_mask_andnot(other_resident_mask, other_resident_mask, break_pages_in_region);
         }
 
@@ -6043,6 +6357,10 @@ static void block_unmap_cpu(uvm_va_block_t *block,
         uvm_page_mask_region_test(unmap_pages, region, block->cpu.fault_authorized.page_index))
         block->cpu.fault_authorized.first_fault_stamp = 0;
 
+    // Stop resolving faults on the pages without the block lock before the
+    // kernel mappings go away.
+    block_cpu_fault_snapshot_clear(block);
+
     for_each_va_block_subregion_in_mask(subregion, unmap_pages, region) {
         if (!block_has_valid_mapping_cpu(block, subregion))
             continue;
@@ -8484,11 +8802,14 @@ static NV_STATUS block_map_gpu_to(uvm_va_block_t *va_block,
     // have exactly new_prot after performing the mapping.
     uvm_page_mask_or(&block_context->scratch_page_mask, &gpu_state->pte_bits[prot_pte_bit], pages_to_map);
     if (prot_pte_bit < UVM_PTE_BITS_GPU_ATOMIC) {
-        uvm_page_mask_andnot(&block_context->scratch_page_mask,
-                             &block_context->scratch_page_mask,
-                             &gpu_state->pte_bits[prot_pte_bit + 1]);
+        uvm_page_mask_and_andnot(&block_context->scratch_page_mask,
+                                 &block_context->scratch_page_mask,
+                                 resident_mask,
+                                 &gpu_state->pte_bits[prot_pte_bit + 1]);
+    }
+    else {
+        uvm_page_mask_and(&block_context->scratch_page_mask, &block_context->scratch_page_mask, resident_mask);
     }
-    uvm_page_mask_and(&block_context->scratch_page_mask, &block_context->scratch_page_mask, resident_mask);
 
     block_gpu_compute_new_pte_state(va_block,
                                     gpu,
@@ -8940,10 +9261,10 @@ static NV_STATUS block_revoke_prot_gpu_to(uvm_va_block_t *va_block,
     // For PTE merge/split computation, compute all resident pages which will
     // have exactly prot_to_revoke-1 after performing the revocation.
     uvm_page_mask_andnot(&block_context->scratch_page_mask, &gpu_state->pte_bits[prot_pte_bit], pages_to_revoke);
-    uvm_page_mask_andnot(&block_context->scratch_page_mask,
-                         &gpu_state->pte_bits[prot_pte_bit - 1],
-                         &block_context->scratch_page_mask);
-    uvm_page_mask_and(&block_context->scratch_page_mask, &block_context->scratch_page_mask, resident_mask);
+    uvm_page_mask_and_andnot(&block_context->scratch_page_mask,
+                             &gpu_state->pte_bits[prot_pte_bit - 1],
+                             resident_mask,
+                             &block_context->scratch_page_mask);
 
     block_gpu_compute_new_pte_state(va_block,
                                     gpu,
@@ -9433,8 +9754,7 @@ static void block_unmap_gpu_egm_mappings(uvm_va_block_t *va_block,
                                                                           UVM_ID_CPU,
                                                                           gpu1->parent->closest_cpu_numa_node);
 
-        if (uvm_page_mask_andnot(unmap_page_mask, resident1, resident0) &&
-            uvm_page_mask_and(unmap_page_mask, unmap_page_mask, &gpu_state0->egm_pages)) {
+        if (uvm_page_mask_and_andnot(unmap_page_mask, resident1, &gpu_state0->egm_pages, resident0)) {
             NV_STATUS status = block_unmap_gpu(va_block, block_context, gpu0, unmap_page_mask, tracker);
 
             if (status != NV_OK) {
@@ -9849,6 +10169,8 @@ void uvm_va_block_munmap_region(uvm_va_block_t *va_block,
         if (uvm_page_mask_empty(&gpu_state->evicted))
             uvm_processor_mask_clear(&va_block->evicted_gpus, gpu_id);
 
+        uvm_page_mask_region_clear(&gpu_state->read_duplicate_write_invalidated, region);
+
         if (gpu_state->chunks) {
             block_gpu_release_region(va_block, gpu_id, gpu_state, region);
 
@@ -10612,6 +10934,8 @@ static void block_split_cpu(uvm_va_block_t *existing, uvm_va_block_t *new)
     block_split_page_mask(&existing->cpu.resident, existing_pages, &new->cpu.resident, new_pages);
     new->cpu.ever_mapped = existing->cpu.ever_mapped;
 
+    block_cpu_fault_snapshot_clear(existing);
+
     for (pte_bit = 0; pte_bit < UVM_PTE_BITS_CPU_MAX; pte_bit++)
         block_split_page_mask(&existing->cpu.pte_bits[pte_bit], existing_pages, &new->cpu.pte_bits[pte_bit], new_pages);
 }
@@ -10862,6 +11186,10 @@ static void block_split_gpu(uvm_va_block_t *existing, uvm_va_block_t *new, uvm_g
     }
 
     block_split_page_mask(&existing_gpu_state->evicted, existing_pages, &new_gpu_state->evicted, new_pages);
+    block_split_page_mask(&existing_gpu_state->read_duplicate_write_invalidated,
+                          existing_pages,
+                          &new_gpu_state->read_duplicate_write_invalidated,
+                          new_pages);
 }
 
 NV_STATUS uvm_va_block_split(uvm_va_block_t *existing_va_block,
@@ -11925,6 +12253,64 @@ static void uvm_va_block_get_prefetch_hint(uvm_va_block_t *va_block,
     }
 }
 
+// Add the pages whose read duplicate on the faulting GPU was invalidated by a
+// write to the pages read duplicated by the fault, so they are re-duplicated
+// in a single batch. See uvm_va_policy_t::read_duplication_write_tracking.
+static void block_add_write_invalidated_read_duplicates(uvm_va_block_t *va_block,
+                                                        const uvm_va_policy_t *policy,
+                                                        uvm_processor_id_t processor_id,
+                                                        uvm_service_block_context_t *service_context)
+{
+    uvm_va_space_t *va_space = uvm_va_block_get_va_space(va_block);
+    uvm_va_block_gpu_state_t *gpu_state;
+    uvm_page_mask_t *invalidated_mask;
+    uvm_page_mask_t *new_residency_mask;
+    uvm_page_index_t page_index;
+
+    if (!policy->read_duplication_write_tracking || !uvm_va_policy_is_read_duplicate(policy, va_space))
+        return;
+
+    if (UVM_ID_IS_CPU(processor_id) || service_context->operation == UVM_SERVICE_OPERATION_ACCESS_COUNTERS)
+        return;
+
+    // Only piggyback on faults which make pages resident on the faulting GPU,
+    // which is what read faults on read duplicated pages do.
+    if (uvm_processor_mask_get_count(&service_context->resident_processors) != 1 ||
+        !uvm_processor_mask_test(&service_context->resident_processors, processor_id))
+        return;
+
+    gpu_state = uvm_va_block_gpu_state_get(va_block, processor_id);
+    if (!gpu_state)
+        return;
+
+    // Drop the pages which are already resident on the GPU again
+    invalidated_mask = &gpu_state->read_duplicate_write_invalidated;
+    if (!uvm_page_mask_andnot(invalidated_mask, invalidated_mask, &gpu_state->resident))
+        return;
+
+    new_residency_mask = &service_context->per_processor_masks[uvm_id_value(processor_id)].new_residency;
+
+    for_each_va_block_page_in_mask(page_index, invalidated_mask, va_block) {
+        if (uvm_page_mask_test(new_residency_mask, page_index))
+            continue;
+
+        // The page may have been freed, for example by a discard
+        if (!block_is_page_resident_anywhere(va_block, page_index))
+            continue;
+
+        service_context->access_type[page_index] = UVM_FAULT_ACCESS_TYPE_PREFETCH;
+
+        if (service_context->read_duplicate_count++ == 0)
+            uvm_page_mask_zero(&service_context->read_duplicate_mask);
+
+        uvm_page_mask_set(&service_context->read_duplicate_mask, page_index);
+        uvm_page_mask_set(new_residency_mask, page_index);
+    }
+
+    uvm_page_mask_zero(invalidated_mask);
+    service_context->region = uvm_va_block_region_from_mask(va_block, new_residency_mask);
+}
+
 NV_STATUS uvm_va_block_service_copy(uvm_processor_id_t processor_id,
                                     uvm_processor_id_t new_residency,
                                     uvm_va_block_t *va_block,
@@ -12425,6 +12811,7 @@ NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id,
                                       uvm_service_block_context_t *service_context)
 {
     uvm_va_space_t *va_space = uvm_va_block_get_va_space(va_block);
+    const uvm_va_policy_t *policy;
     uvm_processor_id_t new_residency;
     NV_STATUS status = NV_OK;
 
@@ -12444,9 +12831,12 @@ NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id,
     else
         uvm_assert_rwsem_locked_read(&va_space->lock);
 
-    uvm_va_block_get_prefetch_hint(va_block,
-                                   uvm_va_policy_get_region(va_block, service_context->region),
-                                   service_context);
+    policy = uvm_va_policy_get_region(va_block, service_context->region);
+
+    uvm_va_block_get_prefetch_hint(va_block, policy, service_context);
+
+    if (!uvm_va_block_is_hmm(va_block))
+        block_add_write_invalidated_read_duplicates(va_block, policy, processor_id, service_context);
 
     for_each_id_in_mask(new_residency, &service_context->resident_processors) {
         if (uvm_va_block_is_hmm(va_block)) {
@@ -12468,6 +12858,8 @@ NV_STATUS uvm_va_block_service_locked(uvm_processor_id_t processor_id,
         status = uvm_va_block_service_finish(processor_id, va_block, service_context);
         if (status != NV_OK)
             break;
+
+        uvm_va_block_mark_memory_accessed(va_block, new_residency);
     }
 
     return status;
@@ -12780,6 +13172,90 @@ static bool skip_cpu_fault_with_valid_permissions(uvm_va_block_t *va_block,
     return false;
 }
 
+// Publish the current CPU residency and mappings of the block in its CPU fault
+// snapshot.
+static void block_cpu_fault_snapshot_publish(uvm_va_block_t *va_block)
+{
+    uvm_pte_bits_cpu_t pte_bit;
+
+    uvm_assert_mutex_locked(&va_block->lock);
+
+    // HMM CPU mappings are managed by the kernel, see
+    // skip_cpu_fault_with_valid_permissions().
+    if (uvm_va_block_is_hmm(va_block))
+        return;
+
+    preempt_disable();
+    write_seqcount_begin(&va_block->cpu.fault_snapshot.seq);
+
+    uvm_page_mask_copy(&va_block->cpu.fault_snapshot.resident, &va_block->cpu.resident);
+    for (pte_bit = 0; pte_bit < UVM_PTE_BITS_CPU_MAX; pte_bit++)
+        uvm_page_mask_copy(&va_block->cpu.fault_snapshot.pte_bits[pte_bit], &va_block->cpu.pte_bits[pte_bit]);
+
+    write_seqcount_end(&va_block->cpu.fault_snapshot.seq);
+    preempt_enable();
+
+    atomic_set(&va_block->cpu.fault_snapshot.num_fast_faults, 0);
+}
+
+// Returns true if the snapshot has the page resident on the CPU and mapped
+// with at least the given protection.
+static bool block_cpu_fault_snapshot_test(uvm_va_block_t *va_block, uvm_page_index_t page_index, uvm_prot_t prot)
+{
+    uvm_pte_bits_cpu_t pte_bit = get_cpu_pte_bit_index(prot);
+    unsigned seq;
+    bool mapped;
+
+    do {
+        seq = read_seqcount_begin(&va_block->cpu.fault_snapshot.seq);
+        mapped = uvm_page_mask_test(&va_block->cpu.fault_snapshot.resident, page_index) &&
+                 uvm_page_mask_test(&va_block->cpu.fault_snapshot.pte_bits[pte_bit], page_index);
+    } while (read_seqcount_retry(&va_block->cpu.fault_snapshot.seq, seq));
+
+    return mapped;
+}
+
+// Try to resolve a CPU fault without taking the block lock. This is only
+// possible if the page is already resident on the CPU and mapped with the
+// required permissions, which happens when several threads race to fault on
+// the same page or when the fault was already serviced by a retry.
+//
+// Like skip_cpu_fault_with_valid_permissions(), this needs to handle the kernel
+// downgrading the mappings behind our back: a thread faulting twice in a row on
+// the same page, or too many faults resolved in a row, send the fault to the
+// regular path.
+//
+// Returns true if the fault was resolved.
+static bool block_cpu_fault_fast_path(uvm_va_block_t *va_block,
+                                      NvU64 fault_addr,
+                                      uvm_fault_access_type_t fault_access_type)
+{
+    uvm_va_space_t *va_space = uvm_va_block_get_va_space(va_block);
+    uvm_page_index_t page_index;
+    NvU64 fault_key;
+
+    if (!uvm_perf_cpu_fault_fast_path || uvm_va_block_is_hmm(va_block))
+        return false;
+
+    // Tools expect an event for every CPU fault, which is only recorded with
+    // the block lock held.
+    if (va_space->tools.enabled)
+        return false;
+
+    page_index = uvm_va_block_cpu_page_index(va_block, fault_addr);
+    if (!block_cpu_fault_snapshot_test(va_block, page_index, uvm_fault_access_type_to_prot(fault_access_type)))
+        return false;
+
+    fault_key = ((NvU64)(NvU32)current->pid << 32) | page_index;
+    if (atomic64_xchg(&va_block->cpu.fault_snapshot.last_fault, fault_key) == fault_key)
+        return false;
+
+    if (atomic_inc_return(&va_block->cpu.fault_snapshot.num_fast_faults) > UVM_CPU_FAULT_FAST_PATH_MAX_FAULTS)
+        return false;
+
+    return true;
+}
+
 static NV_STATUS block_cpu_fault_locked(uvm_va_block_t *va_block,
                                         uvm_va_block_retry_t *va_block_retry,
                                         NvU64 fault_addr,
@@ -12837,8 +13313,10 @@ static NV_STATUS block_cpu_fault_locked(uvm_va_block_t *va_block,
     uvm_processor_mask_zero(&service_context->cpu_fault.gpus_to_check_for_ecc);
     uvm_processor_mask_zero(&service_context->gpus_to_check_for_nvlink_errors);
 
-    if (skip_cpu_fault_with_valid_permissions(va_block, page_index, fault_access_type))
+    if (skip_cpu_fault_with_valid_permissions(va_block, page_index, fault_access_type)) {
+        block_cpu_fault_snapshot_publish(va_block);
         return NV_OK;
+    }
 
     thrashing_hint = uvm_perf_thrashing_get_hint(va_block, service_context->block_context, fault_addr, UVM_ID_CPU);
     // Throttling is implemented by sleeping in the fault handler on the CPU
@@ -12893,6 +13371,9 @@ static NV_STATUS block_cpu_fault_locked(uvm_va_block_t *va_block,
     status = uvm_va_block_service_locked(UVM_ID_CPU, va_block, va_block_retry, service_context);
     UVM_ASSERT(status != NV_WARN_MISMATCHED_TARGET);
 
+    if (status == NV_OK)
+        block_cpu_fault_snapshot_publish(va_block);
+
 out:
     ++service_context->num_retries;
 
@@ -12915,6 +13396,14 @@ NV_STATUS uvm_va_block_cpu_fault(uvm_va_block_t *va_block,
 
     service_context->cpu_fault.did_migrate = false;
 
+    // Spurious faults on pages that are already mapped don't need the block
+    // lock.
+    if (service_context->num_retries == 0 && block_cpu_fault_fast_path(va_block, fault_addr, fault_access_type)) {
+        uvm_processor_mask_zero(&service_context->cpu_fault.gpus_to_check_for_ecc);
+        uvm_processor_mask_zero(&service_context->gpus_to_check_for_nvlink_errors);
+        return NV_OK;
+    }
+
     // We have to use vm_insert_page instead of handing the page to the kernel
     // and letting it insert the mapping, and we must do that while holding the
     // lock on this VA block. Otherwise there will be a window in which we think
@@ -14171,6 +14660,172 @@ out:
     return status;
 }
 
+typedef struct
+{
+    uvm_va_block_t *va_block;
+    uvm_page_index_t page_index;
+    uvm_prot_t prot;
+    NvU32 num_threads;
+    NvU32 iterations;
+    bool fast_path;
+
+    // Number of threads that started, used to run the lookups concurrently
+    atomic_t started;
+
+    atomic64_t total_ns;
+    atomic64_t hits;
+} cpu_fault_bench_t;
+
+typedef struct
+{
+    nv_kthread_q_t q;
+    nv_kthread_q_item_t q_item;
+    cpu_fault_bench_t *bench;
+} cpu_fault_bench_thread_t;
+
+// Look up the CPU mapping of the benchmarked page the way a CPU fault on it
+// would, either with the snapshot or with the block lock.
+static void cpu_fault_bench_thread(void *args)
+{
+    cpu_fault_bench_thread_t *thread = (cpu_fault_bench_thread_t *)args;
+    cpu_fault_bench_t *bench = thread->bench;
+    uvm_va_block_t *va_block = bench->va_block;
+    NvU64 hits = 0;
+    NvU64 start;
+    NvU32 i;
+
+    atomic_inc(&bench->started);
+    while (atomic_read(&bench->started) < bench->num_threads)
+        cond_resched();
+
+    start = NV_GETTIME();
+
+    for (i = 0; i < bench->iterations; i++) {
+        bool mapped;
+
+        if (bench->fast_path) {
+            mapped = block_cpu_fault_snapshot_test(va_block, bench->page_index, bench->prot);
+        }
+        else {
+            uvm_mutex_lock(&va_block->lock);
+            mapped = block_page_is_processor_authorized(va_block, bench->page_index, UVM_ID_CPU, bench->prot);
+            uvm_mutex_unlock(&va_block->lock);
+        }
+
+        if (mapped)
+            hits++;
+    }
+
+    atomic64_add(NV_GETTIME() - start, &bench->total_ns);
+    atomic64_add(hits, &bench->hits);
+}
+
+static void cpu_fault_bench_thread_entry(void *args)
+{
+    UVM_ENTRY_VOID(cpu_fault_bench_thread(args));
+}
+
+static NV_STATUS cpu_fault_bench_run(cpu_fault_bench_thread_t *threads, cpu_fault_bench_t *bench, bool fast_path)
+{
+    NvU32 i;
+
+    bench->fast_path = fast_path;
+    atomic_set(&bench->started, 0);
+    atomic64_set(&bench->total_ns, 0);
+    atomic64_set(&bench->hits, 0);
+
+    for (i = 0; i < bench->num_threads; i++) {
+        if (!nv_kthread_q_schedule_q_item(&threads[i].q, &threads[i].q_item))
+            return NV_ERR_INVALID_STATE;
+    }
+
+    for (i = 0; i < bench->num_threads; i++)
+        nv_kthread_q_flush(&threads[i].q);
+
+    return NV_OK;
+}
+
+NV_STATUS uvm_test_va_block_cpu_fault_bench(UVM_TEST_VA_BLOCK_CPU_FAULT_BENCH_PARAMS *params, struct file *filp)
+{
+    uvm_va_space_t *va_space = uvm_va_space_get(filp);
+    uvm_va_block_t *va_block;
+    cpu_fault_bench_thread_t *threads;
+    cpu_fault_bench_t bench;
+    NvU64 num_lookups;
+    NvU32 num_started = 0;
+    NV_STATUS status;
+    NvU32 i;
+
+    if (params->num_threads == 0 ||
+        params->num_threads > UVM_TEST_VA_BLOCK_CPU_FAULT_BENCH_MAX_THREADS ||
+        params->iterations == 0)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    threads = uvm_kvmalloc_zero(sizeof(*threads) * params->num_threads);
+    if (!threads)
+        return NV_ERR_NO_MEMORY;
+
+    // The threads rely on the VA space lock held here to keep the block alive
+    uvm_va_space_down_read(va_space);
+
+    status = uvm_va_block_find(va_space, params->lookup_address, &va_block);
+    if (status != NV_OK)
+        goto out;
+
+    if (uvm_va_block_is_hmm(va_block)) {
+        status = NV_ERR_INVALID_ADDRESS;
+        goto out;
+    }
+
+    memset(&bench, 0, sizeof(bench));
+    bench.va_block = va_block;
+    bench.page_index = uvm_va_block_cpu_page_index(va_block, params->lookup_address);
+    bench.prot = params->write ? UVM_PROT_READ_WRITE : UVM_PROT_READ_ONLY;
+    bench.num_threads = params->num_threads;
+    bench.iterations = params->iterations;
+
+    uvm_mutex_lock(&va_block->lock);
+    block_cpu_fault_snapshot_publish(va_block);
+    uvm_mutex_unlock(&va_block->lock);
+
+    for (i = 0; i < params->num_threads; i++) {
+        if (nv_kthread_q_init(&threads[i].q, "uvm_fault_bench") != 0) {
+            status = NV_ERR_NO_MEMORY;
+            goto stop;
+        }
+
+        nv_kthread_q_item_init(&threads[i].q_item, cpu_fault_bench_thread_entry, &threads[i]);
+        threads[i].bench = &bench;
+        num_started++;
+    }
+
+    num_lookups = (NvU64)params->num_threads * params->iterations;
+
+    status = cpu_fault_bench_run(threads, &bench, false);
+    if (status != NV_OK)
+        goto stop;
+
+    params->locked_path_ns = atomic64_read(&bench.total_ns) / num_lookups;
+    params->locked_path_hits = atomic64_read(&bench.hits);
+
+    status = cpu_fault_bench_run(threads, &bench, true);
+    if (status != NV_OK)
+        goto stop;
+
+    params->fast_path_ns = atomic64_read(&bench.total_ns) / num_lookups;
+    params->fast_path_hits = atomic64_read(&bench.hits);
+
+stop:
+    for (i = 0; i < num_started; i++)
+        nv_kthread_q_stop(&threads[i].q);
+
+out:
+    uvm_va_space_up_read(va_space);
+    uvm_kvfree(threads);
+
+    return status;
+}
+
 void uvm_va_block_mark_cpu_dirty(uvm_va_block_t *va_block)
 {
     block_mark_region_cpu_dirty(va_block, uvm_va_block_region_from_block(va_block));
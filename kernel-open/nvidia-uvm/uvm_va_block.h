@@ -111,6 +111,13 @@ typedef struct
     // Pages that have been evicted to sysmem
     uvm_page_mask_t evicted;
 
+    // Pages whose read duplicate on this GPU was invalidated by a write from
+    // another processor, in a VA range with read_duplication_write_tracking
+    // set. They are re-duplicated in a batch on the next read fault from this
+    // GPU to the block. Bits of pages which are resident on this GPU again, or
+    // not resident anywhere, are stale and ignored.
+    uvm_page_mask_t read_duplicate_write_invalidated;
+
     // Array of naturally-aligned chunks. Each chunk has the largest possible
     // size which can fit within the block, so they are not uniform size.
     //
@@ -441,6 +448,36 @@ struct uvm_va_block_struct
             // Index of the page whose faults are being tracked
             uvm_page_index_t  page_index;
         } fault_authorized;
+
+        // Snapshot of the CPU residency and mappings, used to resolve CPU
+        // faults on pages that are already resident and mapped with the
+        // required permissions without taking the block lock. See
+        // block_cpu_fault_fast_path() in uvm_va_block.c.
+        //
+        // The masks are only written with the block lock held, within a
+        // write section of seq. They are published after a CPU fault is
+        // serviced, and cleared whenever CPU residency or mappings are
+        // removed, so they are always a subset of cpu.resident and
+        // cpu.pte_bits when the block lock is released.
+        struct
+        {
+            seqcount_t        seq;
+
+            uvm_page_mask_t   resident;
+
+            uvm_page_mask_t   pte_bits[UVM_PTE_BITS_CPU_MAX];
+
+            // Last fault resolved in the fast path, as the faulting pid in
+            // the upper 32 bits and the page index in the lower ones. Like
+            // fault_authorized, a second fault from the same thread on the
+            // same page means the kernel downgraded the mapping.
+            atomic64_t        last_fault;
+
+            // Number of faults resolved in the fast path since the last
+            // publication. Bounds how long a stale mapping can be missed when
+            // several threads fault on it.
+            atomic_t          num_fast_faults;
+        } fault_snapshot;
     } cpu;
 
     // Per-GPU residency and mapping state
@@ -1609,6 +1646,7 @@ NV_STATUS uvm_test_va_residency_info(UVM_TEST_VA_RESIDENCY_INFO_PARAMS *params,
 NV_STATUS uvm_test_va_block_discard_status(UVM_TEST_VA_BLOCK_DISCARD_STATUS_PARAMS *params, struct file *filp);
 NV_STATUS uvm_test_va_block_discard_check_pmm_state(UVM_TEST_VA_BLOCK_DISCARD_CHECK_PMM_STATE_PARAMS *params,
                                                     struct file *filp);
+NV_STATUS uvm_test_va_block_cpu_fault_bench(UVM_TEST_VA_BLOCK_CPU_FAULT_BENCH_PARAMS *params, struct file *filp);
 
 // Compute the offset in system pages of addr from the start of va_block.
 static uvm_page_index_t uvm_va_block_cpu_page_index(uvm_va_block_t *va_block, NvU64 addr)
@@ -1631,6 +1669,14 @@ size_t uvm_va_block_gpu_chunk_index_range(NvU64 start,
 // If there are any resident CPU pages in the block, mark them as dirty
 void uvm_va_block_mark_cpu_dirty(uvm_va_block_t *va_block);
 
+// Let the eviction policy of the given GPU know that the memory of the block
+// resident on it was accessed. This is a no-op for the CPU, for processors on
+// which the block is not resident and for blocks whose GPU memory is not
+// tracked by root chunk (see uvm_pmm_gpu_mark_root_chunk_accessed()).
+//
+// LOCKING: The caller must hold the va_block lock.
+void uvm_va_block_mark_memory_accessed(uvm_va_block_t *va_block, uvm_processor_id_t id);
+
 // Sets the internal state required to handle fault cancellation
 //
 // This function may require allocating page tables to split big pages into 4K
@@ -1922,6 +1968,149 @@ static bool uvm_page_mask_intersects(const uvm_page_mask_t *mask1, const uvm_pag
     return bitmap_intersects(mask1->bitmap, mask2->bitmap, PAGES_PER_UVM_VA_BLOCK);
 }
 
+// Fused page mask operations
+//
+// Chaining the two-operand helpers above to combine three masks writes out the
+// intermediate mask and reads it back for the second operation. The helpers
+// below compute the whole expression in a single pass over the
+// UVM_PAGE_MASK_WORDS words of the bitmaps instead. The loops have a constant
+// trip count and no cross-word dependencies, so the compiler can unroll and
+// vectorize them where the kernel allows it.
+//
+// Like uvm_page_mask_and(), the helpers producing a mask return whether the
+// resulting mask has any page set. mask_out may alias any of the inputs.
+
+// Mask of the bits of the given bitmap word that correspond to pages. Only the
+// last word can be partial, when PAGE_SIZE is 64K.
+static unsigned long uvm_page_mask_word_valid_bits(size_t word_index)
+{
+    if (word_index == UVM_PAGE_MASK_WORDS - 1)
+        return BITMAP_LAST_WORD_MASK(PAGES_PER_UVM_VA_BLOCK);
+
+    return ~0UL;
+}
+
+// mask_out = mask_in1 & mask_in2 & mask_in3
+static bool uvm_page_mask_and3(uvm_page_mask_t *mask_out,
+                               const uvm_page_mask_t *mask_in1,
+                               const uvm_page_mask_t *mask_in2,
+                               const uvm_page_mask_t *mask_in3)
+{
+    unsigned long result = 0;
+    size_t i;
+
+    for (i = 0; i < UVM_PAGE_MASK_WORDS; i++) {
+        mask_out->bitmap[i] = mask_in1->bitmap[i] & mask_in2->bitmap[i] & mask_in3->bitmap[i];
+        result |= mask_out->bitmap[i] & uvm_page_mask_word_valid_bits(i);
+    }
+
+    return result != 0;
+}
+
+// mask_out = mask_in1 & mask_in2 & ~mask_in3
+static bool uvm_page_mask_and_andnot(uvm_page_mask_t *mask_out,
+                                     const uvm_page_mask_t *mask_in1,
+                                     const uvm_page_mask_t *mask_in2,
+                                     const uvm_page_mask_t *mask_in3)
+{
+    unsigned long result = 0;
+    size_t i;
+
+    for (i = 0; i < UVM_PAGE_MASK_WORDS; i++) {
+        mask_out->bitmap[i] = mask_in1->bitmap[i] & mask_in2->bitmap[i] & ~mask_in3->bitmap[i];
+        result |= mask_out->bitmap[i] & uvm_page_mask_word_valid_bits(i);
+    }
+
+    return result != 0;
+}
+
+// mask_out = mask_in1 & ~mask_in2 & ~mask_in3
+static bool uvm_page_mask_andnot2(uvm_page_mask_t *mask_out,
+                                  const uvm_page_mask_t *mask_in1,
+                                  const uvm_page_mask_t *mask_in2,
+                                  const uvm_page_mask_t *mask_in3)
+{
+    unsigned long result = 0;
+    size_t i;
+
+    for (i = 0; i < UVM_PAGE_MASK_WORDS; i++) {
+        mask_out->bitmap[i] = mask_in1->bitmap[i] & ~(mask_in2->bitmap[i] | mask_in3->bitmap[i]);
+        result |= mask_out->bitmap[i] & uvm_page_mask_word_valid_bits(i);
+    }
+
+    return result != 0;
+}
+
+// Number of pages set in mask_in1 & mask_in2, without storing the intersection
+static NvU32 uvm_page_mask_and_weight(const uvm_page_mask_t *mask_in1, const uvm_page_mask_t *mask_in2)
+{
+    NvU32 weight = 0;
+    size_t i;
+
+    for (i = 0; i < UVM_PAGE_MASK_WORDS; i++)
+        weight += hweight_long(mask_in1->bitmap[i] & mask_in2->bitmap[i] & uvm_page_mask_word_valid_bits(i));
+
+    return weight;
+}
+
+// Number of pages set in mask_in1 & ~mask_in2, without storing the difference
+static NvU32 uvm_page_mask_andnot_weight(const uvm_page_mask_t *mask_in1, const uvm_page_mask_t *mask_in2)
+{
+    NvU32 weight = 0;
+    size_t i;
+
+    for (i = 0; i < UVM_PAGE_MASK_WORDS; i++)
+        weight += hweight_long(mask_in1->bitmap[i] & ~mask_in2->bitmap[i] & uvm_page_mask_word_valid_bits(i));
+
+    return weight;
+}
+
+// Return the first run of contiguous set pages of page_mask within region that
+// starts at or after first. If there is none, an empty region starting at
+// region.outer is returned.
+//
+// Unlike a find_next_bit()/find_next_zero_bit() pair, the end of the run is
+// looked for starting from the bitmap word in which the run starts, and whole
+// words of set pages are skipped with a single comparison.
+static uvm_va_block_region_t uvm_page_mask_next_run(const uvm_page_mask_t *page_mask,
+                                                    uvm_va_block_region_t region,
+                                                    uvm_page_index_t first)
+{
+    uvm_va_block_region_t run = { .first = region.outer, .outer = region.outer };
+    size_t word_index;
+    unsigned long word;
+
+    UVM_ASSERT(region.outer <= PAGES_PER_UVM_VA_BLOCK);
+
+    if (first >= region.outer)
+        return run;
+
+    word_index = BIT_WORD(first);
+    word = page_mask->bitmap[word_index] & BITMAP_FIRST_WORD_MASK(first);
+    while (!word) {
+        if (++word_index * BITS_PER_LONG >= region.outer)
+            return run;
+
+        word = page_mask->bitmap[word_index];
+    }
+
+    run.first = min_t(size_t, word_index * BITS_PER_LONG + __ffs(word), region.outer);
+    if (run.first == region.outer)
+        return run;
+
+    word = ~page_mask->bitmap[word_index] & BITMAP_FIRST_WORD_MASK(run.first);
+    while (!word) {
+        if (++word_index * BITS_PER_LONG >= region.outer)
+            return run;
+
+        word = ~page_mask->bitmap[word_index];
+    }
+
+    run.outer = min_t(size_t, word_index * BITS_PER_LONG + __ffs(word), region.outer);
+
+    return run;
+}
+
 // Print the given page mask on the given buffer using hex symbols. The
 // minimum required size of the buffer is UVM_PAGE_MASK_PRINT_MIN_BUFFER_SIZE.
 static void uvm_page_mask_print(const uvm_page_mask_t *mask, char *buffer)
@@ -1957,14 +2146,10 @@ static void uvm_page_mask_print(const uvm_page_mask_t *mask, char *buffer)
 static uvm_va_block_region_t uvm_va_block_first_subregion_in_mask(uvm_va_block_region_t region,
                                                                   const uvm_page_mask_t *page_mask)
 {
-    uvm_va_block_region_t subregion;
-
     if (!page_mask)
         return region;
 
-    subregion.first = find_next_bit(page_mask->bitmap, region.outer, region.first);
-    subregion.outer = find_next_zero_bit(page_mask->bitmap, region.outer, subregion.first + 1);
-    return subregion;
+    return uvm_page_mask_next_run(page_mask, region, region.first);
 }
 
 static uvm_va_block_region_t uvm_va_block_next_subregion_in_mask(uvm_va_block_region_t region,
@@ -1979,9 +2164,7 @@ static uvm_va_block_region_t uvm_va_block_next_subregion_in_mask(uvm_va_block_re
         return subregion;
     }
 
-    subregion.first = find_next_bit(page_mask->bitmap, region.outer, previous_subregion.outer + 1);
-    subregion.outer = find_next_zero_bit(page_mask->bitmap, region.outer, subregion.first + 1);
-    return subregion;
+    return uvm_page_mask_next_run(page_mask, region, previous_subregion.outer + 1);
 }
 
 // Iterate over contiguous subregions of the region given by the page mask.
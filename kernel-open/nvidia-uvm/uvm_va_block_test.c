@@ -25,6 +25,8 @@
 #include "uvm_linux.h"
 #include "uvm_test.h"
 #include "uvm_test_ioctl.h"
+#include "uvm_test_rng.h"
+#include "uvm_kvmalloc.h"
 #include "uvm_va_block.h"
 #include "uvm_va_space.h"
 #include "uvm_mmu.h"
@@ -110,3 +112,305 @@ out:
     uvm_va_space_up_read(va_space);
     return status;
 }
+
+// Number of random masks cycled through by the page mask benchmark
+#define PAGE_MASK_BENCH_NUM_MASKS 64
+
+static void page_mask_test_fill_random(uvm_test_rng_t *rng, uvm_page_mask_t *mask)
+{
+    uvm_va_block_region_t region;
+    NvU32 count;
+
+    // Besides uniformly random bits, generate the sparse and run-heavy masks
+    // which residency and mapping masks usually look like. When PAGE_SIZE is
+    // 64K, uvm_test_rng_memset() also fills the unused upper bits of the
+    // bitmap, which the fused operations must ignore.
+    switch (uvm_test_rng_range_32(rng, 0, 4)) {
+        case 0:
+            uvm_page_mask_zero(mask);
+            break;
+        case 1:
+            uvm_page_mask_fill(mask);
+            break;
+        case 2:
+            uvm_test_rng_memset(rng, mask, sizeof(*mask));
+            break;
+        case 3:
+            uvm_page_mask_zero(mask);
+            for (count = uvm_test_rng_range_32(rng, 1, 8); count > 0; count--)
+                uvm_page_mask_set(mask, uvm_test_rng_range_32(rng, 0, PAGES_PER_UVM_VA_BLOCK - 1));
+            break;
+        default:
+            uvm_page_mask_zero(mask);
+            for (count = uvm_test_rng_range_32(rng, 1, 4); count > 0; count--) {
+                region.first = uvm_test_rng_range_32(rng, 0, PAGES_PER_UVM_VA_BLOCK - 1);
+                region.outer = uvm_test_rng_range_32(rng, region.first + 1, PAGES_PER_UVM_VA_BLOCK);
+                uvm_page_mask_region_fill(mask, region);
+            }
+            break;
+    }
+}
+
+// The run lookup uvm_va_block_first_subregion_in_mask() used to do with a
+// find_next_bit()/find_next_zero_bit() pair
+static uvm_va_block_region_t page_mask_test_bit_run(const uvm_page_mask_t *mask,
+                                                    uvm_va_block_region_t region,
+                                                    uvm_page_index_t first)
+{
+    uvm_va_block_region_t run;
+
+    run.first = find_next_bit(mask->bitmap, region.outer, first);
+    run.outer = find_next_zero_bit(mask->bitmap, region.outer, run.first);
+
+    return run;
+}
+
+static NV_STATUS page_mask_test_ops(const uvm_page_mask_t *in1,
+                                    const uvm_page_mask_t *in2,
+                                    const uvm_page_mask_t *in3)
+{
+    uvm_page_mask_t expected;
+    uvm_page_mask_t result;
+    bool expected_nonempty;
+
+    // in1 & in2 & in3
+    uvm_page_mask_and(&expected, in1, in2);
+    expected_nonempty = uvm_page_mask_and(&expected, &expected, in3);
+    TEST_CHECK_RET(uvm_page_mask_and3(&result, in1, in2, in3) == expected_nonempty);
+    TEST_CHECK_RET(uvm_page_mask_equal(&result, &expected));
+    uvm_page_mask_copy(&result, in1);
+    TEST_CHECK_RET(uvm_page_mask_and3(&result, &result, in2, in3) == expected_nonempty);
+    TEST_CHECK_RET(uvm_page_mask_equal(&result, &expected));
+
+    // in1 & in2 & ~in3
+    uvm_page_mask_and(&expected, in1, in2);
+    expected_nonempty = uvm_page_mask_andnot(&expected, &expected, in3);
+    TEST_CHECK_RET(uvm_page_mask_and_andnot(&result, in1, in2, in3) == expected_nonempty);
+    TEST_CHECK_RET(uvm_page_mask_equal(&result, &expected));
+    uvm_page_mask_copy(&result, in3);
+    TEST_CHECK_RET(uvm_page_mask_and_andnot(&result, in1, in2, &result) == expected_nonempty);
+    TEST_CHECK_RET(uvm_page_mask_equal(&result, &expected));
+
+    // in1 & ~in2 & ~in3
+    uvm_page_mask_andnot(&expected, in1, in2);
+    expected_nonempty = uvm_page_mask_andnot(&expected, &expected, in3);
+    TEST_CHECK_RET(uvm_page_mask_andnot2(&result, in1, in2, in3) == expected_nonempty);
+    TEST_CHECK_RET(uvm_page_mask_equal(&result, &expected));
+    uvm_page_mask_copy(&result, in1);
+    TEST_CHECK_RET(uvm_page_mask_andnot2(&result, &result, in2, in3) == expected_nonempty);
+    TEST_CHECK_RET(uvm_page_mask_equal(&result, &expected));
+
+    // Weights
+    uvm_page_mask_and(&expected, in1, in2);
+    TEST_CHECK_RET(uvm_page_mask_and_weight(in1, in2) == uvm_page_mask_weight(&expected));
+    uvm_page_mask_andnot(&expected, in1, in2);
+    TEST_CHECK_RET(uvm_page_mask_andnot_weight(in1, in2) == uvm_page_mask_weight(&expected));
+
+    return NV_OK;
+}
+
+static NV_STATUS page_mask_test_runs(const uvm_page_mask_t *mask, uvm_va_block_region_t region)
+{
+    uvm_va_block_region_t subregion;
+    uvm_va_block_region_t expected = page_mask_test_bit_run(mask, region, region.first);
+    NvU32 num_pages = 0;
+
+    for_each_va_block_subregion_in_mask(subregion, mask, region) {
+        TEST_CHECK_RET(subregion.first == expected.first);
+        TEST_CHECK_RET(subregion.outer == expected.outer);
+        TEST_CHECK_RET(subregion.first < subregion.outer);
+
+        num_pages += uvm_va_block_region_num_pages(subregion);
+        expected = page_mask_test_bit_run(mask, region, expected.outer);
+    }
+
+    TEST_CHECK_RET(expected.first == region.outer);
+    TEST_CHECK_RET(num_pages == uvm_page_mask_region_weight(mask, region));
+
+    return NV_OK;
+}
+
+static NV_STATUS page_mask_test_directed(uvm_page_mask_t *masks)
+{
+    uvm_va_block_region_t full = uvm_va_block_region(0, PAGES_PER_UVM_VA_BLOCK);
+    uvm_va_block_region_t region = uvm_va_block_region(1, PAGES_PER_UVM_VA_BLOCK - 1);
+    uvm_va_block_region_t subregion;
+
+    uvm_page_mask_zero(&masks[0]);
+    uvm_page_mask_fill(&masks[1]);
+
+    TEST_CHECK_RET(!uvm_page_mask_and3(&masks[2], &masks[1], &masks[1], &masks[0]));
+    TEST_CHECK_RET(uvm_page_mask_and3(&masks[2], &masks[1], &masks[1], &masks[1]));
+    TEST_CHECK_RET(uvm_page_mask_full(&masks[2]));
+    TEST_CHECK_RET(!uvm_page_mask_and_andnot(&masks[2], &masks[1], &masks[1], &masks[1]));
+    TEST_CHECK_RET(uvm_page_mask_andnot2(&masks[2], &masks[1], &masks[0], &masks[0]));
+    TEST_CHECK_RET(uvm_page_mask_full(&masks[2]));
+    TEST_CHECK_RET(uvm_page_mask_and_weight(&masks[1], &masks[1]) == PAGES_PER_UVM_VA_BLOCK);
+    TEST_CHECK_RET(uvm_page_mask_andnot_weight(&masks[1], &masks[0]) == PAGES_PER_UVM_VA_BLOCK);
+
+    // No runs in an empty mask, a single run covering the region in a full one
+    for_each_va_block_subregion_in_mask(subregion, &masks[0], full)
+        TEST_CHECK_RET(false);
+
+    subregion = uvm_va_block_first_subregion_in_mask(region, &masks[1]);
+    TEST_CHECK_RET(subregion.first == region.first && subregion.outer == region.outer);
+    subregion = uvm_va_block_next_subregion_in_mask(region, &masks[1], subregion);
+    TEST_CHECK_RET(subregion.first == region.outer);
+
+    // Runs touching the first and last pages of the block and, with 4K pages,
+    // runs crossing bitmap words.
+    uvm_page_mask_zero(&masks[2]);
+    uvm_page_mask_set(&masks[2], 0);
+    uvm_page_mask_region_fill(&masks[2], uvm_va_block_region(PAGES_PER_UVM_VA_BLOCK / 2 - 3,
+                                                             PAGES_PER_UVM_VA_BLOCK / 2 + 3));
+    uvm_page_mask_set(&masks[2], PAGES_PER_UVM_VA_BLOCK - 1);
+    TEST_NV_CHECK_RET(page_mask_test_runs(&masks[2], full));
+    TEST_NV_CHECK_RET(page_mask_test_runs(&masks[2], region));
+    TEST_NV_CHECK_RET(page_mask_test_runs(&masks[2], uvm_va_block_region(PAGES_PER_UVM_VA_BLOCK / 2 - 1,
+                                                                         PAGES_PER_UVM_VA_BLOCK / 2 + 1)));
+
+    return NV_OK;
+}
+
+static NV_STATUS page_mask_test_random(uvm_test_rng_t *rng, uvm_page_mask_t *masks, NvU32 iterations)
+{
+    NvU32 i;
+
+    for (i = 0; i < iterations; i++) {
+        uvm_va_block_region_t region;
+
+        if (fatal_signal_pending(current))
+            return NV_ERR_SIGNAL_PENDING;
+
+        page_mask_test_fill_random(rng, &masks[0]);
+        page_mask_test_fill_random(rng, &masks[1]);
+        page_mask_test_fill_random(rng, &masks[2]);
+
+        TEST_NV_CHECK_RET(page_mask_test_ops(&masks[0], &masks[1], &masks[2]));
+
+        region.first = uvm_test_rng_range_32(rng, 0, PAGES_PER_UVM_VA_BLOCK);
+        region.outer = uvm_test_rng_range_32(rng, region.first, PAGES_PER_UVM_VA_BLOCK);
+        TEST_NV_CHECK_RET(page_mask_test_runs(&masks[0], region));
+        TEST_NV_CHECK_RET(page_mask_test_runs(&masks[0], uvm_va_block_region(0, PAGES_PER_UVM_VA_BLOCK)));
+    }
+
+    return NV_OK;
+}
+
+static NV_STATUS page_mask_bench(uvm_test_rng_t *rng, uvm_page_mask_t *masks, UVM_TEST_PAGE_MASK_PARAMS *params)
+{
+    uvm_va_block_region_t full = uvm_va_block_region(0, PAGES_PER_UVM_VA_BLOCK);
+    uvm_page_mask_t *result = &masks[PAGE_MASK_BENCH_NUM_MASKS];
+    NvU64 fused_sum = 0;
+    NvU64 composed_sum = 0;
+    NvU64 start;
+    NvU32 i, j;
+
+    for (j = 0; j < PAGE_MASK_BENCH_NUM_MASKS; j++)
+        page_mask_test_fill_random(rng, &masks[j]);
+
+    start = get_cycles();
+    for (i = 0; i < params->bench_iterations; i++) {
+        if (fatal_signal_pending(current))
+            return NV_ERR_SIGNAL_PENDING;
+
+        for (j = 0; j + 2 < PAGE_MASK_BENCH_NUM_MASKS; j++) {
+            const uvm_page_mask_t *in = &masks[j];
+
+            fused_sum += uvm_page_mask_and3(result, &in[0], &in[1], &in[2]);
+            fused_sum += uvm_page_mask_and_andnot(result, &in[0], &in[1], &in[2]);
+            fused_sum += uvm_page_mask_andnot2(result, &in[0], &in[1], &in[2]);
+            fused_sum += uvm_page_mask_and_weight(&in[0], &in[1]);
+            fused_sum += uvm_page_mask_andnot_weight(&in[0], &in[1]);
+        }
+    }
+    params->fused_cycles = get_cycles() - start;
+
+    start = get_cycles();
+    for (i = 0; i < params->bench_iterations; i++) {
+        if (fatal_signal_pending(current))
+            return NV_ERR_SIGNAL_PENDING;
+
+        for (j = 0; j + 2 < PAGE_MASK_BENCH_NUM_MASKS; j++) {
+            const uvm_page_mask_t *in = &masks[j];
+
+            uvm_page_mask_and(result, &in[0], &in[1]);
+            composed_sum += uvm_page_mask_and(result, result, &in[2]);
+            uvm_page_mask_and(result, &in[0], &in[1]);
+            composed_sum += uvm_page_mask_andnot(result, result, &in[2]);
+            uvm_page_mask_andnot(result, &in[0], &in[1]);
+            composed_sum += uvm_page_mask_andnot(result, result, &in[2]);
+            uvm_page_mask_and(result, &in[0], &in[1]);
+            composed_sum += uvm_page_mask_weight(result);
+            uvm_page_mask_andnot(result, &in[0], &in[1]);
+            composed_sum += uvm_page_mask_weight(result);
+        }
+    }
+    params->composed_cycles = get_cycles() - start;
+
+    TEST_CHECK_RET(fused_sum == composed_sum);
+
+    fused_sum = 0;
+    composed_sum = 0;
+
+    start = get_cycles();
+    for (i = 0; i < params->bench_iterations; i++) {
+        if (fatal_signal_pending(current))
+            return NV_ERR_SIGNAL_PENDING;
+
+        for (j = 0; j < PAGE_MASK_BENCH_NUM_MASKS; j++) {
+            uvm_va_block_region_t subregion;
+
+            for_each_va_block_subregion_in_mask(subregion, &masks[j], full)
+                fused_sum += subregion.outer - subregion.first;
+        }
+    }
+    params->word_run_cycles = get_cycles() - start;
+
+    start = get_cycles();
+    for (i = 0; i < params->bench_iterations; i++) {
+        if (fatal_signal_pending(current))
+            return NV_ERR_SIGNAL_PENDING;
+
+        for (j = 0; j < PAGE_MASK_BENCH_NUM_MASKS; j++) {
+            uvm_va_block_region_t subregion;
+
+            for (subregion = page_mask_test_bit_run(&masks[j], full, 0);
+                 subregion.first != full.outer;
+                 subregion = page_mask_test_bit_run(&masks[j], full, subregion.outer))
+                composed_sum += subregion.outer - subregion.first;
+        }
+    }
+    params->bit_run_cycles = get_cycles() - start;
+
+    TEST_CHECK_RET(fused_sum == composed_sum);
+
+    return NV_OK;
+}
+
+NV_STATUS uvm_test_page_mask(UVM_TEST_PAGE_MASK_PARAMS *params, struct file *filp)
+{
+    uvm_test_rng_t rng;
+    uvm_page_mask_t *masks;
+    NV_STATUS status;
+
+    if (params->bench_iterations > UVM_TEST_PAGE_MASK_MAX_BENCH_ITERATIONS)
+        return NV_ERR_INVALID_ARGUMENT;
+
+    // The benchmark masks plus one output mask. The tests use the first three.
+    masks = uvm_kvmalloc((PAGE_MASK_BENCH_NUM_MASKS + 1) * sizeof(*masks));
+    if (!masks)
+        return NV_ERR_NO_MEMORY;
+
+    uvm_test_rng_init(&rng, params->seed);
+
+    TEST_NV_CHECK_GOTO(page_mask_test_directed(masks), out);
+    TEST_NV_CHECK_GOTO(page_mask_test_random(&rng, masks, params->iterations), out);
+
+    if (params->bench_iterations)
+        TEST_NV_CHECK_GOTO(page_mask_bench(&rng, masks, params), out);
+
+out:
+    uvm_kvfree(masks);
+    return status;
+}
@@ -79,6 +79,14 @@ struct uvm_va_policy_struct
     // their page tables updated to access the (possibly remote) pages.
     uvm_processor_mask_t accessed_by;
 
+    // Write-tracking mode for read duplication. When set, a write to a
+    // read-duplicated page still gives the writer exclusive ownership of the
+    // page, but the GPUs whose duplicates were invalidated remember it, and
+    // re-duplicate all such pages of the VA block in a single batch on their
+    // next read fault to the block, instead of faulting them back one by one.
+    // It has no effect unless read duplication is enabled.
+    bool read_duplication_write_tracking;
+
 };
 
 // Policy nodes are used for storing policies in HMM va_blocks.
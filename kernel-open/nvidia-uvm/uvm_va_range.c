@@ -35,6 +35,7 @@
 #include "uvm_kvmalloc.h"
 #include "uvm_map_external.h"
 #include "uvm_perf_thrashing.h"
+#include "uvm_test.h"
 #include "nv_uvm_interface.h"
 
 static struct kmem_cache *g_uvm_va_range_managed_cache __read_mostly;
@@ -1369,6 +1370,7 @@ NV_STATUS uvm_va_range_split(uvm_va_range_managed_t *existing_managed_range,
     new_policy = &new->policy;
     existing_policy = &existing_managed_range->policy;
     new_policy->read_duplication = existing_policy->read_duplication;
+    new_policy->read_duplication_write_tracking = existing_policy->read_duplication_write_tracking;
     new_policy->preferred_location = existing_policy->preferred_location;
     new_policy->preferred_nid = existing_policy->preferred_nid;
     uvm_processor_mask_copy(&new_policy->accessed_by,
@@ -2196,6 +2198,7 @@ NV_STATUS uvm_test_va_range_info(UVM_TEST_VA_RANGE_INFO_PARAMS *params, struct f
     params->type = va_range->type;
 
     params->read_duplication = 0;
+    params->read_duplication_write_tracking = NV_FALSE;
     memset(&params->preferred_location, 0, sizeof(params->preferred_location));
     params->preferred_cpu_nid = NUMA_NO_NODE;
     params->accessed_by_count = 0;
@@ -2206,6 +2209,7 @@ NV_STATUS uvm_test_va_range_info(UVM_TEST_VA_RANGE_INFO_PARAMS *params, struct f
 
             policy = &managed_range->policy;
             params->read_duplication = policy->read_duplication;
+            params->read_duplication_write_tracking = policy->read_duplication_write_tracking;
 
             if (UVM_ID_IS_VALID(policy->preferred_location)) {
                 uvm_processor_get_uuid(policy->preferred_location, &params->preferred_location);
@@ -2333,3 +2337,71 @@ out:
     return status;
 }
 
+static NV_STATUS test_write_tracking_range_info(UVM_TEST_VA_RANGE_INFO_PARAMS *info_params,
+                                                NvU64 lookup_address,
+                                                struct file *filp)
+{
+    NV_STATUS status;
+
+    memset(info_params, 0, sizeof(*info_params));
+    info_params->lookup_address = lookup_address;
+
+    status = uvm_test_va_range_info(info_params, filp);
+    if (status != NV_OK)
+        return status;
+
+    if (info_params->type != UVM_TEST_VA_RANGE_TYPE_MANAGED)
+        return NV_ERR_INVALID_ADDRESS;
+
+    return NV_OK;
+}
+
+NV_STATUS uvm_test_read_duplication_write_tracking(UVM_TEST_READ_DUPLICATION_WRITE_TRACKING_PARAMS *params,
+                                                   struct file *filp)
+{
+    UVM_SET_READ_DUPLICATION_WRITE_TRACKING_PARAMS set_params = {0};
+    UVM_TEST_VA_RANGE_INFO_PARAMS *info_params;
+    const NvU64 last_address = params->base + params->length - 1;
+    const NvBool modes[] = { NV_TRUE, NV_FALSE };
+    size_t i;
+    NV_STATUS status = NV_OK;
+
+    if (params->length == 0)
+        return NV_ERR_INVALID_ADDRESS;
+
+    // The params are too large for the stack
+    info_params = uvm_kvmalloc(sizeof(*info_params));
+    if (!info_params)
+        return NV_ERR_NO_MEMORY;
+
+    set_params.requestedBase = params->base;
+    set_params.length = params->length;
+
+    for (i = 0; i < ARRAY_SIZE(modes); i++) {
+        const NvBool expected = modes[i];
+
+        set_params.enable = expected;
+        status = uvm_api_set_read_duplication_write_tracking(&set_params, filp);
+        if (status != NV_OK)
+            goto done;
+
+        status = test_write_tracking_range_info(info_params, params->base, filp);
+        if (status != NV_OK)
+            goto done;
+
+        TEST_CHECK_GOTO(info_params->read_duplication_write_tracking == expected, done);
+        TEST_CHECK_GOTO(info_params->va_range_start == params->base, done);
+
+        status = test_write_tracking_range_info(info_params, last_address, filp);
+        if (status != NV_OK)
+            goto done;
+
+        TEST_CHECK_GOTO(info_params->read_duplication_write_tracking == expected, done);
+        TEST_CHECK_GOTO(info_params->va_range_end == last_address, done);
+    }
+
+done:
+    uvm_kvfree(info_params);
+
+    return status;
+}
@@ -1137,5 +1137,7 @@ NV_STATUS uvm_test_va_range_split(UVM_TEST_VA_RANGE_SPLIT_PARAMS *params, struct
 NV_STATUS uvm_test_va_range_inject_split_error(UVM_TEST_VA_RANGE_INJECT_SPLIT_ERROR_PARAMS *params, struct file *filp);
 NV_STATUS uvm_test_va_range_inject_add_gpu_va_space_error(UVM_TEST_VA_RANGE_INJECT_ADD_GPU_VA_SPACE_ERROR_PARAMS *params,
                                                           struct file *filp);
+NV_STATUS uvm_test_read_duplication_write_tracking(UVM_TEST_READ_DUPLICATION_WRITE_TRACKING_PARAMS *params,
+                                                   struct file *filp);
 
 #endif // __UVM_VA_RANGE_H__
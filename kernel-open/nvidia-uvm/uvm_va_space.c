@@ -190,7 +190,14 @@ NV_STATUS uvm_va_space_create(struct address_space *mapping, uvm_va_space_t **va
         return NV_ERR_INVALID_ARGUMENT;
     }
 
+    va_space->tools.numa_counters = uvm_kvmalloc_zero(sizeof(*va_space->tools.numa_counters) * nr_node_ids);
+    if (!va_space->tools.numa_counters) {
+        uvm_kvfree(va_space);
+        return NV_ERR_NO_MEMORY;
+    }
+
     uvm_init_rwsem(&va_space->lock, UVM_LOCK_ORDER_VA_SPACE);
+    uvm_range_lock_init(&va_space->range_lock, UVM_LOCK_ORDER_VA_SPACE_RANGE);
     uvm_mutex_init(&va_space->closest_processors.mask_mutex, UVM_LOCK_ORDER_LEAF);
     uvm_mutex_init(&va_space->serialize_writers_lock, UVM_LOCK_ORDER_VA_SPACE_SERIALIZE_WRITERS);
     uvm_mutex_init(&va_space->read_acquire_write_release_lock,
@@ -233,6 +240,7 @@ NV_STATUS uvm_va_space_create(struct address_space *mapping, uvm_va_space_t **va
 
     va_space->mapping = mapping;
     va_space->test.page_prefetch_enabled = true;
+    uvm_perf_prefetch_streams_init(&va_space->prefetch_streams);
 
     init_tools_data(va_space);
 
@@ -294,6 +302,7 @@ fail:
     // called after releasing the locks.
     uvm_va_space_mm_unregister(va_space);
 
+    uvm_kvfree(va_space->tools.numa_counters);
     uvm_kvfree(va_space);
 
     return status;
@@ -625,7 +634,10 @@ void uvm_va_space_destroy(uvm_va_space_t *va_space)
 
     uvm_mutex_unlock(&g_uvm_global.global_lock);
 
+    uvm_range_lock_deinit(&va_space->range_lock);
+
     uvm_kvfree(va_space->mapping);
+    uvm_kvfree(va_space->tools.numa_counters);
     uvm_kvfree(va_space);
 }
 
@@ -28,6 +28,7 @@
 #include "uvm_global.h"
 #include "uvm_gpu.h"
 #include "uvm_range_tree.h"
+#include "uvm_range_lock.h"
 #include "uvm_range_group.h"
 #include "uvm_forward_decl.h"
 #include "uvm_mmu.h"
@@ -183,6 +184,15 @@ typedef struct
     uvm_parent_gpu_t *routing_table[UVM_PARENT_ID_MAX_GPUS];
 } uvm_egm_numa_node_info_t;
 
+// Migration counters of a NUMA node, reported by
+// UVM_TOOLS_GET_NUMA_MIGRATION_COUNTERS
+typedef struct
+{
+    atomic64_t pages_in;
+    atomic64_t pages_out;
+    atomic64_t pages_misplaced;
+} uvm_va_space_numa_counters_t;
+
 struct uvm_va_space_struct
 {
     // Mask of gpus registered with the va space
@@ -206,6 +216,11 @@ struct uvm_va_space_struct
     // Semaphore protecting the state of the va space
     uvm_rw_semaphore_t lock;
 
+    // Range lock serializing policy changes on HMM ranges, which are done with
+    // the VA space lock held in read mode. See
+    // UVM_LOCK_ORDER_VA_SPACE_RANGE in uvm_lock.h.
+    uvm_range_lock_t range_lock;
+
     // Lock taken prior to taking the VA space lock in write mode, or prior to
     // taking the VA space lock in read mode on a path which will call in RM.
     // See UVM_LOCK_ORDER_VA_SPACE_SERIALIZE_WRITERS in uvm_lock.h.
@@ -352,6 +367,9 @@ struct uvm_va_space_struct
     // Array of modules that are loaded in the va_space, indexed by module type
     uvm_perf_module_t *perf_modules[UVM_PERF_MODULE_TYPE_COUNT];
 
+    // Cross-block stream detector used by the prefetching heuristics
+    uvm_perf_prefetch_streams_t prefetch_streams;
+
     // Lists of counters listening for events on this VA space
     // Protected by lock
     struct
@@ -361,12 +379,17 @@ struct uvm_va_space_struct
         uvm_rw_semaphore_t lock;
 
         // Lists of counters listening for events on this VA space
-        struct list_head counters[UVM_TOTAL_COUNTERS];
+        struct list_head counters[UVM_TOTAL_COUNTERS_V3];
         struct list_head queues[UvmEventNumTypesAll];
         struct list_head queues_v2[UvmEventNumTypesAll];
 
         // Node for this va_space in global subscribers list
         struct list_head node;
+
+        // Per-NUMA node migration counters, indexed by node ID, with
+        // nr_node_ids entries. Unlike the counters above, they are always
+        // updated.
+        uvm_va_space_numa_counters_t *numa_counters;
     } tools;
 
     // Boolean which is 1 if all user channels have been already stopped. This
@@ -497,6 +520,17 @@ void uvm_va_space_destroy(uvm_va_space_t *va_space);
         uvm_mutex_unlock(&(__va_space)->serialize_writers_lock);        \
     } while (0)
 
+// Assert that the policy of [start, end] can be changed by the caller, either
+// because the VA space lock is held in write mode, or because it's held in
+// read mode along with the VA space range lock covering the range.
+#define uvm_va_space_assert_policy_locked(__va_space, __start, __end) ({                         \
+        typeof(__va_space) _va_space_ = (__va_space);                                           \
+        UVM_ASSERT(uvm_check_locked(&_va_space_->lock, UVM_LOCK_FLAGS_MODE_EXCLUSIVE) ||        \
+                   (uvm_check_locked(&_va_space_->lock, UVM_LOCK_FLAGS_MODE_SHARED) &&          \
+                    uvm_range_lock_is_locked(&_va_space_->range_lock, (__start), (__end)) &&      \
+                    uvm_check_locked(&_va_space_->range_lock, UVM_LOCK_FLAGS_MODE_EXCLUSIVE))); \
+    })
+
 // Get a registered gpu by uuid. This restricts the search for GPUs, to those
 // that have been registered with a va_space. This returns NULL if the GPU is
 // not present, or not registered with the va_space.